@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+// This program measures LightweightTimeslots::CollisionAvoidance on the
+// periodicities of a large number of end devices at one data rate (DR5 and
+// its 63552 slots per hour by default). The end devices send every 1, 2, 5,
+// 10, 15 or 30 minutes at a random offset, so that many of them collide. The
+// program reports the time per call, the number of end devices that were
+// moved and the number of end devices that still share a slot with another
+// one.
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cstdio>
+#include <vector>
+
+using namespace ns3;
+
+// The number of end devices that share at least one slot with another one
+static uint32_t
+CountColliding (const std::vector<Periodicity> &periodicities, uint32_t nSlots)
+{
+  std::vector<uint32_t> counter (nSlots, 0);
+  for (uint32_t i = 0; i < periodicities.size (); i++)
+    {
+      for (int64_t slot = periodicities[i].o; slot < nSlots; slot += periodicities[i].p)
+        {
+          if (slot >= 0)
+            {
+              counter[slot]++;
+            }
+        }
+    }
+  uint32_t colliding = 0;
+  for (uint32_t i = 0; i < periodicities.size (); i++)
+    {
+      for (int64_t slot = periodicities[i].o; slot < nSlots; slot += periodicities[i].p)
+        {
+          if (slot >= 0 && counter[slot] > 1)
+            {
+              colliding++;
+              break;
+            }
+        }
+    }
+  return colliding;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nDevices = 5000;
+  uint32_t dataRateIndex = 5;
+  uint32_t nRuns = 5;
+
+  CommandLine cmd;
+  cmd.AddValue ("nDevices", "Number of end devices", nDevices);
+  cmd.AddValue ("dataRateIndex", "Data rate of the end devices", dataRateIndex);
+  cmd.AddValue ("nRuns", "Number of calls to CollisionAvoidance", nRuns);
+  cmd.Parse (argc, argv);
+
+  Ptr<LightweightTimeslots> timeslots = CreateObject<LightweightTimeslots> ();
+  const uint32_t nSlots = LightweightTimeslots::m_timeSlotsPerDataRate[dataRateIndex].m_slots;
+  const double intervals[] = {60.0, 120.0, 300.0, 600.0, 900.0, 1800.0};
+
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  std::vector<Periodicity> periodicities (nDevices);
+  for (uint32_t i = 0; i < nDevices; i++)
+    {
+      const double interval = intervals[random->GetInteger (0, 5)];
+      periodicities[i].p = static_cast<int> (interval / 3600.0 * nSlots + 0.5);
+      periodicities[i].o = random->GetInteger (0, periodicities[i].p - 1);
+      periodicities[i].uID = i + 1;
+      periodicities[i].change = 0;
+      periodicities[i].changeThisRound = 0;
+    }
+  const uint32_t collidingBefore = CountColliding (periodicities, nSlots);
+
+  std::vector<Periodicity> result;
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t run = 0; run < nRuns; run++)
+    {
+      result = periodicities;
+      timeslots->CollisionAvoidance (result, 0.2, dataRateIndex);
+    }
+  const int64_t ms = clock.End ();
+
+  uint32_t moved = 0;
+  for (uint32_t i = 0; i < result.size (); i++)
+    {
+      if (result[i].changeThisRound != 0)
+        {
+          moved++;
+        }
+    }
+
+  std::printf ("%u end devices at DR%u (%u slots)\n", nDevices, dataRateIndex, nSlots);
+  std::printf ("CollisionAvoidance: %.2f ms per call\n", double (ms) / nRuns);
+  std::printf ("moved: %u, colliding before: %u, after: %u\n", moved, collidingBefore, CountColliding (result, nSlots));
+
+  return 0;
+}
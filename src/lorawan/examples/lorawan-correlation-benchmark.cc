@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+// This program measures the correlations behind
+// LightweightTimeslots::FindCandidateSolutionAutocorrelation on timeslot
+// sequences of the length of DR5 (63552 slots). The sequences hold the
+// transmissions of a few periodic end devices. Every sequence is
+// autocorrelated and then correlated with a pulse train, once with
+// LoRaWANCorrelator and once with the complex to complex correlation over
+// 3 * N - 1 samples that the lightweight timeslots used before. The program
+// reports the time per sequence of both and the largest difference between
+// their results.
+//
+// When the sequences fit the correlator of a data rate, the program also
+// compares the candidate solution of the dense (FFT) path of
+// FindCandidateSolutionAutocorrelation with the one of the sparse path, which
+// works on the slots with a transmission only.
+#include <ns3/core-module.h>
+#include <ns3/lorawan-correlator.h>
+#include <ns3/lightweight-timeslots.h>
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
+using namespace ns3;
+
+// The complex to complex correlation of LightweightTimeslots::CorrelationDR5
+class ReferenceCorrelator
+{
+public:
+  ReferenceCorrelator (uint32_t size)
+    : m_size (size),
+      m_transformSize (3 * size - 1)
+  {
+    m_inX = fftw_alloc_complex (m_transformSize);
+    m_outX = fftw_alloc_complex (m_transformSize);
+    m_inY = fftw_alloc_complex (m_transformSize);
+    m_outY = fftw_alloc_complex (m_transformSize);
+    m_inZ = fftw_alloc_complex (m_transformSize);
+    m_outZ = fftw_alloc_complex (m_transformSize);
+    std::fill (&m_inX[0][0], &m_inX[0][0] + 2 * m_transformSize, 0.0);
+    std::fill (&m_inY[0][0], &m_inY[0][0] + 2 * m_transformSize, 0.0);
+    m_pX = fftw_plan_dft_1d (m_transformSize, m_inX, m_outX, FFTW_FORWARD, FFTW_ESTIMATE);
+    m_pY = fftw_plan_dft_1d (m_transformSize, m_inY, m_outY, FFTW_FORWARD, FFTW_ESTIMATE);
+    m_pZ = fftw_plan_dft_1d (m_transformSize, m_inZ, m_outZ, FFTW_BACKWARD, FFTW_ESTIMATE);
+  }
+
+  ~ReferenceCorrelator ()
+  {
+    fftw_destroy_plan (m_pX);
+    fftw_destroy_plan (m_pY);
+    fftw_destroy_plan (m_pZ);
+    fftw_free (m_inX);
+    fftw_free (m_outX);
+    fftw_free (m_inY);
+    fftw_free (m_outY);
+    fftw_free (m_inZ);
+    fftw_free (m_outZ);
+  }
+
+  // z receives the 2 * N - 1 lags, lag 0 is at index N - 1
+  void Correlate (const std::vector<unsigned char> &x, const std::vector<unsigned char> &y, std::vector<float> &z)
+  {
+    int ysize = y.size ();
+    for (int i = 0; i < ysize; i++)
+      {
+        m_inX[i][0] = x[i];
+      }
+    for (int i = 0; i < ysize; i++)
+      {
+        m_inY[i][0] = y[ysize - 1 - i];
+      }
+
+    fftw_execute (m_pX);
+    fftw_execute (m_pY);
+    for (uint32_t i = 0; i < m_transformSize; i++)
+      {
+        m_inZ[i][0] = (m_outX[i][0] * m_outY[i][0]) - (m_outX[i][1] * m_outY[i][1]);
+        m_inZ[i][1] = (m_outX[i][0] * m_outY[i][1]) + (m_outX[i][1] * m_outY[i][0]);
+      }
+    fftw_execute (m_pZ);
+
+    z.resize (2 * m_size - 1);
+    for (uint32_t i = 0; i < z.size (); i++)
+      {
+        z[i] = std::abs (std::complex<double> (m_outZ[i][0], m_outZ[i][1])) / m_transformSize;
+      }
+  }
+
+private:
+  uint32_t m_size;
+  uint32_t m_transformSize;
+  fftw_complex *m_inX, *m_outX, *m_inY, *m_outY, *m_inZ, *m_outZ;
+  fftw_plan m_pX, m_pY, m_pZ;
+};
+
+// A pulse train with the periodicity of the largest autocorrelation
+static std::vector<unsigned char>
+GetPulseTrain (const std::vector<float> &autocorrelation, uint32_t zeroLag, uint32_t size)
+{
+  uint32_t periodicity = 1;
+  float max = 0.0;
+  for (uint32_t i = zeroLag + 2; i < autocorrelation.size (); i++)
+    {
+      if (autocorrelation[i] + autocorrelation[i - 1] > max)
+        {
+          max = autocorrelation[i] + autocorrelation[i - 1];
+          periodicity = i - zeroLag - (autocorrelation[i] > autocorrelation[i - 1] ? 0 : 1);
+        }
+    }
+  std::vector<unsigned char> pulses (size, 0);
+  for (uint32_t i = 0; i < size; i += periodicity)
+    {
+      pulses[i] = 1;
+    }
+  return pulses;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nSlots = 63552;
+  uint32_t nSequences = 20;
+  uint32_t nDevices = 5;
+
+  CommandLine cmd;
+  cmd.AddValue ("nSlots", "Number of timeslots per sequence", nSlots);
+  cmd.AddValue ("nSequences", "Number of sequences", nSequences);
+  cmd.AddValue ("nDevices", "Number of periodic end devices per sequence", nDevices);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  std::vector<std::vector<unsigned char> > sequences (nSequences, std::vector<unsigned char> (nSlots, 0));
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      for (uint32_t d = 0; d < nDevices; d++)
+        {
+          const uint32_t periodicity = random->GetInteger (nSlots / 20, nSlots / 4);
+          for (uint32_t i = random->GetInteger (0, periodicity - 1); i < nSlots; i += periodicity)
+            {
+              sequences[s][i] = 1;
+            }
+        }
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  ReferenceCorrelator reference (nSlots);
+  const int64_t referenceSetupMs = clock.End ();
+  clock.Start ();
+  LoRaWANCorrelator correlator (nSlots);
+  const int64_t correlatorSetupMs = clock.End ();
+
+  std::vector<std::vector<float> > referenceResults (nSequences);
+  clock.Start ();
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      std::vector<float> autocorrelation;
+      reference.Correlate (sequences[s], sequences[s], autocorrelation);
+      reference.Correlate (sequences[s], GetPulseTrain (autocorrelation, nSlots - 1, nSlots), referenceResults[s]);
+      referenceResults[s].insert (referenceResults[s].end (), autocorrelation.begin () + nSlots - 1, autocorrelation.end ());
+    }
+  const int64_t referenceMs = clock.End ();
+
+  std::vector<std::vector<float> > results (nSequences);
+  clock.Start ();
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      std::vector<float> autocorrelation;
+      correlator.Autocorrelate (sequences[s], autocorrelation);
+      correlator.Correlate (sequences[s], GetPulseTrain (autocorrelation, 0, nSlots), results[s]);
+      results[s].insert (results[s].end (), autocorrelation.begin (), autocorrelation.end ());
+    }
+  const int64_t correlatorMs = clock.End ();
+
+  // Both hold the non negative lags of the correlation with the pulse train,
+  // followed by the ones of the autocorrelation
+  double maxDifference = 0.0;
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      for (uint32_t m = 0; m < nSlots; m++)
+        {
+          maxDifference = std::max (maxDifference, std::fabs (double (results[s][m]) - referenceResults[s][nSlots - 1 + m]));
+          maxDifference = std::max (maxDifference, std::fabs (double (results[s][nSlots + m]) - referenceResults[s][2 * nSlots - 1 + m]));
+        }
+    }
+
+  std::printf ("%u sequences of %u slots with %u periodic end devices\n", nSequences, nSlots, nDevices);
+  std::printf ("complex 3N-1:    setup %5lld ms, %8.2f ms per sequence\n",
+               (long long) referenceSetupMs, double (referenceMs) / nSequences);
+  std::printf ("r2c %6u:     setup %5lld ms, %8.2f ms per sequence (%.2fx)\n", correlator.GetTransformSize (),
+               (long long) correlatorSetupMs, double (correlatorMs) / nSequences,
+               correlatorMs > 0 ? double (referenceMs) / correlatorMs : 0.0);
+  std::printf ("largest difference: %g\n", maxDifference);
+
+  uint8_t dr = 0;
+  while (dr < LightweightTimeslots::m_timeSlotsPerDataRate.size () && LightweightTimeslots::m_timeSlotsPerDataRate[dr].m_slots < nSlots)
+    {
+      dr++;
+    }
+  if (dr == LightweightTimeslots::m_timeSlotsPerDataRate.size ())
+    {
+      return 0;
+    }
+
+  Ptr<LightweightTimeslots> timeslots = CreateObject<LightweightTimeslots> ();
+  std::vector<std::vector<uint32_t> > hits (nSequences);
+  uint64_t nHits = 0;
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      for (uint32_t i = 0; i < nSlots; i++)
+        {
+          if (sequences[s][i])
+            {
+              hits[s].push_back (i);
+            }
+        }
+      nHits += hits[s].size ();
+    }
+
+  std::vector<std::tuple<int, int> > dense (nSequences);
+  clock.Start ();
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      dense[s] = timeslots->FindCandidateSolutionDenseAutocorrelation (sequences[s], dr);
+    }
+  const int64_t denseMs = clock.End ();
+
+  uint32_t mismatches = 0;
+  clock.Start ();
+  for (uint32_t s = 0; s < nSequences; s++)
+    {
+      if (timeslots->FindCandidateSolutionSparseAutocorrelation (hits[s], dr) != dense[s])
+        {
+          mismatches++;
+        }
+    }
+  const int64_t sparseMs = clock.End ();
+
+  std::printf ("candidate solution at DR%u, %.1f transmissions per sequence (%s):\n", dr, double (nHits) / nSequences,
+               LightweightTimeslots::IsSparse (nHits / nSequences, nSlots) ? "sparse" : "dense");
+  std::printf ("dense:  %8.3f ms per sequence\n", double (denseMs) / nSequences);
+  std::printf ("sparse: %8.3f ms per sequence, %u different candidates\n", double (sparseMs) / nSequences, mismatches);
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+// This program measures the time needed to compute chunk success rates with
+// the analytic LoRaWAN error model and with the table based modes of the
+// model, for a sweep of SNRs and chunk sizes over all spreading factors and
+// code rates.
+#include <ns3/core-module.h>
+#include <ns3/lorawan-error-model.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+static double
+RunBenchmark (Ptr<LoRaWANErrorModel> model, uint32_t iterations, double &checksum)
+{
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t it = 0; it < iterations; it++)
+    {
+      for (uint8_t sf = LORAWAN_SF7; sf <= LORAWAN_SF12; sf++)
+        {
+          for (uint8_t codeRate = 1; codeRate <= 3; codeRate += 2)
+            {
+              for (double snr = -26.0; snr < 0.0; snr += 0.1)
+                {
+                  checksum += model->GetChunkSuccessRate (snr, 8 + it % 256, 125000, static_cast<LoRaSpreadingFactor> (sf), codeRate);
+                }
+            }
+        }
+    }
+  return clock.End ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t iterations = 200;
+
+  CommandLine cmd;
+  cmd.AddValue ("iterations", "Number of sweeps over all SF, CR and SNR values", iterations);
+  cmd.Parse (argc, argv);
+
+  const uint32_t calls = iterations * 6 * 2 * 260;
+
+  Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
+  model->SetAttribute ("SuccessRateMode", EnumValue (LoRaWANErrorModel::TABLE_CUBIC));
+  double checksum = 0.0;
+  // Build the tables outside of the measurement
+  model->GetChunkSuccessRate (0.0, 8, 125000, LORAWAN_SF7, 1);
+
+  const char *names[] = {"Analytic", "TableLinear", "TableCubic"};
+  const LoRaWANErrorModel::SuccessRateMode modes[] = {LoRaWANErrorModel::ANALYTIC,
+                                                       LoRaWANErrorModel::TABLE_LINEAR,
+                                                       LoRaWANErrorModel::TABLE_CUBIC};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      model->SetAttribute ("SuccessRateMode", EnumValue (modes[i]));
+      double ms = RunBenchmark (model, iterations, checksum);
+      std::cout << names[i] << ": " << calls << " calls in " << ms << " ms ("
+                << (ms * 1e6 / calls) << " ns/call)" << std::endl;
+    }
+  std::cout << "checksum: " << checksum << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,188 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+// This program measures how fast the network server handles upstream frames
+// when it serves a large number of end devices (one million by default).
+// It first compares looking up the per device state of random end devices in
+// the network server's device table with looking it up in an unordered_map,
+// and then feeds upstream frames of random end devices to
+// LoRaWANNetworkServer::HandleUSPacket. The frames are built outside of the
+// measurement. After every batch of frames the simulator runs until the
+// deduplication windows of the batch closed, which is when the network server
+// processes the frames. The deduplication window is short, so that the whole
+// run takes less simulated time than RECEIVE_DELAY1 and the receive window
+// timers of the frames do not expire.
+//
+// The timeslot recorder of an end device keeps four bytes per recorded
+// frame, so the default run needs about 1.2 GB of memory, most of it for the
+// two device tables of the lookup benchmark.
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cstdio>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace ns3;
+
+// The addresses of the end devices, in order of addition
+static uint32_t
+GetDeviceAddress (uint32_t i)
+{
+  return i + 1;
+}
+
+// A pseudo random sequence of end device indices
+static uint32_t
+GetRandomDevice (uint32_t &state, uint32_t nDevices)
+{
+  state = state * 1664525u + 1013904223u;
+  return static_cast<uint32_t> ((static_cast<uint64_t> (state) * nDevices) >> 32);
+}
+
+static void
+RunLookupBenchmark (uint32_t nDevices, uint32_t nLookups)
+{
+  typedef LoRaWANDeviceTable<LoRaWANEndDeviceInfoNS, LoRaWANEndDeviceColdInfoNS> Table;
+  Table table;
+  table.Reserve (nDevices);
+  std::unordered_map<uint32_t, LoRaWANEndDeviceInfoNS> map;
+  map.reserve (nDevices);
+  for (uint32_t i = 0; i < nDevices; i++)
+    {
+      table.Insert (GetDeviceAddress (i));
+      map[GetDeviceAddress (i)] = LoRaWANEndDeviceInfoNS ();
+    }
+
+  uint32_t state = 1;
+  uint64_t checksum = 0;
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t i = 0; i < nLookups; i++)
+    {
+      LoRaWANEndDeviceInfoNS &info = table.GetHot (table.Find (GetDeviceAddress (GetRandomDevice (state, nDevices))));
+      checksum += ++info.m_fCntUp;
+    }
+  double tableMs = clock.End ();
+
+  state = 1;
+  clock.Start ();
+  for (uint32_t i = 0; i < nLookups; i++)
+    {
+      LoRaWANEndDeviceInfoNS &info = map.find (GetDeviceAddress (GetRandomDevice (state, nDevices)))->second;
+      checksum += ++info.m_fCntUp;
+    }
+  double mapMs = clock.End ();
+
+  std::cout << "LoRaWANDeviceTable: " << nLookups << " lookups in " << tableMs << " ms ("
+            << (tableMs * 1e6 / nLookups) << " ns/lookup)" << std::endl;
+  std::cout << "unordered_map: " << nLookups << " lookups in " << mapMs << " ms ("
+            << (mapMs * 1e6 / nLookups) << " ns/lookup)" << std::endl;
+  std::cout << "checksum: " << checksum << std::endl;
+}
+
+static void
+RunUplinkBenchmark (uint32_t nDevices, uint32_t nUplinks)
+{
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  ns->SetAttribute ("DeduplicationWindow", TimeValue (MicroSeconds (400)));
+  ns->Initialize ();
+  Ptr<LoRaWANGatewayApplication> gw = CreateObject<LoRaWANGatewayApplication> ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t i = 0; i < nDevices; i++)
+    {
+      ns->AddEndDevice (Ipv4Address (GetDeviceAddress (i)));
+    }
+  double addMs = clock.End ();
+  std::cout << "AddEndDevice: " << nDevices << " end devices in " << addMs << " ms" << std::endl;
+
+  // Feed the frames in batches, to bound the memory of the prebuilt frames
+  const uint32_t batchSize = 10000;
+  std::vector<Ptr<Packet> > batch;
+  std::vector<uint16_t> fCntUp (nDevices, 0);
+  uint32_t state = 1;
+  double handleMs = 0;
+  for (uint32_t done = 0; done < nUplinks; done += batch.size ())
+    {
+      batch.clear ();
+      for (uint32_t i = 0; i < batchSize && done + i < nUplinks; i++)
+        {
+          const uint32_t device = GetRandomDevice (state, nDevices);
+          LoRaWANFrameHeaderUplink fhdr;
+          fhdr.setDevAddr (Ipv4Address (GetDeviceAddress (device)));
+          fhdr.setFrameCounter (++fCntUp[device]);
+          fhdr.setFramePort (1);
+          Ptr<Packet> packet = Create<Packet> (20);
+          packet->AddHeader (fhdr);
+
+          LoRaWANPhyParamsTag phyParamsTag;
+          phyParamsTag.SetChannelIndex (0);
+          phyParamsTag.SetDataRateIndex (0);
+          phyParamsTag.SetCodeRate (3);
+          packet->AddPacketTag (phyParamsTag);
+          LoRaWANMsgTypeTag msgTypeTag;
+          msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+          packet->AddPacketTag (msgTypeTag);
+          batch.push_back (packet);
+        }
+
+      clock.Start ();
+      for (std::vector<Ptr<Packet> >::const_iterator it = batch.begin (); it != batch.end (); ++it)
+        {
+          ns->HandleUSPacket (gw, Address (), *it);
+        }
+      Simulator::Stop (MicroSeconds (500));
+      Simulator::Run ();
+      handleMs += clock.End ();
+    }
+
+  std::cout << "HandleUSPacket: " << nUplinks << " frames in " << handleMs << " ms ("
+            << (handleMs * 1e3 / nUplinks) << " us/frame, " << (nUplinks / handleMs) << " frames/ms)" << std::endl;
+
+  // Drop the report that the network server prints for every end device when
+  // it is disposed
+  std::cout.flush ();
+  if (!std::freopen ("/dev/null", "w", stdout))
+    {
+      std::cerr << "Unable to discard the network server report" << std::endl;
+    }
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nDevices = 1000000;
+  uint32_t nLookups = 10000000;
+  uint32_t nUplinks = 1000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("nDevices", "Number of end devices served by the network server", nDevices);
+  cmd.AddValue ("nLookups", "Number of device state lookups", nLookups);
+  cmd.AddValue ("nUplinks", "Number of upstream frames handled by the network server", nUplinks);
+  cmd.Parse (argc, argv);
+
+  RunLookupBenchmark (nDevices, nLookups);
+  RunUplinkBenchmark (nDevices, nUplinks);
+
+  Simulator::Destroy ();
+  return 0;
+}
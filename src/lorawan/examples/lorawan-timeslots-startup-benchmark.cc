@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+// This program measures the start-up of LightweightTimeslots, which creates
+// a correlator with FFTW plans for every data rate. The first instance of the
+// process plans the transforms, the later ones share its plans. With
+// --measure the plans are measured instead of estimated. With --wisdomFile
+// the FFTW wisdom is read from and written to a file, so that the second run
+// of the program with the same file no longer measures.
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cstdio>
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nInstances = 10;
+  bool measure = false;
+  std::string wisdomFile = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("nInstances", "Number of LightweightTimeslots after the first one", nInstances);
+  cmd.AddValue ("measure", "Measure the FFTW plans instead of estimating them", measure);
+  cmd.AddValue ("wisdomFile", "File to read and write the FFTW wisdom, empty for none", wisdomFile);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::LightWeightTimeslots::MeasureFftwPlans", BooleanValue (measure));
+  Config::SetDefault ("ns3::LightWeightTimeslots::FftwWisdomFile", StringValue (wisdomFile));
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Ptr<LightweightTimeslots> first = CreateObject<LightweightTimeslots> ();
+  const int64_t firstMs = clock.End ();
+
+  clock.Start ();
+  for (uint32_t i = 0; i < nInstances; i++)
+    {
+      CreateObject<LightweightTimeslots> ();
+    }
+  const int64_t laterMs = clock.End ();
+
+  std::printf ("%s plans%s%s\n", measure ? "measured" : "estimated",
+               wisdomFile.empty () ? "" : ", wisdom file ", wisdomFile.c_str ());
+  std::printf ("first instance: %lld ms, %u plans\n", (long long) firstMs, LoRaWANCorrelator::GetPlanCacheSize ());
+  std::printf ("later instances: %.2f ms per instance\n", nInstances > 0 ? double (laterMs) / nInstances : 0.0);
+
+  return 0;
+}
@@ -22,7 +22,7 @@
 #include <ns3/lorawan-net-device.h>
 #include <ns3/simulator.h>
 #include <ns3/mobility-model.h>
-#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/lorawan-spectrum-channel.h>
 #include <ns3/multi-model-spectrum-channel.h>
 #include <ns3/propagation-loss-model.h>
 #include <ns3/propagation-delay-model.h>
@@ -37,7 +37,7 @@ LoRaWANHelper::LoRaWANHelper (void) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_
 {
   m_nbRep = 1;
 
-  m_channel = CreateObject<SingleModelSpectrumChannel> ();
+  m_channel = CreateObject<LoRaWANSpectrumChannel> ();
 
   Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
   m_channel->AddPropagationLossModel (lossModel);
@@ -54,7 +54,7 @@ LoRaWANHelper::LoRaWANHelper (bool useMultiModelSpectrumChannel) : m_deviceType
     }
   else
     {
-      m_channel = CreateObject<SingleModelSpectrumChannel> ();
+      m_channel = CreateObject<LoRaWANSpectrumChannel> ();
     }
   Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
   m_channel->AddPropagationLossModel (lossModel);
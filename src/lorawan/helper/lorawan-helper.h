@@ -40,7 +40,7 @@ class LoRaWANHelper {
 public:
   /**
    * \brief Create a LoRaWAN helper in an empty state.  By default, a
-   * SingleModelSpectrumChannel is created, with a 
+   * LoRaWANSpectrumChannel is created, with a 
    * LogDistancePropagationLossModel and a ConstantSpeedPropagationDelayModel.
    *
    * To change the channel type, loss model, or delay model, the Get/Set
@@ -50,8 +50,8 @@ public:
 
   /**
    * \brief Create a LoRaWAN helper in an empty state with either a
-   * SingleModelSpectrumChannel or a MultiModelSpectrumChannel.
-   * \param useMultiModelSpectrumChannel use a MultiModelSpectrumChannel if true, a SingleModelSpectrumChannel otherwise
+   * LoRaWANSpectrumChannel or a MultiModelSpectrumChannel.
+   * \param useMultiModelSpectrumChannel use a MultiModelSpectrumChannel if true, a LoRaWANSpectrumChannel otherwise
    *
    * A LogDistancePropagationLossModel and a 
    * ConstantSpeedPropagationDelayModel are added to the channel.
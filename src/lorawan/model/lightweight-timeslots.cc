@@ -10,8 +10,11 @@
 #include <chrono>
 #include <complex> 
 #include <ns3/log.h>
+#include <ns3/string.h>
+#include <ns3/boolean.h>
 
 #include "lightweight-timeslots.h"
+#include "lorawan-slot-occupancy.h"
 
 #define PI 3.14159265
 
@@ -19,6 +22,8 @@
 
 #define MAX_C 3 //DR dependent
 
+#define SPARSE_AUTOCORRELATION_DIVISOR 8 //see IsSparse
+
 /*
 
 The scoring function of TiCom was used to judge the quality of (p, o) pairs.
@@ -82,6 +87,18 @@ LightweightTimeslots::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName("LoRaWAN")
     .AddConstructor<LightweightTimeslots> ()
+    .AddAttribute ("FftwWisdomFile",
+                   "File with FFTW wisdom: read before the correlators are planned and "
+                   "rewritten when planning added wisdom. Empty for none.",
+                   StringValue (""),
+                   MakeStringAccessor (&LightweightTimeslots::m_fftwWisdomFile),
+                   MakeStringChecker ())
+    .AddAttribute ("MeasureFftwPlans",
+                   "Let FFTW measure the fastest plans (FFTW_MEASURE) instead of estimating them. "
+                   "Measuring takes seconds for the larger data rates, use FftwWisdomFile to only pay it once.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LightweightTimeslots::m_measureFftwPlans),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -133,12 +150,8 @@ LightweightTimeslots::GetTypeId (void)
   */
 
   //For a 64 byte packet:
-  uint32_t DR0_size = m_timeSlotsPerDataRate[0].m_slots;
-  uint32_t DR1_size = m_timeSlotsPerDataRate[1].m_slots;
-  uint32_t DR2_size = m_timeSlotsPerDataRate[2].m_slots;
-  uint32_t DR3_size = m_timeSlotsPerDataRate[3].m_slots;
-  uint32_t DR4_size = m_timeSlotsPerDataRate[4].m_slots;
-  uint32_t DR5_size = m_timeSlotsPerDataRate[5].m_slots;
+  // the correlators of the data rates are created in NotifyConstructionCompleted
+  correlation_holder.reserve(m_timeSlotsPerDataRate.back().m_slots);
 
 
   //For a 33 byte packet:
@@ -156,147 +169,31 @@ LightweightTimeslots::GetTypeId (void)
   int DR4_size = 27000;
   int DR5_size = 50000;*/
 
-  //DR0
-  inX_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR0_size + DR0_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR0_size + DR0_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR0_size + DR0_size*2 - 1));
-  outY_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR0_size + DR0_size*2 - 1));
-
-  inZ_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR0_size + DR0_size*2 - 1));
-  outZ_DR0 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR0_size + DR0_size*2 - 1));
-
-  pX_DR0 = fftw_plan_dft_1d(DR0_size + DR0_size*2 - 1, inX_DR0, outX_DR0, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR0 = fftw_plan_dft_1d(DR0_size + DR0_size*2 - 1, inY_DR0, outY_DR0, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR0 = fftw_plan_dft_1d(DR0_size + DR0_size*2 - 1, inZ_DR0, outZ_DR0, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-  correlation_holder_DR0 = std::vector<float>(DR0_size*2 - 1);
-
-  //DR1
-  inX_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR1_size + DR1_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR1_size + DR1_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR1_size + DR1_size*2 - 1));
-  outY_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR1_size + DR1_size*2 - 1));
-
-  inZ_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR1_size + DR1_size*2 - 1));
-  outZ_DR1 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR1_size + DR1_size*2 - 1));
-
-  pX_DR1 = fftw_plan_dft_1d(DR1_size + DR1_size*2 - 1, inX_DR1, outX_DR1, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR1 = fftw_plan_dft_1d(DR1_size + DR1_size*2 - 1, inY_DR1, outY_DR1, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR1 = fftw_plan_dft_1d(DR1_size + DR1_size*2 - 1, inZ_DR1, outZ_DR1, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-  correlation_holder_DR1 = std::vector<float>(DR1_size*2 - 1);
-
-  //DR2
-  inX_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR2_size + DR2_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR2_size + DR2_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR2_size + DR2_size*2 - 1));
-  outY_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR2_size + DR2_size*2 - 1));
-
-  inZ_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR2_size + DR2_size*2 - 1));
-  outZ_DR2 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR2_size + DR2_size*2 - 1));
-
-  pX_DR2 = fftw_plan_dft_1d(DR2_size + DR2_size*2 - 1, inX_DR2, outX_DR2, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR2 = fftw_plan_dft_1d(DR2_size + DR2_size*2 - 1, inY_DR2, outY_DR2, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR2 = fftw_plan_dft_1d(DR2_size + DR2_size*2 - 1, inZ_DR2, outZ_DR2, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-  correlation_holder_DR2 = std::vector<float>(DR2_size*2 - 1);
-
-  //DR3
-  inX_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR3_size + DR3_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR3_size + DR3_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR3_size + DR3_size*2 - 1));
-  outY_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR3_size + DR3_size*2 - 1));
-
-  inZ_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR3_size + DR3_size*2 - 1));
-  outZ_DR3 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR3_size + DR3_size*2 - 1));
-
-  pX_DR3 = fftw_plan_dft_1d(DR3_size + DR3_size*2 - 1, inX_DR3, outX_DR3, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR3 = fftw_plan_dft_1d(DR3_size + DR3_size*2 - 1, inY_DR3, outY_DR3, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR3 = fftw_plan_dft_1d(DR3_size + DR3_size*2 - 1, inZ_DR3, outZ_DR3, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-  correlation_holder_DR3 = std::vector<float>(DR3_size*2 - 1);
-
-  //DR4
-  inX_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR4_size + DR4_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR4_size + DR4_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR4_size + DR4_size*2 - 1));
-  outY_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR4_size + DR4_size*2 - 1));
-
-  inZ_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR4_size + DR4_size*2 - 1));
-  outZ_DR4 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR4_size + DR4_size*2 - 1));
-
-  pX_DR4 = fftw_plan_dft_1d(DR4_size + DR4_size*2 - 1, inX_DR4, outX_DR4, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR4 = fftw_plan_dft_1d(DR4_size + DR4_size*2 - 1, inY_DR4, outY_DR4, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR4 = fftw_plan_dft_1d(DR4_size + DR4_size*2 - 1, inZ_DR4, outZ_DR4, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-  correlation_holder_DR4 = std::vector<float>(DR4_size*2 - 1);
-
-  //DR5
-  inX_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR5_size + DR5_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-  outX_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR5_size + DR5_size*2 - 1)); //x.size for the data, and x.size*2-1 for the 0 padding
-
-  inY_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR5_size + DR5_size*2 - 1));
-  outY_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR5_size + DR5_size*2 - 1));
+}
 
-  inZ_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (DR5_size + DR5_size*2 - 1));
-  outZ_DR5 = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) *(DR5_size + DR5_size*2 - 1));
+void LightweightTimeslots::NotifyConstructionCompleted (void) {
+  Object::NotifyConstructionCompleted ();
 
-  pX_DR5 = fftw_plan_dft_1d(DR5_size + DR5_size*2 - 1, inX_DR5, outX_DR5, FFTW_FORWARD, FFTW_ESTIMATE);
-  pY_DR5 = fftw_plan_dft_1d(DR5_size + DR5_size*2 - 1, inY_DR5, outY_DR5, FFTW_FORWARD, FFTW_ESTIMATE);
-  pZ_DR5 = fftw_plan_dft_1d(DR5_size + DR5_size*2 - 1, inZ_DR5, outZ_DR5, FFTW_BACKWARD, FFTW_ESTIMATE);
+  if(!m_fftwWisdomFile.empty()) {
+    LoRaWANCorrelator::ImportWisdom(m_fftwWisdomFile);
+  }
 
-  correlation_holder_DR5 = std::vector<float>(DR5_size*2 - 1);
+  // One correlator per data rate, sized for the sequence of time slots of the data rate. The FFTW plans are shared with the
+  // correlators of the other instances, only the first instance of the process plans them
+  const uint32_t nPlans = LoRaWANCorrelator::GetPlanCacheSize();
+  for(uint i=0; i<m_timeSlotsPerDataRate.size(); i++) {
+    m_correlators.push_back(new LoRaWANCorrelator(m_timeSlotsPerDataRate[i].m_slots, m_measureFftwPlans));
+  }
 
+  if(!m_fftwWisdomFile.empty() && LoRaWANCorrelator::GetPlanCacheSize() != nPlans) {
+    LoRaWANCorrelator::ExportWisdom(m_fftwWisdomFile);
+  }
 }
 
 LightweightTimeslots::~LightweightTimeslots (void) {
-  fftw_free(inX_DR0);
-  fftw_free(inY_DR0);
-  fftw_free(outX_DR0);
-  fftw_free(outY_DR0);
-  fftw_free(inZ_DR0);
-  fftw_free(outZ_DR0);
-
-  fftw_free(inX_DR1);
-  fftw_free(inY_DR1);
-  fftw_free(outX_DR1);
-  fftw_free(outY_DR1);
-  fftw_free(inZ_DR1);
-  fftw_free(outZ_DR1);
-
-  fftw_free(inX_DR2);
-  fftw_free(inY_DR2);
-  fftw_free(outX_DR2);
-  fftw_free(outY_DR2);
-  fftw_free(inZ_DR2);
-  fftw_free(outZ_DR2);
-
-
-  fftw_free(inX_DR3);
-  fftw_free(inY_DR3);
-  fftw_free(outX_DR3);
-  fftw_free(outY_DR3);
-  fftw_free(inZ_DR3);
-  fftw_free(outZ_DR3);
-
-  fftw_free(inX_DR4);
-  fftw_free(inY_DR4);
-  fftw_free(outX_DR4);
-  fftw_free(outY_DR4);
-  fftw_free(inZ_DR4);
-  fftw_free(outZ_DR4);
-
-  fftw_free(inX_DR5);
-  fftw_free(inY_DR5);
-  fftw_free(outX_DR5);
-  fftw_free(outY_DR5);
-  fftw_free(inZ_DR5);
-  fftw_free(outZ_DR5);
+  for(uint i=0; i<m_correlators.size(); i++) {
+    delete m_correlators[i];
+  }
 }
 
 /*void
@@ -354,6 +251,11 @@ void LightweightTimeslots::Run() {
   }*/
 }
 
+std::vector<std::tuple <int, int>> LightweightTimeslots::TiComWithAutocorrelation(const LoRaWANTimeslotsRecorder& recorder, float alpha, uint8_t dr) {
+  recorder.Unpack(m_sequence);
+  return TiComWithAutocorrelation(m_sequence, alpha, dr);
+}
+
 std::vector<std::tuple <int, int>> LightweightTimeslots::TiComWithAutocorrelation(std::vector<unsigned char>& O, float alpha, uint8_t dr) {
   std::vector<unsigned char> O_filter(O);
 
@@ -534,296 +436,114 @@ float LightweightTimeslots::TiComScore(std::tuple <int, int> s, std::vector<unsi
 
 
 
-std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionAutocorrelation(const std::vector<unsigned char>& O, uint8_t dr) {
-
-  if(dr == 0) {
-       //autocorrelate the sequence to find a candidate periodicity
-  CorrelationDR0(O, O, correlation_holder_DR0);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder_DR0.size() / 2;
+bool LightweightTimeslots::IsSparse(uint32_t k, uint32_t n) {
+  // sorting k^2 / 2 distances against two forward and one inverse FFT of about 2n samples, at -O2 the sparse path
+  // is faster up to k^2 of about n log2(n) / 10 (DR0 to DR3) and n log2(n) / 4 (DR5)
+  return uint64_t(k) * k * SPARSE_AUTOCORRELATION_DIVISOR <= uint64_t(n) * uint64_t(std::log2(std::max<uint32_t>(n, 2)));
+}
 
-  //choose the max value found
-  float max_autoc = 0.0;
-  for(uint i=start_point+2; i<correlation_holder_DR0.size();i++){
-    if(correlation_holder_DR0[i] + correlation_holder_DR0[i-1] > max_autoc) {
-      max_autoc = correlation_holder_DR0[i] + correlation_holder_DR0[i-1];
-      if(correlation_holder_DR0[i] > correlation_holder_DR0[i-1]) {
-          periodicity = i - start_point;
-      } else {
-          periodicity = i - 1 -  start_point;  
-      }
+std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionAutocorrelation(const std::vector<unsigned char>& O, uint8_t dr) {
+  m_hits.clear();
+  for(uint i=0; i<O.size(); i++) {
+    if(O[i]) {
+      m_hits.push_back(i);
     }
   }
-
-  if(periodicity == 0) {
-    return std::tuple<int, int>(1, 0);
+  if(IsSparse(m_hits.size(), O.size())) {
+    return FindCandidateSolutionSparseAutocorrelation(m_hits, dr);
   }
+  return FindCandidateSolutionDenseAutocorrelation(O, dr);
+}
 
-  /*if(periodicity == 214) {
-    periodicity++;
-  }*/
-  //std::cout << "periodicity DR0 " << periodicity << std::endl;
-
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
-  }
-  
+std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionSparseAutocorrelation(const std::vector<uint32_t>& hits, uint8_t dr) {
+  const uint32_t nLags = m_correlators[std::min<uint8_t>(dr, m_correlators.size() - 1)]->GetSize();
 
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  CorrelationDR0(O, O_copy2, correlation_holder_DR0);
-  float max = 0.0;
-  int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR0.size();i++) {
-    if(correlation_holder_DR0[i] > max) {
-      max = correlation_holder_DR0[i];
-      index = i-start_point;
+  //the autocorrelation at lag m is the number of pairs of transmissions m slots apart, so only the distances have a nonzero autocorrelation
+  m_distances.clear();
+  for(uint i=0; i<hits.size(); i++) {
+    for(uint j=0; j<i; j++) {
+      m_distances.push_back(hits[i] - hits[j]);
     }
   }
+  std::sort(m_distances.begin(), m_distances.end());
 
-  return std::tuple<int, int>(int(periodicity), index);
-  }
-  else if(dr == 1)
-  {
-    CorrelationDR1(O, O, correlation_holder_DR1);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder_DR1.size() / 2;
-
-  //choose the max value found
-  float max_autoc = 0.0;
-  for(uint i=start_point+2; i<correlation_holder_DR1.size();i++){
-    if(correlation_holder_DR1[i] + correlation_holder_DR1[i-1] > max_autoc) {
-      max_autoc = correlation_holder_DR1[i] + correlation_holder_DR1[i-1];
-      if(correlation_holder_DR1[i] > correlation_holder_DR1[i-1]) {
-          periodicity = i - start_point;
-      } else {
-          periodicity = i - 1 -  start_point;  
-      }
+  //the same search as the dense path, over the lags i where a[i] or a[i-1] is nonzero, in increasing order
+  uint32_t periodicity = 0;
+  uint32_t max_autoc = 0;
+  uint32_t previous = 0;       // the lag of the previous run of distances
+  uint32_t previousCount = 0;  // and its autocorrelation
+  uint x = 0;
+  while(x < m_distances.size()) {
+    const uint32_t lag = m_distances[x];
+    uint32_t count = 0;
+    while(x < m_distances.size() && m_distances[x] == lag) {
+      count++;
+      x++;
     }
-  }
+    const bool nextIsAdjacent = x < m_distances.size() && m_distances[x] == lag + 1;
 
-  if(periodicity == 0) {
-    return std::tuple<int, int>(1, 0);
-  }
-
-  /*if(periodicity == 385) { //temp fix
-    periodicity--;
-  }*/
-
-  //std::cout << "periodicity DR1 " << periodicity << std::endl;
-
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
-  }
-  
-
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  //std::cout << "correlation to find angle" << std::endl;
-  CorrelationDR1(O, O_copy2, correlation_holder_DR1);
-  float max = 0.0;
-  int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR1.size();i++) {
-    if(correlation_holder_DR1[i] > max) {
-      max = correlation_holder_DR1[i];
-      index = i-start_point;
+    //i = lag, a[i - 1] is the previous run if adjacent
+    const uint32_t before = (previousCount > 0 && previous + 1 == lag) ? previousCount : 0;
+    if(lag >= 2 && lag < nLags && count + before > max_autoc) {
+      max_autoc = count + before;
+      periodicity = count > before ? lag : lag - 1;
     }
-  }
-
-  return std::tuple<int, int>(int(periodicity), index);
-  }
-  else if(dr == 2) 
-  {
-    CorrelationDR2(O, O, correlation_holder_DR2);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder_DR2.size() / 2;
-
-  //choose the max value found
-  float max_autoc = 0.0;
-  for(uint i=start_point+2; i<correlation_holder_DR2.size();i++){
-    if(correlation_holder_DR2[i] + correlation_holder_DR2[i-1] > max_autoc) {
-      max_autoc = correlation_holder_DR2[i] + correlation_holder_DR2[i-1];
-      if(correlation_holder_DR2[i] > correlation_holder_DR2[i-1]) {
-          periodicity = i - start_point;
-      } else {
-          periodicity = i - 1 -  start_point;  
-      }
+    //i = lag + 1 with a[i] = 0, unless the next run is at lag + 1 and handles it
+    if(!nextIsAdjacent && lag + 1 >= 2 && lag + 1 < nLags && count > max_autoc) {
+      max_autoc = count;
+      periodicity = lag;
     }
+    previous = lag;
+    previousCount = count;
   }
 
   if(periodicity == 0) {
     return std::tuple<int, int>(1, 0);
   }
-  /*if(periodicity == 859) {
-    periodicity++;
-  }*/
 
-  //std::cout << "periodicity DR2 " << periodicity << std::endl;
-
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
+  //the correlation with the pulse train of that periodicity at lag m counts the transmissions h >= m with h - m a multiple of the
+  //periodicity, which is largest at the smallest lag of a residue class: the offset is the most frequent residue, the smallest on ties
+  m_distances.clear();
+  for(uint i=0; i<hits.size(); i++) {
+    m_distances.push_back(hits[i] % periodicity);
   }
-  
-
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  CorrelationDR2(O, O_copy2, correlation_holder_DR2);
-  float max = 0.0;
+  std::sort(m_distances.begin(), m_distances.end());
+  uint32_t max = 0;
   int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR2.size();i++) {
-    if(correlation_holder_DR2[i] > max) {
-      max = correlation_holder_DR2[i];
-      index = i-start_point;
-    }
-  }
-
-  return std::tuple<int, int>(int(periodicity), index);
-  }
-  else if(dr == 3) 
-  {
-    CorrelationDR3(O, O, correlation_holder_DR3);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder_DR3.size() / 2;
-
-  //choose the max value found
-  float max_autoc = 0.0;
-  //std::cout << "autocorrelation start" << std::endl;
-  for(uint i=start_point+2; i<correlation_holder_DR3.size();i++){
-    if(correlation_holder_DR3[i] + correlation_holder_DR3[i-1] > max_autoc) {
-
-      max_autoc = correlation_holder_DR3[i] + correlation_holder_DR3[i-1];
-      if(correlation_holder_DR3[i] > correlation_holder_DR3[i-1]) {
-          periodicity = i - start_point;
-      } else {
-          periodicity = i - 1 -  start_point;  
-      }
-      //periodicity = i - start_point;
-      //std::cout << "found a max at: " << periodicity << " " << max_autoc << std::endl;
-
+  x = 0;
+  while(x < m_distances.size()) {
+    const uint32_t residue = m_distances[x];
+    uint32_t count = 0;
+    while(x < m_distances.size() && m_distances[x] == residue) {
+      count++;
+      x++;
     }
-    /*if(i-start_point == 1538) {
-        std::cout << "val at 1538 is " << correlation_holder_DR3[i] << std::endl;
-      }
-    if(i-start_point == 1539) {
-        std::cout << "val at 1539 is " << correlation_holder_DR3[i] << std::endl;
-      }
-    if(i-start_point == 1540) {
-        std::cout << "val at 1540 is " << correlation_holder_DR3[i] << std::endl;
-      }
-    if(i-start_point == 3076) {
-        std::cout << "val at 3076 is " << correlation_holder_DR3[i] << std::endl;
-      }
-    if(i-start_point == 3077) {
-        std::cout << "val at 3077 is " << correlation_holder_DR3[i] << std::endl;
-      }
-    if(i-start_point == 3078) {
-        std::cout << "val at 3078 is " << correlation_holder_DR3[i] << std::endl;
-      }*/
-  }
-  //std::cout << "max value was " << correlation_holder_DR3.size() - (start_point+1) << std::endl;
- // std::cout << std::endl;
-
-  if(periodicity == 0) {
-    return std::tuple<int, int>(1, 0);
-  }
-  /*if(periodicity == 1538) {
-    periodicity++;
-  }*/
-
-  //std::cout << "periodicity DR3 " << periodicity << std::endl;
-
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
-  }
-  
-
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  CorrelationDR3(O, O_copy2, correlation_holder_DR3);
-  float max = 0.0;
-  int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR3.size();i++) {
-    if(correlation_holder_DR3[i] > max) {
-      max = correlation_holder_DR3[i];
-      index = i-start_point;
+    if(count > max) {
+      max = count;
+      index = residue;
     }
   }
 
   return std::tuple<int, int>(int(periodicity), index);
-  }
-  else if (dr == 4) {
-    CorrelationDR4(O, O, correlation_holder_DR4);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder_DR4.size() / 2;
-
-  //choose the max value found
-  float max_autoc = 0.0;
-
-  for(uint i=start_point+2; i<correlation_holder_DR4.size();i++){
-    if(correlation_holder_DR4[i] + correlation_holder_DR4[i-1] > max_autoc) {
-      max_autoc = correlation_holder_DR4[i] + correlation_holder_DR4[i-1];
-      if(correlation_holder_DR4[i] > correlation_holder_DR4[i-1]) {
-          periodicity = i - start_point;
-      } else {
-          periodicity = i - 1 -  start_point;  
-      }
-    }
-  }
-
-  if(periodicity == 0) {
-    return std::tuple<int, int>(1, 0);
-  }
-  /*if(periodicity == 2777) {
-    periodicity++;
-  }*/
-
-  //std::cout << "periodicity DR4 " << periodicity << std::endl;
+}
 
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
-  }
-  
+std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionDenseAutocorrelation(const std::vector<unsigned char>& O, uint8_t dr) {
+  LoRaWANCorrelator *correlator = m_correlators[std::min<uint8_t>(dr, m_correlators.size() - 1)];
 
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  CorrelationDR4(O, O_copy2, correlation_holder_DR4);
-  float max = 0.0;
-  int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR4.size();i++) {
-    if(correlation_holder_DR4[i] > max) {
-      max = correlation_holder_DR4[i];
-      index = i-start_point;
-    }
-  }
-
-  return std::tuple<int, int>(int(periodicity), index);
-  }
-  else /*if(dr == 5) */
-  {
-    CorrelationDR5(O, O, correlation_holder_DR5);
+  //autocorrelate the sequence to find a candidate periodicity, the holder is indexed by lag
+  correlator->Autocorrelate(O, correlation_holder);
 
   float periodicity = 0.0;
-  int start_point = correlation_holder_DR5.size() / 2;
 
   //choose the max value found
   float max_autoc = 0.0;
-  for(uint i=start_point+2; i<correlation_holder_DR5.size();i++){
-    if(correlation_holder_DR5[i] + correlation_holder_DR5[i-1] > max_autoc) {
-      max_autoc = correlation_holder_DR5[i] + correlation_holder_DR5[i-1];
-      if(correlation_holder_DR5[i] > correlation_holder_DR5[i-1]) {
-          periodicity = i - start_point;
+  for(uint i=2; i<correlation_holder.size();i++){
+    if(correlation_holder[i] + correlation_holder[i-1] > max_autoc) {
+      max_autoc = correlation_holder[i] + correlation_holder[i-1];
+      if(correlation_holder[i] > correlation_holder[i-1]) {
+          periodicity = i;
       } else {
-          periodicity = i - 1 -  start_point;  
+          periodicity = i - 1;
       }
     }
   }
@@ -832,70 +552,24 @@ std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionAutocorrelation(
     return std::tuple<int, int>(1, 0);
   }
 
-  /*if(periodicity == 5084) { //these must be changed
-    periodicity++;
-  }*/
-  //std::cout << "periodicity DR5 " << periodicity << std::endl;
-
   // generate a sequence with that periodicity with the offset 0
   std::vector<unsigned char> O_copy2(O.size(), 0);
   for(uint i=0;i<O_copy2.size();i+=periodicity) {
     O_copy2[i] = 1;
   }
-  
 
   //get the correlation of that sequence with the original sequence, and find the angle between them 
-  CorrelationDR5(O, O_copy2, correlation_holder_DR5);
+  correlator->Correlate(O, O_copy2, correlation_holder);
   float max = 0.0;
   int index = 0;
-  for(uint i=start_point; i<correlation_holder_DR5.size();i++) {
-    if(correlation_holder_DR5[i] > max) {
-      max = correlation_holder_DR5[i];
-      index = i-start_point;
-    }
-  }
-
-  return std::tuple<int, int>(int(periodicity), index);
-  }
-  //autocorrelate the sequence to find a candidate periodicity
-  /*Correlation(O, O, correlation_holder);
-
-  float periodicity = 0.0;
-  int start_point = correlation_holder.size() / 2;
-
-  //choose the max value found
-  float max_autoc = 0.0;
-  for(uint i=start_point+1; i<correlation_holder.size();i++){
-    if(correlation_holder[i] > max_autoc) {
-
-      max_autoc = correlation_holder[i];
-      periodicity = i - start_point;
-    }
-  }
-
-  if(periodicity == 0) {
-    return std::tuple<int, int>(1, 0);
-  }
-
-  // generate a sequence with that periodicity with the offset 0
-  std::vector<unsigned char> O_copy2(O.size(), 0);
-  for(uint i=0;i<O_copy2.size();i+=periodicity) {
-    O_copy2[i] = 1;
-  }
-  
-
-  //get the correlation of that sequence with the original sequence, and find the angle between them 
-  Correlation(O, O_copy2, correlation_holder);
-  float max = 0.0;
-  int index = 0;
-  for(uint i=start_point; i<correlation_holder.size();i++) {
+  for(uint i=0; i<correlation_holder.size();i++) {
     if(correlation_holder[i] > max) {
       max = correlation_holder[i];
-      index = i-start_point;
+      index = i;
     }
   }
 
-  return std::tuple<int, int>(int(periodicity), index);*/
+  return std::tuple<int, int>(int(periodicity), index);
 }
 
 /*void LightweightTimeslots::Correlation(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
@@ -986,187 +660,6 @@ std::tuple<int, int> LightweightTimeslots::FindCandidateSolutionAutocorrelation(
   }
 }*/
 
-void LightweightTimeslots::CorrelationDR0(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR0[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR0[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR0);
-  fftw_execute(pY_DR0);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR0[i][0] = (outX_DR0[i][0] * outY_DR0[i][0]) - (outX_DR0[i][1] * outY_DR0[i][1]);
-    inZ_DR0[i][1] = (outX_DR0[i][0] * outY_DR0[i][1]) + (outX_DR0[i][1] * outY_DR0[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR0);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR0[i][0], outZ_DR0[i][1])) / (x.size()*3 - 1);
-  }
-}
-
-void LightweightTimeslots::CorrelationDR1(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR1[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR1[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR1);
-  fftw_execute(pY_DR1);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR1[i][0] = (outX_DR1[i][0] * outY_DR1[i][0]) - (outX_DR1[i][1] * outY_DR1[i][1]);
-    inZ_DR1[i][1] = (outX_DR1[i][0] * outY_DR1[i][1]) + (outX_DR1[i][1] * outY_DR1[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR1);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR1[i][0], outZ_DR1[i][1])) / (x.size()*3 - 1);
-  }
-}
-
-void LightweightTimeslots::CorrelationDR2(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR2[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR2[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR2);
-  fftw_execute(pY_DR2);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR2[i][0] = (outX_DR2[i][0] * outY_DR2[i][0]) - (outX_DR2[i][1] * outY_DR2[i][1]);
-    inZ_DR2[i][1] = (outX_DR2[i][0] * outY_DR2[i][1]) + (outX_DR2[i][1] * outY_DR2[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR2);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR2[i][0], outZ_DR2[i][1])) / (x.size()*3 - 1);
-  }
-}
-
-void LightweightTimeslots::CorrelationDR3(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR3[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR3[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR3);
-  fftw_execute(pY_DR3);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR3[i][0] = (outX_DR3[i][0] * outY_DR3[i][0]) - (outX_DR3[i][1] * outY_DR3[i][1]);
-    inZ_DR3[i][1] = (outX_DR3[i][0] * outY_DR3[i][1]) + (outX_DR3[i][1] * outY_DR3[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR3);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR3[i][0], outZ_DR3[i][1])) / (x.size()*3 - 1);
-  }
-}
-
-void LightweightTimeslots::CorrelationDR4(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR4[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR4[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR4);
-  fftw_execute(pY_DR4);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR4[i][0] = (outX_DR4[i][0] * outY_DR4[i][0]) - (outX_DR4[i][1] * outY_DR4[i][1]);
-    inZ_DR4[i][1] = (outX_DR4[i][0] * outY_DR4[i][1]) + (outX_DR4[i][1] * outY_DR4[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR4);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR4[i][0], outZ_DR4[i][1])) / (x.size()*3 - 1);
-  }
-}
-
-
-void LightweightTimeslots::CorrelationDR5(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z)
-{
-  //put input data in to in inX and inY. Put y in backwards as this is correlation, not convolution
-  int ysize = y.size();
-  for(int i=0;i<ysize;i++) {
-    inX_DR5[i][0] = x[i];
-  }
-
-  for(int i=0;i<ysize;i++) {
-    inY_DR5[i][0] = y[ysize - 1 - i];
-  }
-
-  fftw_execute(pX_DR5);
-  fftw_execute(pY_DR5);
-
-  //perform element-wise multiplication of x and y (multiplying the complex numbers)
-  //(x + yi)(u + vi) = (xu - yv) + (xv + yu)i
-  for(uint i=0;i<x.size()*3 - 1;i++) {
-    inZ_DR5[i][0] = (outX_DR5[i][0] * outY_DR5[i][0]) - (outX_DR5[i][1] * outY_DR5[i][1]);
-    inZ_DR5[i][1] = (outX_DR5[i][0] * outY_DR5[i][1]) + (outX_DR5[i][1] * outY_DR5[i][0]);    
-  }
-
-  //get ifft of result
-  fftw_execute(pZ_DR5);
-
-  for(uint i=0;i<z.size();i++) {
-    z[i] = std::abs(std::complex<double>(outZ_DR5[i][0], outZ_DR5[i][1])) / (x.size()*3 - 1);
-  }
-}
-
 int LightweightTimeslots::Main(int argc, const char** argv) {
   LightweightTimeslots* lightweightTimeslots = new LightweightTimeslots();
 
@@ -1207,6 +700,14 @@ void LightweightTimeslots::CollisionAvoidance(std::vector<Periodicity>& periodic
   }*/
 
 
+  //the number of transmissions in every slot, built once and updated whenever a device moves
+  uint32_t DR_size = m_timeSlotsPerDataRate[dataRateIndex].m_slots;
+  int maxPush = m_maxTimeSlotPushPerDataRate[dataRateIndex];
+  LoRaWANSlotOccupancy occupancy(DR_size);
+  for(uint i=0; i<periodicities.size(); i++) {
+    occupancy.Add(periodicities[i].p, periodicities[i].o, 1);
+  }
+
   for(uint p=0; p<4; p++) {
     float acceptableNewOverlap = 0.0;
     if(p==0) {
@@ -1218,58 +719,35 @@ void LightweightTimeslots::CollisionAvoidance(std::vector<Periodicity>& periodic
     } else if (p==3) {
       acceptableNewOverlap = 1000;
     }
-    //std::cout << "round " << p << std::endl;
 
-    uint32_t DR_size = m_timeSlotsPerDataRate[dataRateIndex].m_slots;
-  std::vector<unsigned int> period_counter = std::vector<unsigned int>(DR_size, 0);
-  for(uint i=0; i<periodicities.size(); i++) {
-      for(int l=0;l<=(DR_size / periodicities[i].p);l++) {
-          if((l*periodicities[i].p)+periodicities[i].o < period_counter.size()) {
-              period_counter[(l*periodicities[i].p)+periodicities[i].o]++;
-          }
-        
+    uint runEnd = 0;
+    for(uint i=0; i<periodicities.size(); i++) {
+      int period = periodicities[i].p;
+      if(i == runEnd) {
+        //the periodicities are sorted by p, so devices i to runEnd - 1 share this p
+        while(runEnd < periodicities.size() && periodicities[runEnd].p == period) {
+          runEnd++;
+        }
       }
-  }
-  /*std::cout << "start of counter (before)" << std::endl;
-  for(uint i=0; i<DR_size / 6;i++) {
-    std::cout << period_counter[i] << " ";
-  }
-  std::cout << std::endl;
-  std::cout << "end of counter" << std::endl;
-*/
-  for(uint i=0; i<periodicities.size(); i++) {
-      float overlapCount = 0;
-      int numSlots = 0;
-      for(int l=0;l<=(DR_size / periodicities[i].p);l++) { //count the number of transmissions that overlapped with this device in this period
-          if((l*periodicities[i].p)+periodicities[i].o < period_counter.size()) {
-              overlapCount += period_counter[(l*periodicities[i].p)+periodicities[i].o] - 1; // -1 to discount it's own transmission in this slot
-              numSlots++;
-          } 
-        
-      }   
-      /*std::cout << "overlapCount before division " << overlapCount << " and numSlots " << numSlots << std::endl;
-      if(numSlots == 0) {
-        std::cout << "numSlots is 0, here is the po: " << periodicities[i].p << " " << periodicities[i].o << std::endl;
-      } */
-      overlapCount /= numSlots; //get an average count per transmission
-      //std::cout << "overlapCount for device " << periodicities[i].uID << " is " << overlapCount << std::endl;
-
-      if(overlapCount >= 1) { //if there was on average 1 or more overlapping transmissions for this device using this offset 
+
+      //the average count of other transmissions in the slots of this device
+      float overlapCount = occupancy.GetOverlap(period, periodicities[i].o);
+
+      if(overlapCount >= 1) { //if there was on average 1 or more overlapping transmissions for this device using this offset
+          //evaluate the candidates through the strided view of this p once building it is cheaper than
+          //scanning the slot trains of the candidates of the rest of the devices with this p
+          if(occupancy.GetStride() != uint32_t(period)
+             && uint64_t(runEnd - i) * (maxPush + 1) * (DR_size / period) >= DR_size) {
+            occupancy.SetStride(period);
+          }
+
           //check if there is a better potential spot
           float bestOverlap = overlapCount;
           int bestSlot = periodicities[i].o;
-          for(int m=periodicities[i].o - periodicities[i].change; m <= periodicities[i].o - periodicities[i].change + m_maxTimeSlotPushPerDataRate[dataRateIndex]; m++) {
-              //std::cout << m << " ";
-              if(m != periodicities[i].o) {
-                  float currOverlap = 0;
-                  int numSlotM = 0;
-                  for(int n=0;n<(DR_size / periodicities[i].p) ;n++) {
-                      if((n*periodicities[i].p)+m < period_counter.size()) {
-                          currOverlap += period_counter[(n*periodicities[i].p)+m];
-                          numSlotM++;  
-                      } 
-                  }
-                  currOverlap /= numSlotM;
+          for(int m=periodicities[i].o - periodicities[i].change; m <= periodicities[i].o - periodicities[i].change + maxPush; m++) {
+              //skip candidates that have no slots in the period, there is nothing to compare
+              if(m != periodicities[i].o && occupancy.HasCandidateSlots(period, m)) {
+                  float currOverlap = occupancy.GetCandidateOverlap(period, m);
 
                   if(currOverlap < bestOverlap) {
                     bestOverlap = currOverlap;
@@ -1280,89 +758,27 @@ void LightweightTimeslots::CollisionAvoidance(std::vector<Periodicity>& periodic
                   }
               }
           }
-          //std::cout << std::endl;
 
           if(bestOverlap != overlapCount && bestOverlap <= acceptableNewOverlap) { //we're going to move this device to a better slot
-              //std::cout << "old overlap: " << overlapCount  << " best overlap: " << bestOverlap << std::endl;
-              //std::cout << "changing from " << periodicities[i].o << " to " << bestSlot << std::endl; 
-            //printf("change we're going to use: from: %u to %u for device %u\r\n", periodicities[i].o, bestSlot, periodicities[i].uID);
-            //std::cout << "change we're going to use: from: " << periodicities[i].o << " to " << bestSlot << std::endl; 
-              //modify the period_counter to reflect this
-
-            //TODO: check if, based on the changes to the other periodicities of this device, this will overall improve the system or not. If not, don't do it.
-
-              for(int l=0;l<(DR_size / periodicities[i].p);l++) {
-                  if((l*periodicities[i].p)+periodicities[i].o < period_counter.size()) {
-                      period_counter[(l*periodicities[i].p)+periodicities[i].o]--;  
-                  }
-                  if((l*periodicities[i].p)+bestSlot < period_counter.size()) {
-                      period_counter[(l*periodicities[i].p)+bestSlot]++;  
-                  }
-                    
-              }
-               
+              //TODO: check if, based on the changes to the other periodicities of this device, this will overall improve the system or not. If not, don't do it.
+              occupancy.Move(period, periodicities[i].o, bestSlot);
 
               if(bestSlot > periodicities[i].o) { //then make the change
                   periodicities[i].changeThisRound += bestSlot - periodicities[i].o;
                   periodicities[i].change += bestSlot - periodicities[i].o;
                   periodicities[i].o = bestSlot;
               } else {
-                  //std::cout << "j before (o>=B) " << periodicities[j].o << " " << periodicities[j].change << " "  << (int) periodicities[j].changeThisRound << std::endl;
                   periodicities[i].changeThisRound += bestSlot - periodicities[i].o;
                   periodicities[i].change -= periodicities[i].o - bestSlot;
                   periodicities[i].o = bestSlot;
-                  //std::cout << "j after (o>=B)" << periodicities[j].o << " " << periodicities[j].change << " "  << (int) periodicities[j].changeThisRound << std::endl;
               }
 
-              //then also modify all of the device's other periodicities
-              //TODO: removing possibility of other periodicities for now
-              /*for(uint k=0; k<periodicities.size(); k++) {
-                  
-                  if(periodicities[i].uID == periodicities[k].uID && i!=k) {
-                      for(int l=0;l<(DR_size / periodicities[k].p);l++) {
-                          if((l*periodicities[k].p)+periodicities[k].o < period_counter.size()) {
-                              period_counter[(l*periodicities[k].p)+periodicities[k].o]--;  
-                          }
-                          if((l*periodicities[k].p) + (periodicities[k].o + periodicities[i].changeThisRound) < period_counter.size()) {
-                              period_counter[(l*periodicities[k].p) + (periodicities[k].o + periodicities[i].changeThisRound)]++;  
-                          }
-                      }
-                      std::cout << "the device is " << periodicities[k].uID << std::endl;
-                      std::cout << "i that has been changed: " << periodicities[i].o << " " << periodicities[i].change << " "  << (int) periodicities[i].changeThisRound << std::endl;
-                      std::cout << "k is going to change: " << periodicities[k].o << " " << periodicities[k].change << " "  << (int) periodicities[k].changeThisRound << std::endl;
-                      //TODO: this is definitely wrong somehow.
-                      if(periodicities[i].changeThisRound > 0) {
-                          periodicities[k].changeThisRound += periodicities[i].changeThisRound;
-                          periodicities[k].change += periodicities[i].changeThisRound;
-                          periodicities[k].o += periodicities[i].changeThisRound;  
-                      } else {
-                          periodicities[k].changeThisRound += periodicities[i].changeThisRound;
-                          periodicities[k].change -= periodicities[i].changeThisRound; //TODO: double check this works. Comparing signed and unsigned.
-                          periodicities[k].o -= periodicities[i].changeThisRound;
-                      }
-                      std::cout << "the changed k: " << periodicities[k].o << " " << periodicities[k].change << " "  << (int) periodicities[k].changeThisRound << std::endl;
-                  }
-              }*/
-              //std::cout << "there was a significant overlap for this periodicity, so we've chosen a better slot. Old: " << overlapCount << ". And best found: " << bestOverlap << std::endl;
-          } else {
-            //std::cout << "there is a significant overlap for this periodicity, but there is no better slot to place the device in. Old: " << overlapCount << ". And best found: " << bestOverlap << std::endl;
-          }  
-      } else {
-        //std::cout << "no significant overlap for this periodicity: " << overlapCount << std::endl;
-      }     
-  }
-    //if(p==3){
-    //std::cout << "start of counter (after)" << std::endl;
-  //for(uint i=0; i<DR_size / 6;i++) {
-  //  std::cout << period_counter[i] << " ";
- // }
-  //std::cout << std::endl;
-  //std::cout << "end of counter" << std::endl;  
-	//}
+              //TODO: removing possibility of other periodicities of the same device for now
+          }
+      }
+    }
   }
 
-  
-
   /*std::cout << "start of counter (2)" << std::endl;
   for(uint i=0; i<period_counter.size();i++) {
     std::cout << i << " " << period_counter[i] << std::endl;
@@ -1500,8 +916,9 @@ void LightweightTimeslots::CollisionAvoidance(std::vector<Periodicity>& periodic
 
   //we want to minimise the number of p's with changeThisRound > 0
   //so for all the p's with changeThisRound > 0, we check if any of them can move their offsets around to make one of the pair have a changeThisRound of 0.
+  //only devices with the same p can swap, and those follow each other as the list is sorted by p
   for(uint i=0; i<periodicities.size(); i++) {
-    for(uint j=i+1; j<periodicities.size(); j++) {
+    for(uint j=i+1; j<periodicities.size() && periodicities[j].p == periodicities[i].p; j++) {
         if(periodicities[i].p == periodicities[j].p 
           && periodicities[i].o + periodicities[j].changeThisRound == periodicities[j].o
           && periodicities[i].change + periodicities[j].changeThisRound  <= m_maxTimeSlotPushPerDataRate[dataRateIndex]
@@ -5,11 +5,13 @@
 #ifndef LIGHTWEIGHT_TIMESLOTS_H_
 #define LIGHTWEIGHT_TIMESLOTS_H_
 
+#include <string>
 #include <tuple>
 #include <vector>
 #include <ns3/object.h>
 
-#include <fftw3.h>
+#include <ns3/lorawan-correlator.h>
+#include <ns3/lorawan-timeslots-recorder.h>
 
 namespace ns3 {
 
@@ -40,17 +42,23 @@ public:
 
   std::vector<std::tuple <int, int>> TiComWithAutocorrelation(std::vector<unsigned char>& O, float alpha, uint8_t dr);
 
-  //void Correlation(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
+  //run TiCom on the transmissions of a recorder, expanded into the sequence buffer of this object
+  std::vector<std::tuple <int, int>> TiComWithAutocorrelation(const LoRaWANTimeslotsRecorder& recorder, float alpha, uint8_t dr);
 
-  void CorrelationDR0(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
-  void CorrelationDR1(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
-  void CorrelationDR2(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
-  void CorrelationDR3(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
-  void CorrelationDR4(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
-  void CorrelationDR5(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
+  //void Correlation(const std::vector<unsigned char>& x, const std::vector<unsigned char>& y, std::vector<float>& z);
 
+  //picks the sparse or the dense autocorrelation, both give the same candidate solution
   std::tuple<int, int> FindCandidateSolutionAutocorrelation(const std::vector<unsigned char>& O, uint8_t dr);
 
+  //the candidate solution from the FFT correlations of the whole sequence
+  std::tuple<int, int> FindCandidateSolutionDenseAutocorrelation(const std::vector<unsigned char>& O, uint8_t dr);
+
+  //the candidate solution from the distances between the slots with a transmission, O(k^2 log k) for k transmissions
+  std::tuple<int, int> FindCandidateSolutionSparseAutocorrelation(const std::vector<uint32_t>& hits, uint8_t dr);
+
+  //true if the sparse autocorrelation of k transmissions in n slots is cheaper than the FFT
+  static bool IsSparse(uint32_t k, uint32_t n);
+
   //std::tuple<int, int> FindCandidateSolutionFFT(std::vector<unsigned char> O); 
 
   //std::tuple <int, int> ArgmaxOverList(std::vector<std::tuple <int, int>> S, std::vector<unsigned char> Ps_star, std::vector<unsigned char> O, float alpha, float abs_T, float abs_F);
@@ -75,77 +83,13 @@ public:
   std::vector<unsigned char> O;
 
   
-  //DR0
-  fftw_complex *inX_DR0, *outX_DR0;
-  fftw_plan pX_DR0;
-
-  fftw_complex *inY_DR0, *outY_DR0;
-  fftw_plan pY_DR0;
-
-  fftw_complex *inZ_DR0, *outZ_DR0;
-  fftw_plan pZ_DR0;
-
-  std::vector<float> correlation_holder_DR0;
-
-  //DR1
-  fftw_complex *inX_DR1, *outX_DR1;
-  fftw_plan pX_DR1;
-
-  fftw_complex *inY_DR1, *outY_DR1;
-  fftw_plan pY_DR1;
-
-  fftw_complex *inZ_DR1, *outZ_DR1;
-  fftw_plan pZ_DR1;
-
-  std::vector<float> correlation_holder_DR1;
-
-  //DR2
-  fftw_complex *inX_DR2, *outX_DR2;
-  fftw_plan pX_DR2;
-
-  fftw_complex *inY_DR2, *outY_DR2;
-  fftw_plan pY_DR2;
-
-  fftw_complex *inZ_DR2, *outZ_DR2;
-  fftw_plan pZ_DR2;
-
-  std::vector<float> correlation_holder_DR2;
-
-  //DR3
-  fftw_complex *inX_DR3, *outX_DR3;
-  fftw_plan pX_DR3;
-
-  fftw_complex *inY_DR3, *outY_DR3;
-  fftw_plan pY_DR3;
-
-  fftw_complex *inZ_DR3, *outZ_DR3;
-  fftw_plan pZ_DR3;
-
-  std::vector<float> correlation_holder_DR3;
-
-  //DR4
-  fftw_complex *inX_DR4, *outX_DR4;
-  fftw_plan pX_DR4;
-
-  fftw_complex *inY_DR4, *outY_DR4;
-  fftw_plan pY_DR4;
-
-  fftw_complex *inZ_DR4, *outZ_DR4;
-  fftw_plan pZ_DR4;
-
-  std::vector<float> correlation_holder_DR4;
-
-  //DR5
-  fftw_complex *inX_DR5, *outX_DR5;
-  fftw_plan pX_DR5;
-
-  fftw_complex *inY_DR5, *outY_DR5;
-  fftw_plan pY_DR5;
-
-  fftw_complex *inZ_DR5, *outZ_DR5;
-  fftw_plan pZ_DR5;
-
-  std::vector<float> correlation_holder_DR5;
+  std::vector<LoRaWANCorrelator *> m_correlators; //!< The correlator of each data rate, created once the attributes are set
+  std::string m_fftwWisdomFile;                     //!< The FFTW wisdom file, empty for none
+  bool m_measureFftwPlans;                          //!< Measure the FFTW plans instead of estimating them
+  std::vector<float> correlation_holder;            //!< The correlation of the last call, indexed by lag
+  std::vector<unsigned char> m_sequence;            //!< The expanded recorder of the last call
+  std::vector<uint32_t> m_hits;                     //!< The slots with a transmission of the last sequence
+  std::vector<uint32_t> m_distances;                //!< Scratch of the sparse autocorrelation
 
   //for a 64 byte packet
   std::vector<uint8_t> m_maxTimeSlotPushPerDataRate = { //ensuring a max delay of 10s
@@ -172,6 +116,10 @@ static const std::vector<LoRaWANTimeSlotsPerDataRate> m_timeSlotsPerDataRate;
 };*/
 
   static Ptr<LightweightTimeslots> m_lorawanLightweightTimeslotsPtr;
+
+protected:
+  //creates the correlators, with the FFTW attributes
+  virtual void NotifyConstructionCompleted (void);
 };
 
 } // namespace ns3
@@ -0,0 +1,346 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-correlator.h"
+
+#include <ns3/assert.h>
+#include <ns3/log.h>
+#include <ns3/core-config.h>
+#ifdef HAVE_PTHREAD_H
+#include <ns3/system-mutex.h>
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANCorrelator");
+
+/**
+ * The FFTW plans shared by all correlators of the process and the wisdom
+ * bookkeeping. The FFTW planner is not thread safe, so planning and the
+ * wisdom functions run under one lock.
+ */
+struct LoRaWANCorrelatorPlanCache
+{
+  ~LoRaWANCorrelatorPlanCache ()
+  {
+    for (std::map<std::tuple<bool, uint32_t, bool>, fftw_plan>::iterator it = plans.begin (); it != plans.end (); it++)
+      {
+        fftw_destroy_plan (it->second);
+      }
+  }
+
+  std::map<std::tuple<bool, uint32_t, bool>, fftw_plan> plans; //!< The plans by inverse, transform size and measure
+  std::set<std::string> importedFiles;                         //!< The wisdom files read by the process
+  std::string savedWisdom;                                     //!< The wisdom as of the last import or export
+#ifdef HAVE_PTHREAD_H
+  SystemMutex mutex;                                           //!< Guards the planner and the members
+#endif
+};
+
+static LoRaWANCorrelatorPlanCache &
+GetLoRaWANCorrelatorPlanCache (void)
+{
+  static LoRaWANCorrelatorPlanCache cache;
+  return cache;
+}
+
+// The wisdom of the process, the caller holds the lock
+static std::string
+GetWisdom (void)
+{
+  char *wisdom = fftw_export_wisdom_to_string ();
+  const std::string result (wisdom ? wisdom : "");
+  fftw_free (wisdom);
+  return result;
+}
+
+LoRaWANCorrelator::LoRaWANCorrelator (uint32_t size, bool measure)
+  : m_size (size),
+    m_transformSize (GetFastTransformSize (2 * size - 1))
+{
+  NS_LOG_FUNCTION (this << size << measure);
+  NS_ASSERT (size > 0);
+
+  const uint32_t nBins = m_transformSize / 2 + 1;
+  m_inX = fftw_alloc_real (m_transformSize);
+  m_inY = fftw_alloc_real (m_transformSize);
+  m_outX = fftw_alloc_complex (nBins);
+  m_outY = fftw_alloc_complex (nBins);
+
+  m_planForward = GetPlan (false, m_transformSize, measure);
+  m_planInverse = GetPlan (true, m_transformSize, measure);
+}
+
+LoRaWANCorrelator::~LoRaWANCorrelator ()
+{
+  // The plans belong to the cache
+  fftw_free (m_inX);
+  fftw_free (m_inY);
+  fftw_free (m_outX);
+  fftw_free (m_outY);
+}
+
+uint32_t
+LoRaWANCorrelator::GetSize (void) const
+{
+  return m_size;
+}
+
+uint32_t
+LoRaWANCorrelator::GetTransformSize (void) const
+{
+  return m_transformSize;
+}
+
+uint32_t
+LoRaWANCorrelator::GetFastTransformSize (uint32_t n)
+{
+  for (uint32_t size = n; ; size++)
+    {
+      uint32_t rest = size;
+      const uint32_t primes[] = {2, 3, 5, 7};
+      for (uint32_t i = 0; i < 4; i++)
+        {
+          while (rest % primes[i] == 0)
+            {
+              rest /= primes[i];
+            }
+        }
+      if (rest == 1)
+        {
+          return size;
+        }
+    }
+}
+
+fftw_plan
+LoRaWANCorrelator::GetPlan (bool inverse, uint32_t transformSize, bool measure)
+{
+  LoRaWANCorrelatorPlanCache &cache = GetLoRaWANCorrelatorPlanCache ();
+#ifdef HAVE_PTHREAD_H
+  CriticalSection lock (cache.mutex);
+#endif
+  const std::tuple<bool, uint32_t, bool> key (inverse, transformSize, measure);
+  std::map<std::tuple<bool, uint32_t, bool>, fftw_plan>::iterator it = cache.plans.find (key);
+  if (it != cache.plans.end ())
+    {
+      return it->second;
+    }
+
+  // Measuring overwrites the arrays, so the plan is made on scratch arrays.
+  // They come from fftw_alloc like the buffers of the correlators, so that
+  // the plan can run on those with the same alignment.
+  double *real = fftw_alloc_real (transformSize);
+  fftw_complex *bins = fftw_alloc_complex (transformSize / 2 + 1);
+  const unsigned flags = measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+  fftw_plan plan = inverse ? fftw_plan_dft_c2r_1d (transformSize, bins, real, flags)
+    : fftw_plan_dft_r2c_1d (transformSize, real, bins, flags);
+  fftw_free (real);
+  fftw_free (bins);
+  NS_ASSERT_MSG (plan, "FFTW could not plan a transform of " << transformSize << " samples");
+  NS_LOG_LOGIC ("Planned the " << (inverse ? "c2r" : "r2c") << " transform of " << transformSize << " samples" << (measure ? " (measured)" : ""));
+
+  cache.plans[key] = plan;
+  return plan;
+}
+
+uint32_t
+LoRaWANCorrelator::GetPlanCacheSize (void)
+{
+  LoRaWANCorrelatorPlanCache &cache = GetLoRaWANCorrelatorPlanCache ();
+#ifdef HAVE_PTHREAD_H
+  CriticalSection lock (cache.mutex);
+#endif
+  return cache.plans.size ();
+}
+
+bool
+LoRaWANCorrelator::ImportWisdom (const std::string &filename)
+{
+  NS_LOG_FUNCTION (filename);
+  LoRaWANCorrelatorPlanCache &cache = GetLoRaWANCorrelatorPlanCache ();
+#ifdef HAVE_PTHREAD_H
+  CriticalSection lock (cache.mutex);
+#endif
+  if (cache.importedFiles.count (filename))
+    {
+      return true;
+    }
+  if (!fftw_import_wisdom_from_filename (filename.c_str ()))
+    {
+      NS_LOG_LOGIC ("No FFTW wisdom read from " << filename);
+      return false;
+    }
+  cache.importedFiles.insert (filename);
+  cache.savedWisdom = GetWisdom ();
+  return true;
+}
+
+bool
+LoRaWANCorrelator::ExportWisdom (const std::string &filename)
+{
+  NS_LOG_FUNCTION (filename);
+  LoRaWANCorrelatorPlanCache &cache = GetLoRaWANCorrelatorPlanCache ();
+#ifdef HAVE_PTHREAD_H
+  CriticalSection lock (cache.mutex);
+#endif
+  const std::string wisdom = GetWisdom ();
+  if (wisdom == cache.savedWisdom)
+    {
+      return true;
+    }
+
+  // Write a file of this process and move it over the wisdom file
+  std::ostringstream temporary;
+  temporary << filename << "." << getpid () << ".tmp";
+  {
+    std::ofstream file (temporary.str ().c_str (), std::ios::out | std::ios::trunc);
+    file << wisdom;
+    if (!file)
+      {
+        NS_LOG_WARN ("Could not write the FFTW wisdom to " << temporary.str ());
+        return false;
+      }
+  }
+  if (std::rename (temporary.str ().c_str (), filename.c_str ()) != 0)
+    {
+      NS_LOG_WARN ("Could not replace the FFTW wisdom file " << filename);
+      std::remove (temporary.str ().c_str ());
+      return false;
+    }
+  cache.savedWisdom = wisdom;
+  return true;
+}
+
+void
+LoRaWANCorrelator::Load (const std::vector<unsigned char> &x, double *in) const
+{
+  NS_ASSERT_MSG (x.size () <= m_size, "Sequence of " << x.size () << " samples is longer than " << m_size);
+  for (uint32_t i = 0; i < x.size (); i++)
+    {
+      in[i] = x[i];
+    }
+  std::memset (in + x.size (), 0, (m_transformSize - x.size ()) * sizeof (double));
+}
+
+void
+LoRaWANCorrelator::Inverse (std::vector<float> &z)
+{
+  fftw_execute_dft_c2r (m_planInverse, m_outX, m_inX);
+
+  // FFTW does not normalize, the round trip scales by the transform size.
+  // The correlations of byte sequences are integers, rounding removes the
+  // noise of the transforms, also around the lags without any correlation.
+  const double scale = 1.0 / m_transformSize;
+  z.resize (m_size);
+  for (uint32_t m = 0; m < m_size; m++)
+    {
+      z[m] = std::floor (m_inX[m] * scale + 0.5);
+    }
+}
+
+void
+LoRaWANCorrelator::Autocorrelate (const std::vector<unsigned char> &x, std::vector<float> &z)
+{
+  Load (x, m_inX);
+  fftw_execute_dft_r2c (m_planForward, m_inX, m_outX);
+
+  // The spectrum of the autocorrelation is the power spectrum |X|^2
+  const uint32_t nBins = m_transformSize / 2 + 1;
+  double *bins = &m_outX[0][0];
+  uint32_t k = 0;
+#ifdef __SSE2__
+  for (; k + 2 <= nBins; k += 2)
+    {
+      const __m128d x0 = _mm_load_pd (bins + 2 * k);     // re0 im0
+      const __m128d x1 = _mm_load_pd (bins + 2 * k + 2); // re1 im1
+      const __m128d p0 = _mm_mul_pd (x0, x0);
+      const __m128d p1 = _mm_mul_pd (x1, x1);
+      // (re0^2 + im0^2, re1^2 + im1^2)
+      const __m128d power = _mm_add_pd (_mm_unpacklo_pd (p0, p1), _mm_unpackhi_pd (p0, p1));
+      const __m128d zero = _mm_setzero_pd ();
+      _mm_store_pd (bins + 2 * k, _mm_unpacklo_pd (power, zero));
+      _mm_store_pd (bins + 2 * k + 2, _mm_unpackhi_pd (power, zero));
+    }
+#endif
+  for (; k < nBins; k++)
+    {
+      const double re = bins[2 * k];
+      const double im = bins[2 * k + 1];
+      bins[2 * k] = re * re + im * im;
+      bins[2 * k + 1] = 0.0;
+    }
+
+  Inverse (z);
+}
+
+void
+LoRaWANCorrelator::Correlate (const std::vector<unsigned char> &x, const std::vector<unsigned char> &y, std::vector<float> &z)
+{
+  Load (x, m_inX);
+  Load (y, m_inY);
+  fftw_execute_dft_r2c (m_planForward, m_inX, m_outX);
+  fftw_execute_dft_r2c (m_planForward, m_inY, m_outY);
+
+  // The spectrum of the correlation is X times the conjugate of Y:
+  // (a + bi)(c - di) = (ac + bd) + (bc - ad)i
+  const uint32_t nBins = m_transformSize / 2 + 1;
+  double *xBins = &m_outX[0][0];
+  const double *yBins = &m_outY[0][0];
+  uint32_t k = 0;
+#ifdef __SSE2__
+  const __m128d negateImag = _mm_set_pd (-0.0, 0.0);
+  for (; k < nBins; k++)
+    {
+      const __m128d xv = _mm_load_pd (xBins + 2 * k);                    // a b
+      const __m128d yv = _mm_load_pd (yBins + 2 * k);                    // c d
+      const __m128d p = _mm_mul_pd (xv, _mm_unpacklo_pd (yv, yv));       // ac bc
+      const __m128d xSwapped = _mm_shuffle_pd (xv, xv, 1);               // b a
+      const __m128d q = _mm_mul_pd (xSwapped, _mm_unpackhi_pd (yv, yv)); // bd ad
+      _mm_store_pd (xBins + 2 * k, _mm_add_pd (p, _mm_xor_pd (q, negateImag)));
+    }
+#endif
+  for (; k < nBins; k++)
+    {
+      const double a = xBins[2 * k];
+      const double b = xBins[2 * k + 1];
+      const double c = yBins[2 * k];
+      const double d = yBins[2 * k + 1];
+      xBins[2 * k] = a * c + b * d;
+      xBins[2 * k + 1] = b * c - a * d;
+    }
+
+  Inverse (z);
+}
+
+} // namespace ns3
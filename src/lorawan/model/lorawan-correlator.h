@@ -0,0 +1,166 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_CORRELATOR_H
+#define LORAWAN_CORRELATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fftw3.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief FFT based correlation of real sequences of a fixed length.
+ *
+ * The correlator owns the buffers and the FFTW plans for sequences of up to
+ * GetSize samples. The sequences are zero padded to a transform size of at
+ * least 2 * GetSize - 1, so that the circular correlation computed with the
+ * FFT equals the linear one, rounded up to a product of small primes for
+ * which FFTW is fast.
+ *
+ * The transforms are real to complex and complex to real, which only compute
+ * the non redundant half of the spectrum. An autocorrelation takes one
+ * forward transform (the power spectrum |X|^2), a cross correlation two
+ * (X times the conjugate of Y). The spectra are multiplied with SSE2 where
+ * the compiler supports it.
+ *
+ * Only the non negative lags are computed: z[m] is the sum over j of
+ * x[j + m] * y[j], for m from 0 to GetSize - 1. The correlations of byte
+ * sequences are integers, so the results are rounded to the exact values.
+ *
+ * The FFTW plans only depend on the transform size, so all correlators of a
+ * process share them: a plan is created for the first correlator of its
+ * size and reused by the later ones, which run it on their own buffers. The
+ * plans are estimated by default. Measured plans are faster but take seconds
+ * to create for the larger data rates; ExportWisdom and ImportWisdom save
+ * the planning of one run for the next ones.
+ */
+class LoRaWANCorrelator
+{
+public:
+  /**
+   * \param size the maximum length of the sequences
+   * \param measure true to let FFTW measure the fastest plans (FFTW_MEASURE)
+   * instead of estimating them (FFTW_ESTIMATE)
+   */
+  explicit LoRaWANCorrelator (uint32_t size, bool measure = false);
+  ~LoRaWANCorrelator ();
+
+  /**
+   * \return the maximum length of the sequences
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \return the length of the transforms
+   */
+  uint32_t GetTransformSize (void) const;
+
+  /**
+   * Autocorrelate a sequence.
+   *
+   * \param x the sequence, at most GetSize samples
+   * \param z receives the correlation at lags 0 to GetSize - 1
+   */
+  void Autocorrelate (const std::vector<unsigned char> &x, std::vector<float> &z);
+
+  /**
+   * Correlate two sequences.
+   *
+   * \param x the first sequence, at most GetSize samples
+   * \param y the second sequence, at most GetSize samples
+   * \param z receives the correlation at lags 0 to GetSize - 1
+   */
+  void Correlate (const std::vector<unsigned char> &x, const std::vector<unsigned char> &y, std::vector<float> &z);
+
+  /**
+   * \param n a transform length
+   * \return the smallest length of at least n whose prime factors are 2, 3,
+   * 5 and 7
+   */
+  static uint32_t GetFastTransformSize (uint32_t n);
+
+  /**
+   * Add the FFTW wisdom of a file to the wisdom of the process, so that
+   * plans can be created without measuring again. A file is only read
+   * once per process.
+   *
+   * \param filename the wisdom file
+   * \return false if the file could not be read
+   */
+  static bool ImportWisdom (const std::string &filename);
+
+  /**
+   * Write the FFTW wisdom of the process to a file, unless it did not change
+   * since the last import or export. The file is replaced at once, so that
+   * concurrent runs never read a partial file.
+   *
+   * \param filename the wisdom file
+   * \return false if the file could not be written
+   */
+  static bool ExportWisdom (const std::string &filename);
+
+  /**
+   * \return the number of FFTW plans shared by the correlators
+   */
+  static uint32_t GetPlanCacheSize (void);
+
+private:
+  LoRaWANCorrelator (const LoRaWANCorrelator &);
+  LoRaWANCorrelator &operator= (const LoRaWANCorrelator &);
+
+  /**
+   * Copy a sequence into a real input buffer and zero the padding.
+   */
+  void Load (const std::vector<unsigned char> &x, double *in) const;
+
+  /**
+   * Run the inverse transform of m_outX into m_inX and scale the
+   * non negative lags into z.
+   */
+  void Inverse (std::vector<float> &z);
+
+  /**
+   * Get the shared plan of a transform, creating it on first use.
+   *
+   * \param inverse true for the c2r plan, false for the r2c one
+   * \param transformSize the length of the transform
+   * \param measure true for a measured plan
+   * \return the plan, to be run with the new-array execute functions
+   */
+  static fftw_plan GetPlan (bool inverse, uint32_t transformSize, bool measure);
+
+  uint32_t m_size;           //!< The maximum length of the sequences
+  uint32_t m_transformSize;  //!< The length of the transforms
+  double *m_inX;             //!< Real input of the first sequence, also the output of the inverse transform
+  double *m_inY;             //!< Real input of the second sequence
+  fftw_complex *m_outX;      //!< Spectrum of the first sequence, m_transformSize / 2 + 1 bins
+  fftw_complex *m_outY;      //!< Spectrum of the second sequence
+  fftw_plan m_planForward;   //!< Shared r2c plan, from m_inX to m_outX and from m_inY to m_outY
+  fftw_plan m_planInverse;   //!< Shared c2r plan, from m_outX to m_inX
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_CORRELATOR_H */
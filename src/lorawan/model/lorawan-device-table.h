@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_DEVICE_TABLE_H
+#define LORAWAN_DEVICE_TABLE_H
+
+#include <ns3/assert.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Table of end devices keyed by their 32 bit device address.
+ *
+ * The state of a device is split in two records: a hot record with the
+ * fields that are read for every frame, and a cold record with the rest
+ * (statistics, queues, timers). Both are stored by value and indexed by the
+ * order in which the devices were added: the hot records in one dense array,
+ * so that the hot records of all devices are packed together, and the cold
+ * records in a deque, so that adding a device never copies them.
+ *
+ * The address to index mapping is a flat open addressing hash table with
+ * linear probing, holding (address, index) pairs in place. Its capacity is a
+ * power of two that is at least twice the number of devices. Devices are
+ * never removed, so the table needs no tombstones.
+ *
+ * Adding a device can reallocate the hot records, which invalidates the
+ * references returned by GetHot, but not those returned by GetCold nor the
+ * indices.
+ *
+ * \tparam Hot the per device record that is accessed for every frame
+ * \tparam Cold the per device record with the other fields
+ */
+template <typename Hot, typename Cold>
+class LoRaWANDeviceTable
+{
+public:
+  static const uint32_t NOT_FOUND = 0xffffffff; //!< Index returned by Find for unknown addresses
+
+  LoRaWANDeviceTable ()
+    : m_mask (0),
+      m_shift (32)
+  {
+  }
+
+  /**
+   * \return the number of devices
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_keys.size ();
+  }
+
+  /**
+   * Allocate room for a number of devices, so that adding them does not
+   * rehash the table nor reallocate the hot records.
+   *
+   * \param n the number of devices
+   */
+  void Reserve (uint32_t n)
+  {
+    m_keys.reserve (n);
+    m_hot.reserve (n);
+    if (2 * static_cast<uint64_t> (n) > m_slots.size ())
+      {
+        Rehash (n);
+      }
+  }
+
+  /**
+   * \param key the device address
+   * \return the index of the device, or NOT_FOUND
+   */
+  uint32_t Find (uint32_t key) const
+  {
+    if (m_slots.empty ())
+      {
+        return NOT_FOUND;
+      }
+    for (uint32_t s = Hash (key); ; s = (s + 1) & m_mask)
+      {
+        const Slot &slot = m_slots[s];
+        if (slot.index == NOT_FOUND || slot.key == key)
+          {
+            return slot.index;
+          }
+      }
+  }
+
+  /**
+   * Add a device with default constructed records.
+   *
+   * \param key the device address, which must not be in the table yet
+   * \return the index of the new device
+   */
+  uint32_t Insert (uint32_t key)
+  {
+    NS_ASSERT_MSG (Find (key) == NOT_FOUND, "Device " << key << " is already in the table");
+    const uint32_t index = m_keys.size ();
+    NS_ASSERT (index != NOT_FOUND);
+    if (2 * static_cast<uint64_t> (index + 1) > m_slots.size ())
+      {
+        Rehash (index + 1);
+      }
+    Place (key, index);
+    m_keys.push_back (key);
+    m_hot.push_back (Hot ());
+    m_cold.push_back (Cold ());
+    return index;
+  }
+
+  /**
+   * \param index the index of a device
+   * \return the address of the device
+   */
+  uint32_t GetKey (uint32_t index) const
+  {
+    NS_ASSERT (index < m_keys.size ());
+    return m_keys[index];
+  }
+
+  /**
+   * \param index the index of a device
+   * \return the hot record of the device
+   */
+  Hot &GetHot (uint32_t index)
+  {
+    NS_ASSERT (index < m_hot.size ());
+    return m_hot[index];
+  }
+
+  /**
+   * \param index the index of a device
+   * \return the hot record of the device
+   */
+  const Hot &GetHot (uint32_t index) const
+  {
+    NS_ASSERT (index < m_hot.size ());
+    return m_hot[index];
+  }
+
+  /**
+   * \param index the index of a device
+   * \return the cold record of the device
+   */
+  Cold &GetCold (uint32_t index)
+  {
+    NS_ASSERT (index < m_cold.size ());
+    return m_cold[index];
+  }
+
+  /**
+   * \param index the index of a device
+   * \return the cold record of the device
+   */
+  const Cold &GetCold (uint32_t index) const
+  {
+    NS_ASSERT (index < m_cold.size ());
+    return m_cold[index];
+  }
+
+  /**
+   * Remove all devices and release the memory of the table.
+   */
+  void Clear (void)
+  {
+    std::vector<Slot> ().swap (m_slots);
+    std::vector<uint32_t> ().swap (m_keys);
+    std::vector<Hot> ().swap (m_hot);
+    std::deque<Cold> ().swap (m_cold);
+    m_mask = 0;
+    m_shift = 32;
+  }
+
+private:
+  /// An entry of the hash table
+  struct Slot
+  {
+    uint32_t key;   //!< The device address
+    uint32_t index; //!< The index of the device, NOT_FOUND if the slot is empty
+  };
+
+  /**
+   * Fibonacci hashing: device addresses are often allocated sequentially, the
+   * multiplication spreads them over the table.
+   *
+   * \param key the device address
+   * \return the home slot of the address
+   */
+  uint32_t Hash (uint32_t key) const
+  {
+    return m_shift < 32 ? (key * 2654435769u) >> m_shift : 0;
+  }
+
+  /**
+   * Store an (address, index) pair in the first free slot from its home slot.
+   */
+  void Place (uint32_t key, uint32_t index)
+  {
+    uint32_t s = Hash (key);
+    while (m_slots[s].index != NOT_FOUND)
+      {
+        s = (s + 1) & m_mask;
+      }
+    m_slots[s].key = key;
+    m_slots[s].index = index;
+  }
+
+  /**
+   * Grow the hash table so that it holds n devices at a load factor of at
+   * most one half, and re-insert the existing devices.
+   */
+  void Rehash (uint32_t n)
+  {
+    uint32_t capacity = 16;
+    uint32_t bits = 4;
+    while (capacity < 2 * static_cast<uint64_t> (n))
+      {
+        capacity *= 2;
+        bits++;
+      }
+    const Slot empty = {0, NOT_FOUND};
+    m_slots.assign (capacity, empty);
+    m_mask = capacity - 1;
+    m_shift = 32 - bits;
+    for (uint32_t i = 0; i < m_keys.size (); i++)
+      {
+        Place (m_keys[i], i);
+      }
+  }
+
+  std::vector<Slot> m_slots;   //!< The hash table
+  uint32_t m_mask;             //!< The capacity of the hash table minus one
+  uint32_t m_shift;            //!< 32 minus the log2 of the capacity of the hash table
+  std::vector<uint32_t> m_keys; //!< The device addresses, by index
+  std::vector<Hot> m_hot;      //!< The hot records, by index
+  std::deque<Cold> m_cold;     //!< The cold records, by index
+};
+
+template <typename Hot, typename Cold>
+const uint32_t LoRaWANDeviceTable<Hot, Cold>::NOT_FOUND;
+
+} // namespace ns3
+
+#endif /* LORAWAN_DEVICE_TABLE_H */
@@ -45,10 +45,13 @@
 #include "lorawan-frame-header.h"
 #include "lorawan-frame-header-uplink.h"
 #include "lorawan-frame-header-downlink.h"
+#include "lorawan-uplink-generator.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
 
+#include <cstring>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANEndDeviceApplication");
@@ -58,13 +61,6 @@ NS_OBJECT_ENSURE_REGISTERED (LoRaWANEndDeviceApplication);
 TypeId
 LoRaWANEndDeviceApplication::GetTypeId (void)
 {
-  // Construct default value for the channel random variable:
-  std::stringstream channelRandomVariableSS;
-  const uint32_t channelRandomVariableDefaultMin = 0;
-  const uint32_t channelRandomVariableDefaultMax = (LoRaWAN::m_supportedChannels.size () - 1) - 1; // additional -1 as not to use the 10% RDC channel as an upstream channel
-  channelRandomVariableSS << "ns3::UniformRandomVariable[Min=" << channelRandomVariableDefaultMin << "|Max=" << channelRandomVariableDefaultMax << "]";
-  //std::cout << "LoRaWANEndDeviceApplication::GetTypeId: " << channelRandomVariableSS.str() << std::endl;
-
   static TypeId tid = TypeId ("ns3::LoRaWANEndDeviceApplication")
     .SetParent<Application> ()
     .SetGroupName("Applications")
@@ -84,8 +80,17 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_confirmedData),
                    MakeBooleanChecker ())
-    .AddAttribute ("ChannelRandomVariable", "A RandomVariableStream used to pick the channel for upstream transmissions.",
-                   StringValue (channelRandomVariableSS.str ()),
+    .AddAttribute ("ADR",
+                   "Set the ADR bit in US frames, so that the network server adapts the data rate "
+                   "of this end device with LinkADRReq commands.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_adr),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ChannelRandomVariable",
+                   "A RandomVariableStream used to pick the channel for upstream transmissions. "
+                   "If none is set, one of the channels of the uplink channel mask of the region "
+                   "(see LoRaWAN::GetUplinkChannelMask) that allow the data rate is picked.",
+                   PointerValue (),
                    MakePointerAccessor (&LoRaWANEndDeviceApplication::m_channelRandomVariable),
                    MakePointerChecker <RandomVariableStream>())
     .AddAttribute ("UpstreamIAT", "A RandomVariableStream used to pick the time between subsequent US transmissions from this end device.",
@@ -111,6 +116,20 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    UintegerValue (0),
                    MakeUintegerAccessor (&LoRaWANEndDeviceApplication::m_maxBytes),
                    MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("UplinkGenerator",
+                   "The population level source that schedules the US transmissions of this "
+                   "end device, instead of a simulator event per end device. "
+                   "No generator means the end device schedules its own transmissions.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANEndDeviceApplication::m_uplinkGenerator),
+                   MakePointerChecker<LoRaWANUplinkGenerator> ())
+    .AddAttribute ("PayloadCounter",
+                   "Start the FRMPayload with a globally shared decrementing counter. "
+                   "Only the counter takes payload memory, the rest of the FRMPayload is zeros. "
+                   "False means the FRMPayload is all zeros, which costs no payload memory.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_payloadCounter),
+                   MakeBooleanChecker ())
     .AddTraceSource ("USMsgTransmitted", "An US message is sent",
                      MakeTraceSourceAccessor (&LoRaWANEndDeviceApplication::m_usMsgTransmittedTrace),
                      "ns3::Packet::TracedCallback")
@@ -127,6 +146,8 @@ LoRaWANEndDeviceApplication::LoRaWANEndDeviceApplication ()
     m_connected (false),
     m_lastTxTime (Seconds (0)),
     m_totBytes (0),
+    m_uplinkGeneratorIndex (0),
+    m_payloadCounter (true),
     m_framePort (0),
     m_fCntUp (0),
     m_fCntDown (0),
@@ -135,14 +156,14 @@ LoRaWANEndDeviceApplication::LoRaWANEndDeviceApplication ()
     m_timeslotDelay(0),
     m_doSendTimeSlotAns(false),
     m_sendTimeSlotAnsResponse(false),
+    m_doSendLinkADRAns(false),
+    m_linkADRAnsStatus(0),
     m_attemptedThroughput(0)
 {
   NS_LOG_FUNCTION (this);
 
-  //m_channelRandomVariable = CreateObject <UniformRandomVariable> (); // random variable between 0 and size(channels) - 2
-  //m_channelRandomVariable->SetAttribute ("Min", DoubleValue (0.0));
-  //const uint32_t max = (LoRaWAN::m_supportedChannels.size () - 1) - 1; // additional -1 as not to use the 10% RDC channel as an upstream channel
-  //m_channelRandomVariable->SetAttribute ("Max", DoubleValue (max));
+  // Picks the channel if ChannelRandomVariable is not set
+  m_uplinkChannelRandomVariable = CreateObject <UniformRandomVariable> ();
 }
 
 LoRaWANEndDeviceApplication::~LoRaWANEndDeviceApplication ()
@@ -185,7 +206,14 @@ int64_t
 LoRaWANEndDeviceApplication::AssignStreams (int64_t stream)
 {
   NS_LOG_FUNCTION (this << stream);
-  m_channelRandomVariable->SetStream (stream);
+  if (m_channelRandomVariable)
+    {
+      m_channelRandomVariable->SetStream (stream);
+    }
+  else
+    {
+      m_uplinkChannelRandomVariable->SetStream (stream);
+    }
   m_upstreamIATRandomVariable->SetStream (stream + 1);
   m_upstreamSendIATRandomVariable->SetStream (stream + 2);
   m_upstreamEventRateRandomVariable->SetStream (stream + 3);
@@ -198,6 +226,11 @@ LoRaWANEndDeviceApplication::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
 
+  if (m_uplinkGenerator)
+    {
+      m_uplinkGenerator->RemoveDevice (m_uplinkGeneratorIndex);
+      m_uplinkGenerator = 0;
+    }
   m_socket = 0;
   PrintFinalDetails();
   // chain up
@@ -235,6 +268,11 @@ void LoRaWANEndDeviceApplication::StartApplication () // Called at time specifie
         MakeCallback (&LoRaWANEndDeviceApplication::ConnectionFailed, this));
 
       m_devAddr = Ipv4Address::ConvertFrom (GetNode ()->GetDevice (0)->GetAddress ()).Get();
+
+      if (m_uplinkGenerator)
+        {
+          m_uplinkGeneratorIndex = m_uplinkGenerator->AddDevice (this);
+        }
     }
 
   // Insure no pending event
@@ -246,8 +284,15 @@ void LoRaWANEndDeviceApplication::StartApplication () // Called at time specifie
 
    Time nextSendTime (Seconds (this->m_upstreamSendIATRandomVariable->GetValue ()));
   NS_LOG_LOGIC (this << " upstream nextTime = " << nextSendTime);
-  m_txEvent = Simulator::Schedule (nextSendTime,
+  if (m_uplinkGenerator)
+    {
+      m_uplinkGenerator->Schedule (m_uplinkGeneratorIndex, nextSendTime);
+    }
+  else
+    {
+      m_txEvent = Simulator::Schedule (nextSendTime,
                                        &LoRaWANEndDeviceApplication::SendPacket, this);
+    }
 
 
   /*Time nextEvent (Seconds (this->m_upstreamEventRandomVariable->GetValue ()));
@@ -278,6 +323,10 @@ void LoRaWANEndDeviceApplication::CancelEvents ()
 {
   NS_LOG_FUNCTION (this);
   Simulator::Cancel (m_txEvent);
+  if (m_uplinkGenerator)
+    {
+      m_uplinkGenerator->Cancel (m_uplinkGeneratorIndex);
+    }
 }
 
 
@@ -290,8 +339,15 @@ void LoRaWANEndDeviceApplication::ScheduleNextTx ()
     {
       Time nextTime (Seconds (this->m_upstreamIATRandomVariable->GetValue ()));
       NS_LOG_LOGIC (this << " nextTime = " << nextTime);
-      m_txEvent = Simulator::Schedule (nextTime,
-                                       &LoRaWANEndDeviceApplication::SendPacket, this);
+      if (m_uplinkGenerator)
+        {
+          m_uplinkGenerator->Schedule (m_uplinkGeneratorIndex, nextTime);
+        }
+      else
+        {
+          m_txEvent = Simulator::Schedule (nextTime,
+                                           &LoRaWANEndDeviceApplication::SendPacket, this);
+        }
     }
   else
     { // All done, cancel any pending events
@@ -333,9 +389,16 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   LoRaWANFrameHeaderUplink fhdr;
 
   fhdr.setDevAddr (myAddress);
-  fhdr.setAdr(false);
+  fhdr.setAdr(m_adr);
   fhdr.setAck (m_setAck);
   fhdr.setClassB(false);
+
+  if(m_doSendLinkADRAns) {
+    if (fhdr.AddLoRaADRAns(m_linkADRAnsStatus & 0x4, m_linkADRAnsStatus & 0x2, m_linkADRAnsStatus & 0x1)) {
+      NS_LOG_INFO (this << "added LinkADRAns to frame");
+      m_doSendLinkADRAns = false;
+    }
+  }
   
   if(m_doSendTimeSlotAns) {
     if (fhdr.AddLoRaTimeSlotDelayAns(m_sendTimeSlotAnsResponse)){
@@ -353,29 +416,15 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   // Construct MACPayload
   // PHYPayload: MHDR | MACPayload | MIC
   // MACPayload: FHDR | FPort | FRMPayload
-  Ptr<Packet> packet;
   uint8_t frmPayloadSize = m_pktSize  - fhdr.GetSerializedSize() - 1 - 4;  // subtract 8 bytes for frame header, 1B for MAC header and 4B for MAC MIC
-  //std::cout << "frm size " << frmPayloadSize << std::endl;
-  if (frmPayloadSize >= sizeof(uint64_t)) { // check whether payload size is large enough to hold 64 bit integer
-    // send decrementing counter as payload (note: globally shared counter)
-    uint8_t* payload = new uint8_t[frmPayloadSize](); // the parenthesis initialize the allocated memory to zero
-    if (payload) {
-      const uint64_t counter = LoRaWANCounterSingleton::GetCounter ();
-      ((uint64_t*)payload)[0] = counter; // copy counter to beginning payload
-      packet = Create<Packet> (payload, frmPayloadSize);
-      delete[] payload;
-    } else {
-      packet = Create<Packet> (frmPayloadSize);
-    }
-  } else {
-    packet = Create<Packet> (frmPayloadSize);
-  }
+  Ptr<Packet> packet = CreateFrmPayload (frmPayloadSize);
 
   packet->AddHeader (fhdr); // Packet now represents MACPayload
 
   // Select channel to use:
-  uint32_t channelIndex = m_channelRandomVariable->GetInteger ();
-  NS_ASSERT (channelIndex <= LoRaWAN::m_supportedChannels.size () - 2); // -2 because end devices should not use the special high power channel for US traffic
+  uint32_t channelIndex = m_channelRandomVariable ? m_channelRandomVariable->GetInteger ()
+                                                  : LoRaWAN::PickUplinkChannel (m_dataRateIndex, m_uplinkChannelRandomVariable);
+  NS_ASSERT (channelIndex < LoRaWAN::GetNUplinkChannels ()); // end devices should not use the special high power channel or downstream channels for US traffic
 
   LoRaWANPhyParamsTag phyParamsTag;
   phyParamsTag.SetChannelIndex (channelIndex);
@@ -422,6 +471,30 @@ void LoRaWANEndDeviceApplication::SendPacket ()
 }
 
 
+void
+LoRaWANEndDeviceApplication::SendUplink (uint32_t id)
+{
+  SendPacket ();
+}
+
+Ptr<Packet>
+LoRaWANEndDeviceApplication::CreateFrmPayload (uint8_t size)
+{
+  if (!m_payloadCounter || size < sizeof(uint64_t)) // check whether payload size is large enough to hold 64 bit integer
+    {
+      return Create<Packet> (size); // zero filled, the packet does not allocate memory for the payload
+    }
+
+  // send decrementing counter as payload (note: globally shared counter)
+  const uint64_t counter = LoRaWANCounterSingleton::GetCounter ();
+  memcpy (m_payloadCounterBytes, &counter, sizeof(counter));
+  Ptr<Packet> packet = Create<Packet> (m_payloadCounterBytes, sizeof(counter));
+  // The zeros after the counter stay the zero area of the packet, which
+  // takes no memory
+  packet->AddAtEnd (Create<Packet> (size - sizeof(counter)));
+  return packet;
+}
+
 /*
 This is a very lazy way of doing this. TODO: combine this and SendPacket
 */
@@ -443,10 +516,17 @@ void LoRaWANEndDeviceApplication::SendEventBasedPacket ()
   LoRaWANFrameHeaderUplink fhdr;
 
   fhdr.setDevAddr (myAddress);
-  fhdr.setAdr(false);
+  fhdr.setAdr(m_adr);
   fhdr.setAck (m_setAck);
   fhdr.setClassB(false);
 
+  if(m_doSendLinkADRAns) {
+    if (fhdr.AddLoRaADRAns(m_linkADRAnsStatus & 0x4, m_linkADRAnsStatus & 0x2, m_linkADRAnsStatus & 0x1)) {
+      NS_LOG_INFO (this << "added LinkADRAns to frame");
+      m_doSendLinkADRAns = false;
+    }
+  }
+
   if(m_doSendTimeSlotAns) {
     if (fhdr.AddLoRaTimeSlotDelayAns(m_sendTimeSlotAnsResponse)){
       NS_LOG_INFO (this << "added TimeSlotAns to frame");
@@ -464,28 +544,15 @@ void LoRaWANEndDeviceApplication::SendEventBasedPacket ()
   // Construct MACPayload
   // PHYPayload: MHDR | MACPayload | MIC
   // MACPayload: FHDR | FPort | FRMPayload
-  Ptr<Packet> packet;
   uint8_t frmPayloadSize = m_pktSize  - fhdr.GetSerializedSize() - 1 - 4;  // subtract 8 bytes for frame header, 1B for MAC header and 4B for MAC MIC
-  if (frmPayloadSize >= sizeof(uint64_t)) { // check whether payload size is large enough to hold 64 bit integer
-    // send decrementing counter as payload (note: globally shared counter)
-    uint8_t* payload = new uint8_t[frmPayloadSize](); // the parenthesis initialize the allocated memory to zero
-    if (payload) {
-      const uint64_t counter = LoRaWANCounterSingleton::GetCounter ();
-      ((uint64_t*)payload)[0] = counter; // copy counter to beginning payload
-      packet = Create<Packet> (payload, frmPayloadSize);
-      delete[] payload;
-    } else {
-      packet = Create<Packet> (frmPayloadSize);
-    }
-  } else {
-    packet = Create<Packet> (frmPayloadSize);
-  }
+  Ptr<Packet> packet = CreateFrmPayload (frmPayloadSize);
 
   packet->AddHeader (fhdr); // Packet now represents MACPayload
 
   // Select channel to use:
-  uint32_t channelIndex = m_channelRandomVariable->GetInteger ();
-  NS_ASSERT (channelIndex <= LoRaWAN::m_supportedChannels.size () - 2); // -2 because end devices should not use the special high power channel for US traffic
+  uint32_t channelIndex = m_channelRandomVariable ? m_channelRandomVariable->GetInteger ()
+                                                  : LoRaWAN::PickUplinkChannel (m_dataRateIndex, m_uplinkChannelRandomVariable);
+  NS_ASSERT (channelIndex < LoRaWAN::GetNUplinkChannels ()); // end devices should not use the special high power channel or downstream channels for US traffic
 
   LoRaWANPhyParamsTag phyParamsTag;
   phyParamsTag.SetChannelIndex (channelIndex);
@@ -576,7 +643,21 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
   //FOptsLen bit handling - loop through the m_macCommandsNS structure and handle any of the commands with bool set to true. The timeslot-related command is the only implemented one for now.
   for(std::vector<LoRaWANMacCommandDownlink>::iterator it = frmHdr.m_macCommandsNS.begin(); it != frmHdr.m_macCommandsNS.end(); ++it) { 
     if(it->m_isBeingUsed) {
-      if(it->m_commandID == TimeSlotDelayReq) {
+      if(it->m_commandID == LinkADRReq) {
+        NS_LOG_INFO ("Reading LinkADRReq");
+        // The channel mask is accepted as is, end devices use a static set of channels.
+        // The MAC always sends at the maximum power of the sub band: TX power index 0.
+        const bool channelMaskAck = true;
+        const bool dataRateAck = frmHdr.m_dataRateIndex < LoRaWAN::m_supportedDataRates.size ()
+                                 && LoRaWAN::m_supportedDataRates[frmHdr.m_dataRateIndex].bandWith > 0;
+        const bool powerAck = frmHdr.m_txPowerIndex == 0;
+        // The command is applied only if all of it is acknowledged
+        if (channelMaskAck && dataRateAck && powerAck) {
+          SetDataRateIndex (frmHdr.m_dataRateIndex);
+        }
+        m_doSendLinkADRAns = true;
+        m_linkADRAnsStatus = (powerAck << 2) | (dataRateAck << 1) | channelMaskAck;
+      } else if(it->m_commandID == TimeSlotDelayReq) {
            uint8_t newDelay = frmHdr.m_timeslotByte;
            NS_LOG_INFO ("Reading TimeSlotDelayReq");
            //TODO: reset m_timeslotByte to 0, and pull transmissions back to original placing, on DR change
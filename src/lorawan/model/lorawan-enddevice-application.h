@@ -32,12 +32,15 @@
 #include "ns3/ptr.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
+#include "ns3/lorawan-uplink-generator.h"
 
 namespace ns3 {
 
 class Address;
 class RandomVariableStream;
+class UniformRandomVariable;
 class Socket;
+class Packet;
 
 /**
  * \ingroup lorawan
@@ -48,7 +51,7 @@ class Socket;
  * US messages are generated according to a random variable (can be fixed) and
  * not according to a CBR requirement.
 */
-class LoRaWANEndDeviceApplication : public Application
+class LoRaWANEndDeviceApplication : public Application, public LoRaWANUplinkSource
 {
 public:
   /**
@@ -110,13 +113,25 @@ private:
    */
   void SendPacket ();
 
+  // inherited from LoRaWANUplinkSource
+  virtual void SendUplink (uint32_t id);
+
+  /**
+   * \brief Create the FRMPayload of an upstream frame
+   *
+   * \param size the FRMPayload size
+   * \return the FRMPayload
+   */
+  Ptr<Packet> CreateFrmPayload (uint8_t size);
+
   void HandleRead (Ptr<Socket> socket);
 
   void HandleDSPacket (Ptr<Packet> p, Address from);
 
   Ptr<Socket>     m_socket;       //!< Associated socket
   bool            m_connected;    //!< True if connected
-  Ptr<RandomVariableStream> m_channelRandomVariable;	//!< rng for channel selection for upstream TX
+  Ptr<RandomVariableStream> m_channelRandomVariable;	//!< rng for channel selection for upstream TX, if set
+  Ptr<UniformRandomVariable> m_uplinkChannelRandomVariable; //!< rng for channel selection otherwise, see LoRaWAN::PickUplinkChannel
   Ptr<RandomVariableStream> m_upstreamIATRandomVariable;	//!< rng for inter arrival timing for upstream TX
   Ptr<RandomVariableStream> m_upstreamSendIATRandomVariable;
   uint32_t        m_pktSize;      //!< Size of packets
@@ -125,7 +140,12 @@ private:
   uint64_t        m_maxBytes;     //!< Limit total number of bytes sent
   uint64_t        m_totBytes;     //!< Total bytes sent so far
   EventId         m_txEvent;     //!< Event id for next start or stop event
+  Ptr<LoRaWANUplinkGenerator> m_uplinkGenerator; //!< Population level source of the US transmissions, if any
+  uint32_t        m_uplinkGeneratorIndex; //!< Index of this application in m_uplinkGenerator
+  bool            m_payloadCounter; //!< Start the FRMPayload with the global frame counter
+  uint8_t         m_payloadCounterBytes[sizeof (uint64_t)]; //!< Scratch buffer for the counter at the start of the FRMPayload
   bool 		  m_confirmedData; //<! Send upstream data as Confirmed Data Up MAC packets
+  bool            m_adr;           //!< Set the ADR bit, the network server controls the data rate
 
   uint8_t         m_framePort;	  //!< Frame port
   uint32_t        m_fCntUp;       //!< Uplink frame counter
@@ -183,6 +203,9 @@ std::vector<uint8_t> m_maxTimeSlotPushPerDataRate = { //ensuring a max delay of
 bool m_doSendTimeSlotAns;
 bool m_sendTimeSlotAnsResponse;
 
+bool m_doSendLinkADRAns;
+uint8_t m_linkADRAnsStatus; //!< Power, data rate and channel mask ACK bits of the next LinkADRAns
+
 uint32_t    m_attemptedThroughput;
   uint32_t    m_devAddr;
 
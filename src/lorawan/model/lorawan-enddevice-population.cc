@@ -0,0 +1,379 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-enddevice-population.h"
+#include "lorawan.h"
+#include "lorawan-phy.h"
+#include "lorawan-mac-header.h"
+#include "lorawan-frame-header-uplink.h"
+#include "lorawan-spectrum-value-helper.h"
+#include "lorawan-spectrum-signal-parameters.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/net-device.h>
+#include <ns3/antenna-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/trace-source-accessor.h>
+#include <ns3/pointer.h>
+#include <ns3/string.h>
+#include <ns3/uinteger.h>
+#include <ns3/double.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANEndDevicePopulation");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANEndDevicePopulation);
+
+const uint8_t LoRaWANEndDevicePopulation::NO_PENDING_FRAME;
+
+TypeId
+LoRaWANEndDevicePopulation::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANEndDevicePopulation")
+    .SetParent<SpectrumPhy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANEndDevicePopulation> ()
+    .AddAttribute ("DataRateIndex",
+                   "DataRate index used for US transmissions of the end devices.",
+                   UintegerValue (0), // default data rate is SF12
+                   MakeUintegerAccessor (&LoRaWANEndDevicePopulation::m_dataRateIndex),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("CodeRate",
+                   "Code rate used for US transmissions of the end devices, from 1 (4/5) to 4 (4/8).",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&LoRaWANEndDevicePopulation::m_codeRate),
+                   MakeUintegerChecker<uint8_t> (1, 4))
+    .AddAttribute ("PacketSize", "The size of the PHYPayloads sent by the end devices",
+                   UintegerValue (33),
+                   MakeUintegerAccessor (&LoRaWANEndDevicePopulation::m_pktSize),
+                   MakeUintegerChecker<uint32_t> (13, 255)) // MHDR, FHDR, FPort and MIC
+    .AddAttribute ("TxPower", "The TX power of the end devices in dBm",
+                   DoubleValue (14.0),
+                   MakeDoubleAccessor (&LoRaWANEndDevicePopulation::m_txPower),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("ChannelRandomVariable",
+                   "A RandomVariableStream used to pick the channel for upstream transmissions. "
+                   "If none is set, one of the channels of the uplink channel mask of the region "
+                   "that allow the data rate is picked, as for LoRaWANEndDeviceApplication.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANEndDevicePopulation::m_channelRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("UpstreamIAT", "A RandomVariableStream used to pick the time between subsequent US transmissions of an end device.",
+                   StringValue ("ns3::ConstantRandomVariable[Constant=600.0]"),
+                   MakePointerAccessor (&LoRaWANEndDevicePopulation::m_upstreamIATRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("UpstreamSend", "A RandomVariableStream used to pick the time until the first US transmission of an end device.",
+                   StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=600.0]"),
+                   MakePointerAccessor (&LoRaWANEndDevicePopulation::m_upstreamSendIATRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("UplinkGenerator",
+                   "The uplink generator that schedules the frames of the end devices. "
+                   "A generator is created for the population if none is set.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANEndDevicePopulation::m_uplinkGenerator),
+                   MakePointerChecker<LoRaWANUplinkGenerator> ())
+    .AddTraceSource ("USMsgTransmitted", "An US message is sent",
+                     MakeTraceSourceAccessor (&LoRaWANEndDevicePopulation::m_usMsgTransmittedTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANEndDevicePopulation::LoRaWANEndDevicePopulation (void)
+  : m_framePort (0)
+{
+  NS_LOG_FUNCTION (this);
+  LoRaWAN::AcquireRegion ();
+
+  // Account the duty cycle as the RDC objects of the MACs do
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  m_dutyCycleWindow = rdc->GetDutyCycleWindow ();
+  const LoRaWANRegionPlan &plan = LoRaWAN::GetRegionPlan (LoRaWAN::GetRegion ());
+  for (uint8_t i = 0; i < plan.nSubBands; i++)
+    {
+      LoRaWANSubBand subBand = {plan.subBands[i].dutyCycleLimit, plan.subBands[i].maxTXPower, Time (), Time ()};
+      m_regionSubBands.push_back (subBand);
+    }
+  m_txPsds.resize (LoRaWAN::m_supportedChannels.size ());
+  m_mobility = CreateObject<ConstantPositionMobilityModel> ();
+  m_uplinkChannelRandomVariable = CreateObject<UniformRandomVariable> ();
+}
+
+LoRaWANEndDevicePopulation::~LoRaWANEndDevicePopulation (void)
+{
+  LoRaWAN::ReleaseRegion ();
+}
+
+void
+LoRaWANEndDevicePopulation::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_uplinkGenerator)
+    {
+      // The generator can be shared with other populations or applications
+      for (std::vector<LoRaWANCompactEndDevice>::const_iterator it = m_endDevices.begin (); it != m_endDevices.end (); ++it)
+        {
+          m_uplinkGenerator->RemoveDevice (it->generatorIndex);
+        }
+    }
+  m_endDevices.clear ();
+  m_subBands.clear ();
+  m_transmissions.clear ();
+  m_uplinkGenerator = 0;
+  m_mobility = 0;
+  m_uplinkChannelRandomVariable = 0;
+  m_channel = 0;
+  m_txPsds.clear ();
+  SpectrumPhy::DoDispose ();
+}
+
+Ptr<LoRaWANUplinkGenerator>
+LoRaWANEndDevicePopulation::GetUplinkGenerator (void)
+{
+  if (m_uplinkGenerator == 0)
+    {
+      m_uplinkGenerator = CreateObject<LoRaWANUplinkGenerator> ();
+    }
+  return m_uplinkGenerator;
+}
+
+uint32_t
+LoRaWANEndDevicePopulation::AddEndDevice (Ipv4Address devAddr, const Vector &position)
+{
+  NS_LOG_FUNCTION (this << devAddr << position);
+
+  LoRaWANCompactEndDevice endDevice;
+  endDevice.position = position;
+  endDevice.devAddr = devAddr.Get ();
+  endDevice.fCntUp = 0;
+  endDevice.pendingChannelIndex = NO_PENDING_FRAME;
+  const uint32_t index = m_endDevices.size ();
+  endDevice.generatorIndex = GetUplinkGenerator ()->AddDevice (this, index);
+  m_endDevices.push_back (endDevice);
+  m_subBands.insert (m_subBands.end (), m_regionSubBands.begin (), m_regionSubBands.end ());
+  if (!m_dutyCycleWindow.IsZero ())
+    {
+      m_transmissions.resize (m_subBands.size ());
+    }
+
+  Time nextSendTime (Seconds (m_upstreamSendIATRandomVariable->GetValue ()));
+  m_uplinkGenerator->Schedule (endDevice.generatorIndex, nextSendTime);
+  return index;
+}
+
+uint32_t
+LoRaWANEndDevicePopulation::GetNEndDevices (void) const
+{
+  return m_endDevices.size ();
+}
+
+const LoRaWANCompactEndDevice &
+LoRaWANEndDevicePopulation::GetEndDevice (uint32_t index) const
+{
+  NS_ASSERT (index < m_endDevices.size ());
+  return m_endDevices[index];
+}
+
+void
+LoRaWANEndDevicePopulation::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_uplinkGenerator == 0)
+    {
+      return;
+    }
+  for (std::vector<LoRaWANCompactEndDevice>::const_iterator it = m_endDevices.begin (); it != m_endDevices.end (); ++it)
+    {
+      m_uplinkGenerator->Cancel (it->generatorIndex);
+    }
+}
+
+int64_t
+LoRaWANEndDevicePopulation::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  if (m_channelRandomVariable)
+    {
+      m_channelRandomVariable->SetStream (stream);
+    }
+  else
+    {
+      m_uplinkChannelRandomVariable->SetStream (stream);
+    }
+  m_upstreamIATRandomVariable->SetStream (stream + 1);
+  m_upstreamSendIATRandomVariable->SetStream (stream + 2);
+  return 3;
+}
+
+Ptr<SpectrumValue>
+LoRaWANEndDevicePopulation::GetTxPsd (uint8_t channelIndex)
+{
+  NS_ASSERT (channelIndex < m_txPsds.size ());
+  if (m_txPsds[channelIndex] == 0)
+    {
+      LoRaWANSpectrumValueHelper psdHelper;
+      m_txPsds[channelIndex] = psdHelper.CreateTxPowerSpectralDensity (m_txPower, LoRaWAN::m_supportedChannels [channelIndex].m_fc);
+    }
+  return m_txPsds[channelIndex];
+}
+
+void
+LoRaWANEndDevicePopulation::SendUplink (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+  NS_ASSERT (id < m_endDevices.size ());
+  NS_ASSERT_MSG (m_channel, "LoRaWANEndDevicePopulation has no channel");
+  LoRaWANCompactEndDevice &endDevice = m_endDevices[id];
+
+  // Select channel to use, unless the frame was waiting for its sub band
+  uint8_t channelIndex = endDevice.pendingChannelIndex;
+  if (channelIndex == NO_PENDING_FRAME)
+    {
+      channelIndex = m_channelRandomVariable ? m_channelRandomVariable->GetInteger ()
+                                             : LoRaWAN::PickUplinkChannel (m_dataRateIndex, m_uplinkChannelRandomVariable);
+      NS_ASSERT (channelIndex < LoRaWAN::GetNUplinkChannels ()); // end devices should not use the special high power channel or downstream channels for US traffic
+    }
+
+  // Wait for the sub band, as LoRaWANMac::CheckQueue does
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  NS_ASSERT (subBandIndex < m_regionSubBands.size ());
+  const uint32_t subBandStateIndex = id * m_regionSubBands.size () + subBandIndex;
+  LoRaWANSubBand &subBand = m_subBands[subBandStateIndex];
+  LoRaWANMac::LoRaWANMacRDC::TransmissionList &transmissions = m_dutyCycleWindow.IsZero () ? m_noTransmissions : m_transmissions[subBandStateIndex];
+  const Time airTime = LoRaWANPhy::GetTimeOnAir (m_pktSize, m_dataRateIndex, m_codeRate);
+  const Time now = Simulator::Now ();
+  const Time subBandAvailable = LoRaWANMac::LoRaWANMacRDC::ComputeSubBandAvailableTime (subBand, transmissions, m_dutyCycleWindow, airTime);
+  if (subBandAvailable > now)
+    {
+      NS_LOG_LOGIC (this << " end device " << id << " waits for sub band " << (uint16_t)subBandIndex);
+      endDevice.pendingChannelIndex = channelIndex;
+      m_uplinkGenerator->Schedule (endDevice.generatorIndex, subBandAvailable - now);
+      return;
+    }
+  endDevice.pendingChannelIndex = NO_PENDING_FRAME;
+
+  // Construct MACPayload
+  // PHYPayload: MHDR | MACPayload | MIC
+  // MACPayload: FHDR | FPort | FRMPayload
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (endDevice.devAddr));
+  fhdr.setAdr (false);
+  fhdr.setAck (false);
+  fhdr.setClassB (false);
+  endDevice.fCntUp++;
+  fhdr.setFrameCounter (endDevice.fCntUp);
+  fhdr.setFramePort (m_framePort);
+
+  const uint8_t frmPayloadSize = m_pktSize - fhdr.GetSerializedSize () - 1 - 4; // subtract frame header, 1B for MAC header and 4B for MAC MIC
+  Ptr<Packet> packet = Create<Packet> (frmPayloadSize); // zero filled, the packet does not allocate memory for the payload
+  packet->AddHeader (fhdr);
+  if (packet->GetSize () > LoRaWAN::GetMaxMACPayloadSize (m_dataRateIndex))
+    {
+      NS_LOG_ERROR (this << " MACPayload with length = " << packet->GetSize () << " is too long for DataRate " << (uint16_t)m_dataRateIndex);
+    }
+  else
+    {
+      m_usMsgTransmittedTrace (endDevice.devAddr, LORAWAN_UNCONFIRMED_DATA_UP, packet);
+
+      // Construct PHYPayload, as LoRaWANMac::constructPhyPayload
+      LoRaWANMacHeader macHdr (LORAWAN_UNCONFIRMED_DATA_UP, 0);
+      packet->AddHeader (macHdr);
+      packet->AddPaddingAtEnd (4); // MIC
+
+      // Tag the TX'd packet with a unique identifier that can be used for tracing, as LoRaWANPhy::PdDataRequest
+      LoRaWANPhyTraceIdTag traceIdTag;
+      traceIdTag.SetFlowId (LoRaWANPhyTraceIdTag::AllocateFlowId ());
+      packet->AddPacketTag (traceIdTag);
+
+      NS_ASSERT (packet->GetSize () == m_pktSize);
+      Ptr<LoRaWANSpectrumSignalParameters> txParams = Create<LoRaWANSpectrumSignalParameters> ();
+      txParams->duration = airTime;
+      txParams->txPhy = this;
+      txParams->psd = GetTxPsd (channelIndex);
+      txParams->packet = packet;
+      txParams->channelIndex = channelIndex;
+      txParams->dataRateIndex = m_dataRateIndex;
+      txParams->codeRate = m_codeRate;
+
+      // The channel takes the position of the sender in StartTx
+      m_mobility->SetPosition (endDevice.position);
+      m_channel->StartTx (txParams);
+
+      // As LoRaWANMacRDC::UpdateRDCTimerForSubBand
+      LoRaWANMac::LoRaWANMacRDC::RecordSubBandTransmission (subBand, transmissions, m_dutyCycleWindow, airTime);
+    }
+
+  Time nextTime (Seconds (m_upstreamIATRandomVariable->GetValue ()));
+  m_uplinkGenerator->Schedule (endDevice.generatorIndex, nextTime);
+}
+
+void
+LoRaWANEndDevicePopulation::SetDevice (Ptr<NetDevice> d)
+{
+  NS_FATAL_ERROR ("The end devices of a LoRaWANEndDevicePopulation have no net device");
+}
+
+Ptr<NetDevice>
+LoRaWANEndDevicePopulation::GetDevice (void) const
+{
+  return 0;
+}
+
+void
+LoRaWANEndDevicePopulation::SetMobility (Ptr<MobilityModel> m)
+{
+  NS_FATAL_ERROR ("The end devices of a LoRaWANEndDevicePopulation have their own position");
+}
+
+Ptr<MobilityModel>
+LoRaWANEndDevicePopulation::GetMobility (void)
+{
+  return m_mobility;
+}
+
+void
+LoRaWANEndDevicePopulation::SetChannel (Ptr<SpectrumChannel> c)
+{
+  NS_LOG_FUNCTION (this << c);
+  m_channel = c;
+}
+
+Ptr<const SpectrumModel>
+LoRaWANEndDevicePopulation::GetRxSpectrumModel (void) const
+{
+  LoRaWANSpectrumValueHelper psdHelper;
+  return psdHelper.CreateNoisePowerSpectralDensity (LoRaWAN::m_supportedChannels [0].m_fc)->GetSpectrumModel ();
+}
+
+Ptr<AntennaModel>
+LoRaWANEndDevicePopulation::GetRxAntenna (void)
+{
+  return 0;
+}
+
+void
+LoRaWANEndDevicePopulation::StartRx (Ptr<SpectrumSignalParameters> params)
+{
+  // The end devices do not receive, the population is not attached to the channel
+}
+
+} // namespace ns3
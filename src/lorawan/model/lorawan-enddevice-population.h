@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_ENDDEVICE_POPULATION_H
+#define LORAWAN_ENDDEVICE_POPULATION_H
+
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/traced-callback.h>
+#include <ns3/vector.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/packet.h>
+#include "lorawan-uplink-generator.h"
+#include "lorawan-mac.h"
+
+#include <vector>
+
+namespace ns3 {
+
+class ConstantPositionMobilityModel;
+class RandomVariableStream;
+class UniformRandomVariable;
+
+/**
+ * \ingroup lorawan
+ *
+ * The state of an end device of a LoRaWANEndDevicePopulation.
+ */
+struct LoRaWANCompactEndDevice
+{
+  Vector position;             //!< The position of the end device
+  uint32_t devAddr;            //!< The device address
+  uint32_t fCntUp;             //!< Uplink frame counter
+  uint32_t generatorIndex;     //!< The index of the end device in the uplink generator
+  uint8_t pendingChannelIndex; //!< The channel of the frame that waits for its sub band, NO_PENDING_FRAME if none
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * A population of uplink-only end devices that send unconfirmed upstream
+ * frames.
+ *
+ * An end device built from a Node, a LoRaWANNetDevice with its LoRaWANMac,
+ * LoRaWANPhy and RDC object, a MobilityModel, a packet socket and a
+ * LoRaWANEndDeviceApplication takes several kilobytes. The end devices of a
+ * population are a LoRaWANCompactEndDevice record each, plus their sub band
+ * RDC state, in contiguous arrays. Their transmissions are scheduled by a
+ * LoRaWANUplinkGenerator.
+ *
+ * The population is a SpectrumPhy that transmits the frames of all its end
+ * devices on a spectrum channel, from the position of the sending end device.
+ * The frames are the same PHYPayloads a LoRaWANMac sends (MAC header, frame
+ * header, FRMPayload and MIC), so the gateways and the network server handle
+ * them like the frames of any other end device. As the LoRaWANMac does, an
+ * end device waits for the sub band of its channel to become available
+ * again: the duty cycle is accounted by
+ * LoRaWANMac::LoRaWANMacRDC::ComputeSubBandAvailableTime, with the
+ * DutyCycleWindow of ns3::LoRaWANMacRDC. An end device only wakes up when its
+ * pending frame can be sent, as with LazyAvailability. It draws the time
+ * until its next frame once the frame was sent, so an end device never
+ * queues frames.
+ *
+ * The end devices do not receive: they are not attached to the channel and
+ * do not open the RX1 and RX2 receive windows of Class A, so they get no
+ * acknowledgements or MAC commands such as LinkADRReq. Use
+ * LoRaWANEndDeviceApplication for end devices that need downstream traffic.
+ */
+class LoRaWANEndDevicePopulation : public SpectrumPhy, public LoRaWANUplinkSource
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANEndDevicePopulation (void);
+  virtual ~LoRaWANEndDevicePopulation (void);
+
+  /**
+   * Add an end device and schedule its first frame after the UpstreamSend
+   * delay.
+   *
+   * \param devAddr the device address
+   * \param position the position of the end device
+   * \return the index of the end device
+   */
+  uint32_t AddEndDevice (Ipv4Address devAddr, const Vector &position);
+
+  /**
+   * \return the number of end devices
+   */
+  uint32_t GetNEndDevices (void) const;
+
+  /**
+   * \param index the index of the end device
+   * \return the state of the end device
+   */
+  const LoRaWANCompactEndDevice &GetEndDevice (uint32_t index) const;
+
+  /**
+   * Cancel the pending frames of all end devices.
+   */
+  void Stop (void);
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
+  // inherited from SpectrumPhy
+  virtual void SetDevice (Ptr<NetDevice> d);
+  virtual Ptr<NetDevice> GetDevice (void) const;
+  virtual void SetMobility (Ptr<MobilityModel> m);
+  virtual Ptr<MobilityModel> GetMobility (void);
+  virtual void SetChannel (Ptr<SpectrumChannel> c);
+  virtual Ptr<const SpectrumModel> GetRxSpectrumModel (void) const;
+  virtual Ptr<AntennaModel> GetRxAntenna (void);
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params);
+
+  // inherited from LoRaWANUplinkSource
+  virtual void SendUplink (uint32_t id);
+
+  static const uint8_t NO_PENDING_FRAME = 0xff;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \param channelIndex the channel index
+   * \return the TX PSD of the end devices on the channel
+   */
+  Ptr<SpectrumValue> GetTxPsd (uint8_t channelIndex);
+
+  /**
+   * \return the uplink generator, created if none was set
+   */
+  Ptr<LoRaWANUplinkGenerator> GetUplinkGenerator (void);
+
+  std::vector<LoRaWANCompactEndDevice> m_endDevices; //!< The end devices
+  std::vector<LoRaWANSubBand> m_subBands; //!< The RDC state of sub band s of end device d, at d * nSubBands + s
+  std::vector<LoRaWANMac::LoRaWANMacRDC::TransmissionList> m_transmissions; //!< The transmissions per sub band and end device, as m_subBands, only with a duty cycle window
+  LoRaWANMac::LoRaWANMacRDC::TransmissionList m_noTransmissions; //!< Stays empty, used without a duty cycle window
+  std::vector<LoRaWANSubBand> m_regionSubBands; //!< The duty cycle limits of the sub bands of the region
+  Time m_dutyCycleWindow;                 //!< The DutyCycleWindow of ns3::LoRaWANMacRDC
+
+  Ptr<LoRaWANUplinkGenerator> m_uplinkGenerator;    //!< Schedules the frames of the end devices
+  Ptr<ConstantPositionMobilityModel> m_mobility;    //!< Moved to the sending end device for every frame
+  Ptr<SpectrumChannel> m_channel;                   //!< The channel the frames are sent on
+  std::vector<Ptr<SpectrumValue> > m_txPsds;        //!< The TX PSD per channel, created on first use
+
+  Ptr<RandomVariableStream> m_channelRandomVariable;         //!< Picks the channel of a frame, if set
+  Ptr<UniformRandomVariable> m_uplinkChannelRandomVariable;  //!< Picks the channel of a frame otherwise
+  Ptr<RandomVariableStream> m_upstreamIATRandomVariable;     //!< Picks the time between frames of an end device
+  Ptr<RandomVariableStream> m_upstreamSendIATRandomVariable; //!< Picks the time until the first frame of an end device
+  uint32_t m_pktSize;       //!< Size of the PHYPayloads
+  uint8_t m_dataRateIndex;  //!< Data rate index of the frames
+  uint8_t m_codeRate;       //!< Code rate of the frames
+  double m_txPower;         //!< TX power in dBm
+  uint8_t m_framePort;      //!< Frame port
+
+  /**
+   * Traced Callback: transmitted frames, with the device address, the
+   * message type and the MACPayload, as LoRaWANEndDeviceApplication's
+   * USMsgTransmitted.
+   */
+  TracedCallback<uint32_t, uint8_t, Ptr<const Packet> > m_usMsgTransmittedTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_ENDDEVICE_POPULATION_H */
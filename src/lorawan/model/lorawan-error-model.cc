@@ -19,6 +19,7 @@
  */
 #include "lorawan-error-model.h"
 #include <ns3/log.h>
+#include <ns3/enum.h>
 
 #include <cmath>
 
@@ -28,6 +29,40 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANErrorModel");
 
 NS_OBJECT_ENSURE_REGISTERED (LoRaWANErrorModel);
 
+/**
+ * Coefficients from exp1_log_model_curvefit_truncated_output.txt, indexed on
+ * (SF - 7) * 2 + (CR == 3)
+ */
+static constexpr double g_aCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF] = {
+  -30.25798896,    // SF7, CR1
+  -105.19660816,   // SF7, CR3
+  -77.10020378,    // SF8, CR1
+  -289.81333927,   // SF8, CR3
+  -244.64237268,   // SF9, CR1
+  -1114.33115567,  // SF9, CR3
+  -725.95557882,   // SF10, CR1
+  -4285.44400727,  // SF10, CR3
+  -2109.80642246,  // SF11, CR1
+  -20771.69446082, // SF11, CR3
+  -4452.36530463,  // SF12, CR1
+  -98658.11656301, // SF12, CR3
+};
+
+static constexpr double g_bCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF] = {
+  0.28570229, // SF7, CR1
+  0.37455655, // SF7, CR3
+  0.29933678, // SF8, CR1
+  0.37560498, // SF8, CR3
+  0.32227064, // SF9, CR1
+  0.39694465, // SF9, CR3
+  0.33393115, // SF10, CR1
+  0.41164155, // SF10, CR3
+  0.34073142, // SF11, CR1
+  0.43318930, // SF11, CR3
+  0.33174696, // SF12, CR1
+  0.44852713, // SF12, CR3
+};
+
 TypeId
 LoRaWANErrorModel::GetTypeId (void)
 {
@@ -35,106 +70,73 @@ LoRaWANErrorModel::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANErrorModel> ()
+    .AddAttribute ("SuccessRateMode",
+                   "How the chunk success rate is computed: by evaluating the "
+                   "fitted curves, or by interpolating in precomputed tables",
+                   EnumValue (LoRaWANErrorModel::ANALYTIC),
+                   MakeEnumAccessor (&LoRaWANErrorModel::m_successRateMode),
+                   MakeEnumChecker (LoRaWANErrorModel::ANALYTIC, "Analytic",
+                                    LoRaWANErrorModel::TABLE_LINEAR, "TableLinear",
+                                    LoRaWANErrorModel::TABLE_CUBIC, "TableCubic"))
   ;
   return tid;
 }
 
 LoRaWANErrorModel::LoRaWANErrorModel (void)
+  : m_successRateMode (ANALYTIC)
 {
-  /**
-  * Coefficients from exp1_log_model_curvefit_truncated_output.txt
-  */
-
-  // SF7, CR1
-  m_aCoefficients[0] = -30.25798896;
-  m_bCoefficients[0] = 0.28570229;
-
-  // SF7, CR3
-  m_aCoefficients[1] = -105.19660816;
-  m_bCoefficients[1] = 0.37455655;
-
-  // SF8, CR1
-  m_aCoefficients[2] =-77.10020378;
-  m_bCoefficients[2] = 0.29933678;
-
-  // SF8, CR3
-  m_aCoefficients[3] = -289.81333927;
-  m_bCoefficients[3] = 0.37560498;
-
-  // SF9, CR1
-  m_aCoefficients[4] = -244.64237268;
-  m_bCoefficients[4] = 0.32227064;
-
-  // SF9, CR3
-  m_aCoefficients[5] = -1114.33115567;
-  m_bCoefficients[5] = 0.39694465;
-
-  // SF10, CR1
-  m_aCoefficients[6] = -725.95557882;
-  m_bCoefficients[6] = 0.33393115;
-
-  // SF10, CR3
-  m_aCoefficients[7] = -4285.44400727;
-  m_bCoefficients[7] = 0.41164155;
-
-  // SF11, CR1
-  m_aCoefficients[8] = -2109.80642246;
-  m_bCoefficients[8] = 0.34073142;
+}
 
-  // SF11, CR3
-  m_aCoefficients[9] = -20771.69446082;
-  m_bCoefficients[9] = 0.43318930;
+uint8_t
+LoRaWANErrorModel::GetCoefIndex (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate)
+{
+  uint8_t coefIndex = (spreadingFactor-7)*2;
+  if (codeRate == 3)
+    coefIndex+=1;
 
-  // SF12, CR1
-  m_aCoefficients[10] = -4452.36530463;
-  m_bCoefficients[10] = 0.33174696;
+  if (coefIndex >= LORAWAN_ERROR_MODEL_NR_COEFF) {
+    NS_FATAL_ERROR ("invalid coef index");
+  }
+  return coefIndex;
+}
 
-  // SF12, CR3
-  m_aCoefficients[11] = -98658.11656301;
-  m_bCoefficients[11] = 0.44852713;
+double
+LoRaWANErrorModel::GetMinSnr (LoRaSpreadingFactor spreadingFactor)
+{
+  // We checked the BER curves between snr_min and 0dB (where snr_min depends
+  // on the SF) and all curves are monotonically decreasing functions between
+  // these bounds (for increasing SNR_DB)
+  if (spreadingFactor == LORAWAN_SF11)
+    return -23;
+  else if (spreadingFactor == LORAWAN_SF12)
+    return -26;
+  else
+    return -20;
 }
 
 double
 LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
-  // Note only bandwidth 125kHz is supported
+  // The curves were fitted for 125kHz. The SNR is measured over the channel
+  // bandwidth and the demodulation SNR limits of LoRa only depend on the
+  // spreading factor, so they are also used for 250kHz and 500kHz.
 
   double snr_db_rounded = snr_db;
 
-  // We checked the BER curves between snr_min and 0dB (where snr_min depends
-  // on the SF) and all curves are monotonically decreasing functions between
-  // these bounds (for increasing SNR_DB)
-  if (spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10) {
-    if (snr_db < -20)
-      snr_db_rounded = -20;
-    if (snr_db > 0)
-      snr_db_rounded = 0;
-  } else if (spreadingFactor == LORAWAN_SF11) {
-    if (snr_db < -23)
-      snr_db_rounded = -23;
-    if (snr_db > 0)
-      snr_db_rounded = 0;
-  } else if (spreadingFactor == LORAWAN_SF12) {
-    if (snr_db < -26)
-      snr_db_rounded = -26;
-    if (snr_db > 0)
-      snr_db_rounded = 0;
-  }
+  const double snr_min = GetMinSnr (spreadingFactor);
+  if (snr_db < snr_min)
+    snr_db_rounded = snr_min;
+  if (snr_db > 0)
+    snr_db_rounded = 0;
 
   // Get index for coeffients in arrays:
-  uint8_t coefIndex = (spreadingFactor-7)*2;
-  if (codeRate == 3)
-    coefIndex+=1;
-
-  if (coefIndex >= LORAWAN_ERROR_MODEL_NR_COEFF) {
-    NS_FATAL_ERROR (this << "invalid coef index");
-  }
+  uint8_t coefIndex = GetCoefIndex (spreadingFactor, codeRate);
 
   // log10(BER) = a*exp(b*x) + c*exp(d*x) where x is the SNR in dB
-  double log_ber = m_aCoefficients[coefIndex]*exp (m_bCoefficients[coefIndex]*snr_db_rounded);
+  double log_ber = g_aCoefficients[coefIndex]*exp (g_bCoefficients[coefIndex]*snr_db_rounded);
   double ber = pow (10.0, log_ber);
 
   NS_LOG_LOGIC (this << " snr_db = " << snr_db << ", snr_db_rounded = " << snr_db_rounded << ", log_ber = " << log_ber << ", ber = " << ber);
@@ -145,27 +147,99 @@ LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFacto
 double
 LoRaWANErrorModel::GetChunkSuccessRate (double snr_db, uint32_t nbits, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
 
-  double ber = getBER (snr_db, bandWidth, spreadingFactor, codeRate);
+  double retval;
+  if (m_successRateMode == ANALYTIC)
+    {
+      double ber = getBER (snr_db, bandWidth, spreadingFactor, codeRate);
 
-  if (ber > 1.0)
-    NS_FATAL_ERROR (this << "BER is great than 1.0");
+      if (ber > 1.0)
+        NS_FATAL_ERROR (this << "BER is great than 1.0");
 
-  ber = std::min (ber, 1.0);
-  double retval = pow (1.0 - ber, nbits);
+      ber = std::min (ber, 1.0);
+      retval = pow (1.0 - ber, nbits);
+    }
+  else
+    {
+      retval = exp (nbits * GetLogBitSuccessRate (snr_db, spreadingFactor, codeRate, m_successRateMode == TABLE_CUBIC));
+    }
 
   NS_LOG_LOGIC (this << " snr_db = " << snr_db << ", nbits = " << nbits << ", spreadingFactor = " << static_cast<uint32_t>(spreadingFactor) << ", codeRate = " << static_cast<uint32_t>(codeRate) << ". ChunkSuccesRate = " << retval);
 
   return retval;
 }
 
+double
+LoRaWANErrorModel::GetLogBitSuccessRate (double snr_db, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate, bool cubic)
+{
+  const SuccessRateTable& table = GetTables ()[GetCoefIndex (spreadingFactor, codeRate)];
+  const uint32_t last = table.logSuccess.size () - 1;
+
+  // Clamp to the fitted range, like getBER does (also catches NaN)
+  if (!(snr_db > table.snrMin))
+    return table.logSuccess[0];
+  double x = (snr_db - table.snrMin) / LORAWAN_ERROR_MODEL_TABLE_STEP;
+  if (x >= last)
+    return table.logSuccess[last];
+
+  const uint32_t i = static_cast<uint32_t> (x);
+  const double t = x - i;
+  const double f0 = table.logSuccess[i];
+  const double f1 = table.logSuccess[i + 1];
+  if (!cubic)
+    return f0 + t * (f1 - f0);
+
+  // Cubic Hermite spline
+  const double t2 = t * t;
+  const double t3 = t2 * t;
+  const double h = LORAWAN_ERROR_MODEL_TABLE_STEP;
+  return (2*t3 - 3*t2 + 1) * f0 + (t3 - 2*t2 + t) * h * table.slope[i]
+         + (-2*t3 + 3*t2) * f1 + (t3 - t2) * h * table.slope[i + 1];
+}
+
+const std::vector<LoRaWANErrorModel::SuccessRateTable>&
+LoRaWANErrorModel::GetTables (void)
+{
+  static const std::vector<SuccessRateTable> tables = BuildTables ();
+  return tables;
+}
+
+std::vector<LoRaWANErrorModel::SuccessRateTable>
+LoRaWANErrorModel::BuildTables (void)
+{
+  NS_LOG_FUNCTION ("LoRaWANErrorModel::BuildTables");
+
+  std::vector<SuccessRateTable> tables (LORAWAN_ERROR_MODEL_NR_COEFF);
+  for (uint8_t coefIndex = 0; coefIndex < LORAWAN_ERROR_MODEL_NR_COEFF; coefIndex++)
+    {
+      const double a = g_aCoefficients[coefIndex];
+      const double b = g_bCoefficients[coefIndex];
+      SuccessRateTable& table = tables[coefIndex];
+      table.snrMin = GetMinSnr (static_cast<LoRaSpreadingFactor> (7 + coefIndex / 2));
+
+      const uint32_t n = static_cast<uint32_t> (std::floor (-table.snrMin / LORAWAN_ERROR_MODEL_TABLE_STEP + 0.5)) + 1;
+      table.logSuccess.resize (n);
+      table.slope.resize (n);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          const double snr = std::min (table.snrMin + i * LORAWAN_ERROR_MODEL_TABLE_STEP, 0.0);
+          const double log_ber = a * exp (b * snr);
+          const double ber = pow (10.0, log_ber);
+          // d(ln(1 - ber))/dx = -ber' / (1 - ber), with ber' = ber * ln(10) * b * log_ber
+          table.logSuccess[i] = log1p (-ber);
+          table.slope[i] = -ber * M_LN10 * b * log_ber / (1.0 - ber);
+        }
+    }
+  return tables;
+}
+
 double
 LoRaWANErrorModel::getSNRCutoffForRX (uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3);
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3);
 
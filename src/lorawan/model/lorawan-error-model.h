@@ -23,6 +23,8 @@
 #include "lorawan.h"
 #include <ns3/object.h>
 
+#include <vector>
+
 namespace ns3 {
 
 /**
@@ -46,8 +48,18 @@ namespace ns3 {
  *
  * Note that spreading factors 7, 8, 9, 10, 11 and 12 and CR=1 and CR=3 were
  * part of the baseband simulation.
+ *
+ * Evaluating the curves requires an exp and a pow per call. As an alternative,
+ * the per bit success rate ln(1 - BER) can be looked up in a table that is
+ * sampled every LORAWAN_ERROR_MODEL_TABLE_STEP dB over the fitted SNR range of
+ * each (SF, CR) pair. Between samples the table is interpolated linearly or
+ * with a cubic Hermite spline (using the exact derivative of the curve), and
+ * the chunk success rate is then exp(nbits * ln(1 - BER)). The tables are
+ * built once per process and shared between all error model instances. See the
+ * SuccessRateMode attribute.
  */
 #define LORAWAN_ERROR_MODEL_NR_COEFF 2*6
+#define LORAWAN_ERROR_MODEL_TABLE_STEP 0.01
 
 class LoRaWANErrorModel : public Object
 {
@@ -59,6 +71,16 @@ public:
    */
   static TypeId GetTypeId (void);
 
+  /**
+   * How GetChunkSuccessRate evaluates the error model.
+   */
+  typedef enum
+  {
+    ANALYTIC = 0,  //!< Evaluate the fitted curves for every call
+    TABLE_LINEAR,  //!< Linear interpolation in the precomputed tables
+    TABLE_CUBIC,   //!< Cubic Hermite interpolation in the precomputed tables
+  } SuccessRateMode;
+
   LoRaWANErrorModel (void);
 
   /**
@@ -79,12 +101,61 @@ public:
    * \return SNR cutoff in dB
    */
   double getSNRCutoffForRX (uint32_t bandwidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const;
+
+  /**
+   * Return the natural logarithm of the per bit success rate, ln(1 - BER),
+   * looked up in the precomputed table for the given SF and CR.
+   *
+   * \param snr_db SNR expressed in dB
+   * \param spreadingFactor the spreading factor
+   * \param codeRate the code rate
+   * \param cubic use cubic instead of linear interpolation
+   * \return ln(1 - BER)
+   */
+  static double GetLogBitSuccessRate (double snr_db, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate, bool cubic);
+
 private:
   /**
-   * Array of precalculated curve fitting coefficients.
+   * Per bit success rate table of a single (SF, CR) pair.
+   */
+  struct SuccessRateTable
+  {
+    double snrMin;                  //!< SNR (dB) of the first sample
+    std::vector<double> logSuccess; //!< ln(1 - BER) every LORAWAN_ERROR_MODEL_TABLE_STEP dB
+    std::vector<double> slope;      //!< Derivative of logSuccess to the SNR (1/dB)
+  };
+
+  /**
+   * \param spreadingFactor the spreading factor
+   * \param codeRate the code rate
+   * \return the index of the (SF, CR) pair in the coefficient tables
+   */
+  static uint8_t GetCoefIndex (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate);
+
+  /**
+   * \param spreadingFactor the spreading factor
+   * \return the lowest SNR (dB) for which the curve of the SF was fitted
+   */
+  static double GetMinSnr (LoRaSpreadingFactor spreadingFactor);
+
+  /**
+   * Get the success rate tables, they are built on first use.
+   *
+   * \return the tables, indexed on the coefficient index
+   */
+  static const std::vector<SuccessRateTable>& GetTables (void);
+
+  /**
+   * Sample the fitted curves of all (SF, CR) pairs.
+   *
+   * \return the tables, indexed on the coefficient index
+   */
+  static std::vector<SuccessRateTable> BuildTables (void);
+
+  /**
+   * The mode used by GetChunkSuccessRate.
    */
-  double m_aCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF];
-  double m_bCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF];
+  SuccessRateMode m_successRateMode;
 };
 
 
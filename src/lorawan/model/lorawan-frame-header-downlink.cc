@@ -388,7 +388,7 @@ bool LoRaWANFrameHeaderDownlink::AddLoRaTimeSlotDelayReq(uint8_t timeslot, uint8
     return false;
   }
 
-  m_frameControl += m_macCommandsNS[LinkADRReq].m_size; //add size of MAC command to the FOptsLen, which is [3:0] of FCtrl
+  m_frameControl += m_macCommandsNS[TimeSlotDelayReq].m_size; //add size of MAC command to the FOptsLen, which is [3:0] of FCtrl
 
   m_timeslotByte = timeslot;
   m_macCommandsNS[TimeSlotDelayReq].m_isBeingUsed = true;
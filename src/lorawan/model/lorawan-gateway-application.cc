@@ -18,6 +18,7 @@
  * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
  */
 #include <algorithm>
+#include <cmath>
 
 #include "ns3/log.h"
 #include "ns3/address.h"
@@ -34,6 +35,7 @@
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
 #include "ns3/trace-source-accessor.h"
 #include "lorawan.h"
 #include "lorawan-net-device.h"
@@ -44,6 +46,11 @@
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/system-thread.h"
+#include <thread>
+#endif
 
 // DONE: info.m_timeslotsRecorder changes size whenever the DR changes. And timeslotsDrChanged also gets changed to true
 // DONE: and an index gets flipped whenever a packet is received.
@@ -114,7 +121,11 @@ time to send a 33 byte packet, for each DR:
 
 //Ptr<LightweightTimeslots> LoRaWANNetworkServer::m_lightweightTimeslotsPtr = NULL;
 
-LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0) {}
+LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0),
+  m_dedupWindow(MilliSeconds (200)), m_dedupTick(MilliSeconds (50).GetTimeStep ()), m_dedupWheel(8),
+  m_adrHistoryLength(20), m_adrMargin(10.0), m_timeslotsDetectionThreads(0) {}
+
+const uint32_t LoRaWANNetworkServer::NO_DEDUP_ENTRY;
 
 TypeId
 LoRaWANNetworkServer::GetTypeId (void)
@@ -147,6 +158,31 @@ LoRaWANNetworkServer::GetTypeId (void)
                    StringValue ("ns3::ConstantRandomVariable[Constant=3600.0]"),
                    MakePointerAccessor (&LoRaWANNetworkServer::m_timeSlotCalcRandomVariable),
                    MakePointerChecker <RandomVariableStream>()) 
+    .AddAttribute ("DeduplicationWindow",
+                   "The time during which the receptions of an upstream frame by several gateways are collected, "
+                   "starting at the first reception. The frame is processed once the window closes. "
+                   "The window is rounded up to a quarter of its length and has to close before RW1.",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&LoRaWANNetworkServer::SetDeduplicationWindow,
+                                     &LoRaWANNetworkServer::GetDeduplicationWindow),
+                   MakeTimeChecker (NanoSeconds (4)))
+    .AddAttribute ("ADRHistoryLength",
+                   "The number of US frames with the ADR bit set over which the highest SNR of an end device is taken. "
+                   "The data rate of an end device is only changed once this many frames were received.",
+                   UintegerValue (20),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_adrHistoryLength),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ADRMargin",
+                   "The margin in dB that the ADR engine keeps above the SNR required at the data rate of an end device.",
+                   DoubleValue (10.0),
+                   MakeDoubleAccessor (&LoRaWANNetworkServer::m_adrMargin),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("TimeslotsDetectionThreads",
+                   "The number of threads that run the periodicity detector of the lightweight timeslots, "
+                   "0 for one per hardware thread. The result does not depend on the number of threads.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_timeslotsDetectionThreads),
+                   MakeUintegerChecker<uint32_t> ())
     .AddTraceSource ("nrRW1Sent",
                      "The number of times that a DS packet was sent in RW1 by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrRW1Sent),
@@ -230,10 +266,7 @@ LoRaWANNetworkServer::PopulateEndDevices (void)
         continue;
       }
 
-      // Construct LoRaWANEndDeviceInfoNS object
-      LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (ipv4DevAddr);
-      uint32_t key = ipv4DevAddr.Get ();
-      m_endDevices[key] = info; // store object
+      AddEndDevice (ipv4DevAddr);
     } else {
       NS_LOG_ERROR (this << " Unable to allocate device address");
       continue;
@@ -264,8 +297,8 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
   currentTimePeriodStart = Simulator::Now () ;
 
   int count = 0;
-  for (auto d = m_endDevices.cbegin(); d != m_endDevices.cend(); d++) {
-    count += d->second.m_nUSPackets;
+  for (uint32_t d = 0; d < m_endDevices.GetSize (); d++) {
+    count += m_endDevices.GetHot (d).m_nUSPackets;
   }
   std::cout << "count loop: " << count << std::endl;
 
@@ -283,106 +316,8 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
   //m_timeSlotCalcEvent = Simulator::Schedule (nextTimeslotCalcTime,
   //                                     &LightweightTimeslots::LightweightTimeSlots, this); //or something like this
 
-  //loop through m_endDevices ("loop", it's a map)
-  // if it->second.m_timeslotsDrChanged is false
-  // run periodicity detector i.e. 
-
-  periodicitiesDR0.clear();
-  periodicitiesDR1.clear();
-  periodicitiesDR2.clear();
-  periodicitiesDR3.clear();
-  periodicitiesDR4.clear();
-  periodicitiesDR5.clear();
-
-  //for each device
-  for (auto& it: m_endDevices) {
-      //if the DR hasn't changed in the last time period
-      if(!(it.second.m_timeslotsDrChanged)) {
-        //run the periodicity detector.
-        float alpha = 0.99;
-
-        /*std::cout << "start dev" << std::endl;
-        for(uint i=0;i<it.second.m_timeslotsRecorder.size();i++) {
-          if(it.second.m_timeslotsRecorder[i] == 1) {
-            std::cout << i << std::endl;
-          }
-        }
-        std::cout << "end dev" << std::endl;*/
-        //std::cout << "going to run TiCom for device " << it.second.m_deviceAddress.Get() << std::endl;
-        std::vector<std::tuple <int, int>> S = this->m_lightweightTimeslotsPtr->TiComWithAutocorrelation(it.second.m_timeslotsRecorder, alpha, it.second.m_lastDataRateIndex);
-        //std::cout << "first S found for device " << it.second.m_deviceAddress.Get() << " is (" << std::get<0>(S[0]) << "," << std::get<1>(S[0]) << ")" << std::endl;
-        //std::cout << "s size is " << S.size() << std::endl;
-        //std::cout << "s size: " << S.size() << std::endl;
-
-        // the periodicities detected won't be perfect unless the real periodicity of the transmission is a multiple of the size of the time slot, which we have no guarantee of
-        // and there is no possible value for the timeslots we can choose that will fit perfectly because any periodicity is possible.
-        // but our detector will provide decent answers which we can recombine back into one (p,o) tuple 
-        //TODO: search through this vector of tuples, combine any that have the same p values and an o value less than 3
-        // which value to choose though? The first one as it will have the higher confidence value
-        
-        //TODO: this is a stupidly slow way of doing this
-        std::vector<uint> toRemove;
-        for(uint i=0;i<S.size();i++){
-          for(uint j=i+1;j<S.size();j++){
-            if(std::get<0>(S[i]) == std::get<0>(S[j])) {
-              if(abs(std::get<1>(S[i]) - std::get<1>(S[j])) < 3) {
-                if(!(std::find(toRemove.begin(), toRemove.end(), j) != toRemove.end())) {
-                  toRemove.push_back(j);
-                  //std::cout << std::get<0>(S[i]) << " " << std::get<1>(S[i]) << " is the same periodicity is " << std::get<0>(S[j]) << " " << std::get<1>(S[j]) << ", deleting the second" << std::endl ;
-                }
-              }
-            }
-          }
-        }
-        for(uint i=toRemove.size(); i-- > 0;) {
-          S.erase(S.begin() + toRemove[i]);
-        }
-
-        //TODO: just using best result here, simplest solution for now.
-
-        /*for(uint i=0;i<S.size();i++){
-          //std::cout << std::get<0>(S[i]) << " " << std::get<1>(S[i]) << std::endl;
-          //add S with node id to a dr-specific vector
-          if(it.second.m_lastDataRateIndex == 0) {
-            periodicitiesDR0.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay, 0});
-          } else if(it.second.m_lastDataRateIndex == 1) {
-            periodicitiesDR1.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 2) {
-            periodicitiesDR2.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 3) {
-            periodicitiesDR3.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 4) {
-            periodicitiesDR4.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else {
-            periodicitiesDR5.push_back({std::get<0>(S[i]), std::get<1>(S[i]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          }
-        }*/
-
-          //std::cout << "periodicity for device " << it.second.m_deviceAddress.Get() << " is (" << std::get<0>(S[0]) << ", " << std::get<1>(S[0]) << ")" << std::endl; 
-          
-
-          if(it.second.m_lastDataRateIndex == 0) {
-            periodicitiesDR0.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay, 0});
-          } else if(it.second.m_lastDataRateIndex == 1) {
-            periodicitiesDR1.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 2) {
-            periodicitiesDR2.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 3) {
-            periodicitiesDR3.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else if(it.second.m_lastDataRateIndex == 4) {
-            periodicitiesDR4.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          } else {
-            periodicitiesDR5.push_back({std::get<0>(S[0]), std::get<1>(S[0]), it.second.m_deviceAddress.Get(), it.second.m_timeslotDelay , 0});
-          }
-
-      } else {
-        //std::cout << "dr for this device changed" << std::endl;
-      }
-
-      //clear the timeslots recorder for this device back to all 0s.
-      //TODO: there is likely a more efficient way of doing this
-      it.second.m_timeslotsRecorder = std::vector<unsigned char>(m_timeSlotsPerDataRate[it.second.m_lastDataRateIndex].m_slots, 0); 
-  }
+  //run the periodicity detector on every device that hasn't changed DR in the last period
+  DetectPeriodicities ();
 
   std::sort(periodicitiesDR1.begin(), periodicitiesDR1.end(), sortByPthenO);
   //std::cout << "devices in DR1 before run: " << periodicitiesDR1.size() << std::endl;
@@ -407,17 +342,17 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
   // send the MAC command in the next downlink
   uint c = 0;
   for(uint i=0; i<periodicitiesDR0.size(); i++) {
-    if(periodicitiesDR0[i].change != m_endDevices[periodicitiesDR0[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR0[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR0[i].change != GetEndDeviceInfo (periodicitiesDR0[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR0[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
         //std::cout << "changing the slot for device " << periodicitiesDR0[i].uID << " from ";
-        //printf("%u to %u, changing to (%u, %u)\r\n", m_endDevices[periodicitiesDR0[i].uID].m_timeslotDelay, periodicitiesDR0[i].change, periodicitiesDR0[i].p, periodicitiesDR0[i].o);
-        m_endDevices[periodicitiesDR0[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR0[i].uID].m_timeslotDelay = periodicitiesDR0[i].change;
+        //printf("%u to %u, changing to (%u, %u)\r\n", GetEndDeviceInfo (periodicitiesDR0[i].uID).m_timeslotDelay, periodicitiesDR0[i].change, periodicitiesDR0[i].p, periodicitiesDR0[i].o);
+        GetEndDeviceInfo (periodicitiesDR0[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR0[i].uID).m_timeslotDelay = periodicitiesDR0[i].change;
 
         c++;
-        m_endDevices[periodicitiesDR0[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR0[i].uID).m_changedInLastPeriod = true;
     } else {
-        m_endDevices[periodicitiesDR0[i].uID].m_changedInLastPeriod = false;
+        GetEndDeviceColdInfo (periodicitiesDR0[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR0 send count: " <<  c << std::endl;
@@ -427,22 +362,22 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
   std::sort(periodicitiesDR1.begin(), periodicitiesDR1.end(), sortByPthenO);
   /*std::cout << "devices in DR1 after run: " << periodicitiesDR1.size() << std::endl;
   for(uint i=0; i<periodicitiesDR1.size(); i++) {
-    std::cout << periodicitiesDR1[i].uID << ": (" << periodicitiesDR1[i].p << "," << periodicitiesDR1[i].o << "), a change from  " << m_endDevices[periodicitiesDR1[i].uID].m_timeslotDelay << " to " << periodicitiesDR1[i].change << std::endl;
+    std::cout << periodicitiesDR1[i].uID << ": (" << periodicitiesDR1[i].p << "," << periodicitiesDR1[i].o << "), a change from  " << GetEndDeviceInfo (periodicitiesDR1[i].uID).m_timeslotDelay << " to " << periodicitiesDR1[i].change << std::endl;
   }*/
 
   //std::cout << "devices in DR1: " << periodicitiesDR1.size() << std::endl;
   for(uint i=0; i<periodicitiesDR1.size(); i++) {
 
-    if(periodicitiesDR1[i].change != m_endDevices[periodicitiesDR1[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR1[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR1[i].change != GetEndDeviceInfo (periodicitiesDR1[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR1[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
         //std::cout << "changing the slot for device " << periodicitiesDR1[i].uID << " from ";
-        //printf("%u to %u, changing to (%u, %u)\r\n", m_endDevices[periodicitiesDR1[i].uID].m_timeslotDelay, periodicitiesDR1[i].change, periodicitiesDR1[i].p, periodicitiesDR1[i].o);
-        m_endDevices[periodicitiesDR1[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR1[i].uID].m_timeslotDelay = periodicitiesDR1[i].change;
+        //printf("%u to %u, changing to (%u, %u)\r\n", GetEndDeviceInfo (periodicitiesDR1[i].uID).m_timeslotDelay, periodicitiesDR1[i].change, periodicitiesDR1[i].p, periodicitiesDR1[i].o);
+        GetEndDeviceInfo (periodicitiesDR1[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR1[i].uID).m_timeslotDelay = periodicitiesDR1[i].change;
         c++;
-        m_endDevices[periodicitiesDR1[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR1[i].uID).m_changedInLastPeriod = true;
     } else {
-        m_endDevices[periodicitiesDR1[i].uID].m_changedInLastPeriod = false;
+        GetEndDeviceColdInfo (periodicitiesDR1[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR1 send count: " <<  c << std::endl;
@@ -451,56 +386,56 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
 
   c = 0;
   for(uint i=0; i<periodicitiesDR2.size(); i++) {
-    if(periodicitiesDR2[i].change != m_endDevices[periodicitiesDR2[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR2[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR2[i].change != GetEndDeviceInfo (periodicitiesDR2[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR2[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
-        m_endDevices[periodicitiesDR2[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR2[i].uID].m_timeslotDelay = periodicitiesDR2[i].change;
+        GetEndDeviceInfo (periodicitiesDR2[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR2[i].uID).m_timeslotDelay = periodicitiesDR2[i].change;
         c++;
-        m_endDevices[periodicitiesDR2[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR2[i].uID).m_changedInLastPeriod = true;
     } else {
-      m_endDevices[periodicitiesDR2[i].uID].m_changedInLastPeriod = false;
+      GetEndDeviceColdInfo (periodicitiesDR2[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR2 send count: " <<  c << std::endl;
 
   c = 0;
   for(uint i=0; i<periodicitiesDR3.size(); i++) {
-    if(periodicitiesDR3[i].change != m_endDevices[periodicitiesDR3[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR3[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR3[i].change != GetEndDeviceInfo (periodicitiesDR3[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR3[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
-        m_endDevices[periodicitiesDR3[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR3[i].uID].m_timeslotDelay = periodicitiesDR3[i].change;
+        GetEndDeviceInfo (periodicitiesDR3[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR3[i].uID).m_timeslotDelay = periodicitiesDR3[i].change;
         c++;
-        m_endDevices[periodicitiesDR3[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR3[i].uID).m_changedInLastPeriod = true;
     } else {
-      m_endDevices[periodicitiesDR3[i].uID].m_changedInLastPeriod = false;
+      GetEndDeviceColdInfo (periodicitiesDR3[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR3 send count: " <<  c << std::endl;
 
   c = 0;
   for(uint i=0; i<periodicitiesDR4.size(); i++) {
-    if(periodicitiesDR4[i].change != m_endDevices[periodicitiesDR4[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR4[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR4[i].change != GetEndDeviceInfo (periodicitiesDR4[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR4[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
-        m_endDevices[periodicitiesDR4[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR4[i].uID].m_timeslotDelay = periodicitiesDR4[i].change;
+        GetEndDeviceInfo (periodicitiesDR4[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR4[i].uID).m_timeslotDelay = periodicitiesDR4[i].change;
         c++;
-        m_endDevices[periodicitiesDR4[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR4[i].uID).m_changedInLastPeriod = true;
     } else {
-        m_endDevices[periodicitiesDR4[i].uID].m_changedInLastPeriod = false;
+        GetEndDeviceColdInfo (periodicitiesDR4[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR4 send count: " <<  c << std::endl;
 
   c = 0;
   for(uint i=0; i<periodicitiesDR5.size(); i++) {
-    if(periodicitiesDR5[i].change != m_endDevices[periodicitiesDR5[i].uID].m_timeslotDelay && m_endDevices[periodicitiesDR5[i].uID].m_changedInLastPeriod == false) {
+    if(periodicitiesDR5[i].change != GetEndDeviceInfo (periodicitiesDR5[i].uID).m_timeslotDelay && GetEndDeviceColdInfo (periodicitiesDR5[i].uID).m_changedInLastPeriod == false) {
         // if MAC command has not yet been added, add the MAC command to the device's next downlink frame
-        m_endDevices[periodicitiesDR5[i].uID].m_runTimeSlotMAC = true;
-        m_endDevices[periodicitiesDR5[i].uID].m_timeslotDelay = periodicitiesDR5[i].change;
+        GetEndDeviceInfo (periodicitiesDR5[i].uID).m_runTimeSlotMAC = true;
+        GetEndDeviceInfo (periodicitiesDR5[i].uID).m_timeslotDelay = periodicitiesDR5[i].change;
         c++;
-        m_endDevices[periodicitiesDR5[i].uID].m_changedInLastPeriod = true;
+        GetEndDeviceColdInfo (periodicitiesDR5[i].uID).m_changedInLastPeriod = true;
     } else {
-        m_endDevices[periodicitiesDR5[i].uID].m_changedInLastPeriod = false;
+        GetEndDeviceColdInfo (periodicitiesDR5[i].uID).m_changedInLastPeriod = false;
     }
   }
   std::cout << "DR5 send count: " <<  c << std::endl;
@@ -509,11 +444,112 @@ LoRaWANNetworkServer::LightweightTimeslotsScheduler (void)
                                        &LoRaWANNetworkServer::LightweightTimeslotsScheduler, this);                                      
 }
 
+void
+LoRaWANNetworkServer::DetectPeriodicities (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t nWorkers = m_timeslotsDetectionThreads;
+#ifdef HAVE_PTHREAD_H
+  if (nWorkers == 0) {
+    nWorkers = std::thread::hardware_concurrency ();
+  }
+#else
+  nWorkers = 1;
+#endif
+  nWorkers = std::max<uint32_t> (1, std::min<uint32_t> (nWorkers, m_endDevices.GetSize ()));
+
+  // The detectors are created here, in the simulator thread, as the FFTW
+  // planner is not thread safe. Executing the plans is.
+  if (m_timeslotsDetectors.empty ()) {
+    m_timeslotsDetectors.push_back (m_lightweightTimeslotsPtr ? m_lightweightTimeslotsPtr : CreateObject<LightweightTimeslots> ());
+  }
+  while (m_timeslotsDetectors.size () < nWorkers) {
+    m_timeslotsDetectors.push_back (CreateObject<LightweightTimeslots> ());
+  }
+  m_detectedPeriodicities.assign (m_endDevices.GetSize (), std::tuple<int, int> (0, 0));
+
+  NS_LOG_LOGIC (this << " detecting the periodicity of " << m_endDevices.GetSize () << " end devices with " << nWorkers << " workers");
+#ifdef HAVE_PTHREAD_H
+  std::vector<Ptr<SystemThread> > threads;
+  for (uint32_t w = 1; w < nWorkers; w++) {
+    threads.push_back (Create<SystemThread> (MakeCallback (&LoRaWANNetworkServer::DetectPeriodicitiesWorker, this).TwoBind (w, nWorkers)));
+    threads.back ()->Start ();
+  }
+#endif
+  DetectPeriodicitiesWorker (0, nWorkers);
+#ifdef HAVE_PTHREAD_H
+  for (uint32_t i = 0; i < threads.size (); i++) {
+    threads[i]->Join ();
+  }
+#endif
+
+  // Merge in the order of m_endDevices, as the serial detector did
+  std::vector<Periodicity>* periodicities[] = {&periodicitiesDR0, &periodicitiesDR1, &periodicitiesDR2,
+                                               &periodicitiesDR3, &periodicitiesDR4, &periodicitiesDR5};
+  for (uint32_t i = 0; i < 6; i++) {
+    periodicities[i]->clear ();
+  }
+  for (uint32_t d = 0; d < m_endDevices.GetSize (); d++) {
+    const LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (d);
+    const std::tuple<int, int> &s = m_detectedPeriodicities[d];
+    if (std::get<0> (s) > 0) {
+      periodicities[std::min<uint8_t> (info.m_lastDataRateIndex, 5)]->push_back ({std::get<0> (s), std::get<1> (s), info.m_deviceAddress.Get (), info.m_timeslotDelay, 0});
+    }
+  }
+}
+
+void
+LoRaWANNetworkServer::DetectPeriodicitiesWorker (uint32_t worker, uint32_t nWorkers)
+{
+  // Only reads the state of m_endDevices that the simulator thread does not
+  // change while the workers run, and only writes the entries of its own end
+  // devices
+  LightweightTimeslots *detector = PeekPointer (m_timeslotsDetectors[worker]);
+  for (uint32_t d = worker; d < m_endDevices.GetSize (); d += nWorkers) {
+    const LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (d);
+    LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (d);
+    //if the DR hasn't changed in the last time period
+    if (!coldInfo.m_timeslotsDrChanged) {
+      float alpha = 0.99;
+      std::vector<std::tuple <int, int>> S = detector->TiComWithAutocorrelation (coldInfo.m_timeslotsRecorder, alpha, info.m_lastDataRateIndex);
+
+      // the periodicities detected won't be perfect unless the real periodicity of the transmission is a multiple of the size of the time slot.
+      //TODO: just using best result here, simplest solution for now.
+      if (!S.empty ()) {
+        m_detectedPeriodicities[d] = S[0];
+      }
+    }
+
+    //clear the timeslots recorder for this device back to all 0s.
+    coldInfo.m_timeslotsRecorder.Reset (m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots);
+  }
+}
+
+const std::vector<Periodicity>&
+LoRaWANNetworkServer::GetPeriodicities (uint8_t dataRateIndex) const
+{
+  switch (dataRateIndex) {
+    case 0: return periodicitiesDR0;
+    case 1: return periodicitiesDR1;
+    case 2: return periodicitiesDR2;
+    case 3: return periodicitiesDR3;
+    case 4: return periodicitiesDR4;
+    default: return periodicitiesDR5;
+  }
+}
+
 void
 LoRaWANNetworkServer::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
 
+  m_dedupEvent.Cancel ();
+  m_dedupWheel.Clear ();
+  m_dedupEntries.clear ();
+  m_freeDedupEntries.clear ();
+  m_timeslotsDetectors.clear ();
+
   PrintFinalDetails();
 
 
@@ -546,12 +582,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR0.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR0[i].p);l++) {
       if((l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o < DR_size) {
-          m_endDevices[periodicitiesDR0[i].uID].m_finalExpectedAverageCollisions += period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] - 1;
+          GetEndDeviceColdInfo (periodicitiesDR0[i].uID).m_finalExpectedAverageCollisions += period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] - 1;
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR0[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR0[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR0[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR0[i].p);
   }
   std::cout << "DR0:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_0);
@@ -575,12 +611,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR1.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR1[i].p);l++) {
       if((l*periodicitiesDR1[i].p)+periodicitiesDR1[i].o < DR_size) {
-        m_endDevices[periodicitiesDR1[i].uID].m_finalExpectedAverageCollisions += period_counter_1[(l*periodicitiesDR1[i].p)+periodicitiesDR1[i].o] - 1;
+        GetEndDeviceColdInfo (periodicitiesDR1[i].uID).m_finalExpectedAverageCollisions += period_counter_1[(l*periodicitiesDR1[i].p)+periodicitiesDR1[i].o] - 1;
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR1[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR1[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR1[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR1[i].p);
   }
   std::cout << "DR1:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_1);
@@ -604,12 +640,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR2.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR2[i].p);l++) {
       if((l*periodicitiesDR2[i].p)+periodicitiesDR2[i].o < DR_size) {
-        m_endDevices[periodicitiesDR2[i].uID].m_finalExpectedAverageCollisions += period_counter_2[(l*periodicitiesDR2[i].p)+periodicitiesDR2[i].o] - 1;
+        GetEndDeviceColdInfo (periodicitiesDR2[i].uID).m_finalExpectedAverageCollisions += period_counter_2[(l*periodicitiesDR2[i].p)+periodicitiesDR2[i].o] - 1;
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR2[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR2[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR2[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR2[i].p);
   }
   std::cout << "DR2:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_2);
@@ -633,12 +669,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR3.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR3[i].p);l++) {
       if((l*periodicitiesDR3[i].p)+periodicitiesDR3[i].o < DR_size) {
-          m_endDevices[periodicitiesDR3[i].uID].m_finalExpectedAverageCollisions += period_counter_3[(l*periodicitiesDR3[i].p)+periodicitiesDR3[i].o] - 1;       
+          GetEndDeviceColdInfo (periodicitiesDR3[i].uID).m_finalExpectedAverageCollisions += period_counter_3[(l*periodicitiesDR3[i].p)+periodicitiesDR3[i].o] - 1;       
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR3[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR3[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR3[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR3[i].p);
   }
   std::cout << "DR3:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_3);
@@ -662,12 +698,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR4.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR4[i].p);l++) {
       if((l*periodicitiesDR4[i].p)+periodicitiesDR4[i].o < DR_size) {
-          m_endDevices[periodicitiesDR4[i].uID].m_finalExpectedAverageCollisions += period_counter_4[(l*periodicitiesDR4[i].p)+periodicitiesDR4[i].o] - 1;
+          GetEndDeviceColdInfo (periodicitiesDR4[i].uID).m_finalExpectedAverageCollisions += period_counter_4[(l*periodicitiesDR4[i].p)+periodicitiesDR4[i].o] - 1;
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR4[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR4[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR4[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR4[i].p);
   }
   std::cout << "DR4:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_4);
@@ -691,12 +727,12 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   for(uint i=0; i<periodicitiesDR5.size(); i++) {
     for(uint l=0;l<(DR_size / periodicitiesDR5[i].p);l++) {
       if((l*periodicitiesDR5[i].p)+periodicitiesDR5[i].o < DR_size) {
-          m_endDevices[periodicitiesDR5[i].uID].m_finalExpectedAverageCollisions += period_counter_5[(l*periodicitiesDR5[i].p)+periodicitiesDR5[i].o] - 1;  
+          GetEndDeviceColdInfo (periodicitiesDR5[i].uID).m_finalExpectedAverageCollisions += period_counter_5[(l*periodicitiesDR5[i].p)+periodicitiesDR5[i].o] - 1;  
       }
        
       //period_counter_0[(l*periodicitiesDR0[i].p)+periodicitiesDR0[i].o] += 1;
     }
-    m_endDevices[periodicitiesDR5[i].uID].m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR5[i].p);
+    GetEndDeviceColdInfo (periodicitiesDR5[i].uID).m_finalExpectedAverageCollisions /= (DR_size / periodicitiesDR5[i].p);
   }
   std::cout << "DR5:" << std::endl;
   PrintAvgAndStdDevOfTimeSlots(period_counter_5);
@@ -706,13 +742,15 @@ LoRaWANNetworkServer::PrintFinalDetails ()
   int count = 0;
   std::array<float,6> countDevicesByDR = {0};
   std::array<float,6> countUplinksByDR = {0};
-  for (auto d = m_endDevices.cbegin(); d != m_endDevices.cend(); d++) {
-     std::cout << std::dec << d->second.m_deviceAddress.Get() - 1 << "\t" /*<<  d->second.m_nDSPacketsGenerated <<  
-    "\t" << d->second.m_nDSPacketsSent << "\t" << d->second.m_nDSPacketsSentRW1 << "\t" << d->second.m_nDSPacketsSentRW2 << 
-    "\t" << d->second.m_nDSRetransmission << "\t" << d->second.m_nDSAcks << "\t"*/ << d->second.m_nUSPackets << "\t" << d->second.m_lastDataRateIndex << "\t" << d->second.m_finalExpectedAverageCollisions << "\t" << d->second.m_timeslotDelay <<  std::endl;
-    count += d->second.m_nUSPackets;
-    countDevicesByDR[d->second.m_lastDataRateIndex]++;
-    countUplinksByDR[d->second.m_lastDataRateIndex] += d->second.m_nUSPackets;
+  for (uint32_t d = 0; d < m_endDevices.GetSize (); d++) {
+    const LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (d);
+    const LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (d);
+     std::cout << std::dec << info.m_deviceAddress.Get() - 1 << "\t" /*<<  coldInfo.m_nDSPacketsGenerated <<  
+    "\t" << coldInfo.m_nDSPacketsSent << "\t" << coldInfo.m_nDSPacketsSentRW1 << "\t" << coldInfo.m_nDSPacketsSentRW2 << 
+    "\t" << coldInfo.m_nDSRetransmission << "\t" << coldInfo.m_nDSAcks << "\t"*/ << info.m_nUSPackets << "\t" << info.m_lastDataRateIndex << "\t" << coldInfo.m_finalExpectedAverageCollisions << "\t" << info.m_timeslotDelay <<  std::endl;
+    count += info.m_nUSPackets;
+    countDevicesByDR[info.m_lastDataRateIndex]++;
+    countUplinksByDR[info.m_lastDataRateIndex] += info.m_nUSPackets;
   }
   //the timeslot delay and lastDR can be combined to calculated the introduced delay
 
@@ -747,27 +785,51 @@ LoRaWANNetworkServer::PrintAvgAndStdDevOfTimeSlots (std::vector<unsigned char> p
   std::cout << "mean: " << mean << " stddev: " << stddev << std::endl;
 }
 
-LoRaWANEndDeviceInfoNS
-LoRaWANNetworkServer::InitEndDeviceInfo (Ipv4Address ipv4DevAddr)
+uint32_t
+LoRaWANNetworkServer::AddEndDevice (Ipv4Address ipv4DevAddr)
 {
   uint32_t key = ipv4DevAddr.Get ();
 
-  // Construct LoRaWANEndDeviceInfoNS object
-  LoRaWANEndDeviceInfoNS info;
+  // Construct the LoRaWANEndDeviceInfoNS objects in place
+  const uint32_t index = m_endDevices.Insert (key);
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
   info.m_deviceAddress = ipv4DevAddr;
   info.m_rx1DROffset = 0; // default
   info.m_setAck = false;
 
-  info.m_timeslotsRecorder = std::vector<unsigned char>(m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots, 0); 
+  coldInfo.m_timeslotsRecorder.Reset (m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots); 
 
 
   if (m_generateDataDown) {
     Time t = Seconds (this->m_downstreamIATRandomVariable->GetValue ());
-    info.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, key);
+    coldInfo.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, key);
     NS_LOG_DEBUG (this << " DS Traffic Timer for node " << ipv4DevAddr << " scheduled at " << t);
   }
 
-  return info;
+  return index;
+}
+
+uint32_t
+LoRaWANNetworkServer::GetNEndDevices (void) const
+{
+  return m_endDevices.GetSize ();
+}
+
+LoRaWANEndDeviceInfoNS&
+LoRaWANNetworkServer::GetEndDeviceInfo (uint32_t deviceAddr)
+{
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  NS_ASSERT_MSG (index != m_endDevices.NOT_FOUND, "Unknown end device " << Ipv4Address (deviceAddr));
+  return m_endDevices.GetHot (index);
+}
+
+LoRaWANEndDeviceColdInfoNS&
+LoRaWANNetworkServer::GetEndDeviceColdInfo (uint32_t deviceAddr)
+{
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  NS_ASSERT_MSG (index != m_endDevices.NOT_FOUND, "Unknown end device " << Ipv4Address (deviceAddr));
+  return m_endDevices.GetCold (index);
 }
 
 Ptr<LoRaWANNetworkServer>
@@ -781,98 +843,219 @@ LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()
   return LoRaWANNetworkServer::m_ptr;
 }
 
+void
+LoRaWANNetworkServer::SetDeduplicationWindow (Time window)
+{
+  NS_ABORT_MSG_UNLESS (m_dedupWheel.IsEmpty (), "The deduplication window can not change while frames are being deduplicated");
+  // The wheel has a tick of a quarter of the window, so that the window of
+  // a frame closes at most a quarter of the window late
+  const int64_t tick = std::max<int64_t> (window.GetTimeStep () / 4, 1);
+  NS_ABORT_MSG_UNLESS (window + TimeStep (tick) < MicroSeconds (RECEIVE_DELAY1), "The deduplication window has to close before RW1");
+  m_dedupWindow = window;
+  m_dedupTick = tick;
+}
+
+Time
+LoRaWANNetworkServer::GetDeduplicationWindow (void) const
+{
+  return m_dedupWindow;
+}
+
 void
 LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Address from, Ptr<Packet> packet)
 {
   NS_LOG_FUNCTION(this);
   // PacketSocketAddress fromAddress = PacketSocketAddress::ConvertFrom (from);
 
-  // Decode Frame header
+  // Only the device address and frame counter are needed to find the
+  // deduplication entry, the frame is decoded when its window closes
   LoRaWANFrameHeaderUplink frmHdr;
-  frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that RemoveHeader will deserialize the FPort
-  packet->RemoveHeader (frmHdr);
+  frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that PeekHeader will deserialize the FPort
+  packet->PeekHeader (frmHdr);
 
   // Find end device meta data:
   Ipv4Address deviceAddr = frmHdr.getDevAddr ();
-  //NS_LOG_INFO(this << "Received packet from device addr = " << deviceAddr);
   uint32_t key = deviceAddr.Get ();
-  auto it = m_endDevices.find (key);
-  if (it == m_endDevices.end ()) { // not found, so create a new struct and insert it (note this should have already happened in DoInitialize()):
+  uint32_t index = m_endDevices.Find (key);
+  if (index == m_endDevices.NOT_FOUND) { // not found, so create a new struct and insert it (note this should have already happened in DoInitialize()):
     NS_LOG_WARN (this << " end device with address = " << deviceAddr << " not found in m_endDevices, allocating");
 
-    LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (deviceAddr);
-    m_endDevices[key] = info;
-    it = m_endDevices.find (key);
+    index = AddEndDevice (deviceAddr);
+  }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+
+  LoRaWANUplinkReception reception;
+  reception.m_gateway = lastGW;
+  reception.m_rssi = 0.0;
+  reception.m_snr = 0.0;
+  LoRaWANPhyParamsTag phyParamsTag;
+  if (packet->PeekPacketTag (phyParamsTag)) {
+    reception.m_rssi = phyParamsTag.GetRssi ();
+    reception.m_snr = phyParamsTag.GetSnr ();
+  }
+
+  const uint16_t fCnt = frmHdr.getFrameCounter ();
+  if (info.m_dedupEntry != NO_DEDUP_ENTRY) {
+    DedupEntry &entry = m_dedupEntries[info.m_dedupEntry];
+    if (entry.m_fCnt == fCnt) { // same frame received by another gateway
+      m_endDevices.GetCold (index).m_nUSDuplicates += 1;
+      entry.m_receptions.push_back (reception);
+      NS_LOG_INFO (this << " Duplicate of frame " << fCnt << " of " << deviceAddr << " received by gateway " << lastGW << ", " << entry.m_receptions.size () << " receptions");
+      return;
+    }
+    // A new frame while the window of the previous one is still open can only
+    // happen for very long windows, the previous frame keeps its own entry
+    NS_LOG_WARN (this << " Frame " << fCnt << " of " << deviceAddr << " received during the deduplication window of frame " << entry.m_fCnt);
+  } else if (fCnt == info.m_fCntUp && m_endDevices.GetCold (index).m_nUniqueUSPackets > 0
+             && Simulator::Now () - info.m_lastSeen < MicroSeconds (RECEIVE_DELAY1)) {
+    // Received by a gateway after the window of the frame closed: too late to
+    // be merged, but the gateway can still send in the receive windows
+    LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
+    coldInfo.m_nUSDuplicates += 1;
+    coldInfo.m_lastReceptions.insert (std::upper_bound (coldInfo.m_lastReceptions.begin (), coldInfo.m_lastReceptions.end (),
+                                                        reception, &LoRaWANNetworkServer::IsBetterReception),
+                                      reception);
+    NS_LOG_INFO (this << " Late duplicate of frame " << fCnt << " of " << deviceAddr << " => dropping packet");
+    return;
+  }
+
+  // First reception of the frame: open a deduplication entry
+  uint32_t id;
+  if (m_freeDedupEntries.empty ()) {
+    id = m_dedupEntries.size ();
+    m_dedupEntries.push_back (DedupEntry ());
+  } else {
+    id = m_freeDedupEntries.back ();
+    m_freeDedupEntries.pop_back ();
+  }
+  DedupEntry &entry = m_dedupEntries[id];
+  entry.m_deviceIndex = index;
+  entry.m_fCnt = fCnt;
+  entry.m_firstRx = Simulator::Now ();
+  entry.m_packet = packet;
+  entry.m_receptions.push_back (reception);
+  info.m_dedupEntry = id;
+
+  // The window closes at the first tick after its end
+  const int64_t closeTick = ((Simulator::Now () + m_dedupWindow).GetTimeStep () + m_dedupTick - 1) / m_dedupTick;
+  const bool earliest = m_dedupWheel.IsEmpty () || static_cast<uint64_t> (closeTick) < m_dedupWheel.GetNextTick ();
+  m_dedupWheel.Insert (closeTick, id);
+  if (earliest) {
+    m_dedupEvent.Cancel ();
+    m_dedupEvent = Simulator::Schedule (TimeStep (closeTick * m_dedupTick) - Simulator::Now (),
+                                        &LoRaWANNetworkServer::DeduplicationTimerExpired, this);
+  }
+}
+
+void
+LoRaWANNetworkServer::DeduplicationTimerExpired (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_dedupWheel.PopNextTick (m_closingDedupEntries);
+  for (uint32_t i = 0; i < m_closingDedupEntries.size (); i++) {
+    const uint32_t id = m_closingDedupEntries[i];
+    DedupEntry &entry = m_dedupEntries[id];
+    LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (entry.m_deviceIndex);
+    if (info.m_dedupEntry == id) {
+      info.m_dedupEntry = NO_DEDUP_ENTRY;
+    }
+    ProcessUSPacket (entry);
+
+    // Keep the capacity of the receptions for the next frame
+    entry.m_packet = 0;
+    entry.m_receptions.clear ();
+    m_freeDedupEntries.push_back (id);
+  }
+
+  if (!m_dedupWheel.IsEmpty ()) {
+    const int64_t nextTick = m_dedupWheel.GetNextTick ();
+    m_dedupEvent = Simulator::Schedule (TimeStep (nextTick * m_dedupTick) - Simulator::Now (),
+                                        &LoRaWANNetworkServer::DeduplicationTimerExpired, this);
   }
+}
+
+void
+LoRaWANNetworkServer::ProcessUSPacket (DedupEntry &entry)
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<Packet> packet = entry.m_packet;
+
+  // Decode Frame header
+  LoRaWANFrameHeaderUplink frmHdr;
+  frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that RemoveHeader will deserialize the FPort
+  packet->RemoveHeader (frmHdr);
+
+  Ipv4Address deviceAddr = frmHdr.getDevAddr ();
+  uint32_t key = deviceAddr.Get ();
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (entry.m_deviceIndex);
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (entry.m_deviceIndex);
 
   // Always update number of received upstream packets:
-  //it->second.m_nUSPackets += 1;
+  //info.m_nUSPackets += 1;
   if(m_timeslotLoopCount >= 3) {
-      it->second.m_nUSPackets += 1;  
+      info.m_nUSPackets += 1;  
   }
 
-  // Always update last seen GWs:
-  if ((Simulator::Now () - it->second.m_lastSeen) > Seconds(1.0)) { // assume a new upstream transmission, so clear the vector of seenGWs
-    it->second.m_lastGWs.clear ();
-  }
-  it->second.m_lastGWs.push_back (lastGW);
+  // The gateways that received the frame are the candidates for the DS transmission, best link first
+  coldInfo.m_lastReceptions.swap (entry.m_receptions);
+  std::stable_sort (coldInfo.m_lastReceptions.begin (), coldInfo.m_lastReceptions.end (), &LoRaWANNetworkServer::IsBetterReception);
 
-  // Check for duplicate.
-  // Depending on the frame counter and received time, we can classify the US Packet as:
+  // The receptions of the frame by other gateways were merged by the
+  // deduplication window (see HandleUSPacket), so the US Packet is either:
   // i) The first time the NS sees the US Packet: i.e. new frame counter up value
-  // ii) Retransmission of a previously transmitted US Packet (then the NS has to reply with an Ack): i.e. frame counter up already seen, seen longer than 1 second ago
-  // iii) The same transmission received by a second Gateway (in this case we can drop the packet): i.e. frame counter up already seen, seen shorter than 1 second ago
-  bool firstRX = it->second.m_nUSPackets == 0;
+  // ii) Retransmission of a previously transmitted US Packet (then the NS has to reply with an Ack): i.e. frame counter up already seen
+  bool firstRX = info.m_nUSPackets == 0;
   bool processMACAck = true;
-  if (frmHdr.getFrameCounter () <= it->second.m_fCntUp && !firstRX) {
-    Time t = Simulator::Now () - it->second.m_lastSeen;
-    if (t <= Seconds (1.0)) { // assume US packet is really a duplicate received by a second gateway
-      // Duplicate, drop packet
-      it->second.m_nUSDuplicates += 1;
-      NS_LOG_INFO (this << " Duplicate detected: " << frmHdr.getFrameCounter () << " <= " << it->second.m_fCntUp << " &&  t = " << t << " < 1 second => dropping packet");
-      // TODO: add trace for dropping duplicate packets?
-      return;
-    } else { // assume US packet is a retransmission
-      it->second.m_nUSRetransmission += 1;
-      processMACAck = false; // as we have already receive this US packet is a retransmission, we should not process the Ack flag set in the MAC header (but we should still open a RW or reply with an Ack if necessary)
-    }
+  if (frmHdr.getFrameCounter () <= info.m_fCntUp && !firstRX) {
+    coldInfo.m_nUSRetransmission += 1;
+    processMACAck = false; // as we have already receive this US packet is a retransmission, we should not process the Ack flag set in the MAC header (but we should still open a RW or reply with an Ack if necessary)
   } else { // new US frame counter value -> update number of unique packets received and US frame counter
-    it->second.m_nUniqueUSPackets += 1;
-    it->second.m_fCntUp = frmHdr.getFrameCounter (); // update US frame counter
+    coldInfo.m_nUniqueUSPackets += 1;
+    info.m_fCntUp = frmHdr.getFrameCounter (); // update US frame counter
   }
 
-  // Update fields in LoRaWANEndDeviceInfoNS:
-  it->second.m_lastSeen = Simulator::Now ();
+  // Update fields in LoRaWANEndDeviceInfoNS, the receive windows of the end
+  // device are relative to the end of its transmission:
+  info.m_lastSeen = entry.m_firstRx;
 
   // Parse PhyRx Packet Tag
   LoRaWANPhyParamsTag phyParamsTag;
   if (packet->RemovePacketTag (phyParamsTag)) {
-    it->second.m_lastChannelIndex = phyParamsTag.GetChannelIndex ();
+    info.m_lastChannelIndex = phyParamsTag.GetChannelIndex ();
 
     //temp
-    uint8_t temp_dr = it->second.m_lastDataRateIndex;
-    it->second.m_lastDataRateIndex = phyParamsTag.GetDataRateIndex ();
+    uint8_t temp_dr = info.m_lastDataRateIndex;
+    info.m_lastDataRateIndex = phyParamsTag.GetDataRateIndex ();
 
-    if(temp_dr != it->second.m_lastDataRateIndex) {
+    if(temp_dr != info.m_lastDataRateIndex) {
       //the data rate has changed
       // don't run the periodicity detection algorithm on this node this time, unless this is the first time this device has been seen
-      if(it->second.m_nUniqueUSPackets != 1) {
-        it->second.m_timeslotsDrChanged = true;  
+      if(coldInfo.m_nUniqueUSPackets != 1) {
+        coldInfo.m_timeslotsDrChanged = true;  
       }
       
       // and change the size of the vector holding the timeslots, and reset the timeslots delay
-      it->second.m_timeslotsRecorder = std::vector<unsigned char>(m_timeSlotsPerDataRate[it->second.m_lastDataRateIndex].m_slots, 0); 
-      it->second.m_timeslotDelay = 0;
+      coldInfo.m_timeslotsRecorder.Reset (m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots); 
+      info.m_timeslotDelay = 0;
     }
-    it->second.m_lastCodeRate = phyParamsTag.GetCodeRate ();
+    info.m_lastCodeRate = phyParamsTag.GetCodeRate ();
 
 
     //TODO: the issue is here. Anti-aliasing is the issue.
-    float slot_time = Simulator::Now ().GetSeconds() - currentTimePeriodStart.GetSeconds(); 
+    float slot_time = entry.m_firstRx.GetSeconds() - currentTimePeriodStart.GetSeconds(); 
     //float slot_time = (Simulator::Now ().GetMilliSeconds() - currentTimePeriodStart.GetMilliSeconds() )/ 1000;
-    float slot_index = floor(slot_time / this->m_timeSlotCalcRandomVariable->GetValue () * m_timeSlotsPerDataRate[it->second.m_lastDataRateIndex].m_slots); 
-    //std::cout << Simulator::Now ().GetSeconds() << " " << currentTimePeriodStart.GetSeconds() << " " << slot_time << " " << this->m_timeSlotCalcRandomVariable->GetValue () << " " << m_timeSlotsPerDataRate[it->second.m_lastDataRateIndex].m_slots << " " << slot_time / this->m_timeSlotCalcRandomVariable->GetValue () * m_timeSlotsPerDataRate[it->second.m_lastDataRateIndex].m_slots  << std::endl;
-    it->second.m_timeslotsRecorder[int(slot_index)] = 1;
+    float slot_index = floor(slot_time / this->m_timeSlotCalcRandomVariable->GetValue () * m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots); 
+    //std::cout << Simulator::Now ().GetSeconds() << " " << currentTimePeriodStart.GetSeconds() << " " << slot_time << " " << this->m_timeSlotCalcRandomVariable->GetValue () << " " << m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots << " " << slot_time / this->m_timeSlotCalcRandomVariable->GetValue () * m_timeSlotsPerDataRate[info.m_lastDataRateIndex].m_slots  << std::endl;
+    if (slot_index < 0 || !coldInfo.m_timeslotsRecorder.Record (uint32_t (slot_index))) {
+      NS_LOG_WARN (this << " US frame of " << info.m_deviceAddress << " outside the timeslots period, slot " << slot_index);
+    }
+
+    // Adaptive data rate, evaluated on every US frame of an end device that sets the ADR bit
+    if (frmHdr.getAdr ()) {
+      EvaluateADR (info, coldInfo, coldInfo.m_lastReceptions.front ().m_snr);
+    }
   } else {
     NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
   }
@@ -883,7 +1066,7 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     LoRaWANMsgType msgType = msgTypeTag.GetMsgType();
 
     if (msgType == LORAWAN_CONFIRMED_DATA_UP) {
-      it->second.m_setAck = true; // Set ack bit in next DS msg
+      info.m_setAck = true; // Set ack bit in next DS msg
       NS_LOG_DEBUG (this << " Received Confirmed Data UP. Next DS Packet will have Ack bit set");
     }
   } else {
@@ -896,11 +1079,11 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
   // Parse Ack flag:
   if (processMACAck && frmHdr.getAck ()) {
-    it->second.m_nUSAcks += 1;
+    coldInfo.m_nUSAcks += 1;
 
-    if (!it->second.m_downstreamQueue.empty ()) { // there is a DS message in the queue
-      if (it->second.m_downstreamQueue.front()->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
-        LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front();
+    if (!coldInfo.m_downstreamQueue.empty ()) { // there is a DS message in the queue
+      if (coldInfo.m_downstreamQueue.front()->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
+        LoRaWANNSDSQueueElement* ptr = coldInfo.m_downstreamQueue.front();
 
         // LOG that network server received an Acknowledgment for a DS packet
         m_dsMsgAckdTrace (key, ptr->m_downstreamTransmissionsRemaining, ptr->m_downstreamMsgType, ptr->m_downstreamPacket);
@@ -909,7 +1092,7 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
         NS_LOG_DEBUG (this << " Received Ack for Confirmed DS packet, removing packet from DS queue for end device " << deviceAddr);
       } else {
-        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << it->second.m_downstreamQueue.front()->m_downstreamMsgType << ")");
+        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << coldInfo.m_downstreamQueue.front()->m_downstreamMsgType << ")");
       }
     } else {
       // One occurence of this condition is when the NS receives a retransmission that re-acknowledges a previously send DS confirmed packet
@@ -926,7 +1109,14 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     if(it->m_isBeingUsed) {
       //TODO: write functions inside the frame-header to extract the MAC command properly
       // for now, since the ADR command is the only one implemented, we will just check for that one.
-      if(it->m_commandID == TimeSlotDelayAns) {
+      if(it->m_commandID == LinkADRAns) {
+          // bit 2: power ACK, bit 1: data rate ACK, bit 0: channel mask ACK
+          if((frmHdr.m_status & 0x7) == 0x7) {
+            NS_LOG_INFO("LinkADRAns received from " << deviceAddr << " - success");
+          } else {
+            NS_LOG_WARN("LinkADRAns received from " << deviceAddr << " - refused, status = " << (uint32_t)frmHdr.m_status);
+          }
+      } else if(it->m_commandID == TimeSlotDelayAns) {
           uint8_t status = frmHdr.m_timeslotStatus;
           if(status) {
             NS_LOG_INFO("ACK for Timeslots received - success");
@@ -944,20 +1134,84 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   } 
 
   // We should always schedule a timer, even when m_downstreamPacket is NULL as a new DS packet might be generated between now and RW1
-  if (it->second.m_rw1Timer.IsRunning()) {
-    NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << it->second.m_rw1Timer.GetTs ());
+  if (coldInfo.m_rw1Timer.IsRunning()) {
+    NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << coldInfo.m_rw1Timer.GetTs ());
   }
-  Time receiveDelay = MicroSeconds (RECEIVE_DELAY1);
-  it->second.m_rw1Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW1TimerExpired, this, key);
+  Time receiveDelay = (entry.m_firstRx + MicroSeconds (RECEIVE_DELAY1)) - Simulator::Now ();
+  coldInfo.m_rw1Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW1TimerExpired, this, key);
+}
+
+bool
+LoRaWANNetworkServer::IsBetterReception (const LoRaWANUplinkReception &a, const LoRaWANUplinkReception &b)
+{
+  if (a.m_snr != b.m_snr) {
+    return a.m_snr > b.m_snr;
+  }
+  return a.m_rssi > b.m_rssi;
+}
+
+double
+LoRaWANNetworkServer::GetRequiredSnr (uint8_t dataRateIndex)
+{
+  // Demodulation floor of the LoRa modem per spreading factor, SF7 to SF12
+  static const double requiredSnr[] = {-7.5, -10.0, -12.5, -15.0, -17.5, -20.0};
+
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates[dataRateIndex].spreadingFactor;
+  NS_ASSERT (sf >= LORAWAN_SF7 && sf <= LORAWAN_SF12);
+  return requiredSnr[sf - LORAWAN_SF7];
+}
+
+uint8_t
+LoRaWANNetworkServer::GetADRMaxDataRateIndex (void)
+{
+  const std::vector<LoRaWANDataRate> &dataRates = LoRaWAN::m_supportedDataRates;
+  uint8_t maxDataRateIndex = 0;
+  while (maxDataRateIndex + 1u < dataRates.size () && dataRates[maxDataRateIndex + 1].bandWith == dataRates[0].bandWith) {
+    maxDataRateIndex++;
+  }
+  return maxDataRateIndex;
+}
+
+void
+LoRaWANNetworkServer::EvaluateADR (LoRaWANEndDeviceInfoNS &info, LoRaWANEndDeviceColdInfoNS &coldInfo, double snr)
+{
+  LoRaWANSnrHistory &history = coldInfo.m_snrHistory;
+  if (history.GetCapacity () != m_adrHistoryLength) {
+    history.Resize (m_adrHistoryLength);
+  }
+  history.Add (snr);
+  if (!history.IsFull ()) {
+    return;
+  }
+
+  const uint8_t dataRateIndex = info.m_lastDataRateIndex;
+  const uint8_t maxDataRateIndex = GetADRMaxDataRateIndex ();
+  const double margin = history.GetMax () - GetRequiredSnr (dataRateIndex) - m_adrMargin;
+  int nStep = std::floor (margin / 3.0);
+
+  uint8_t targetDataRateIndex = dataRateIndex;
+  while (nStep > 0 && targetDataRateIndex < maxDataRateIndex) {
+    targetDataRateIndex++;
+    nStep--;
+  }
+
+  // A pending LinkADRReq that is no longer needed (e.g. the end device lowered
+  // its data rate in the meantime) is replaced or cancelled here
+  info.m_runADRMAC = targetDataRateIndex != dataRateIndex;
+  info.m_adrDataRateIndex = targetDataRateIndex;
+  NS_LOG_DEBUG (this << " ADR for " << info.m_deviceAddress << ": max SNR = " << history.GetMax () << " dB, mean SNR = " << history.GetMean ()
+                << " dB, margin = " << margin << " dB, DR" << (uint32_t)dataRateIndex << " -> DR" << (uint32_t)targetDataRateIndex);
 }
 
 bool
 LoRaWANNetworkServer::HaveSomethingToSendToEndDevice (uint32_t deviceAddr)
 {
-  uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+  const LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
 
-  return it_ed->second.m_downstreamQueue.size() > 0 || it_ed->second.m_setAck;
+  return coldInfo.m_downstreamQueue.size() > 0 || info.m_setAck;
 }
 
 void
@@ -966,27 +1220,13 @@ LoRaWANNetworkServer::RW1TimerExpired (uint32_t deviceAddr)
   NS_LOG_FUNCTION (this << deviceAddr);
 
   uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
-
-  // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW1
-  bool foundGW = false;
-  // The RW1 LoRa channel and data rate are the same as used in the last US transmission
-  const uint8_t dsChannelIndex = it_ed->second.m_lastChannelIndex;
-  const uint8_t dsDataRateIndex = it_ed->second.m_lastDataRateIndex;;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      /*if(dsDataRateIndex == 1) {
-      //std::cout << "going to send a packet on DR1 , RW1 to " << deviceAddr << std::endl;
-      }*/
-      this->SendDSPacket (deviceAddr, *it_gw, true, false);
-      break;
-    } else {
-      /*if(dsDataRateIndex == 1) {
-        std::cout << "can't attempt to send dl to this device yet on DR1, RW1 to " << deviceAddr << std::endl;
-      }*/
-    }
-  }
+  const uint32_t index = m_endDevices.Find (key);
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
+
+  // Try to send a downstream transmission immediately (i.e. right now) in RW1 via one of the GWs that received the US frame
+  // The RW1 LoRa channel and data rate are derived from the ones used in the last US transmission
+  const bool foundGW = this->SendDSPacket (deviceAddr, true, false);
 
   if (!foundGW) {
     NS_LOG_DEBUG (this << " No gateway available for transmission in RW1, scheduling timer for DS transmission in RW2");
@@ -996,14 +1236,14 @@ LoRaWANNetworkServer::RW1TimerExpired (uint32_t deviceAddr)
       m_nrRW1Missed++;
     }
 
-    if (it_ed->second.m_rw2Timer.IsRunning()) {
-      NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << it_ed->second.m_rw2Timer.GetTs ());
+    if (coldInfo.m_rw2Timer.IsRunning()) {
+      NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << coldInfo.m_rw2Timer.GetTs ());
     }
 
     // Time receiveDelay = MicroSeconds (RECEIVE_DELAY2);
-    Time receiveDelay = (it_ed->second.m_lastSeen + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
+    Time receiveDelay = (info.m_lastSeen + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
     NS_ASSERT (receiveDelay > 0);
-    it_ed->second.m_rw2Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW2TimerExpired, this, key);
+    coldInfo.m_rw2Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW2TimerExpired, this, key);
   }
 }
 
@@ -1012,29 +1252,9 @@ LoRaWANNetworkServer::RW2TimerExpired (uint32_t deviceAddr)
 {
   NS_LOG_FUNCTION (this << deviceAddr);
 
-  uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
-
-  const uint8_t dsDataRateIndexOfRW1 = it_ed->second.m_lastDataRateIndex;;
-  // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW2
+  // Try to send a downstream transmission immediately (i.e. right now) in RW2 via one of the GWs that received the US frame
   // The RW2 LoRa channel is a fixed channel depending on the region, for EU this is the high power 869.525 MHz channel
-  const uint8_t dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
-  const uint8_t dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
-  bool foundGW = false;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      /*if(dsDataRateIndexOfRW1 == 1) {
-        std::cout << "going to send a packet on DR1 , RW2 (so actually using DR0) to " << deviceAddr << std::endl;
-      }*/
-      this->SendDSPacket (deviceAddr, *it_gw, false, true);
-      break;
-    } else {
-      /*if(dsDataRateIndexOfRW1 == 1) {
-        std::cout << "can't attempt to send dl to this device yet on DR1, RW2 (so actually using DR0) to " << deviceAddr << std::endl;
-      }*/
-    }
-  }
+  const bool foundGW = this->SendDSPacket (deviceAddr, false, true);
 
   if (!foundGW) {
     // Increment m_nrRW2Missed only if there is something to send:
@@ -1045,61 +1265,57 @@ LoRaWANNetworkServer::RW2TimerExpired (uint32_t deviceAddr)
   }
 }
 
-void
-LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2)
+bool
+LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, bool RW1, bool RW2)
 {
   // Search device in m_endDevices:
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  if (index == m_endDevices.NOT_FOUND) { // end device not found
     NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr << ". Aborting DS Transmission");
-    return;
+    return true;
   }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
 
-  // Check if we have a last known GW for the device:
-  // bool haveGW = it->second.m_lastGWs.size () > 0;
-  // if (!haveGW) {
-  //   NS_LOG_ERROR (this << " lastGW is not set for dev addr " << deviceAddr << ". Aborting DS Transmission");
-  //   return;
-  // }
-  // Ptr <LoRaWANGatewayApplication> lastGW = *it->second.m_lastGWs.begin ();
+  // The LoRa channel and data rate of the receive window:
+  uint8_t dsChannelIndex;
+  uint8_t dsDataRateIndex;
+  if (RW1) {
+    dsChannelIndex = LoRaWAN::GetRX1ChannelIndex (info.m_lastChannelIndex);
+    dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (info.m_lastDataRateIndex, info.m_rx1DROffset);
+  } else if (RW2) {
+    dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
+    dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
+  } else {
+    NS_FATAL_ERROR (this << " Either RW1 or RW2 should be true");
+    return true;
+  }
 
   // Figure out which DS packet to send
+  // Nothing is changed in the state of the end device until a gateway accepted the packet
   LoRaWANNSDSQueueElement elementToSend;
+  LoRaWANNSDSQueueElement* element = 0;
   bool deleteQueueElement = false;
-  bool createdJustForTimeslot = false;
-  if (it->second.m_downstreamQueue.size() > 0) {
-    LoRaWANNSDSQueueElement* element = it->second.m_downstreamQueue.front ();
-
-    // Bookkeeping for Confirmed packets:
-    if (element->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) {
-      // Count number of retransmissions:
-      if (element->m_isRetransmission) {
-        it->second.m_nDSRetransmission++;
-      }
+  bool createdJustForMACCommands = false;
+  if (coldInfo.m_downstreamQueue.size() > 0) {
+    element = coldInfo.m_downstreamQueue.front ();
 
-      // Update for next transmission:
-      element->m_downstreamTransmissionsRemaining--; // decrement
-      element->m_isRetransmission = true;
-    }
+    elementToSend.m_downstreamPacket = element->m_downstreamPacket;
+    elementToSend.m_downstreamMsgType = element->m_downstreamMsgType;
+    elementToSend.m_downstreamFramePort = element->m_downstreamFramePort;
+    elementToSend.m_downstreamTransmissionsRemaining = element->m_downstreamTransmissionsRemaining;
 
     // Should we delete pending packet after transmission?
     if (element->m_downstreamMsgType != LORAWAN_CONFIRMED_DATA_DOWN) { // delete the queueelement object after the send operation
       deleteQueueElement = true;
     } else {
-      if (element->m_downstreamTransmissionsRemaining == 0) {// in case of CONFIRMED_DATA_DOWN, delete the pending transmission when the number of remaining transmissions has reached 1
+      elementToSend.m_downstreamTransmissionsRemaining--; // this transmission
+      if (elementToSend.m_downstreamTransmissionsRemaining == 0) {// in case of CONFIRMED_DATA_DOWN, delete the pending transmission when the number of remaining transmissions has reached 1
         deleteQueueElement = true;
-
-        // LOG that network server will delete DS packet from queue
-        m_dsMsgDroppedTrace (deviceAddr, 0, element->m_downstreamMsgType, element->m_downstreamPacket);
       }
     }
-
-    elementToSend.m_downstreamPacket = element->m_downstreamPacket;
-    elementToSend.m_downstreamMsgType = element->m_downstreamMsgType;
-    elementToSend.m_downstreamFramePort = element->m_downstreamFramePort;
-    elementToSend.m_downstreamTransmissionsRemaining = element->m_downstreamTransmissionsRemaining;
   } else {
-    if(it->second.m_runTimeSlotMAC | it->second.m_setAck) { //If there is no data to be sent down, but we need to send ADR data. TODO: make this a more general MAC command bool
+    if(info.m_runTimeSlotMAC | info.m_runADRMAC | info.m_setAck) { //If there is no data to be sent down, but we need to send an Ack or MAC commands
         NS_LOG_INFO (this << " Generating empty downstream packet for dev addr " << deviceAddr);
         elementToSend.m_downstreamPacket = Create<Packet> (0); // TODO: think about this. The message gets added to the payload instead of FOpts when theres no other payload
         // this makes a difference in the encryption. But in our case does it make any difference?
@@ -1107,70 +1323,75 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
         elementToSend.m_downstreamFramePort = 0; // empty packet, so don't send frame port
         elementToSend.m_downstreamTransmissionsRemaining = 0;
 
-        if(it->second.m_runTimeSlotMAC && !(it->second.m_setAck)) 
+        if(!(info.m_setAck)) 
         {
-            createdJustForTimeslot = true;
+            createdJustForMACCommands = true;
         }
-      } else { //i.e. !it->second.m_setAck && !it->second.m_setAdr
+      } else { //i.e. !info.m_setAck && !info.m_setAdr
         // Not really a warning as there is just no need to send a DS packet (i.e. no data and no Ack)
         NS_LOG_INFO (this << " No downstream packet found nor is ack bit set for dev addr " << deviceAddr << ". Aborting DS transmission");
-        return;  
+        // Report whether a gateway was available, a DS packet might still be generated before RW2
+        for (auto it_gw = coldInfo.m_lastReceptions.cbegin(); it_gw != coldInfo.m_lastReceptions.cend(); it_gw++) {
+          if (it_gw->m_gateway->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
+            return true;
+          }
+        }
+        return false;
       }
   }
 
-  // LOG DS msg transmission
-  uint8_t rwNumber = RW1 ? 1 : 2;
-  m_dsMsgTransmittedTrace (deviceAddr, elementToSend.m_downstreamTransmissionsRemaining, elementToSend.m_downstreamMsgType, elementToSend.m_downstreamPacket, rwNumber);
-
-  // Make a copy here, this is u
-  Ptr<Packet> p;
-  if (deleteQueueElement)
-    p = elementToSend.m_downstreamPacket;
-  else
-    p = elementToSend.m_downstreamPacket->Copy (); // make a copy, so that we don't alter elementToSend.m_downstreamPacket as we might re-use this packet later (e.g. retransmission)
+  // Make a copy here, so that we don't alter elementToSend.m_downstreamPacket as we might re-use this packet later (e.g. retransmission)
+  Ptr<Packet> p = elementToSend.m_downstreamPacket->Copy ();
 
   // Construct Frame Header:
   LoRaWANFrameHeaderDownlink fhdr;
   fhdr.setDevAddr (Ipv4Address (deviceAddr));
-  fhdr.setAck (it->second.m_setAck);
-  fhdr.setFramePending (it->second.m_framePending);
-  fhdr.setFrameCounter (it->second.m_fCntDown++);
+  fhdr.setAck (info.m_setAck);
+  fhdr.setFramePending (info.m_framePending);
+  fhdr.setFrameCounter (info.m_fCntDown);
   if (elementToSend.m_downstreamFramePort > 0)
     fhdr.setFramePort (elementToSend.m_downstreamFramePort);
 
-  //TODO: add MAC command here
+  // MAC commands
+  bool sentADRMAC = false;
+  if(info.m_runADRMAC) {
+    // The end devices use a static set of channels, enable all upstream channels
+    uint16_t channelMask;
+    uint8_t chMaskCntl;
+    LoRaWAN::GetUplinkChannelMask (channelMask, chMaskCntl);
+    // TX power index 0 is the maximum power, which end devices always use in this model
+    if(!(fhdr.AddLoRaADRReq(info.m_adrDataRateIndex, 0, channelMask, chMaskCntl, 1))) {
+      NS_LOG_WARN (this << " Unable to add LinkADRReq to DS packet for dev addr " << deviceAddr);
+    } else {
+      sentADRMAC = true;
+    }
+  }
 
-  if(it->second.m_runTimeSlotMAC) {
-    if(!(fhdr.AddLoRaTimeSlotDelayReq(it->second.m_timeslotDelay, it->second.m_lastDataRateIndex))) {
+  bool sentTimeSlotMAC = false;
+  if(info.m_runTimeSlotMAC) {
+    if(!(fhdr.AddLoRaTimeSlotDelayReq(info.m_timeslotDelay, info.m_lastDataRateIndex))) {
       //TODO: log err
-      if(createdJustForTimeslot){
-        return;  
-      }
     } else {
-      it->second.m_runTimeSlotMAC = false;
+      sentTimeSlotMAC = true;
     }
   }
 
-  p->AddHeader (fhdr);
+  if(createdJustForMACCommands && !sentADRMAC && !sentTimeSlotMAC) {
+    return true;
+  }
 
-  // Add Phy Packet tag to specify channel, data rate and code rate:
-  uint8_t dsChannelIndex;
-  uint8_t dsDataRateIndex;
-  if (RW1) {
-    dsChannelIndex = it->second.m_lastChannelIndex;
-    dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (it->second.m_lastDataRateIndex, it->second.m_rx1DROffset);
-  } else if (RW2) {
-    dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
-    dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
-  } else {
-    NS_FATAL_ERROR (this << " Either RW1 or RW2 should be true");
-    return;
+  // MAC commands are only serialized together with a frame port
+  if((sentADRMAC || sentTimeSlotMAC) && !fhdr.getSerializeFramePort ()) {
+    fhdr.setFramePort (elementToSend.m_downstreamFramePort);
   }
 
+  p->AddHeader (fhdr);
+
+  // Add Phy Packet tag to specify channel, data rate and code rate:
   LoRaWANPhyParamsTag phyParamsTag;
   phyParamsTag.SetChannelIndex (dsChannelIndex);
   phyParamsTag.SetDataRateIndex (dsDataRateIndex);
-  phyParamsTag.SetCodeRate (it->second.m_lastCodeRate);
+  phyParamsTag.SetCodeRate (info.m_lastCodeRate);
   p->AddPacketTag (phyParamsTag);
 
   // Set Msg type
@@ -1178,36 +1399,73 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   msgTypeTag.SetMsgType (elementToSend.m_downstreamMsgType);
   p->AddPacketTag (msgTypeTag);
 
+  // Ask the gateways that received the US frame, best link first, to send the DS packet.
+  // A gateway refuses the packet when it is sending or when the duty cycle of the sub band does not allow it.
+  Ptr<LoRaWANGatewayApplication> gatewayPtr;
+  for (auto it_gw = coldInfo.m_lastReceptions.cbegin(); it_gw != coldInfo.m_lastReceptions.cend(); it_gw++) {
+    if (it_gw->m_gateway->SendDSPacket (p->Copy ())) {
+      gatewayPtr = it_gw->m_gateway;
+      break;
+    }
+    NS_LOG_DEBUG (this << " GW " << it_gw->m_gateway << " can not send DS Packet to device addr " << deviceAddr << " in RW" << (RW1 ? "1" : "2") << ", trying next GW");
+  }
+  if (!gatewayPtr) {
+    return false;
+  }
+  NS_LOG_DEBUG (this << " Sent DS Packet to device addr " << deviceAddr << " via GW #" << gatewayPtr->GetNode()->GetId() << " in RW" << (RW1 ? "1" : "2"));
+
+  // Bookkeeping for Confirmed packets:
+  if (element && element->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) {
+    // Count number of retransmissions:
+    if (element->m_isRetransmission) {
+      coldInfo.m_nDSRetransmission++;
+    }
+
+    // Update for next transmission:
+    element->m_downstreamTransmissionsRemaining--; // decrement
+    element->m_isRetransmission = true;
+
+    if (deleteQueueElement) {
+      // LOG that network server will delete DS packet from queue
+      m_dsMsgDroppedTrace (deviceAddr, 0, element->m_downstreamMsgType, element->m_downstreamPacket);
+    }
+  }
+
+  // LOG DS msg transmission
+  uint8_t rwNumber = RW1 ? 1 : 2;
+  m_dsMsgTransmittedTrace (deviceAddr, elementToSend.m_downstreamTransmissionsRemaining, elementToSend.m_downstreamMsgType, elementToSend.m_downstreamPacket, rwNumber);
+
+  info.m_fCntDown++;
+  if (sentTimeSlotMAC) {
+    info.m_runTimeSlotMAC = false;
+  }
+  if (sentADRMAC) {
+    info.m_runADRMAC = false;
+  }
+
   // Update DS Packet counters:
-  it->second.m_nDSPacketsSent += 1;
+  coldInfo.m_nDSPacketsSent += 1;
   if (RW1) {
     m_nrRW1Sent++;
-    it->second.m_nDSPacketsSentRW1 += 1;
+    coldInfo.m_nDSPacketsSentRW1 += 1;
   } else if (RW2) {
-    it->second.m_nDSPacketsSentRW2 += 1;
+    coldInfo.m_nDSPacketsSentRW2 += 1;
     m_nrRW2Sent++;
   }
-  if (it->second.m_setAck)
-    it->second.m_nDSAcks += 1;
+  if (info.m_setAck)
+    coldInfo.m_nDSAcks += 1;
 
   // Store gatewayPtr as last DS GW:
-  it->second.m_lastDSGW = gatewayPtr;
-
-  /*if(it->second.m_lastDataRateIndex == 1) {
-    std::cout << "sending DL to device set to use DR1 with addr " << deviceAddr << std::endl;
-  }*/
-
-  // Ask gateway application on lastseenGW to send the DS packet:
-  gatewayPtr->SendDSPacket (p);
-  NS_LOG_DEBUG (this << " Sent DS Packet to device addr " << deviceAddr << " via GW #" << gatewayPtr->GetNode()->GetId() << " in RW" << (RW1 ? "1" : "2"));
+  coldInfo.m_lastDSGW = gatewayPtr;
 
   // Reset data structures
-  it->second.m_setAck = false; // we only sent an Ack once, see Note on page 75 of LoRaWAN std
+  info.m_setAck = false; // we only sent an Ack once, see Note on page 75 of LoRaWAN std
 
   // For some cases (see deleteQueueElement bool), remove the pending DS packet here
   if (deleteQueueElement) {
     this->DeleteFirstDSQueueElement (deviceAddr);
   }
+  return true;
 }
 
 void
@@ -1215,14 +1473,16 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
 {
   NS_LOG_FUNCTION (this << deviceAddr);
 
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  if (index == m_endDevices.NOT_FOUND) { // end device not found
     NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr);
     return;
   }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.GetHot (index);
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
 
   // Generate a Downstream packet
-  if (it->second.m_downstreamQueue.size () > 0)
+  if (coldInfo.m_downstreamQueue.size () > 0)
     NS_LOG_INFO(this << " DS queue for end device " << Ipv4Address(deviceAddr) << " is not empty");
 
   NS_ASSERT (m_pktSize >= 8 + 1 + 4); // should be able to send at least frame header, MAC header and MAC MIC
@@ -1262,31 +1522,32 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
       element->m_downstreamTransmissionsRemaining = 1;
     }
     element->m_isRetransmission = false;
-    it->second.m_downstreamQueue.push_back (element);
-    it->second.m_nDSPacketsGenerated += 1;
+    coldInfo.m_downstreamQueue.push_back (element);
+    coldInfo.m_nDSPacketsGenerated += 1;
 
     m_dsMsgGeneratedTrace (deviceAddr, element->m_downstreamTransmissionsRemaining, element->m_downstreamMsgType, element->m_downstreamPacket);
-    NS_LOG_DEBUG (this << " Added downstream packet with size " << m_pktSize  << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << it->second.m_downstreamQueue.size());
+    NS_LOG_DEBUG (this << " Added downstream packet with size " << m_pktSize  << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << coldInfo.m_downstreamQueue.size());
   }
 
   // Reschedule timer:
   Time t = Seconds (this->m_downstreamIATRandomVariable->GetValue ());
-  it->second.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, deviceAddr);
-  NS_LOG_DEBUG (this << " DS Traffic Timer for end device " << it->second.m_deviceAddress << " scheduled at " << t);
+  coldInfo.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, deviceAddr);
+  NS_LOG_DEBUG (this << " DS Traffic Timer for end device " << info.m_deviceAddress << " scheduled at " << t);
 }
 
 void
 LoRaWANNetworkServer::DeleteFirstDSQueueElement (uint32_t deviceAddr)
 {
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
+  const uint32_t index = m_endDevices.Find (deviceAddr);
+  if (index == m_endDevices.NOT_FOUND) { // end device not found
     NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr << ". Unable to delete DS queue element.");
     return;
   }
+  LoRaWANEndDeviceColdInfoNS &coldInfo = m_endDevices.GetCold (index);
 
-  LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front ();
+  LoRaWANNSDSQueueElement* ptr = coldInfo.m_downstreamQueue.front ();
   delete ptr;
-  it->second.m_downstreamQueue.pop_front ();
+  coldInfo.m_downstreamQueue.pop_front ();
 }
 
 int64_t
@@ -1389,9 +1650,14 @@ LoRaWANGatewayApplication::AssignStreams (int64_t stream)
 }
 
 bool
-LoRaWANGatewayApplication::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex)
+LoRaWANGatewayApplication::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex, Time airTime)
 {
-  NS_LOG_FUNCTION (this << (unsigned)channelIndex << (unsigned)dataRateIndex);
+  NS_LOG_FUNCTION (this << (unsigned)channelIndex << (unsigned)dataRateIndex << airTime);
+
+  if (!IsTxScheduleFree (Simulator::Now (), Simulator::Now () + std::max (airTime, TimeStep (1)))) {
+    NS_LOG_DEBUG (this << " Gateway is already sending a DS frame");
+    return false;
+  }
 
   Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
 
@@ -1399,21 +1665,47 @@ LoRaWANGatewayApplication::CanSendImmediatelyOnChannel (uint8_t channelIndex, ui
     NS_LOG_ERROR (this << " Cannot get LoRaWANNetDevice pointer belonging to this gateway");
     return false;
   } else {
-    return device->CanSendImmediatelyOnChannel (channelIndex, dataRateIndex);
+    return device->CanSendImmediatelyOnChannel (channelIndex, dataRateIndex, airTime);
   }
 }
 
-void LoRaWANGatewayApplication::SendDSPacket (Ptr<Packet> p)
+bool
+LoRaWANGatewayApplication::IsTxScheduleFree (Time start, Time end)
+{
+  // Forget the transmissions that are over, the bookings do not overlap so
+  // they end in the same order as they start
+  while (!m_txSchedule.empty () && m_txSchedule.begin ()->second <= Simulator::Now ()) {
+    m_txSchedule.erase (m_txSchedule.begin ());
+  }
+
+  // Only the last booking that starts before end can overlap [start, end)
+  std::map<Time, Time>::const_iterator it = m_txSchedule.lower_bound (end);
+  if (it == m_txSchedule.begin ()) {
+    return true;
+  }
+  --it;
+  return it->second <= start;
+}
+
+bool LoRaWANGatewayApplication::SendDSPacket (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this);
   // p represents MACPayload
 
-  // Get the requested data rate from the packet tag
-  uint8_t dataRateIndex = 12; // SF12 as default value
-
+  // Get the requested channel, data rate and code rate from the packet tag
   LoRaWANPhyParamsTag phyParamsTag;
-  if (p->PeekPacketTag (phyParamsTag)) {
-	  dataRateIndex = phyParamsTag.GetDataRateIndex();
+  if (!p->PeekPacketTag (phyParamsTag)) {
+    NS_LOG_ERROR (this << " LoRaWANPhyParamsTag not found on DS packet.");
+    return false;
+  }
+  const uint8_t channelIndex = phyParamsTag.GetChannelIndex ();
+  const uint8_t dataRateIndex = phyParamsTag.GetDataRateIndex ();
+
+  // The MAC adds the MAC header and the MIC to the MACPayload
+  const Time airTime = LoRaWANPhy::GetTimeOnAir (p->GetSize () + 1 + 4, dataRateIndex, phyParamsTag.GetCodeRate ());
+  if (!CanSendImmediatelyOnChannel (channelIndex, dataRateIndex, airTime)) {
+    NS_LOG_DEBUG (this << " Gateway can not send DS packet on channel " << (unsigned)channelIndex << " and data rate " << (unsigned)dataRateIndex);
+    return false;
   }
 
   // Set NetDevice MTU Data rate before calling socket::Send
@@ -1421,13 +1713,18 @@ void LoRaWANGatewayApplication::SendDSPacket (Ptr<Packet> p)
   netDevice->SetMTUSpreadingFactor(LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor);
 
   m_txTrace (p);
-  m_socket->Send (p);
+  if (m_socket->Send (p) < 0) {
+    NS_LOG_WARN (this << " Net device refused DS packet");
+    return false;
+  }
+  m_txSchedule[Simulator::Now ()] = Simulator::Now () + airTime;
 
   NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
                 << "s LoRaWANGatewayApplication application on node #"
                 << GetNode()->GetId()
                 << " sent a downstream packet of size "
                 <<  p->GetSize ());
+  return true;
 }
 
 // Application Methods
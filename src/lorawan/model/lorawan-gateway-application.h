@@ -33,8 +33,11 @@
 #include "ns3/lightweight-timeslots.h"
 
 #include "ns3/lorawan.h"
-#include <unordered_map>
+#include "ns3/lorawan-device-table.h"
+#include "ns3/lorawan-timing-wheel.h"
+#include "ns3/lorawan-snr-history.h"
 #include <deque>
+#include <map>
 
 namespace ns3 {
 
@@ -85,28 +88,61 @@ typedef struct LoRaWANNSDSQueueElement {
   bool 		  m_isRetransmission;
 } LoRaWANNSDSQueueElement;
 
+/**
+ * A reception of an upstream frame by a gateway.
+ */
+typedef struct LoRaWANUplinkReception {
+  Ptr<LoRaWANGatewayApplication> m_gateway; //!< The gateway that received the frame
+  double m_rssi; //!< RSSI in dBm
+  double m_snr;  //!< SNR in dB
+} LoRaWANUplinkReception;
+
+/**
+ * Network server state of an end device that is read or updated for every
+ * upstream frame. Kept small, as the records of all end devices are stored
+ * next to each other (see LoRaWANDeviceTable).
+ */
 typedef struct LoRaWANEndDeviceInfoNS {
-  LoRaWANEndDeviceInfoNS () : m_deviceAddress(), m_rx1DROffset(0), m_lastDSGW(nullptr), m_lastGWs(),
-	m_lastDataRateIndex(0), m_lastChannelIndex(0), m_lastCodeRate(0), m_lastSeen(0),
-	m_framePending(false),m_setAck(false), m_fCntUp(0), m_fCntDown(0),
-	m_nUSPackets(0), m_nUniqueUSPackets(0), m_nUSRetransmission(0), m_nUSDuplicates(0), m_nUSAcks(0),
-	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSRetransmission(0), m_nDSAcks(0),
-	m_rw1Timer(), m_rw2Timer(), m_downstreamQueue(),m_downstreamTimer(), m_timeslotsDrChanged(false), m_timeslotsRecorder(), m_runTimeSlotMAC(false), m_timeslotDelay(0), m_finalExpectedAverageCollisions(0), m_changedInLastPeriod(false) {}
+  LoRaWANEndDeviceInfoNS () : m_deviceAddress(), m_lastSeen(0), m_fCntUp(0), m_fCntDown(0), m_nUSPackets(0),
+	m_rx1DROffset(0), m_lastDataRateIndex(0), m_lastChannelIndex(0), m_lastCodeRate(0),
+	m_framePending(false), m_setAck(false), m_runTimeSlotMAC(false), m_timeslotDelay(0),
+	m_runADRMAC(false), m_adrDataRateIndex(0), m_dedupEntry(0xffffffff) {}
 
   Ipv4Address     m_deviceAddress;
+  Time            m_lastSeen;
+  uint32_t        m_fCntUp;       //!< Uplink frame counter
+  uint32_t        m_fCntDown;     //!< Downlink frame counter
+  uint32_t 	  m_nUSPackets;   //!< The total number of received US packets
   uint8_t 	  m_rx1DROffset;
-  Ptr<LoRaWANGatewayApplication> m_lastDSGW;
-  std::vector< Ptr<LoRaWANGatewayApplication> > m_lastGWs;
   uint8_t         m_lastDataRateIndex;
   uint8_t         m_lastChannelIndex;
   uint8_t         m_lastCodeRate;
-  Time            m_lastSeen;
   bool            m_framePending;
   bool            m_setAck;
-  uint32_t        m_fCntUp;       //!< Uplink frame counter
-  uint32_t        m_fCntDown;     //!< Downlink frame counter
 
-  uint32_t 	  m_nUSPackets;   //!< The total number of received US packets
+  bool m_runTimeSlotMAC;
+  uint8_t m_timeslotDelay;
+
+  bool m_runADRMAC;            //!< Send a LinkADRReq in the next DS frame
+  uint8_t m_adrDataRateIndex;  //!< The data rate of the LinkADRReq
+
+  uint32_t m_dedupEntry; //!< The open deduplication entry of the device, 0xffffffff if none
+} LoRaWANEndDeviceInfoNS;
+
+/**
+ * Network server state of an end device that is not needed for every
+ * upstream frame: statistics, downstream queue, timers and timeslot
+ * bookkeeping.
+ */
+typedef struct LoRaWANEndDeviceColdInfoNS {
+  LoRaWANEndDeviceColdInfoNS () : m_lastDSGW(nullptr), m_lastReceptions(),
+	m_nUniqueUSPackets(0), m_nUSRetransmission(0), m_nUSDuplicates(0), m_nUSAcks(0),
+	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSRetransmission(0), m_nDSAcks(0),
+	m_rw1Timer(), m_rw2Timer(), m_downstreamQueue(),m_downstreamTimer(), m_timeslotsDrChanged(false), m_timeslotsRecorder(), m_finalExpectedAverageCollisions(0), m_changedInLastPeriod(false), m_snrHistory() {}
+
+  Ptr<LoRaWANGatewayApplication> m_lastDSGW;
+  std::vector<LoRaWANUplinkReception> m_lastReceptions; //!< The gateways that received the last upstream frame, best link first
+
   uint32_t 	  m_nUniqueUSPackets;   //!< Number of received unique US packets (i.e. with a new US frame counter)
   uint32_t        m_nUSRetransmission;  //!< Number of upstream retransmission received
   uint32_t        m_nUSDuplicates;  //!< Number of upstream duplicates received
@@ -130,16 +166,13 @@ typedef struct LoRaWANEndDeviceInfoNS {
   bool m_timeslotsDrChanged; //only run algorithm for devices that have not changed their DR since the last run
   //TODO: for each device, add a data structure containing a 0 for each timeslot (DR dependent). Then, for each receive, calculate the timeslot
   // the receive occured in since the last run of the algorithm, and set that to 1. 
-  std::vector<unsigned char> m_timeslotsRecorder;
+  LoRaWANTimeslotsRecorder m_timeslotsRecorder;
 
-  bool m_runTimeSlotMAC;
-  uint8_t m_timeslotDelay;
-  
   float m_finalExpectedAverageCollisions;
   bool m_changedInLastPeriod;
 
-  
-} LoRaWANEndDeviceInfoNS;
+  LoRaWANSnrHistory m_snrHistory; //!< The SNR of the last US frames with the ADR bit set, allocated at the first one
+} LoRaWANEndDeviceColdInfoNS;
 
 //class LoRaWANNetworkServer : public SimpleRefCount<LoRaWANNetworkServer>
 class LoRaWANNetworkServer : public Object
@@ -152,7 +185,20 @@ public:
   virtual void DoDispose (void);
 
   void PopulateEndDevices (void);
-  LoRaWANEndDeviceInfoNS InitEndDeviceInfo (Ipv4Address);
+
+  /**
+   * Add an end device to the device table and start its DS traffic timer if
+   * GenerateDataDown is set.
+   *
+   * \param deviceAddr the device address, which must not be known yet
+   * \return the index of the end device in the device table
+   */
+  uint32_t AddEndDevice (Ipv4Address deviceAddr);
+
+  /**
+   * \return the number of end devices in the device table
+   */
+  uint32_t GetNEndDevices (void) const;
 
   static void clearLoRaWANNetworkServerPointer () { LoRaWANNetworkServer::m_ptr = nullptr; }
   static bool haveLoRaWANNetworkServerObject () { return LoRaWANNetworkServer::m_ptr != NULL; }
@@ -163,10 +209,56 @@ public:
 
   static bool sortByPthenO(Periodicity p1, Periodicity p2);
   
-  void HandleUSPacket (Ptr<LoRaWANGatewayApplication>, Address from, Ptr<Packet> packet);
+  /**
+   * Handle an upstream frame received by a gateway.
+   *
+   * The receptions of the same frame (device address and frame counter) by
+   * several gateways are collected during the DeduplicationWindow that starts
+   * at the first reception. When the window closes, the frame is processed
+   * once, with the list of gateways that received it and their RSSI and SNR.
+   *
+   * \param lastGW the gateway that received the frame
+   * \param from the address of the gateway's net device
+   * \param packet the MACPayload, with a LoRaWANPhyParamsTag and a
+   * LoRaWANMsgTypeTag
+   */
+  void HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Address from, Ptr<Packet> packet);
   void RW1TimerExpired (uint32_t deviceAddr);
   void RW2TimerExpired (uint32_t deviceAddr);
-  void SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2);
+  /**
+   * Send the pending DS frame or Ack of an end device in one of its receive
+   * windows. The gateways that received the last US frame of the end device
+   * are tried in order of link quality (see IsBetterReception), the frame is
+   * sent by the first one that can send it right away.
+   *
+   * \param deviceAddr the address of the end device
+   * \param RW1 true to send in RW1
+   * \param RW2 true to send in RW2
+   * \return false if there was something to send but no gateway could send it
+   */
+  bool SendDSPacket (uint32_t deviceAddr, bool RW1, bool RW2);
+
+  /**
+   * Order of the gateways for DS transmissions: highest SNR first, then
+   * highest RSSI. A LoRa receiver can demodulate below the noise floor, so the
+   * SNR is the better indication of the margin on the link.
+   *
+   * \return true if reception a is a better link to the end device than b
+   */
+  static bool IsBetterReception (const LoRaWANUplinkReception &a, const LoRaWANUplinkReception &b);
+
+  /**
+   * \param dataRateIndex a data rate of the current region
+   * \return the SNR in dB that a LoRa receiver needs to demodulate a frame
+   * sent at the data rate
+   */
+  static double GetRequiredSnr (uint8_t dataRateIndex);
+
+  /**
+   * \return the highest data rate the ADR engine assigns to end devices: the
+   * last of the upstream data rates that use the bandwidth of DR0
+   */
+  static uint8_t GetADRMaxDataRateIndex (void);
   bool HaveSomethingToSendToEndDevice (uint32_t deviceAddr);
   void DSTimerExpired (uint32_t deviceAddr);
   void DeleteFirstDSQueueElement (uint32_t deviceAddr);
@@ -175,11 +267,96 @@ public:
 
   void PrintFinalDetails();
 
+  /**
+   * Run the periodicity detector on the timeslots recorded for every end
+   * device that kept its data rate during the last period, store the best
+   * (p, o) pair of each in the list of its data rate and clear the recorders.
+   *
+   * The end devices are split over TimeslotsDetectionThreads workers, each
+   * with its own LightweightTimeslots and so its own FFTW plans and buffers.
+   * The workers only write the entries of their own end devices, the lists
+   * are then filled in the order of m_endDevices by the calling thread, so
+   * the result does not depend on the number of workers.
+   */
+  void DetectPeriodicities (void);
+
+  /**
+   * \param dataRateIndex a data rate index
+   * \return the periodicities found by the last DetectPeriodicities at the
+   * data rate, after collision avoidance once the scheduler ran
+   */
+  const std::vector<Periodicity>& GetPeriodicities (uint8_t dataRateIndex) const;
+
   void PrintAvgAndStdDevOfTimeSlots (std::vector<unsigned char> period_counter);
 
 private:
+  /**
+   * \param deviceAddr the address of a known end device
+   * \return the network server state of the end device
+   */
+  LoRaWANEndDeviceInfoNS& GetEndDeviceInfo (uint32_t deviceAddr);
+  LoRaWANEndDeviceColdInfoNS& GetEndDeviceColdInfo (uint32_t deviceAddr);
+
+  /// The receptions of an upstream frame during its deduplication window
+  struct DedupEntry
+  {
+    uint32_t m_deviceIndex;  //!< The index of the end device in m_endDevices
+    uint16_t m_fCnt;         //!< The frame counter of the frame
+    Time m_firstRx;          //!< The time of the first reception
+    Ptr<Packet> m_packet;    //!< The frame of the first reception
+    std::vector<LoRaWANUplinkReception> m_receptions; //!< The receptions, in order
+  };
+
+  static const uint32_t NO_DEDUP_ENTRY = 0xffffffff;
+
+  void SetDeduplicationWindow (Time window);
+  Time GetDeduplicationWindow (void) const;
+
+  /**
+   * Process the frames whose deduplication window closes now and schedule
+   * the next window closure.
+   */
+  void DeduplicationTimerExpired (void);
+
+  /**
+   * Process a deduplicated upstream frame: update the state of the end
+   * device, handle the frame and schedule RW1.
+   *
+   * \param entry the deduplication entry of the frame
+   */
+  void ProcessUSPacket (DedupEntry &entry);
+
+  /**
+   * Adaptive data rate: add the SNR of an US frame with the ADR bit set to
+   * the history of the end device and, once the history holds ADRHistoryLength
+   * frames, decide whether the next DS frame carries a LinkADRReq.
+   *
+   * The margin is the highest SNR in the history minus the SNR required at the
+   * current data rate minus ADRMargin, the data rate is raised one step per 3
+   * dB of margin, up to GetADRMaxDataRateIndex. The end devices of this model
+   * always send at the maximum power of the sub band, so the transmit power is
+   * not lowered and the data rate is never decreased: an end device that lost
+   * its link lowers its own data rate (ADR backoff).
+   *
+   * \param info the state of the end device, with the data rate of the frame
+   * \param coldInfo the statistics of the end device
+   * \param snr the SNR of the frame at the gateway with the best link
+   */
+  void EvaluateADR (LoRaWANEndDeviceInfoNS &info, LoRaWANEndDeviceColdInfoNS &coldInfo, double snr);
+
+  uint32_t m_adrHistoryLength;      //!< The number of US frames in the ADR history
+  double m_adrMargin;               //!< The installation margin of the ADR engine, in dB
+
+  Time m_dedupWindow;               //!< The deduplication window
+  int64_t m_dedupTick;              //!< The tick of m_dedupWheel, in time steps
+  LoRaWANTimingWheel m_dedupWheel;  //!< The open entries, by tick at which their window closes
+  std::vector<DedupEntry> m_dedupEntries;   //!< The pool of entries
+  std::vector<uint32_t> m_freeDedupEntries; //!< The entries of m_dedupEntries that are not in use
+  std::vector<uint32_t> m_closingDedupEntries; //!< The entries being processed
+  EventId m_dedupEvent;             //!< Expires at the next tick of m_dedupWheel
+
   static Ptr<LoRaWANNetworkServer> m_ptr;
-  std::unordered_map <uint32_t, LoRaWANEndDeviceInfoNS> m_endDevices;
+  LoRaWANDeviceTable<LoRaWANEndDeviceInfoNS, LoRaWANEndDeviceColdInfoNS> m_endDevices;
   uint16_t m_pktSize;
   bool m_generateDataDown;
   bool m_confirmedData;
@@ -202,6 +379,19 @@ private:
   EventId m_timeSlotCalcScheduler;
   Time currentTimePeriodStart;
   void LightweightTimeslotsScheduler (void);
+
+  /**
+   * Body of a DetectPeriodicities worker: detect the periodicity of the end
+   * devices with index worker, worker + nWorkers, ... in m_endDevices.
+   *
+   * \param worker the index of the worker, also of its detector
+   * \param nWorkers the number of workers
+   */
+  void DetectPeriodicitiesWorker (uint32_t worker, uint32_t nWorkers);
+
+  uint32_t m_timeslotsDetectionThreads; //!< The number of DetectPeriodicities workers, 0 for one per hardware thread
+  std::vector<Ptr<LightweightTimeslots> > m_timeslotsDetectors; //!< The detector of each worker
+  std::vector<std::tuple<int, int> > m_detectedPeriodicities;   //!< The (p, o) of each end device, p is 0 if none was found
   static const std::vector<LoRaWANTimeSlotsPerDataRate> m_timeSlotsPerDataRate;
 
   std::vector<Periodicity> periodicitiesDR0;
@@ -258,8 +448,23 @@ public:
    */
   void HandleRead (Ptr<Socket> socket);
 
-  bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex);
-  void SendDSPacket (Ptr<Packet> p);
+  /**
+   * \param channelIndex the channel of the DS frame
+   * \param dataRateIndex the data rate of the DS frame
+   * \param airTime the time on air of the DS frame
+   * \return true if the gateway can start sending the DS frame now: its
+   * radio is not booked by an earlier DS frame, the MAC for the channel and
+   * data rate is idle and the duty cycle of the sub band allows it
+   */
+  bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex, Time airTime = Time ());
+
+  /**
+   * Send a DS frame now, if the gateway can (see CanSendImmediatelyOnChannel).
+   *
+   * \param p the MACPayload, with a LoRaWANPhyParamsTag and a LoRaWANMsgTypeTag
+   * \return true if the frame is being sent, false if the gateway refused it
+   */
+  bool SendDSPacket (Ptr<Packet> p);
 protected:
   virtual void DoInitialize (void);
   virtual void DoDispose (void);
@@ -317,7 +522,21 @@ private:
    */
   void ConnectionFailed (Ptr<Socket> socket);
 
+  /**
+   * \return true if the radio of the gateway is not booked during [start, end)
+   */
+  bool IsTxScheduleFree (Time start, Time end);
+
   uint64_t        m_totalRx;      //!< Total bytes received
+
+  /**
+   * The DS transmissions of the gateway: start time to end time, in a
+   * balanced tree so that checking an interval is logarithmic. A transmission
+   * is booked as soon as it is handed to the net device, so that several
+   * receive windows that open in the same time step do not pick the same
+   * gateway before its MAC changes state.
+   */
+  std::map<Time, Time> m_txSchedule;
 };
 
 } // namespace ns3
@@ -0,0 +1,248 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-gateway-receiver.h"
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-spectrum-value-helper.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/uinteger.h>
+#include <ns3/net-device.h>
+#include <ns3/mobility-model.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/antenna-model.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayReceiver");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANGatewayReceiver);
+
+TypeId
+LoRaWANGatewayReceiver::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANGatewayReceiver")
+    .SetParent<SpectrumPhy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANGatewayReceiver> ()
+    .AddAttribute ("Demodulators",
+                   "The number of frames the gateway can receive at the same time",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&LoRaWANGatewayReceiver::m_nDemodulators),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("DemodulatorsBusy",
+                     "A frame was dropped because all demodulation paths were busy",
+                     MakeTraceSourceAccessor (&LoRaWANGatewayReceiver::m_demodulatorsBusyTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANGatewayReceiver::LoRaWANGatewayReceiver (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  LoRaWAN::AcquireRegion ();
+  LoRaWANSpectrumValueHelper psdHelper;
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (LoRaWAN::m_supportedChannels [0].m_fc);
+  m_spectrumModel = noise->GetSpectrumModel ();
+  m_signal = Create<LoRaWANInterferenceHelper> (m_spectrumModel);
+}
+
+LoRaWANGatewayReceiver::~LoRaWANGatewayReceiver (void)
+{
+  LoRaWAN::ReleaseRegion ();
+}
+
+void
+LoRaWANGatewayReceiver::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_phys.clear ();
+  m_demodulations.clear ();
+  m_signal = 0;
+  m_spectrumModel = 0;
+  m_device = 0;
+  m_mobility = 0;
+  m_channel = 0;
+  SpectrumPhy::DoDispose ();
+}
+
+void
+LoRaWANGatewayReceiver::SetPhys (const std::vector<Ptr<LoRaWANPhy> > &phys, const std::vector<int16_t> &phyIndices)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (phyIndices.size () == LoRaWAN::m_supportedChannels.size () * LoRaWAN::m_supportedDataRates.size ());
+  m_phys = phys;
+  m_phyIndices = phyIndices;
+  for (std::vector<Ptr<LoRaWANPhy> >::const_iterator it = m_phys.begin (); it != m_phys.end (); ++it)
+    {
+      (*it)->SetSharedInterferenceHelper (m_signal);
+    }
+}
+
+uint32_t
+LoRaWANGatewayReceiver::GetNBusyDemodulators (void) const
+{
+  return m_demodulations.size ();
+}
+
+void
+LoRaWANGatewayReceiver::SetDevice (Ptr<NetDevice> d)
+{
+  NS_LOG_FUNCTION (this << d);
+  m_device = d;
+}
+
+Ptr<NetDevice>
+LoRaWANGatewayReceiver::GetDevice (void) const
+{
+  if (m_device == 0 && !m_phys.empty ())
+    {
+      return m_phys[0]->GetDevice ();
+    }
+  return m_device;
+}
+
+void
+LoRaWANGatewayReceiver::SetMobility (Ptr<MobilityModel> m)
+{
+  NS_LOG_FUNCTION (this << m);
+  m_mobility = m;
+}
+
+Ptr<MobilityModel>
+LoRaWANGatewayReceiver::GetMobility (void)
+{
+  // The gateway PHYs share the mobility model of the gateway
+  if (m_mobility == 0 && !m_phys.empty ())
+    {
+      return m_phys[0]->GetMobility ();
+    }
+  return m_mobility;
+}
+
+void
+LoRaWANGatewayReceiver::SetChannel (Ptr<SpectrumChannel> c)
+{
+  NS_LOG_FUNCTION (this << c);
+  m_channel = c;
+}
+
+Ptr<const SpectrumModel>
+LoRaWANGatewayReceiver::GetRxSpectrumModel (void) const
+{
+  return m_spectrumModel;
+}
+
+Ptr<AntennaModel>
+LoRaWANGatewayReceiver::GetRxAntenna (void)
+{
+  if (m_phys.empty ())
+    {
+      return 0;
+    }
+  return m_phys[0]->GetRxAntenna ();
+}
+
+void
+LoRaWANGatewayReceiver::CheckInterference (uint8_t channelIndex)
+{
+  for (std::vector<Demodulation>::const_iterator it = m_demodulations.begin (); it != m_demodulations.end (); ++it)
+    {
+      Ptr<LoRaWANPhy> phy = m_phys[it->phyIndex];
+      if (channelIndex == LoRaWANSpectrumChannel::ALL_CHANNELS || phy->GetCurrentChannelIndex () == channelIndex)
+        {
+          phy->CheckInterference ();
+        }
+    }
+}
+
+void
+LoRaWANGatewayReceiver::StartRx (Ptr<SpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params);
+  NS_ASSERT (!m_phys.empty ());
+
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanParams = DynamicCast<LoRaWANSpectrumSignalParameters> (params);
+  if (loraWanParams == 0)
+    {
+      // Not a LoRaWAN signal, this is interference for all PHYs
+      CheckInterference (LoRaWANSpectrumChannel::ALL_CHANNELS);
+      m_signal->AddSignal (params->psd);
+      Simulator::Schedule (params->duration, &LoRaWANGatewayReceiver::EndRx, this, params);
+      return;
+    }
+
+  // The PHYs on other channels ignore the signal, as in LoRaWANPhy::StartRx
+  CheckInterference (loraWanParams->channelIndex);
+  m_signal->AddSignal (params->psd, loraWanParams->dataRateIndex);
+  Simulator::Schedule (params->duration, &LoRaWANGatewayReceiver::EndRx, this, params);
+
+  if (params->txPhy && params->txPhy->GetDevice () && params->txPhy->GetDevice () == GetDevice ())
+    {
+      return; // our own transmission, only interference for the other PHYs
+    }
+
+  const int16_t phyIndex = m_phyIndices[loraWanParams->channelIndex * LoRaWAN::m_supportedDataRates.size () + loraWanParams->dataRateIndex];
+  if (phyIndex < 0)
+    {
+      return; // the gateway does not listen on this channel and data rate, only interference
+    }
+  NS_ASSERT (static_cast<uint32_t> (phyIndex) < m_phys.size ());
+  if (m_demodulations.size () >= m_nDemodulators)
+    {
+      NS_LOG_DEBUG (this << " all " << m_nDemodulators << " demodulation paths are busy, dropping packet");
+      m_demodulatorsBusyTrace (loraWanParams->packet);
+      return;
+    }
+
+  Ptr<LoRaWANPhy> phy = m_phys[phyIndex];
+  phy->StartRx (params);
+  if (phy->m_currentRxPacket.first == loraWanParams)
+    {
+      Demodulation demodulation;
+      demodulation.params = loraWanParams;
+      demodulation.phyIndex = phyIndex;
+      m_demodulations.push_back (demodulation);
+    }
+}
+
+void
+LoRaWANGatewayReceiver::EndRx (Ptr<SpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params);
+
+  for (std::vector<Demodulation>::iterator it = m_demodulations.begin (); it != m_demodulations.end (); ++it)
+    {
+      if (it->params == params)
+        {
+          Ptr<LoRaWANPhy> phy = m_phys[it->phyIndex];
+          m_demodulations.erase (it);
+          // The PHY finishes the reception before the signal is removed
+          phy->EndRx (params);
+          break;
+        }
+    }
+
+  m_signal->RemoveSignal (params->psd);
+}
+
+} // namespace ns3
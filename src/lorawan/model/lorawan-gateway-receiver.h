@@ -0,0 +1,162 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_GATEWAY_RECEIVER_H
+#define LORAWAN_GATEWAY_RECEIVER_H
+
+#include <ns3/spectrum-phy.h>
+#include <ns3/traced-callback.h>
+#include <ns3/packet.h>
+#include "lorawan-phy.h"
+#include "lorawan-interference-helper.h"
+#include "lorawan-spectrum-signal-parameters.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * Receive path of a gateway, modelled after the SX1301 baseband processor.
+ *
+ * Instead of attaching the gateway PHYs (one per channel and data rate) to
+ * the channel, this receiver is attached once and keeps a single interference
+ * helper for all PHYs (which tracks the interference per channel and per data
+ * rate). An incoming LoRaWAN transmission is handed to the PHY of its channel
+ * and data rate only, provided that one of the Demodulators demodulation
+ * paths is free. The PHY then receives the frame as usual, so that the PHY
+ * traces and the callbacks to the MAC and the net device keep working. When
+ * all demodulation paths are busy, the frame is dropped and the
+ * DemodulatorsBusy trace is fired.
+ */
+class LoRaWANGatewayReceiver : public SpectrumPhy
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANGatewayReceiver (void);
+  virtual ~LoRaWANGatewayReceiver (void);
+
+  /**
+   * Set the PHYs of the gateway. The PHYs are switched to the interference
+   * helper of this receiver.
+   *
+   * \param phys the gateway PHYs
+   * \param phyIndices the index in phys of the PHY for channel c and data
+   * rate d at c * LoRaWAN::m_supportedDataRates.size () + d, -1 if there is
+   * none
+   */
+  void SetPhys (const std::vector<Ptr<LoRaWANPhy> > &phys, const std::vector<int16_t> &phyIndices);
+
+  /**
+   * \return the number of demodulation paths that are currently receiving a frame
+   */
+  uint32_t GetNBusyDemodulators (void) const;
+
+  // inherited from SpectrumPhy
+  virtual void SetDevice (Ptr<NetDevice> d);
+  virtual Ptr<NetDevice> GetDevice (void) const;
+  virtual void SetMobility (Ptr<MobilityModel> m);
+  virtual Ptr<MobilityModel> GetMobility (void);
+  virtual void SetChannel (Ptr<SpectrumChannel> c);
+  virtual Ptr<const SpectrumModel> GetRxSpectrumModel (void) const;
+  virtual Ptr<AntennaModel> GetRxAntenna (void);
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params);
+
+private:
+  // Inherited from Object.
+  virtual void DoDispose (void);
+
+  /**
+   * Remove a signal from the interference at the end of its transmission,
+   * finishing its reception if it occupies a demodulation path.
+   *
+   * \param params signal parameters of the signal
+   */
+  void EndRx (Ptr<SpectrumSignalParameters> params);
+
+  /**
+   * Let the PHYs that are receiving a frame account for the interference up
+   * to now, before the interference changes.
+   *
+   * \param channelIndex only update the PHYs on this channel, or
+   * LoRaWANSpectrumChannel::ALL_CHANNELS for all PHYs
+   */
+  void CheckInterference (uint8_t channelIndex);
+
+  /**
+   * A demodulation path that is receiving a frame.
+   */
+  struct Demodulation
+  {
+    Ptr<LoRaWANSpectrumSignalParameters> params; //!< The frame being received
+    uint32_t phyIndex;                            //!< The PHY receiving the frame
+  };
+
+  /**
+   * The gateway PHYs.
+   */
+  std::vector<Ptr<LoRaWANPhy> > m_phys;
+
+  /**
+   * The index in m_phys of the PHY for every channel and data rate, -1 if
+   * there is none (see SetPhys).
+   */
+  std::vector<int16_t> m_phyIndices;
+
+  /**
+   * The accumulated signals currently received by the gateway.
+   */
+  Ptr<LoRaWANInterferenceHelper> m_signal;
+
+  /**
+   * The demodulation paths in use.
+   */
+  std::vector<Demodulation> m_demodulations;
+
+  /**
+   * The number of demodulation paths.
+   */
+  uint32_t m_nDemodulators;
+
+  /**
+   * The spectrum model of the LoRaWAN signals.
+   */
+  Ptr<const SpectrumModel> m_spectrumModel;
+
+  Ptr<NetDevice> m_device;
+  Ptr<MobilityModel> m_mobility;
+  Ptr<SpectrumChannel> m_channel;
+
+  /**
+   * The trace source fired when a frame is dropped because all demodulation
+   * paths are busy.
+   */
+  TracedCallback<Ptr<const Packet> > m_demodulatorsBusyTrace;
+}; // class LoRaWANGatewayReceiver
+
+} // namespace ns3
+
+#endif /* LORAWAN_GATEWAY_RECEIVER_H */
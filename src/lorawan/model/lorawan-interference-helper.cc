@@ -18,41 +18,163 @@
  * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
  */
 #include "lorawan-interference-helper.h"
+#include "lorawan.h"
 #include <ns3/spectrum-value.h>
 #include <ns3/spectrum-model.h>
 #include <ns3/log.h>
+#include <ns3/abort.h>
+
+#include <limits>
+#include <sstream>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANInterferenceHelper");
 
+namespace {
+
+/**
+ * Default isolations (dB), rows for the wanted SF7 to SF12 and columns for the
+ * interfering SF7 to SF12: 1 dB minus the SIR thresholds of Croce et al.
+ */
+const double g_defaultInterSfIsolationDb[LoRaWANInterSfRejection::N_SPREADING_FACTORS][LoRaWANInterSfRejection::N_SPREADING_FACTORS] = {
+  {  0,  9, 10, 10, 10, 10 },
+  { 12,  0, 12, 13, 14, 14 },
+  { 16, 14,  0, 14, 15, 16 },
+  { 20, 19, 18,  0, 18, 19 },
+  { 23, 23, 22, 21,  0, 21 },
+  { 26, 26, 26, 25, 24,  0 },
+};
+
+} // anonymous namespace
+
+LoRaWANInterSfRejection::LoRaWANInterSfRejection ()
+{
+  NS_ABORT_MSG_UNLESS (Set (g_defaultInterSfIsolationDb), "Invalid default inter-SF isolation table");
+}
+
+bool
+LoRaWANInterSfRejection::Parse (const std::string &table)
+{
+  if (table == "default")
+    {
+      return Set (g_defaultInterSfIsolationDb);
+    }
+
+  double isolationDb[N_SPREADING_FACTORS][N_SPREADING_FACTORS];
+  std::istringstream iss (table);
+  for (uint32_t i = 0; i < N_SPREADING_FACTORS; i++)
+    {
+      for (uint32_t j = 0; j < N_SPREADING_FACTORS; j++)
+        {
+          if (!(iss >> isolationDb[i][j]))
+            {
+              return false;
+            }
+        }
+    }
+  std::string trailing;
+  if (iss >> trailing)
+    {
+      return false;
+    }
+  return Set (isolationDb);
+}
+
+bool
+LoRaWANInterSfRejection::Set (const double table[N_SPREADING_FACTORS][N_SPREADING_FACTORS])
+{
+  for (uint32_t i = 0; i < N_SPREADING_FACTORS; i++)
+    {
+      for (uint32_t j = 0; j < N_SPREADING_FACTORS; j++)
+        {
+          const double isolationDb = table[i][j];
+          if (!std::isfinite (isolationDb) || isolationDb < 0.0 || (i == j && isolationDb != 0.0))
+            {
+              NS_LOG_WARN ("Invalid inter-SF isolation " << isolationDb << "dB for SF" << i + LORAWAN_SF7 << " vs SF" << j + LORAWAN_SF7);
+              return false;
+            }
+        }
+    }
+
+  for (uint32_t i = 0; i < N_SPREADING_FACTORS; i++)
+    {
+      for (uint32_t j = 0; j < N_SPREADING_FACTORS; j++)
+        {
+          m_isolationDb[i][j] = table[i][j];
+          m_gain[i][j] = std::pow (10.0, -table[i][j] / 10.0);
+        }
+    }
+  return true;
+}
+
+double
+LoRaWANInterSfRejection::GetIsolationDb (uint8_t wanted, uint8_t interferer) const
+{
+  return m_isolationDb[GetIndex (wanted)][GetIndex (interferer)];
+}
+
+double
+LoRaWANInterSfRejection::GetGain (uint8_t wanted, uint8_t interferer) const
+{
+  return m_gain[GetIndex (wanted)][GetIndex (interferer)];
+}
+
+uint32_t
+LoRaWANInterSfRejection::GetIndex (uint8_t sf)
+{
+  NS_ASSERT (sf >= LORAWAN_SF7 && sf <= LORAWAN_SF12);
+  return sf - LORAWAN_SF7;
+}
+
 LoRaWANInterferenceHelper::LoRaWANInterferenceHelper (Ptr<const SpectrumModel> spectrumModel)
   : m_spectrumModel (spectrumModel),
-    m_dirty (false)
+    m_removalsSinceRebuild (0)
 {
-  m_signal = Create<SpectrumValue> (m_spectrumModel);
+  LoRaWAN::AcquireRegion ();
+  const uint32_t nBands = m_spectrumModel->GetNumBands ();
+
+  // One slot per LoRaWAN data rate plus one for signals of unknown data rate
+  m_nDataRateSlots = LoRaWAN::m_supportedDataRates.size () + 1;
+
+  m_bandSums.resize (nBands);
+  m_dataRateSums.resize (nBands * m_nDataRateSlots);
+  m_bandWidths.reserve (nBands);
+  for (Bands::const_iterator it = m_spectrumModel->Begin (); it != m_spectrumModel->End (); ++it)
+    {
+      m_bandWidths.push_back (it->fh - it->fl);
+    }
 }
 
 LoRaWANInterferenceHelper::~LoRaWANInterferenceHelper (void)
 {
   m_spectrumModel = 0;
-  m_signal = 0;
   m_signals.clear ();
+  LoRaWAN::ReleaseRegion ();
 }
 
 bool
 LoRaWANInterferenceHelper::AddSignal (Ptr<const SpectrumValue> signal)
 {
-  NS_LOG_FUNCTION (this << signal);
+  return AddSignal (signal, UNKNOWN_DATA_RATE_INDEX);
+}
+
+bool
+LoRaWANInterferenceHelper::AddSignal (Ptr<const SpectrumValue> signal, uint8_t dataRateIndex)
+{
+  NS_LOG_FUNCTION (this << signal << static_cast<uint16_t> (dataRateIndex));
 
   bool result = false;
 
   if (signal->GetSpectrumModel () == m_spectrumModel)
     {
-      result = m_signals.insert (signal).second;
-      if (result && !m_dirty)
+      SignalEntry entry;
+      entry.psd = signal;
+      entry.dataRateIndex = dataRateIndex;
+      result = m_signals.insert (std::make_pair (PeekPointer (signal), entry)).second;
+      if (result)
         {
-          *m_signal += *signal;
+          Accumulate (signal, dataRateIndex, 1.0);
         }
     }
   return result;
@@ -67,10 +189,22 @@ LoRaWANInterferenceHelper::RemoveSignal (Ptr<const SpectrumValue> signal)
 
   if (signal->GetSpectrumModel () == m_spectrumModel)
     {
-      result = (m_signals.erase (signal) == 1);
-      if (result)
+      std::unordered_map<const SpectrumValue *, SignalEntry>::iterator it = m_signals.find (PeekPointer (signal));
+      if (it != m_signals.end ())
         {
-          m_dirty = true;
+          const uint8_t dataRateIndex = it->second.dataRateIndex;
+          m_signals.erase (it);
+          result = true;
+
+          if (m_signals.empty () || ++m_removalsSinceRebuild >= REBUILD_INTERVAL)
+            {
+              // Flush the rounding error accumulated by the running sums
+              Rebuild ();
+            }
+          else
+            {
+              Accumulate (signal, dataRateIndex, -1.0);
+            }
         }
     }
   return result;
@@ -82,7 +216,7 @@ LoRaWANInterferenceHelper::ClearSignals (void)
   NS_LOG_FUNCTION (this);
 
   m_signals.clear ();
-  m_dirty = true;
+  Rebuild ();
 }
 
 Ptr<SpectrumValue>
@@ -90,19 +224,153 @@ LoRaWANInterferenceHelper::GetSignalPsd (void) const
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_dirty)
+  Ptr<SpectrumValue> signal = Create<SpectrumValue> (m_spectrumModel);
+  for (uint32_t i = 0; i < m_bandSums.size (); i++)
+    {
+      (*signal)[i] = m_bandSums[i].Get ();
+    }
+
+  return signal;
+}
+
+double
+LoRaWANInterferenceHelper::GetSignalPsd (uint32_t bandIndex) const
+{
+  NS_ASSERT (bandIndex < m_bandSums.size ());
+  return m_bandSums[bandIndex].Get ();
+}
+
+double
+LoRaWANInterferenceHelper::GetSignalPsd (uint32_t bandIndex, uint8_t dataRateIndex) const
+{
+  NS_ASSERT (bandIndex < m_bandSums.size ());
+  return m_dataRateSums[GetSlot (bandIndex, dataRateIndex)].Get ();
+}
+
+void
+LoRaWANInterferenceHelper::SetInterSfRejection (const LoRaWANInterSfRejection &rejection)
+{
+  NS_LOG_FUNCTION (this);
+
+  const uint32_t nSf = LoRaWANInterSfRejection::N_SPREADING_FACTORS;
+  m_rejectionGains.assign (nSf * m_nDataRateSlots, 1.0); // signals of unknown data rate are not attenuated
+  for (uint32_t wanted = 0; wanted < nSf; wanted++)
     {
-      // Sum up the current interference PSD.
-      std::set<Ptr<const SpectrumValue> >::const_iterator it;
-      m_signal = Create<SpectrumValue> (m_spectrumModel);
-      for (it = m_signals.begin (); it != m_signals.end (); ++it)
+      for (uint32_t dataRateIndex = 0; dataRateIndex < m_nDataRateSlots - 1; dataRateIndex++)
         {
-          *m_signal += *(*it);
+          const uint8_t interfererSf = LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor;
+          m_rejectionGains[wanted * m_nDataRateSlots + dataRateIndex] = rejection.GetGain (wanted + LORAWAN_SF7, interfererSf);
         }
-      m_dirty = false;
     }
+  m_rejectedSums.resize (m_bandSums.size () * nSf);
+  Rebuild ();
+}
+
+void
+LoRaWANInterferenceHelper::ClearInterSfRejection (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_rejectionGains.clear ();
+  m_rejectedSums.clear ();
+}
+
+bool
+LoRaWANInterferenceHelper::HasInterSfRejection (void) const
+{
+  return !m_rejectedSums.empty ();
+}
+
+double
+LoRaWANInterferenceHelper::GetRejectedSignalPsd (uint32_t bandIndex, uint8_t wantedDataRateIndex) const
+{
+  NS_ASSERT (bandIndex < m_bandSums.size ());
+  const uint32_t wanted = GetSfSlot (wantedDataRateIndex);
+  if (m_rejectedSums.empty () || wanted >= LoRaWANInterSfRejection::N_SPREADING_FACTORS)
+    {
+      return m_bandSums[bandIndex].Get ();
+    }
+  return m_rejectedSums[bandIndex * LoRaWANInterSfRejection::N_SPREADING_FACTORS + wanted].Get ();
+}
+
+double
+LoRaWANInterferenceHelper::GetInBandPower (uint32_t bandIndex) const
+{
+  NS_ASSERT (bandIndex < m_bandSums.size ());
+  return m_bandSums[bandIndex].Get () * m_bandWidths[bandIndex];
+}
 
-  return m_signal->Copy ();
+uint32_t
+LoRaWANInterferenceHelper::GetNSignals (void) const
+{
+  return m_signals.size ();
+}
+
+Ptr<const SpectrumModel>
+LoRaWANInterferenceHelper::GetSpectrumModel (void) const
+{
+  return m_spectrumModel;
+}
+
+void
+LoRaWANInterferenceHelper::Accumulate (Ptr<const SpectrumValue> signal, uint8_t dataRateIndex, double sign)
+{
+  Values::const_iterator it = signal->ConstValuesBegin ();
+  for (uint32_t i = 0; it != signal->ConstValuesEnd (); ++it, ++i)
+    {
+      // LoRaWAN transmit PSDs only occupy a single band, skip the others
+      if (*it != 0.0)
+        {
+          m_bandSums[i].Add (sign * (*it));
+          const uint32_t slot = GetSlot (i, dataRateIndex);
+          m_dataRateSums[slot].Add (sign * (*it));
+          if (!m_rejectedSums.empty ())
+            {
+              const uint32_t nSf = LoRaWANInterSfRejection::N_SPREADING_FACTORS;
+              const uint32_t dataRateSlot = slot - i * m_nDataRateSlots;
+              for (uint32_t wanted = 0; wanted < nSf; wanted++)
+                {
+                  m_rejectedSums[i * nSf + wanted].Add (sign * (*it) * m_rejectionGains[wanted * m_nDataRateSlots + dataRateSlot]);
+                }
+            }
+        }
+    }
+}
+
+void
+LoRaWANInterferenceHelper::Rebuild (void)
+{
+  NS_LOG_FUNCTION (this << m_signals.size ());
+
+  m_bandSums.assign (m_bandSums.size (), CompensatedSum ());
+  m_dataRateSums.assign (m_dataRateSums.size (), CompensatedSum ());
+  m_rejectedSums.assign (m_rejectedSums.size (), CompensatedSum ());
+  for (std::unordered_map<const SpectrumValue *, SignalEntry>::const_iterator it = m_signals.begin (); it != m_signals.end (); ++it)
+    {
+      Accumulate (it->second.psd, it->second.dataRateIndex, 1.0);
+    }
+  m_removalsSinceRebuild = 0;
+}
+
+uint32_t
+LoRaWANInterferenceHelper::GetSlot (uint32_t bandIndex, uint8_t dataRateIndex) const
+{
+  uint32_t dataRateSlot = dataRateIndex;
+  if (dataRateSlot >= m_nDataRateSlots - 1)
+    {
+      dataRateSlot = m_nDataRateSlots - 1;
+    }
+  return bandIndex * m_nDataRateSlots + dataRateSlot;
+}
+
+uint32_t
+LoRaWANInterferenceHelper::GetSfSlot (uint8_t dataRateIndex)
+{
+  if (dataRateIndex >= LoRaWAN::m_supportedDataRates.size ())
+    {
+      return LoRaWANInterSfRejection::N_SPREADING_FACTORS;
+    }
+  return LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor - LORAWAN_SF7;
 }
 
 }
@@ -22,21 +22,114 @@
 
 #include <ns3/simple-ref-count.h>
 #include <ns3/ptr.h>
-#include <set>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3 {
 
 class SpectrumValue;
 class SpectrumModel;
 
+/**
+ * \ingroup lorawan
+ *
+ * \brief Isolation between LoRa transmissions with different spreading factors.
+ *
+ * LoRa spreading factors are not perfectly orthogonal. Entry (wanted SF,
+ * interferer SF) is the isolation in dB of a transmission with the interferer
+ * SF, as seen by a receiver of the wanted SF: the interferer is as harmful as
+ * a co-SF transmission that is this much weaker. The diagonal is 0 dB.
+ *
+ * The default table is derived from the SIR thresholds measured by Croce et
+ * al., "Impact of LoRa Imperfect Orthogonality: Analysis of Link-Level
+ * Performance" (IEEE Communications Letters, 2018), as the co-SF threshold
+ * (1 dB) minus the inter-SF threshold.
+ */
+class LoRaWANInterSfRejection
+{
+public:
+  /**
+   * The number of spreading factors in the table, SF7 to SF12.
+   */
+  static const uint32_t N_SPREADING_FACTORS = 6;
+
+  /**
+   * Create the default table.
+   */
+  LoRaWANInterSfRejection ();
+
+  /**
+   * Set the table from a string of N_SPREADING_FACTORS x N_SPREADING_FACTORS
+   * isolations in dB, row by row, rows for the wanted SF7 to SF12 and columns
+   * for the interfering SF7 to SF12. "default" selects the default table.
+   *
+   * \param table the table
+   * \return false, and leaves the table untouched, if the string does not
+   * hold a valid table
+   */
+  bool Parse (const std::string &table);
+
+  /**
+   * \param table the isolations in dB, row major
+   * \return false, and leaves the table untouched, if an isolation is not
+   * finite, is negative, or is not 0 on the diagonal
+   */
+  bool Set (const double table[N_SPREADING_FACTORS][N_SPREADING_FACTORS]);
+
+  /**
+   * \param wanted the spreading factor of the receiver
+   * \param interferer the spreading factor of the interferer
+   * \return the isolation in dB
+   */
+  double GetIsolationDb (uint8_t wanted, uint8_t interferer) const;
+
+  /**
+   * \param wanted the spreading factor of the receiver
+   * \param interferer the spreading factor of the interferer
+   * \return the linear factor the power of the interferer is multiplied with
+   */
+  double GetGain (uint8_t wanted, uint8_t interferer) const;
+
+private:
+  /**
+   * \param sf a spreading factor
+   * \return its index in the table
+   */
+  static uint32_t GetIndex (uint8_t sf);
+
+  double m_isolationDb[N_SPREADING_FACTORS][N_SPREADING_FACTORS]; //!< The isolations (dB)
+  double m_gain[N_SPREADING_FACTORS][N_SPREADING_FACTORS];        //!< The linear gains
+};
+
 /**
  * \ingroup lorawan
  *
  * \brief This class provides helper functions for LoRaWAN interference handling.
+ *
+ * The accumulated interference is kept incrementally per (band, data rate)
+ * pair, where a band of the LoRaWAN SpectrumModel corresponds to a LoRaWAN
+ * channel index. Adding or removing a signal only touches the non-zero bands
+ * of that signal, so both are O(1) in the number of active signals.
+ * Compensated (Kahan-Babuska) summation is used to keep the running sums
+ * accurate and the sums are periodically rebuilt from the active signals to
+ * flush any residual rounding error.
+ *
+ * When an inter-SF rejection table is set, a signal is also added to one
+ * running sum per (band, wanted spreading factor), attenuated by the isolation
+ * between its spreading factor and the wanted one. The interference seen by a
+ * receiver of any spreading factor is then a single lookup.
  */
 class LoRaWANInterferenceHelper : public SimpleRefCount<LoRaWANInterferenceHelper>
 {
 public:
+  /**
+   * Data rate index used for signals for which the data rate is unknown (e.g.
+   * non LoRaWAN signals).
+   */
+  static const uint8_t UNKNOWN_DATA_RATE_INDEX = 0xff;
+
   /**
    * Create a new interference helper for the given SpectrumModel.
    *
@@ -57,6 +150,16 @@ public:
    */
   bool AddSignal (Ptr<const SpectrumValue> signal);
 
+  /**
+   * Add the given signal to the set of accumulated signals and account for it
+   * under the given data rate index.
+   *
+   * \param signal the signal to be added
+   * \param dataRateIndex the data rate index of the transmission
+   * \return false, if the signal was not added, true otherwise.
+   */
+  bool AddSignal (Ptr<const SpectrumValue> signal, uint8_t dataRateIndex);
+
   /**
    * Remove the given signal to the set of accumulated signals.
    *
@@ -78,6 +181,70 @@ public:
    */
   Ptr<SpectrumValue> GetSignalPsd (void) const;
 
+  /**
+   * Get the accumulated power spectral density in a single band, without
+   * creating a SpectrumValue.
+   *
+   * \param bandIndex the index of the band (i.e. the LoRaWAN channel index)
+   * \return the sum of the signals in the band (W/Hz)
+   */
+  double GetSignalPsd (uint32_t bandIndex) const;
+
+  /**
+   * Get the accumulated power spectral density in a single band for the
+   * signals that were added with the given data rate index.
+   *
+   * \param bandIndex the index of the band (i.e. the LoRaWAN channel index)
+   * \param dataRateIndex the data rate index
+   * \return the sum of the signals in the band with that data rate (W/Hz)
+   */
+  double GetSignalPsd (uint32_t bandIndex, uint8_t dataRateIndex) const;
+
+  /**
+   * Apply the isolation between spreading factors to the accumulated signals.
+   * Signals of unknown data rate are not attenuated.
+   *
+   * \param rejection the isolation table
+   */
+  void SetInterSfRejection (const LoRaWANInterSfRejection &rejection);
+
+  /**
+   * Stop applying the isolation between spreading factors.
+   */
+  void ClearInterSfRejection (void);
+
+  /**
+   * \return true if the isolation between spreading factors is applied
+   */
+  bool HasInterSfRejection (void) const;
+
+  /**
+   * Get the accumulated power spectral density in a single band as seen by a
+   * receiver of the given data rate: every signal is attenuated by the
+   * isolation between its spreading factor and the one of the data rate. This
+   * equals GetSignalPsd (bandIndex) when no rejection table is set.
+   *
+   * \param bandIndex the index of the band (i.e. the LoRaWAN channel index)
+   * \param wantedDataRateIndex the data rate index of the receiver
+   * \return the attenuated sum of the signals in the band (W/Hz)
+   */
+  double GetRejectedSignalPsd (uint32_t bandIndex, uint8_t wantedDataRateIndex) const;
+
+  /**
+   * Get the accumulated in-band power of a single band. This is the quantity
+   * that LoRaWANSpectrumValueHelper::TotalAvgPower computes on the PSD returned
+   * by GetSignalPsd (void), but without creating any SpectrumValue.
+   *
+   * \param bandIndex the index of the band (i.e. the LoRaWAN channel index)
+   * \return the in-band power (W)
+   */
+  double GetInBandPower (uint32_t bandIndex) const;
+
+  /**
+   * \return the number of currently accumulated signals
+   */
+  uint32_t GetNSignals (void) const;
+
   /**
    * Get the SpectrumModel used by the helper.
    *
@@ -95,26 +262,131 @@ private:
    * \returns
    */
   LoRaWANInterferenceHelper& operator= (LoRaWANInterferenceHelper const &);
+
+  /**
+   * A running sum with Kahan-Babuska (Neumaier) compensation. Contrary to plain
+   * Kahan summation this also keeps the low-order bits of the smaller operand
+   * when a dominant signal is added and later removed again.
+   */
+  struct CompensatedSum
+  {
+    CompensatedSum () : sum (0.0), compensation (0.0) {}
+    /**
+     * Add a value to the sum.
+     * \param value the value to add (negative to subtract)
+     */
+    void Add (double value)
+    {
+      double t = sum + value;
+      if (std::fabs (sum) >= std::fabs (value))
+        {
+          compensation += (sum - t) + value;
+        }
+      else
+        {
+          compensation += (value - t) + sum;
+        }
+      sum = t;
+    }
+    /**
+     * \return the compensated value of the sum
+     */
+    double Get (void) const
+    {
+      return sum + compensation;
+    }
+    double sum;          //!< The running sum
+    double compensation; //!< The lost low-order bits of the sum
+  };
+
+  /**
+   * An accumulated signal.
+   */
+  struct SignalEntry
+  {
+    Ptr<const SpectrumValue> psd; //!< The PSD of the signal
+    uint8_t dataRateIndex;         //!< The data rate index of the signal
+  };
+
+  /**
+   * Add or subtract a signal to or from the running sums.
+   *
+   * \param signal the PSD of the signal
+   * \param dataRateIndex the data rate index of the signal
+   * \param sign +1.0 to add the signal, -1.0 to subtract it
+   */
+  void Accumulate (Ptr<const SpectrumValue> signal, uint8_t dataRateIndex, double sign);
+
+  /**
+   * Recompute all running sums from the set of active signals.
+   */
+  void Rebuild (void);
+
+  /**
+   * \param bandIndex the band index
+   * \param dataRateIndex the data rate index
+   * \return the index in m_dataRateSums
+   */
+  uint32_t GetSlot (uint32_t bandIndex, uint8_t dataRateIndex) const;
+
+  /**
+   * \param dataRateIndex a data rate index
+   * \return the spreading factor index of the data rate in the rejection
+   * table
+   */
+  static uint32_t GetSfSlot (uint8_t dataRateIndex);
+
   /**
    * The helpers SpectrumModel.
    */
   Ptr<const SpectrumModel> m_spectrumModel;
 
   /**
-   * The set of accumulated signals.
+   * The accumulated signals, keyed on the address of their PSD.
+   */
+  std::unordered_map<const SpectrumValue *, SignalEntry> m_signals;
+
+  /**
+   * The running sum of all accumulated signals per band.
+   */
+  std::vector<CompensatedSum> m_bandSums;
+
+  /**
+   * The running sum of all accumulated signals per (band, data rate). The last
+   * data rate slot of each band is used for signals of unknown data rate.
+   */
+  std::vector<CompensatedSum> m_dataRateSums;
+
+  /**
+   * The running sum of all accumulated signals per (band, wanted spreading
+   * factor), attenuated by the rejection table. Empty without rejection.
+   */
+  std::vector<CompensatedSum> m_rejectedSums;
+
+  /**
+   * The gain applied to a signal per (wanted spreading factor, data rate slot).
+   */
+  std::vector<double> m_rejectionGains;
+
+  /**
+   * The width of each band (Hz).
+   */
+  std::vector<double> m_bandWidths;
+
+  /**
+   * The number of data rate slots per band.
    */
-  std::set<Ptr<const SpectrumValue> > m_signals;
+  uint32_t m_nDataRateSlots;
 
   /**
-   * The precomputed sum of all accumulated signals.
+   * The number of removals since the last rebuild of the running sums.
    */
-  mutable Ptr<SpectrumValue> m_signal;
+  uint32_t m_removalsSinceRebuild;
 
   /**
-   * Mark m_signal as dirty, whenever a signal is added or removed. m_signal has
-   * to be recomputed before next use.
+   * The number of removals after which the running sums are rebuilt.
    */
-  mutable bool m_dirty;
+  static const uint32_t REBUILD_INTERVAL = 1024;
 };
 
 }
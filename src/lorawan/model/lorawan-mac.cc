@@ -27,6 +27,11 @@
 #include <ns3/packet.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <ns3/boolean.h>
+
+#include <algorithm>
 
 namespace ns3 {
 
@@ -34,7 +39,9 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANMac");
 
 NS_OBJECT_ENSURE_REGISTERED (LoRaWANMac);
 
-const uint8_t LoRaWANMac::maxMACPayloadSize[] = {59, 59, 59, 123, 230, 230, 230}; // we don't take the FSK row (for DR7) into account
+// NS_OBJECT_ENSURE_REGISTERED does not take a nested class name
+typedef LoRaWANMac::LoRaWANMacRDC LoRaWANMacRDC;
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANMacRDC);
 
 std::ostream&
 operator<< (std::ostream& os, const LoRaWANDataRequestParams& p)
@@ -58,6 +65,19 @@ LoRaWANMac::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANMac> ()
+    .AddAttribute ("TxQueueDepth",
+                   "The number of frames the transmit queue can hold, 0 for no limit",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANMac::SetTxQueueDepth,
+                                         &LoRaWANMac::GetTxQueueDepth),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TxQueueOverflowPolicy",
+                   "What to do with a new frame when the transmit queue is full",
+                   EnumValue (LORAWAN_TXQ_DROP_TAIL),
+                   MakeEnumAccessor (&LoRaWANMac::m_txQueueOverflowPolicy),
+                   MakeEnumChecker (LORAWAN_TXQ_DROP_TAIL, "DropTail",
+                                    LORAWAN_TXQ_DROP_OLDEST, "DropOldest",
+                                    LORAWAN_TXQ_ACK_PRIORITY, "AckPriority"))
     .AddTraceSource ("MacTxEnqueue",
                      "Trace source indicating a packet has been "
                      "enqueued in the transaction queue",
@@ -68,6 +88,15 @@ LoRaWANMac::GetTypeId (void)
                      "dequeued from the transaction queue",
                      MakeTraceSourceAccessor (&LoRaWANMac::m_macTxDequeueTrace),
                      "ns3::Packet::TracedCallback")
+    .AddTraceSource ("TxQueueOccupancy",
+                     "The number of frames in the transmit queue",
+                     MakeTraceSourceAccessor (&LoRaWANMac::m_txQueueOccupancy),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("TxQueueSojournTime",
+                     "The time a frame spent in the transmit queue, "
+                     "fired when the frame leaves the queue",
+                     MakeTraceSourceAccessor (&LoRaWANMac::m_txQueueSojournTimeTrace),
+                     "ns3::Time::TracedCallback")
     .AddTraceSource ("MacTx",
                      "Trace source indicating a packet has "
                      "arrived for transmission by this device",
@@ -145,6 +174,8 @@ LoRaWANMac::LoRaWANMac (uint8_t index) : m_index (index)
   // m_macPromiscuousMode = false;
   m_retransmission = 0;
   m_txPkt = 0;
+  m_txQueueOccupancy = 0;
+  m_txQueueOverflowPolicy = LORAWAN_TXQ_DROP_TAIL;
 
   m_ackTimeOutRandomVariable = CreateObject<UniformRandomVariable> ();
 }
@@ -193,12 +224,9 @@ void
 LoRaWANMac::DoDispose ()
 {
   m_txPkt = 0;
-  for (uint32_t i = 0; i < m_txQueue.size (); i++)
-    {
-      m_txQueue[i]->txQPkt = 0;
-      delete m_txQueue[i];
-    }
-  m_txQueue.clear ();
+  m_txQueue.Clear ();
+  m_txQueueOccupancy = 0;
+  m_rdcWakeUp.Cancel ();
   m_phy = 0;
   m_dataIndicationCallback = MakeNullCallback< void, LoRaWANDataIndicationParams, Ptr<Packet> > ();
   m_dataConfirmCallback = MakeNullCallback< void, LoRaWANDataConfirmParams > ();
@@ -488,7 +516,7 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
           m_ackTimeOut.Cancel ();
           if (!m_dataConfirmCallback.IsNull ())
           { // Call callback, informing succesfull delivery of frame
-              TxQueueElement *txQElement = m_txQueue.front ();
+              TxQueueElement *txQElement = &m_txQueue.Front ();
               LoRaWANDataConfirmParams confirmParams;
               confirmParams.m_requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
               confirmParams.m_status = LORAWAN_SUCCESS;
@@ -518,6 +546,8 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
     params.m_channelIndex = channelIndex;
     params.m_dataRateIndex = dataRateIndex;
     params.m_codeRate = codeRate;
+    params.m_rssi = m_phy->GetRxRssi ();
+    params.m_snr = m_phy->GetRxSnr ();
     params.m_msgType = macHdr.getLoRaWANMsgType ();
     params.m_endDeviceAddress = frameHdr.getDevAddr (); // Note that a gateway can not access the Dev Addr due to encryption of the MACPayload
     params.m_MIC = MIC;
@@ -557,7 +587,7 @@ LoRaWANMac::SetTRXStateConfirm (LoRaWANPhyEnumeration status)
       Ptr<Packet> p = m_txPkt;
 
       // Get airtime for TX of PHY frame and update RDC
-      TxQueueElement *txQElement = m_txQueue.front ();
+      TxQueueElement *txQElement = &m_txQueue.Front ();
       Time airTime = m_phy->CalculateTxTime (p->GetSize ()); // which PHY does not matter here
       uint8_t subBandIndex = LoRaWAN::m_supportedChannels [txQElement->lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex;
       m_lorawanMacRDC->UpdateRDCTimerForSubBand (subBandIndex, airTime);
@@ -602,7 +632,7 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 {
   NS_ASSERT (m_LoRaWANMacState == MAC_TX);
 
-  NS_LOG_FUNCTION (this << status << m_txQueue.size ());
+  NS_LOG_FUNCTION (this << status << m_txQueue.GetSize ());
 
   NS_ASSERT (m_txPkt);
   LoRaWANMacHeader macHdr;
@@ -614,8 +644,8 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 
   if (status == LORAWAN_PHY_SUCCESS)
     {
-      NS_ASSERT_MSG (m_txQueue.size () > 0, "TxQsize = 0");
-      TxQueueElement *txQElement = m_txQueue.front ();
+      NS_ASSERT_MSG (m_txQueue.GetSize () > 0, "TxQsize = 0");
+      TxQueueElement *txQElement = &m_txQueue.Front ();
       // As no Ack is comming, notify upper layer that packet was sent and check if packet can be removed from queue
       if (!macHdr.IsConfirmed ())
       {
@@ -745,21 +775,47 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
   }
 
   // Check length of MACPayload
-  if (p->GetSize () > maxMACPayloadSize[params.m_loraWANDataRateIndex]) {
-    NS_LOG_ERROR (this << " Requested to transmit MACPayload with length = " << p->GetSize () << ", maxiumum size is limited to " << maxMACPayloadSize[params.m_loraWANDataRateIndex] << " for DataRate " << params.m_loraWANDataRateIndex);
+  const uint8_t maxMACPayloadSize = LoRaWAN::GetMaxMACPayloadSize (params.m_loraWANDataRateIndex);
+  if (p->GetSize () > maxMACPayloadSize) {
+    NS_LOG_ERROR (this << " Requested to transmit MACPayload with length = " << p->GetSize () << ", maxiumum size is limited to " << (uint16_t)maxMACPayloadSize << " for DataRate " << (uint16_t)params.m_loraWANDataRateIndex);
     return;
   }
 
+  // The ACK bit is only needed to decide on an overflow
+  bool isAck = false;
+  if (m_txQueueOverflowPolicy == LORAWAN_TXQ_ACK_PRIORITY)
+    {
+      LoRaWANFrameHeader frameHdr;
+      p->PeekHeader (frameHdr);
+      isAck = frameHdr.IsAck ();
+    }
+
   // Construct Phy Payload
   Ptr<Packet> phyPayload = constructPhyPayload (params, p);
 
+  if (m_txQueue.IsFull () && !MakeRoomInTxQueue (isAck))
+    {
+      NS_LOG_DEBUG (this << " transmit queue is full (" << m_txQueue.GetCapacity () << " frames), dropping new frame");
+      m_macTxDropTrace (phyPayload);
+      if (!m_dataConfirmCallback.IsNull ())
+        {
+          LoRaWANDataConfirmParams confirmParams;
+          confirmParams.m_requestHandle = params.m_requestHandle;
+          confirmParams.m_status = LORAWAN_TRANSACTION_OVERFLOW;
+          m_dataConfirmCallback (confirmParams);
+        }
+      return;
+    }
+
   m_macTxEnqueueTrace (phyPayload);
 
   // All checks have been passed, add packet to the queue
-  TxQueueElement *txQElement = new TxQueueElement;
-  txQElement->lorawanDataRequestParams = params;
-  txQElement->txQPkt = phyPayload;
-  m_txQueue.push_back (txQElement);
+  TxQueueElement &txQElement = m_txQueue.PushBack ();
+  txQElement.lorawanDataRequestParams = params;
+  txQElement.txQPkt = phyPayload;
+  txQElement.enqueueTime = Simulator::Now ();
+  txQElement.isAck = isAck;
+  m_txQueueOccupancy = m_txQueue.GetSize ();
   /*if (m_deviceType == LORAWAN_DT_GATEWAY && params.m_loraWANDataRateIndex == 1) {
       std::cout << "DR1 packet queued on gw" << std::endl;  
   }*/
@@ -791,15 +847,20 @@ LoRaWANMac::CheckQueue ()
   // Check if we can send a packet: MAC State, Phy state and RDC
   //std::cout << "checking queue" << std::endl;
 
-  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.size());
+  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.GetSize ());
 
-  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.empty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
+  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.IsEmpty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
   {
     // Check RDC constraints for first packet in the queue
-    TxQueueElement *txQElement = m_txQueue.front ();
+    TxQueueElement *txQElement = &m_txQueue.Front ();
     int8_t subBandIndex = m_lorawanMacRDC->GetSubBandIndexForChannelIndex (txQElement->lorawanDataRequestParams.m_loraWANChannelIndex);
     NS_ASSERT (subBandIndex >= 0);
-    if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex))
+    // The air time as the PHY computes it in StartTx, see SetLoRaWANMacState
+    Time airTime = m_phy->CalculateTxTime (txQElement->txQPkt->GetSize (),
+                                           txQElement->lorawanDataRequestParams.m_loraWANChannelIndex,
+                                           txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex,
+                                           txQElement->lorawanDataRequestParams.m_loraWANCodeRate);
+    if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex, airTime))
     {
       NS_LOG_DEBUG (this << " sub band #" << (uint16_t)subBandIndex << " is available");
       /*if(m_deviceType == LORAWAN_DT_GATEWAY && txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex == 1) {
@@ -821,22 +882,20 @@ LoRaWANMac::CheckQueue ()
       
 
       if (m_deviceType != LORAWAN_DT_GATEWAY) {
-        m_lorawanMacRDC->ScheduleSubBandTimer (this, subBandIndex); // schedule RDC timer
+        WaitForSubBand (subBandIndex, airTime); // schedule RDC timer
       }
     }
   } else {
     if (m_LoRaWANMacState != MAC_IDLE) {
       NS_LOG_DEBUG (this << " Cannot sent packet because MAC is not idle, MAC state is equal to " << m_LoRaWANMacState);
-      TxQueueElement *txQElement = m_txQueue.front ();
       /*if(m_deviceType == LORAWAN_DT_GATEWAY && txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex == 1) {
           std::cout << "can't send DR1 frame from GW because mac not idle" << std::endl;
       }*/
     }
-    if (m_txQueue.empty ())
+    if (m_txQueue.IsEmpty ())
       NS_LOG_DEBUG (this << " tx queue is empty, so there is no packet to send.");
     if (m_txPkt){
       NS_LOG_DEBUG (this << " Cannot sent packet because of ongoing tx (m_txPkt is set)");
-      TxQueueElement *txQElement = m_txQueue.front ();
       /*if(m_deviceType == LORAWAN_DT_GATEWAY && txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex == 1) {
           std::cout << "can't send dr1 frame from gw because of ongoing tx" << std::endl;
       }*/
@@ -846,12 +905,22 @@ LoRaWANMac::CheckQueue ()
   }
 
   // If a gateway can not send a packet immediately, then there is no use in trying to send it later as the RW of the end device will not be open later
+  // The network server only hands a frame to a gateway that can send it (see LoRaWANNetDevice::Send), so drop the frame rather than leaving the MAC stuck with it
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    if (!m_txQueue.empty ()) {
-      // this is a dangereous state to be in, experience has shown that the gateway MACs gets stuck at this point
+    if (!m_txQueue.IsEmpty () && m_txPkt == 0) {
+      TxQueueElement *txQElement = &m_txQueue.Front ();
+      const uint32_t requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
+      m_macTxDropTrace (txQElement->txQPkt);
       this->RemoveFirstTxQElement (false);
-      //std::cout << "removing packet from queue" << std::endl;
-      NS_FATAL_ERROR (this << " Gateway is unable to send packet immediately, aborting packet transmission.");
+      NS_LOG_WARN (this << " Gateway is unable to send packet immediately, dropping packet.");
+
+      if (!m_dataConfirmCallback.IsNull ())
+      {
+        LoRaWANDataConfirmParams confirmParams;
+        confirmParams.m_requestHandle = requestHandle;
+        confirmParams.m_status = LORAWAN_CHANNEL_ACCESS_FAILURE;
+        m_dataConfirmCallback (confirmParams);
+      }
     }
   }
 }
@@ -866,7 +935,7 @@ LoRaWANMac::CheckRetransmission ()
   NS_LOG_FUNCTION (this);
 
   // The packet:
-  TxQueueElement *txQElement = m_txQueue.front ();
+  TxQueueElement *txQElement = &m_txQueue.Front ();
   NS_ASSERT (txQElement != 0);
   LoRaWANDataRequestParams params = txQElement->lorawanDataRequestParams;
 
@@ -908,11 +977,12 @@ LoRaWANMac::CheckRetransmission ()
     // TODO: frequency hopping also applies to UNC US with NbRep > 1
     int8_t subBandIndex = m_lorawanMacRDC->GetSubBandIndexForChannelIndex (params.m_loraWANChannelIndex);
     NS_ASSERT (subBandIndex >= 0);
-    if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex)) { // we can sent the next frame
+    Time airTime = m_phy->CalculateTxTime (m_txPkt->GetSize (), params.m_loraWANChannelIndex, params.m_loraWANDataRateIndex, params.m_loraWANCodeRate);
+    if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex, airTime)) { // we can sent the next frame
       m_retransmission++;
       m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_TX);
     } else {
-      m_lorawanMacRDC->ScheduleSubBandTimer (this, subBandIndex);
+      WaitForSubBand (subBandIndex, airTime);
     }
   } else {
       NS_LOG_ERROR ( this << "  called eventhough there is a mac state change scheduled.");
@@ -924,26 +994,92 @@ LoRaWANMac::RemoveFirstTxQElement (bool sentPacket)
 {
   NS_LOG_FUNCTION (this);
 
-  TxQueueElement *txQElement = m_txQueue.front ();
+  TxQueueElement *txQElement = &m_txQueue.Front ();
   Ptr<const Packet> p = txQElement->txQPkt;
 
   if (sentPacket)
     m_sentPktTrace (p, m_retransmission + 1);
 
-  txQElement->txQPkt = 0;
-  delete txQElement;
-  m_txQueue.pop_front ();
+  m_txQueueSojournTimeTrace (Simulator::Now () - txQElement->enqueueTime);
+  m_txQueue.PopFront ();
+  m_txQueueOccupancy = m_txQueue.GetSize ();
+  if (m_txQueue.IsEmpty ())
+    {
+      m_rdcWakeUp.Cancel (); // no frame is waiting for a sub band anymore
+    }
   m_txPkt = 0;
   m_retransmission = 0;
   m_macTxDequeueTrace (p);
 }
 
+bool
+LoRaWANMac::MakeRoomInTxQueue (bool isAck)
+{
+  NS_LOG_FUNCTION (this << isAck);
+
+  // The first frame can not be dropped while it is being sent
+  const uint32_t first = m_txPkt != 0 ? 1 : 0;
+  if (m_txQueueOverflowPolicy == LORAWAN_TXQ_DROP_OLDEST)
+    {
+      if (first < m_txQueue.GetSize ())
+        {
+          DropTxQElement (first);
+          return true;
+        }
+    }
+  else if (m_txQueueOverflowPolicy == LORAWAN_TXQ_ACK_PRIORITY && isAck)
+    {
+      for (uint32_t i = first; i < m_txQueue.GetSize (); i++)
+        {
+          if (!m_txQueue[i].isAck)
+            {
+              DropTxQElement (i);
+              return true;
+            }
+        }
+    }
+  return false;
+}
+
+void
+LoRaWANMac::DropTxQElement (uint32_t i)
+{
+  NS_LOG_FUNCTION (this << i);
+
+  TxQueueElement &txQElement = m_txQueue[i];
+  NS_LOG_DEBUG (this << " transmit queue is full, dropping queued frame with request handle " << (uint16_t)txQElement.lorawanDataRequestParams.m_requestHandle);
+  m_macTxDropTrace (txQElement.txQPkt);
+  if (!m_dataConfirmCallback.IsNull ())
+    {
+      LoRaWANDataConfirmParams confirmParams;
+      confirmParams.m_requestHandle = txQElement.lorawanDataRequestParams.m_requestHandle;
+      confirmParams.m_status = LORAWAN_TRANSACTION_OVERFLOW;
+      m_dataConfirmCallback (confirmParams);
+    }
+  m_txQueueSojournTimeTrace (Simulator::Now () - txQElement.enqueueTime);
+  m_txQueue.Erase (i);
+  m_txQueueOccupancy = m_txQueue.GetSize ();
+}
+
+void
+LoRaWANMac::SetTxQueueDepth (uint32_t depth)
+{
+  NS_LOG_FUNCTION (this << depth);
+  m_txQueue.SetCapacity (depth);
+}
+
+uint32_t
+LoRaWANMac::GetTxQueueDepth (void) const
+{
+  return m_txQueue.GetCapacity ();
+}
+
 bool
 LoRaWANMac::ConfigurePhyForTX () {
   NS_LOG_FUNCTION (this);
 
   if (m_txPkt != 0) {
-    TxQueueElement *txQElement = m_txQueue.front ();
+    TxQueueElement *txQElement = &m_txQueue.Front ();
     // Select and configure PHY
     uint8_t channelIndex = txQElement->lorawanDataRequestParams.m_loraWANChannelIndex;
     uint8_t dataRateIndex = txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex;
@@ -1006,6 +1142,33 @@ LoRaWANMac::SubBandTimerCallback ()
     CheckQueue ();
   }
 }
+
+void
+LoRaWANMac::WaitForSubBand (uint8_t subBandIndex, Time airTime)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)subBandIndex << airTime);
+
+  if (!m_lorawanMacRDC->IsLazy ())
+    {
+      m_lorawanMacRDC->ScheduleSubBandTimer (this, subBandIndex, airTime);
+      return;
+    }
+
+  // A lazy RDC object keeps no timers: the MAC wakes itself up once, when the
+  // sub band of its first queued frame becomes available
+  Time available = m_lorawanMacRDC->GetSubBandAvailableTime (subBandIndex, airTime);
+  NS_ASSERT (available > Simulator::Now ());
+  if (m_rdcWakeUp.IsRunning ())
+    {
+      if (Simulator::Now () + Simulator::GetDelayLeft (m_rdcWakeUp) == available)
+        {
+          return;
+        }
+      m_rdcWakeUp.Cancel ();
+    }
+  m_rdcWakeUp = Simulator::Schedule (available - Simulator::Now (), &LoRaWANMac::SubBandTimerCallback, this);
+  NS_LOG_LOGIC (this << " waking up at " << available << " for subBand #" << (uint16_t)subBandIndex);
+}
 void
 LoRaWANMac::OpenRW ()
 {
@@ -1014,9 +1177,9 @@ LoRaWANMac::OpenRW ()
   NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A);
 
   if (m_LoRaWANMacState == MAC_RW1) {
-    // RW1 uses the same channel as the preceding uplink
+    // RW1 uses the same channel as the preceding uplink, or a channel derived from it (e.g. US902-928)
     // The data rate is a function of the uplink data rate and the RX1DROffset
-    uint8_t channelIndex = m_phy->GetCurrentChannelIndex ();
+    uint8_t channelIndex = LoRaWAN::GetRX1ChannelIndex (m_phy->GetCurrentChannelIndex ());
     uint8_t dataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_phy->GetCurrentDataRateIndex (), m_RX1DROffset);
 
     uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
@@ -1174,26 +1337,69 @@ LoRaWANMac::AckTimeoutExpired ()
 }
 
 // LoRaWANMacRDC class implementation:
-LoRaWANMac::LoRaWANMacRDC::LoRaWANMacRDC (void) {
-  // init sub bands, EU868
-  LoRaWANSubBand g0 = {100, 14, Time (), Time ()}; // g(Note 7), 14dBm?
-  LoRaWANSubBand g1 = {100, 14, Time (), Time ()}; // 1%
-  LoRaWANSubBand g2 = {1000, 14, Time (), Time ()}; // 0.1%
-  LoRaWANSubBand g3 = {10, 27, Time (), Time ()}; // 10%, high power subband
-  LoRaWANSubBand g4 = {100, 14, Time (), Time ()}; // 1%
-
-  this->m_subBands.push_back (g0);
-  this->m_subBands.push_back (g1);
-  this->m_subBands.push_back (g2);
-  this->m_subBands.push_back (g3);
-  this->m_subBands.push_back (g4);
-
-  // init sub band timers:
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
+TypeId
+LoRaWANMac::LoRaWANMacRDC::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANMacRDC")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANMacRDC> ()
+    .AddAttribute ("LazyAvailability",
+                   "Compute the availability of the sub bands on demand, "
+                   "without scheduling sub band timers. The MACs then only "
+                   "wake up for a blocked sub band while they have a frame queued.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANMacRDC::m_lazy),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DutyCycleWindow",
+                   "Account the duty cycle over a sliding window of this length "
+                   "(e.g. one hour), instead of imposing an off time after every frame. "
+                   "Zero selects the off time.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&LoRaWANMacRDC::m_window),
+                   MakeTimeChecker (Seconds (0)))
+  ;
+  return tid;
+}
+
+LoRaWANMac::LoRaWANMacRDC::LoRaWANMacRDC (void) : m_lazy (false) {
+  // init sub bands and their timers from the region plan
+  LoRaWAN::AcquireRegion ();
+  const LoRaWANRegionPlan &plan = LoRaWAN::GetRegionPlan (LoRaWAN::GetRegion ());
+  for (uint8_t i = 0; i < plan.nSubBands; i++) {
+    LoRaWANSubBand subBand = {plan.subBands[i].dutyCycleLimit, plan.subBands[i].maxTXPower, Time (), Time ()};
+    this->m_subBands.push_back (subBand);
+  }
+  this->m_subBandTimers.resize (m_subBands.size ());
+  this->m_transmissions.resize (m_subBands.size ());
+}
+
+LoRaWANMac::LoRaWANMacRDC::~LoRaWANMacRDC (void)
+{
+  LoRaWAN::ReleaseRegion ();
+}
+
+void
+LoRaWANMac::LoRaWANMacRDC::DoDispose (void)
+{
+  for (std::vector<EventId>::iterator it = m_subBandTimers.begin (); it != m_subBandTimers.end (); ++it)
+    {
+      it->Cancel ();
+    }
+  m_transmissions.clear ();
+  Object::DoDispose ();
+}
+
+bool
+LoRaWANMac::LoRaWANMacRDC::IsLazy (void) const
+{
+  return m_lazy;
+}
+
+Time
+LoRaWANMac::LoRaWANMacRDC::GetDutyCycleWindow (void) const
+{
+  return m_window;
 }
 
 int8_t
@@ -1213,9 +1419,12 @@ LoRaWANMac::LoRaWANMacRDC::GetMaxPowerForSubBand (uint8_t subBandIndex) const
 }
 
 bool
-LoRaWANMac::LoRaWANMacRDC::IsSubBandAvailable (uint8_t subBandIndex) const
+LoRaWANMac::LoRaWANMacRDC::IsSubBandAvailable (uint8_t subBandIndex, Time airTime) const
 {
-  NS_LOG_FUNCTION (this << (uint16_t)subBandIndex);
+  NS_LOG_FUNCTION (this << (uint16_t)subBandIndex << airTime);
+
+  if (!m_window.IsZero ())
+    return GetSubBandAvailableTime (subBandIndex, airTime) <= Simulator::Now ();
 
   if (m_subBands[subBandIndex].timeoff == 0) // when sending for the first time on this sub band timeoff will be zero, so then the sub band is always available
     return true;
@@ -1228,13 +1437,73 @@ LoRaWANMac::LoRaWANMacRDC::IsSubBandAvailable (uint8_t subBandIndex) const
   return result;
 }
 
+Time
+LoRaWANMac::LoRaWANMacRDC::GetSubBandAvailableTime (uint8_t subBandIndex, Time airTime) const
+{
+  NS_LOG_FUNCTION (this << (uint16_t)subBandIndex << airTime);
+
+  return ComputeSubBandAvailableTime (m_subBands[subBandIndex], m_transmissions[subBandIndex], m_window, airTime);
+}
+
+Time
+LoRaWANMac::LoRaWANMacRDC::ComputeSubBandAvailableTime (const LoRaWANSubBand &subBand, TransmissionList &transmissions, Time window, Time airTime)
+{
+  const Time now = Simulator::Now ();
+  if (window.IsZero ())
+    {
+      Time available = subBand.LastTxFinishedTimestamp + subBand.timeoff;
+      return available > now ? available : now;
+    }
+
+  // Sliding window: the air time of the transmissions in the window ending
+  // at the send time, plus that of the new frame, may not exceed the budget
+  ExpireTransmissions (transmissions, window);
+  const Time windowStart = now - window;
+  const Time budget = NanoSeconds (window.GetNanoSeconds () / subBand.dutyCycleLimit);
+
+  Time excess = airTime - budget;
+  for (TransmissionList::const_iterator it = transmissions.begin (); it != transmissions.end (); ++it)
+    {
+      excess += it->second - std::max (it->first, windowStart);
+    }
+  if (!excess.IsStrictlyPositive ())
+    {
+      return now;
+    }
+
+  // As the window slides forward, the oldest transmissions leave it
+  for (TransmissionList::const_iterator it = transmissions.begin (); it != transmissions.end (); ++it)
+    {
+      Time start = std::max (it->first, windowStart);
+      if (it->second - start >= excess)
+        {
+          return start + excess + window;
+        }
+      excess -= it->second - start;
+    }
+
+  // The frame alone exceeds the budget, it has to wait for an empty window
+  NS_LOG_WARN ("Air time " << airTime << " exceeds the duty cycle budget " << budget << " of the sub band");
+  return transmissions.empty () ? now : transmissions.back ().second + window;
+}
+
 void
-LoRaWANMac::LoRaWANMacRDC::ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex)
+LoRaWANMac::LoRaWANMacRDC::ExpireTransmissions (TransmissionList &transmissions, Time window)
 {
-  NS_LOG_FUNCTION (this << static_cast<int> (subBandIndex));
+  const Time windowStart = Simulator::Now () - window;
+  while (!transmissions.empty () && transmissions.front ().second <= windowStart)
+    {
+      transmissions.pop_front ();
+    }
+}
+
+void
+LoRaWANMac::LoRaWANMacRDC::ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex, Time airTime)
+{
+  NS_LOG_FUNCTION (this << static_cast<int> (subBandIndex) << airTime);
 
   if (!m_subBandTimers[subBandIndex].IsRunning ()) {
-    Time subBandAvailable = m_subBands[subBandIndex].LastTxFinishedTimestamp + m_subBands[subBandIndex].timeoff;
+    Time subBandAvailable = GetSubBandAvailableTime (subBandIndex, airTime);
     // As Simulator::Schedule expects a delay as its time argument we need to subtract Simulator::now() from SubBandAvailable
     Time delay = subBandAvailable  - Simulator::Now ();
     NS_ASSERT (delay > 0); // if equal to zero, then ns3 will get stuck in a loop checking whether the band available ...
@@ -1260,16 +1529,25 @@ LoRaWANMac::LoRaWANMacRDC::UpdateRDCTimerForSubBand (uint8_t subBandIndex, Time
 {
   NS_LOG_FUNCTION (this << (uint16_t)subBandIndex << airTime);
 
-  // Assume that this function is called before the frame is transmitted, i.e. the transmission starts at Simulator::Now ()
-  Time LastTxFinishedTimestamp = Simulator::Now () + airTime;
-  Time timeoff = airTime*m_subBands[subBandIndex].dutyCycleLimit - airTime;
-
-  m_subBands[subBandIndex].LastTxFinishedTimestamp = LastTxFinishedTimestamp;
-  m_subBands[subBandIndex].timeoff = timeoff;
+  RecordSubBandTransmission (m_subBands[subBandIndex], m_transmissions[subBandIndex], m_window, airTime);
 
   NS_LOG_LOGIC (this << " updated RDC for subBand " << (uint16_t)subBandIndex << ": "
-                     << LastTxFinishedTimestamp << ", "
-                     << timeoff);
+                     << m_subBands[subBandIndex].LastTxFinishedTimestamp << ", "
+                     << m_subBands[subBandIndex].timeoff);
+}
+
+void
+LoRaWANMac::LoRaWANMacRDC::RecordSubBandTransmission (LoRaWANSubBand &subBand, TransmissionList &transmissions, Time window, Time airTime)
+{
+  // Assume that this function is called before the frame is transmitted, i.e. the transmission starts at Simulator::Now ()
+  subBand.LastTxFinishedTimestamp = Simulator::Now () + airTime;
+  subBand.timeoff = airTime*subBand.dutyCycleLimit - airTime;
+
+  if (!window.IsZero ())
+    {
+      ExpireTransmissions (transmissions, window);
+      transmissions.push_back (std::make_pair (Simulator::Now (), subBand.LastTxFinishedTimestamp));
+    }
 }
 
 int64_t
@@ -22,6 +22,7 @@
 
 #include "lorawan.h"
 #include "lorawan-phy.h"
+#include "lorawan-ring-queue.h"
 #include <ns3/object.h>
 #include <ns3/traced-callback.h>
 #include <ns3/traced-value.h>
@@ -29,6 +30,7 @@
 #include <ns3/nstime.h>
 #include <ns3/event-id.h>
 #include <ns3/timer.h>
+
 #include <deque>
 
 // Default settings for EU863-870
@@ -91,9 +93,23 @@ typedef struct LoRaWANSubBand {
 typedef enum
 {
   LORAWAN_SUCCESS                = 0,
+  LORAWAN_TRANSACTION_OVERFLOW   = 1,
   LORAWAN_NO_ACK                 = 2,
+  LORAWAN_CHANNEL_ACCESS_FAILURE = 3, //!< A gateway could not send the frame immediately
 } LoRaWANMcpsDataConfirmStatus;
 
+/**
+ * \ingroup lorawan
+ *
+ * What the MAC does with a new frame when its transmit queue is full
+ */
+typedef enum
+{
+  LORAWAN_TXQ_DROP_TAIL,    //!< Drop the new frame
+  LORAWAN_TXQ_DROP_OLDEST,  //!< Drop the oldest frame that is not being sent
+  LORAWAN_TXQ_ACK_PRIORITY, //!< Drop the oldest frame without ACK bit that is not being sent for a new frame with ACK bit, otherwise drop the new frame
+} LoRaWANTxQueueOverflowPolicy;
+
 /**
  * \ingroup lorawan
  *
@@ -133,6 +149,8 @@ struct LoRaWANDataIndicationParams
   uint8_t m_channelIndex;		//!< Channel index of received transmission
   uint8_t m_dataRateIndex;		//!< Data rate index of received transmission
   uint8_t m_codeRate;			//!< Code rate of received transmission
+  double m_rssi;			//!< RSSI of received transmission in dBm
+  double m_snr;				//!< SNR of received transmission in dB
 
   LoRaWANMsgType m_msgType; 		//!< Message Type
   Ipv4Address m_endDeviceAddress; 	//!< End Device Address
@@ -196,23 +214,120 @@ public:
   class LoRaWANMacRDC : public Object
   {
   public:
+    /**
+     * Get the type ID.
+     *
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
     LoRaWANMacRDC (void);
+    virtual ~LoRaWANMacRDC (void);
 
     int8_t GetSubBandIndexForChannelIndex (uint8_t channelIndex) const;
     int8_t GetMaxPowerForSubBand (uint8_t subBandIndex) const;
-    bool IsSubBandAvailable (uint8_t subBandIndex) const;
+
+    /**
+     * \param subBandIndex the sub band
+     * \param airTime the air time of the next frame, only used for the
+     * sliding window accounting
+     * \return true if a frame can be sent on the sub band now
+     */
+    bool IsSubBandAvailable (uint8_t subBandIndex, Time airTime = Time ()) const;
+
+    /**
+     * Compute when a frame can be sent on a sub band, from the transmissions
+     * on the sub band so far.
+     *
+     * \param subBandIndex the sub band
+     * \param airTime the air time of the next frame, only used for the
+     * sliding window accounting
+     * \return the earliest time, not before now, at which the frame can be sent
+     */
+    Time GetSubBandAvailableTime (uint8_t subBandIndex, Time airTime = Time ()) const;
+
+    /**
+     * \return true if the MACs have to wake themselves up for blocked sub
+     * bands, instead of relying on the sub band timers of this object
+     */
+    bool IsLazy (void) const;
+
+    /**
+     * \return the duty cycle window, zero for an off time after every frame
+     */
+    Time GetDutyCycleWindow (void) const;
 
     void UpdateRDCTimerForSubBand (uint8_t subBandIndex, Time airTime);
 
-    void ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex);
+    /**
+     * The (start, end) times of the transmissions on a sub band.
+     */
+    typedef std::deque<std::pair<Time, Time> > TransmissionList;
+
+    /**
+     * Compute when a frame can be sent on a sub band, from the RDC state of
+     * the sub band. GetSubBandAvailableTime and LoRaWANEndDevicePopulation
+     * both account the duty cycle with this function.
+     *
+     * \param subBand the duty cycle limit and off time of the sub band
+     * \param transmissions the transmissions on the sub band, only used
+     * with a duty cycle window
+     * \param window the duty cycle window, zero for the off time
+     * \param airTime the air time of the next frame, only used with a duty
+     * cycle window
+     * \return the earliest time, not before now, at which the frame can be sent
+     */
+    static Time ComputeSubBandAvailableTime (const LoRaWANSubBand &subBand, TransmissionList &transmissions, Time window, Time airTime);
+
+    /**
+     * Update the RDC state of a sub band for a frame that is sent now, as
+     * UpdateRDCTimerForSubBand does.
+     *
+     * \param subBand the duty cycle limit and off time of the sub band
+     * \param transmissions the transmissions on the sub band, only used
+     * with a duty cycle window
+     * \param window the duty cycle window, zero for the off time
+     * \param airTime the air time of the frame
+     */
+    static void RecordSubBandTransmission (LoRaWANSubBand &subBand, TransmissionList &transmissions, Time window, Time airTime);
+
+    void ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex, Time airTime = Time ());
     void SubBandTimerExpired (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex);
   private:
+    // Inherited from Object.
+    virtual void DoDispose (void);
+
+    /**
+     * Forget the transmissions that left the duty cycle window.
+     *
+     * \param transmissions the transmissions on a sub band
+     * \param window the duty cycle window
+     */
+    static void ExpireTransmissions (TransmissionList &transmissions, Time window);
+
     /**
      * The RDC limitations per sub-band
      */
     std::vector<LoRaWANSubBand> m_subBands;
 
     std::vector<EventId> m_subBandTimers;
+
+    /**
+     * Whether the availability of the sub bands is only computed on demand,
+     * without sub band timers.
+     */
+    bool m_lazy;
+
+    /**
+     * The duty cycle window, zero to impose an off time after every frame.
+     */
+    Time m_window;
+
+    /**
+     * The (start, end) times of the transmissions in the duty cycle window,
+     * per sub band.
+     */
+    mutable std::vector<TransmissionList> m_transmissions;
   };
 
   /**
@@ -330,10 +445,47 @@ protected:
   void CheckRetransmission ();
   void RemoveFirstTxQElement (bool sentPacket);
 
+  /**
+   * Apply the overflow policy to make room in the full transmit queue.
+   *
+   * \param isAck whether the new frame has the ACK bit set
+   * \return true if a queued frame was dropped
+   */
+  bool MakeRoomInTxQueue (bool isAck);
+
+  /**
+   * Drop a queued frame that is not being sent because of a queue overflow.
+   *
+   * \param i the position of the frame in the transmit queue
+   */
+  void DropTxQElement (uint32_t i);
+
+  /**
+   * Set the number of frames the transmit queue can hold. Only allowed while
+   * the queue is empty.
+   *
+   * \param depth the number of frames, 0 for no limit
+   */
+  void SetTxQueueDepth (uint32_t depth);
+
+  /**
+   * \return the number of frames the transmit queue can hold
+   */
+  uint32_t GetTxQueueDepth (void) const;
+
   bool ConfigurePhyForTX ();
 
   void SubBandTimerCallback ();
 
+  /**
+   * Wait for a sub band to become available for the first frame in the
+   * transmit queue.
+   *
+   * \param subBandIndex the sub band
+   * \param airTime the air time of the frame
+   */
+  void WaitForSubBand (uint8_t subBandIndex, Time airTime);
+
   void OpenRW ();
   void CloseRW ();
   void CheckPhyPreamble ();
@@ -370,6 +522,17 @@ private:
    */
   TracedCallback<Ptr<const Packet> > m_macTxDequeueTrace;
 
+  /**
+   * The number of frames in the transmit queue.
+   */
+  TracedValue<uint32_t> m_txQueueOccupancy;
+
+  /**
+   * The trace source fired with the time a frame spent in the transmit queue,
+   * when it leaves the queue.
+   */
+  TracedCallback<Time> m_txQueueSojournTimeTrace;
+
   /**
    * The trace source fired when packets are being sent down to L1.
    *
@@ -427,11 +590,6 @@ private:
    */
   Ptr<LoRaWANMacRDC> m_lorawanMacRDC;
 
-  /*
-   * Maximum MACPayload size length as per $7.1.6
-   */
-  const static uint8_t maxMACPayloadSize[]; // defined for LoRaWAN DR0 to DR7
-
   /**
    * The type of device: End Device or Gateway
    */
@@ -478,12 +636,19 @@ private:
   {
     LoRaWANDataRequestParams lorawanDataRequestParams; //!< Data request Params
     Ptr<Packet> txQPkt;    //!< Queued packet
+    Time enqueueTime;      //!< Time the packet was queued
+    bool isAck;            //!< Whether the ACK bit of the packet is set
   };
 
   /**
    * The transmit queue used by the MAC.
    */
-  std::deque<TxQueueElement*> m_txQueue;
+  LoRaWANRingQueue<TxQueueElement> m_txQueue;
+
+  /**
+   * What to do with a new frame when m_txQueue is full.
+   */
+  LoRaWANTxQueueOverflowPolicy m_txQueueOverflowPolicy;
 
   /**
    * The packet which is currently being sent by the MAC layer.
@@ -518,6 +683,12 @@ private:
    */
   EventId m_ackTimeOut;
 
+  /**
+   * Scheduler event for waking up the MAC when the sub band of a queued
+   * frame becomes available. Only used with a lazy RDC object.
+   */
+  EventId m_rdcWakeUp;
+
   /**
    * The Time when the last uplink bit was transmitted
    * Only used in class A end devices for calculating the start of RW1 and RW2
@@ -57,6 +57,13 @@ LoRaWANNetDevice::GetTypeId (void)
                    MakePointerAccessor (&LoRaWANNetDevice::GetMac,
                                         &LoRaWANNetDevice::SetMac),
                    MakePointerChecker<LoRaWANMac> ())
+    .AddAttribute ("SharedGatewayReceiver",
+                   "Let gateways receive through a single LoRaWANGatewayReceiver "
+                   "with a limited number of demodulation paths, instead of "
+                   "attaching every gateway PHY to the channel",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANNetDevice::m_sharedGatewayReceiver),
+                   MakeBooleanChecker ())
     .AddAttribute("NbRep", "The number of repetitions for each UNC uplink message",
                    UintegerValue (1), // default value is one
                    MakeUintegerAccessor (&LoRaWANNetDevice::m_nbRep),
@@ -65,30 +72,40 @@ LoRaWANNetDevice::GetTypeId (void)
   return tid;
 }
 
-LoRaWANNetDevice::LoRaWANNetDevice () : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_configComplete(false)
-{}
+LoRaWANNetDevice::LoRaWANNetDevice () : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_configComplete(false), m_sharedGatewayReceiver (false)
+{
+  LoRaWAN::AcquireRegion ();
+}
 
 LoRaWANNetDevice::LoRaWANNetDevice (LoRaWANDeviceType deviceType)
-  : m_deviceType (deviceType), m_configComplete (false)
+  : m_deviceType (deviceType), m_configComplete (false), m_sharedGatewayReceiver (false)
 {
   NS_LOG_FUNCTION (this);
 
+  LoRaWAN::AcquireRegion ();
   if (deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
     uint8_t index = 0;
     m_phy = CreateObject<LoRaWANPhy> (index);
     m_mac = CreateObject<LoRaWANMac> (index);
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
   } else if (deviceType == LORAWAN_DT_GATEWAY) {
-    uint8_t index = 0;
-    for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++) {
-      for (uint8_t j = 0; j < LoRaWAN::m_supportedDataRates.size (); j++) {
-        index = i*LoRaWAN::m_supportedDataRates.size () + j;
+    // One phy/mac per data rate of every channel the gateway listens on (see
+    // LoRaWANRegionPlan::gatewayChannels), rather than one per channel and
+    // data rate of the region
+    const LoRaWANRegionPlan &plan = LoRaWAN::GetRegionPlan (LoRaWAN::GetRegion ());
+    m_gatewayMacIndices.assign (LoRaWAN::m_supportedChannels.size () * LoRaWAN::m_supportedDataRates.size (), -1);
+    for (uint8_t i = 0; i < plan.nGatewayChannels; i++) {
+      const LoRaWANChannel &channel = LoRaWAN::m_supportedChannels [plan.gatewayChannels[i]];
+      for (uint8_t j = channel.m_minDataRateIndex; j <= channel.m_maxDataRateIndex; j++) {
+        NS_ASSERT (m_phys.size () <= UINT8_MAX);
+        uint8_t index = m_phys.size ();
         Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (index);
         Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (index);
-        // index in std::vector is i*LoRaWAN::m_supportedDataRates.size () + j
         // phy and mac belong together
         m_phys.push_back (phy);
         m_macs.push_back (mac);
+        m_gatewayChannelDataRates.push_back (std::make_pair (channel.m_channelIndex, j));
+        m_gatewayMacIndices [channel.m_channelIndex * LoRaWAN::m_supportedDataRates.size () + j] = index;
       }
     }
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
@@ -99,6 +116,7 @@ LoRaWANNetDevice::LoRaWANNetDevice (LoRaWANDeviceType deviceType)
 LoRaWANNetDevice::~LoRaWANNetDevice ()
 {
   NS_LOG_FUNCTION (this);
+  LoRaWAN::ReleaseRegion ();
 }
 
 
@@ -119,6 +137,12 @@ LoRaWANNetDevice::DoDispose (void)
 
     m_phys.clear ();
     m_macs.clear ();
+
+    if (m_gatewayReceiver)
+      {
+        m_gatewayReceiver->Dispose ();
+        m_gatewayReceiver = 0;
+      }
   }
   m_macRDC = 0;
   m_node = 0;
@@ -197,9 +221,9 @@ LoRaWANNetDevice::CompleteConfig (void)
       NS_ASSERT(mac);
 
       // Phy: set channel and data rate for listining (using SetTxConf):
-      uint8_t channelIndex = i / LoRaWAN::m_supportedDataRates.size();
-      uint8_t dataRateIndex = i % LoRaWAN::m_supportedDataRates.size();
-      if (!phy->SetTxConf (2, channelIndex, dataRateIndex, 3, 8, false, true) ) {
+      uint8_t channelIndex = m_gatewayChannelDataRates[i].first;
+      uint8_t dataRateIndex = m_gatewayChannelDataRates[i].second;
+      if (!phy->SetTxConf (LoRaWAN::GetMinTxPower (), channelIndex, dataRateIndex, 3, 8, false, true) ) {
         NS_LOG_ERROR (this << " Phy #" << static_cast<uint16_t>(i) << ": failed setting channelIndex to " << static_cast<uint16_t>(channelIndex) << " and dataRateIndex to " << static_cast<uint16_t>(dataRateIndex));
       }
 
@@ -263,10 +287,23 @@ LoRaWANNetDevice::SetChannel (Ptr<SpectrumChannel> channel)
     m_phy->SetChannel (channel);
     channel->AddRx (m_phy);
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    for (uint8_t i = 0; i < m_phys.size (); i++) {
-      Ptr<LoRaWANPhy> phy = m_phys[i];
-      phy->SetChannel (channel);
-      channel->AddRx (phy);
+    if (m_sharedGatewayReceiver) {
+      // The PHYs only transmit on the channel, the receiver receives for all of them
+      if (!m_gatewayReceiver) {
+        m_gatewayReceiver = CreateObject<LoRaWANGatewayReceiver> ();
+        m_gatewayReceiver->SetPhys (m_phys, m_gatewayMacIndices);
+      }
+      for (uint8_t i = 0; i < m_phys.size (); i++) {
+        m_phys[i]->SetChannel (channel);
+      }
+      m_gatewayReceiver->SetChannel (channel);
+      channel->AddRx (m_gatewayReceiver);
+    } else {
+      for (uint8_t i = 0; i < m_phys.size (); i++) {
+        Ptr<LoRaWANPhy> phy = m_phys[i];
+        phy->SetChannel (channel);
+        channel->AddRx (phy);
+      }
     }
   } else {
     NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
@@ -321,6 +358,13 @@ LoRaWANNetDevice::GetPhys (void) const
     return m_phys;
   }
 }
+Ptr<LoRaWANGatewayReceiver>
+LoRaWANNetDevice::GetGatewayReceiver (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_gatewayReceiver;
+}
+
 void
 LoRaWANNetDevice::SetIfIndex (const uint32_t index)
 {
@@ -563,6 +607,14 @@ LoRaWANNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protoc
     uint8_t macIndex = 0;
     if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex)) {
       if (macIndex >= 0 && macIndex < this->m_macs.size ()) {
+        // A gateway has to send a DS frame right away, as the receive window of the end device closes soon.
+        // Refuse the frame if that is not possible, so that the network server can try another gateway.
+        // The MAC adds the MAC header and the MIC to the MACPayload.
+        const Time airTime = m_macs[macIndex]->GetPhy ()->CalculateTxTime (packet->GetSize () + 1 + 4, channelIndex, dataRateIndex, codeRate);
+        if (!CanSendImmediatelyOnChannel (channelIndex, dataRateIndex, airTime)) {
+          NS_LOG_WARN (this << " Unable to send immediately on channelIndex = " << (uint16_t)channelIndex << ", dataRateIndex = " << (uint16_t)dataRateIndex);
+          return false;
+        }
         this->m_macs[macIndex]->sendMACPayloadRequest (loRaWANDataRequestParams, packet);
         return true;
       } else {
@@ -585,7 +637,11 @@ LoRaWANNetDevice::getMACSIndexForChannelAndDataRate (uint8_t& macsIndex, uint8_t
   if (channelIndex >= LoRaWAN::m_supportedChannels.size() || dataRateIndex >= LoRaWAN::m_supportedDataRates.size())
     return false;
 
-  macsIndex = channelIndex*LoRaWAN::m_supportedDataRates.size() + dataRateIndex;
+  const int16_t index = m_gatewayMacIndices[channelIndex*LoRaWAN::m_supportedDataRates.size() + dataRateIndex];
+  if (index < 0)
+    return false; // the gateway does not listen on this channel and data rate
+
+  macsIndex = index;
   return true;
 }
 
@@ -625,13 +681,13 @@ LoRaWANNetDevice::MacEndsTx (Ptr<LoRaWANMac> macPtr)
 }
 
 bool
-LoRaWANNetDevice::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex)
+LoRaWANNetDevice::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex, Time airTime)
 {
   if (this->m_macRDC) {
     int8_t subBandIndex = this->m_macRDC->GetSubBandIndexForChannelIndex (channelIndex);
     NS_ASSERT (subBandIndex >= 0);
-    // step 1: check RDC restrictions
-    if (this->m_macRDC->IsSubBandAvailable (subBandIndex)) {
+    // step 1: check RDC restrictions, the same way LoRaWANMac::CheckQueue does
+    if (this->m_macRDC->IsSubBandAvailable (subBandIndex, airTime)) {
       uint8_t macIndex = 0;
       if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex)) {
         // step2: check whether MAC object is in Idle state (could be in TX or unavailable)
@@ -697,6 +753,8 @@ LoRaWANNetDevice::DataIndication (LoRaWANDataIndicationParams params, Ptr<Packet
   phyParamsTag.SetChannelIndex (params.m_channelIndex);
   phyParamsTag.SetDataRateIndex (params.m_dataRateIndex);
   phyParamsTag.SetCodeRate (params.m_codeRate);
+  phyParamsTag.SetRssi (params.m_rssi);
+  phyParamsTag.SetSnr (params.m_snr);
   pkt->AddPacketTag (phyParamsTag);
 
   // Add MsgTypeTag to packet
@@ -24,6 +24,7 @@
 #include <ns3/traced-callback.h>
 #include <ns3/lorawan-phy.h>
 #include <ns3/lorawan-mac.h>
+#include <ns3/lorawan-gateway-receiver.h>
 #include <ns3/lorawan.h>
 
 namespace ns3 {
@@ -68,6 +69,13 @@ public:
   Ptr<LoRaWANPhy> GetPhy (void) const;
   std::vector<Ptr<LoRaWANPhy> > GetPhys (void) const;
 
+  /**
+   * \returns the shared receiver of a gateway, or 0 if the gateway PHYs are
+   * attached to the channel individually (see the SharedGatewayReceiver
+   * attribute)
+   */
+  Ptr<LoRaWANGatewayReceiver> GetGatewayReceiver (void) const;
+
   //inherited from NetDevice base class.
   virtual void SetIfIndex (const uint32_t index);
   virtual uint32_t GetIfIndex (void) const;
@@ -98,7 +106,14 @@ public:
   void MacBeginsTx (Ptr<LoRaWANMac> macPtr);
   void MacEndsTx (Ptr<LoRaWANMac> macPtr);
 
-  bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex);
+  /**
+   * \param channelIndex the channel of the frame
+   * \param dataRateIndex the data rate of the frame
+   * \param airTime the time on air of the frame, for the sliding window duty
+   * cycle accounting of the RDC object
+   * \return true if the frame can be sent now
+   */
+  bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex, Time airTime = Time ());
 
   LoRaWANDeviceType GetDeviceType (void) const;
   // void SetDeviceType (LoRaWANDeviceType type);
@@ -161,7 +176,22 @@ private:
   Ptr<LoRaWANMac> m_mac;
   // For gateways: multiple phys/macs (note one mac per phy)
   std::vector<Ptr<LoRaWANPhy> > m_phys;
+
+  /**
+   * The receiver shared by the gateway PHYs, if any.
+   */
+  Ptr<LoRaWANGatewayReceiver> m_gatewayReceiver;
   std::vector<Ptr<LoRaWANMac> > m_macs;
+  /**
+   * For gateways: the channel and data rate index of every phy/mac.
+   */
+  std::vector<std::pair<uint8_t, uint8_t> > m_gatewayChannelDataRates;
+  /**
+   * For gateways: the index in m_phys and m_macs for channel c and data rate
+   * d at c * LoRaWAN::m_supportedDataRates.size () + d, -1 if the gateway
+   * does not listen on c and d.
+   */
+  std::vector<int16_t> m_gatewayMacIndices;
 
   Ptr<LoRaWANMac::LoRaWANMacRDC> m_macRDC;
   LoRaWANDeviceType m_deviceType;
@@ -172,6 +202,12 @@ private:
    */
   bool m_configComplete;
 
+  /**
+   * Attach a gateway to the channel with a LoRaWANGatewayReceiver instead of
+   * with all its PHYs.
+   */
+  bool m_sharedGatewayReceiver;
+
   /**
    * Configure the NetDevice to request MAC layer acknowledgments when sending
    * packets using the Send() API.
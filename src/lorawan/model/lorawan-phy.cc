@@ -20,6 +20,7 @@
 #include "lorawan-phy.h"
 #include "lorawan-spectrum-signal-parameters.h"
 #include "lorawan-spectrum-value-helper.h"
+#include "lorawan-spectrum-channel.h"
 #include "lorawan-error-model.h"
 #include "lorawan-lqi-tag.h"
 #include <ns3/log.h>
@@ -33,6 +34,11 @@
 #include <ns3/net-device.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/string.h>
+
+#include <algorithm>
+#include <limits>
 
 namespace ns3 {
 
@@ -40,6 +46,59 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANPhy");
 
 NS_OBJECT_ENSURE_REGISTERED (LoRaWANPhy);
 
+namespace {
+
+/**
+ * Number of payload symbols (including the 8 header symbols) of every
+ * combination of CRC setting, code rate, spreading factor and payload length.
+ */
+class LoRaWANPayloadSymbolTable
+{
+public:
+  LoRaWANPayloadSymbolTable ()
+  {
+    for (uint32_t crc = 0; crc < 2; crc++)
+      for (uint32_t cr = 1; cr <= 4; cr++)
+        for (uint32_t sf = LORAWAN_SF6; sf <= LORAWAN_SF12; sf++)
+          for (uint32_t length = 0; length < 256; length++)
+            {
+              // LoRaWAN mandates no imlicit header, assume low data rate optimization (DE) is not used
+              double nConditionalSymbolsPayload = ceil ((8.0*length - 4.0*sf + 28 + 16*crc)/4.0/(double)sf)*(cr + 4);
+              uint16_t nSymbolsPayload = 8;
+              if (nConditionalSymbolsPayload > 0.0)
+                nSymbolsPayload += nConditionalSymbolsPayload;
+              m_symbols[crc][cr - 1][sf - LORAWAN_SF6][length] = nSymbolsPayload;
+            }
+  }
+
+  uint16_t Get (uint8_t payloadLength, LoRaSpreadingFactor sf, uint8_t codeRate, bool crcOn) const
+  {
+    NS_ASSERT (sf >= LORAWAN_SF6 && sf <= LORAWAN_SF12);
+    NS_ASSERT (codeRate >= 1 && codeRate <= 4);
+    return m_symbols[crcOn ? 1 : 0][codeRate - 1][sf - LORAWAN_SF6][payloadLength];
+  }
+
+private:
+  uint16_t m_symbols[2][4][LORAWAN_SF12 - LORAWAN_SF6 + 1][256];
+};
+
+const LoRaWANPayloadSymbolTable &
+GetPayloadSymbolTable (void)
+{
+  static const LoRaWANPayloadSymbolTable table; // built on first use
+  return table;
+}
+
+/* the symbol period in microseconds */
+inline double
+GetSymbolPeriod (LoRaSpreadingFactor sf, uint32_t bandwidth)
+{
+  double symbolRate = ((double)bandwidth)/(double)(1u << sf);
+  return 1.0e6/symbolRate;
+}
+
+} // anonymous namespace
+
 //const m_maxPhyPayloadSize[8] = {64, 64, 64, 128, 235, 235, 235, 235};
 
 TypeId
@@ -49,6 +108,34 @@ LoRaWANPhy::GetTypeId (void)
     .SetParent<SpectrumPhy> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANPhy> ()
+    .AddAttribute ("ScalarSinr",
+                   "Compute the SINR of received packets from the cached in-band "
+                   "powers of the signals instead of from full PSD copies",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANPhy::m_scalarSinr),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SinrTimeline",
+                   "Record the interference during the reception of a packet and "
+                   "decide on its reception once at the end, per preamble, header "
+                   "and payload symbol, instead of at every interference change",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANPhy::m_sinrTimeline),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CaptureThreshold",
+                   "The minimum signal to interference ratio (dB) during the end "
+                   "of the preamble and the header of a packet, when SinrTimeline is set",
+                   DoubleValue (6.0),
+                   MakeDoubleAccessor (&LoRaWANPhy::m_captureThresholdDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("InterSfRejection",
+                   "The isolation (dB) between spreading factors applied to the "
+                   "interference: empty to treat all signals as co-SF interference, "
+                   "\"default\" for the default table, or 36 values for the wanted "
+                   "SF7 to SF12 (rows) and the interfering SF7 to SF12 (columns)",
+                   StringValue (""),
+                   MakeStringAccessor (&LoRaWANPhy::SetInterSfRejection,
+                                       &LoRaWANPhy::GetInterSfRejection),
+                   MakeStringChecker ())
     .AddTraceSource ("TrxState",
                      "The state of the transceiver",
                      MakeTraceSourceAccessor (&LoRaWANPhy::m_trxState),
@@ -93,8 +180,8 @@ LoRaWANPhy::GetTypeId (void)
 }
 
 LoRaWANPhy::LoRaWANPhy (void)
+  : LoRaWANPhy (0)
 {
-  LoRaWANPhy (0);
 }
 
 LoRaWANPhy::LoRaWANPhy (uint8_t index)
@@ -102,6 +189,7 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
 {
   NS_LOG_FUNCTION (this << index);
 
+  LoRaWAN::AcquireRegion ();
   ChangeTrxState (LORAWAN_PHY_TRX_OFF);
   //m_trxStatePending = LORAWAN_PHY_IDLE;
 
@@ -112,6 +200,10 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
   m_codeRate = 3;
   m_preambleLength = 8;
   m_crcOn = true;
+  m_scalarSinr = false;
+  m_sinrTimeline = false;
+  m_captureThresholdDb = 6.0;
+  m_sharedSignal = false;
 
   // receiver sensitivity depends on LoRa modulation parameters according to Semtech
   // However, we don't use sensitivity in our PHY modelling as we don't do any
@@ -125,6 +217,9 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
   m_noise = psdHelper.CreateNoisePowerSpectralDensity (freq);
   m_signal = Create<LoRaWANInterferenceHelper> (m_noise->GetSpectrumModel ());
   m_rxLastUpdate = Seconds (0);
+  m_rxStart = Seconds (0);
+  m_rxRssi = 0.0;
+  m_rxSnr = 0.0;
   Ptr<Packet> none_packet = 0;
   Ptr<LoRaWANSpectrumSignalParameters> none_params = 0;
   m_currentRxPacket = std::make_pair (none_params, LoRaWANPhyRxStatus (true, false));
@@ -141,6 +236,7 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
 
 LoRaWANPhy::~LoRaWANPhy (void)
 {
+  LoRaWAN::ReleaseRegion ();
 }
 
 void
@@ -259,6 +355,67 @@ LoRaWANPhy::GetErrorModel (void) const
   return m_errorModel;
 }
 
+void
+LoRaWANPhy::SetSharedInterferenceHelper (Ptr<LoRaWANInterferenceHelper> signal)
+{
+  NS_LOG_FUNCTION (this << signal);
+  NS_ASSERT (signal);
+  NS_ASSERT_MSG (m_signal->GetNSignals () == 0, "The interference helper can only be replaced while no signals are received");
+  m_signal = signal;
+  m_sharedSignal = true;
+  if (!m_interSfRejectionTable.empty ())
+    {
+      m_signal->SetInterSfRejection (m_interSfRejection);
+    }
+}
+
+bool
+LoRaWANPhy::UseInBandPower (void) const
+{
+  return m_scalarSinr || m_signal->HasInterSfRejection ();
+}
+
+void
+LoRaWANPhy::SetInterSfRejection (std::string table)
+{
+  NS_LOG_FUNCTION (this << table);
+
+  if (table.empty ())
+    {
+      m_interSfRejectionTable = table;
+      if (m_signal && !m_sharedSignal)
+        {
+          m_signal->ClearInterSfRejection ();
+        }
+      return;
+    }
+
+  if (!m_interSfRejection.Parse (table))
+    {
+      NS_FATAL_ERROR ("Invalid InterSfRejection table \"" << table << "\"");
+    }
+  m_interSfRejectionTable = table;
+  if (m_signal && !m_sharedSignal)
+    {
+      m_signal->SetInterSfRejection (m_interSfRejection);
+    }
+}
+
+std::string
+LoRaWANPhy::GetInterSfRejection (void) const
+{
+  return m_interSfRejectionTable;
+}
+
+void
+LoRaWANPhy::AddSignal (Ptr<const SpectrumValue> psd, uint8_t dataRateIndex)
+{
+  if (!m_sharedSignal)
+    {
+      m_signal->AddSignal (psd, dataRateIndex);
+    }
+}
+
 uint8_t
 LoRaWANPhy::GetIndex (void) const
 {
@@ -300,10 +457,13 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   // validate input:
   bool validConf = true;
-  if (!(power == 27 || power == 20 || power == 14 || power == 11 || power == 8 || power == 5 || power == 2)) // as per LoRaWAN $7.1.3
+  if (!LoRaWAN::IsValidTxPower (power)) // as per the regional parameters
+    validConf = false;
+
+  if (channel->m_bw != 125e3 && channel->m_bw != 500e3) // only 125KHz and 500KHz (US902-928) channels are supported for the moment
     validConf = false;
 
-  if (channel->m_bw != 125e3) // only 125KHz is supported for the moment
+  if (dataRate->bandWith == 0) // RFU data rate
     validConf = false;
 
   if (codeRate != 1 && codeRate != 2 && codeRate != 3 && codeRate != 4)
@@ -319,6 +479,15 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   m_txPower = power;
   // TODO: changing the channel should corrupt any ongoing packet reception/transmission
+  if (m_currentChannelIndex != channelIndex)
+    {
+      // Let the channel know we are now listening on another LoRaWAN channel
+      Ptr<LoRaWANSpectrumChannel> loraWanChannel = DynamicCast<LoRaWANSpectrumChannel> (m_channel);
+      if (loraWanChannel)
+        {
+          loraWanChannel->SetRxChannelIndex (this, channelIndex);
+        }
+    }
   m_currentChannelIndex = channelIndex;
   m_currentDataRateIndex = dataRateIndex;
   m_codeRate = codeRate;
@@ -530,13 +699,29 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
     return; // just do nothing
   }
 
+  if (loraWanRxParams && (UseInBandPower () || m_sinrTimeline))
+    {
+      // Cache the in-band power of the signal as received by this PHY
+      loraWanRxParams->rxPower = LoRaWANSpectrumValueHelper::TotalAvgPower ((*loraWanRxParams->psd)[m_currentChannelIndex], LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw);
+    }
+
   if (loraWanRxParams == 0 || dataRateMismatch)
     { // reception is not a LoRaWAN packet or is a LoRaWAN transmission with a different data rate
       CheckInterference ();
-      m_signal->AddSignal (spectrumRxParams->psd);
+      if (loraWanRxParams)
+        {
+          AddSignal (spectrumRxParams->psd, loraWanRxParams->dataRateIndex);
+        }
+      else
+        {
+          AddSignal (spectrumRxParams->psd);
+        }
 
       // Schedule EndRx to update m_signal when the transmission of the incoming signal has ended
-      Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+      if (!m_sharedSignal)
+        {
+          Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+        }
       return;
     }
 
@@ -571,12 +756,20 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
       NS_LOG_DEBUG (this << " channel index = " << static_cast<uint16_t>(m_currentChannelIndex));
       NS_LOG_DEBUG (this << " receiving packet with power: " << 10 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq)) + 30 << "dBm");
 
-      m_signal->AddSignal (loraWanRxParams->psd);
-      Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
-      *interferenceAndNoise -= *loraWanRxParams->psd;
-      *interferenceAndNoise += *m_noise;
+      AddSignal (loraWanRxParams->psd, loraWanRxParams->dataRateIndex);
+      double sinr_db;
+      if (UseInBandPower ())
+        {
+          sinr_db = 10.0 * log10 (loraWanRxParams->rxPower / GetInterferenceAndNoisePower (loraWanRxParams));
+        }
+      else
+        {
+          Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
+          *interferenceAndNoise -= *loraWanRxParams->psd;
+          *interferenceAndNoise += *m_noise;
 
-      double sinr_db = 10.0 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, freq));
+          sinr_db = 10.0 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, freq));
+        }
       double sinr_cutoff_db = m_errorModel->getSNRCutoffForRX (bw, sf, transmissionCodeRate);
 
       // When the BER is higher than 0.1 do not even try and decode the packet
@@ -588,6 +781,10 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
           m_phyRxBeginTrace (p);
 
           m_rxLastUpdate = Simulator::Now ();
+          m_rxStart = Simulator::Now ();
+          m_rxRssi = 10.0 * log10 (UseInBandPower () ? loraWanRxParams->rxPower : LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq)) + 30;
+          m_rxSnr = sinr_db;
+          m_rxTimeline.clear ();
         }
       else
         {
@@ -607,7 +804,7 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
       // Add the incoming packet to the current interference after we have
       // checked for successfull reception of the current packet for the time
       // before the additional interference.
-      m_signal->AddSignal (loraWanRxParams->psd);
+      AddSignal (loraWanRxParams->psd, loraWanRxParams->dataRateIndex);
     }
   else
     {
@@ -616,13 +813,16 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
       m_phyRxDropTrace (p, LORAWAN_RX_DROP_NOT_IN_RX_STATE);
 
       // Add the signal power to the interference, anyway.
-      m_signal->AddSignal (loraWanRxParams->psd);
+      AddSignal (loraWanRxParams->psd, loraWanRxParams->dataRateIndex);
     }
 
   // Always call EndRx to update the interference.
   // \todo: Do we need to keep track of these events to unschedule them when disposing off the PHY?
 
-  Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+  if (!m_sharedSignal)
+    {
+      Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+    }
 }
 
 void
@@ -632,8 +832,17 @@ LoRaWANPhy::CheckInterference (void)
   LoRaWANSpectrumValueHelper psdHelper;
   Ptr<LoRaWANSpectrumSignalParameters> currentRxParams = m_currentRxPacket.first;
 
+  if (m_trxState == LORAWAN_PHY_BUSY_RX && m_sinrTimeline)
+    {
+      // Only record the interference up to now, the packet is evaluated in EndRx
+      NS_ASSERT (currentRxParams);
+      if (Simulator::Now () > m_rxLastUpdate)
+        {
+          m_rxTimeline.push_back (std::make_pair (Simulator::Now (), GetInterferenceAndNoisePower (currentRxParams)));
+        }
+    }
   // We are currently receiving a packet.
-  if (m_trxState == LORAWAN_PHY_BUSY_RX)
+  else if (m_trxState == LORAWAN_PHY_BUSY_RX)
     {
       NS_ASSERT (currentRxParams); // && !m_currentRxPacket.second.destroyed);
 
@@ -643,11 +852,19 @@ LoRaWANPhy::CheckInterference (void)
           // How many bits did we receive since the last calculation?
           double t = (Simulator::Now () - m_rxLastUpdate).ToDouble (Time::MS);
           uint32_t chunkSize = ceil (t * (GetNominalDataRate () / 1000)); // divide by 1000, to get data rate per ms
-          Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
-          *interferenceAndNoise -= *currentRxParams->psd;
-          *interferenceAndNoise += *m_noise;
+          double sinr;
+          if (UseInBandPower ())
+            {
+              sinr = currentRxParams->rxPower / GetInterferenceAndNoisePower (currentRxParams);
+            }
+          else
+            {
+              Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
+              *interferenceAndNoise -= *currentRxParams->psd;
+              *interferenceAndNoise += *m_noise;
 
-          double sinr = LoRaWANSpectrumValueHelper::TotalAvgPower (currentRxParams->psd, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc);
+              sinr = LoRaWANSpectrumValueHelper::TotalAvgPower (currentRxParams->psd, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc);
+            }
           double sinr_db = 10.0*log10(sinr);
 
           const uint8_t transmissionDataRateIndex = currentRxParams->dataRateIndex;
@@ -679,6 +896,115 @@ LoRaWANPhy::CheckInterference (void)
   m_rxLastUpdate = Simulator::Now ();
 }
 
+double
+LoRaWANPhy::GetInterferenceAndNoisePower (Ptr<const LoRaWANSpectrumSignalParameters> params) const
+{
+  // Without InterSfRejection these are the same operations, in the same order,
+  // as on the full PSD copy: the result is bit-identical to
+  // TotalAvgPower (GetSignalPsd () - psd + noise)
+  double interferenceAndNoise = m_signal->GetRejectedSignalPsd (m_currentChannelIndex, params->dataRateIndex);
+  interferenceAndNoise -= (*params->psd)[m_currentChannelIndex];
+  interferenceAndNoise += (*m_noise)[m_currentChannelIndex];
+
+  return LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw);
+}
+
+void
+LoRaWANPhy::EvaluateRxTimeline (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<LoRaWANSpectrumSignalParameters> currentRxParams = m_currentRxPacket.first;
+  NS_ASSERT (currentRxParams);
+  if (m_errorModel == 0)
+    {
+      NS_LOG_WARN ("Missing ErrorModel");
+      return;
+    }
+
+  const uint8_t transmissionDataRateIndex = currentRxParams->dataRateIndex;
+  const uint8_t transmissionCodeRate = currentRxParams->codeRate;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [transmissionDataRateIndex].spreadingFactor;
+  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
+
+  // All times in microseconds, relative to the start of the reception
+  const double symbolPeriod = GetSymbolPeriod (sf, bandwidth);
+  const double preambleEnd = (m_preambleLength + 4.25) * symbolPeriod;
+  const double lockStart = std::max (0.0, preambleEnd - PREAMBLE_LOCK_SYMBOLS * symbolPeriod);
+  const double headerEnd = preambleEnd + HEADER_SYMBOLS * symbolPeriod;
+  const double frameEnd = currentRxParams->duration.ToDouble (Time::US);
+  const uint32_t nDataSymbols = std::max (0.0, round ((frameEnd - preambleEnd) / symbolPeriod));
+
+  const double signalPower = currentRxParams->rxPower;
+  const double noisePower = LoRaWANSpectrumValueHelper::TotalAvgPower ((*m_noise)[m_currentChannelIndex], bandwidth);
+
+  LoRaWANLqiTag tag (std::numeric_limits<uint8_t>::max ());
+  Ptr<Packet> currentPacket = currentRxParams->packet;
+  currentPacket->PeekPacketTag (tag);
+
+  std::vector<double> symbolSinr (nDataSymbols, std::numeric_limits<double>::infinity ());
+  double segmentStart = 0.0;
+  for (std::vector<std::pair<Time, double> >::const_iterator it = m_rxTimeline.begin (); it != m_rxTimeline.end (); ++it)
+    {
+      const double segmentEnd = (it->first - m_rxStart).ToDouble (Time::US);
+      const double interferencePower = it->second - noisePower;
+
+      // Capture: the receiver loses the frame when an interferer is too strong
+      // while it locks onto the preamble or decodes the header
+      if (segmentEnd > lockStart && segmentStart < headerEnd && interferencePower > 0.0
+          && 10.0 * log10 (signalPower / interferencePower) < m_captureThresholdDb)
+        {
+          NS_LOG_DEBUG (this << " preamble or header not captured, sir = " << 10.0 * log10 (signalPower / interferencePower) << "dB");
+          tag.Set (0);
+          currentPacket->ReplacePacketTag (tag);
+          m_currentRxPacket.second.destroyed = true;
+          return;
+        }
+
+      // The header and payload symbols overlapping this segment
+      const double sinr = signalPower / it->second;
+      const double dataStart = std::max (segmentStart, preambleEnd) - preambleEnd;
+      const double dataEnd = segmentEnd - preambleEnd;
+      if (dataEnd > dataStart)
+        {
+          const uint32_t first = std::min<double> (nDataSymbols, floor (dataStart / symbolPeriod));
+          const uint32_t last = std::min<double> (nDataSymbols, ceil (dataEnd / symbolPeriod));
+          for (uint32_t i = first; i < last; i++)
+            {
+              symbolSinr[i] = std::min (symbolSinr[i], sinr);
+            }
+        }
+      segmentStart = segmentEnd;
+    }
+
+  // One error model lookup per run of symbols with the same SINR
+  double successRate = 1.0;
+  uint32_t i = 0;
+  while (i < nDataSymbols)
+    {
+      uint32_t j = i + 1;
+      while (j < nDataSymbols && symbolSinr[j] == symbolSinr[i])
+        {
+          j++;
+        }
+      if (symbolSinr[i] != std::numeric_limits<double>::infinity ())
+        {
+          successRate *= m_errorModel->GetChunkSuccessRate (10.0 * log10 (symbolSinr[i]), (j - i) * sf, LoRaWAN::m_supportedDataRates [transmissionDataRateIndex].bandWith, sf, transmissionCodeRate);
+        }
+      i = j;
+    }
+
+  // The LQI is the total packet success rate scaled to 0-255.
+  uint8_t lqi = tag.Get ();
+  tag.Set (lqi * successRate);
+  currentPacket->ReplacePacketTag (tag);
+
+  if (m_random->GetValue () < 1.0 - successRate)
+    {
+      m_currentRxPacket.second.destroyed = true;
+    }
+}
+
 void
 LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
 {
@@ -690,10 +1016,17 @@ LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
   if (currentRxParams == params)
     {
       CheckInterference ();
+      if (m_sinrTimeline && m_trxState == LORAWAN_PHY_BUSY_RX && !m_currentRxPacket.second.aborted)
+        {
+          EvaluateRxTimeline ();
+        }
     }
 
   // Update the interference.
-  m_signal->RemoveSignal (par->psd);
+  if (!m_sharedSignal)
+    {
+      m_signal->RemoveSignal (par->psd);
+    }
 
   // Check whether EndRx is called for the end of LoRaWAN TX with different data rate:
   bool dataRateMismatch = false;
@@ -731,7 +1064,8 @@ LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
           if (m_currentRxPacket.second.destroyed) {
             NS_LOG_DEBUG (this << " packet dropped, packet was destroyed");
             m_phyRxDropTrace (currentPacket, LORAWAN_RX_DROP_PACKET_DESTOYED);
-            m_pdDataDestroyedCallback ();
+            if (!m_pdDataDestroyedCallback.IsNull ())
+              m_pdDataDestroyedCallback ();
           } else if (m_currentRxPacket.second.aborted) {
             NS_LOG_DEBUG (this << " packet dropped, packet was aborted");
             m_phyRxDropTrace (currentPacket, LORAWAN_RX_DROP_PACKET_ABORTED);
@@ -865,35 +1199,58 @@ LoRaWANPhy::EndTx (void)
   // TODO: switch PHY state?
 }
 
-/* \param p is the PHYPayload as per the LoRaWAN spec */
 Time
-LoRaWANPhy::CalculateTxTime (uint8_t payloadLength)
+LoRaWANPhy::GetTimeOnAir (uint8_t payloadLength, LoRaSpreadingFactor sf, uint32_t bandwidth,
+                          uint8_t codeRate, uint8_t preambleLength, bool crcOn)
 {
-  // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
+  double nSymbolsPreamble = preambleLength + 4.25;
+  uint16_t nSymbolsPayload = GetPayloadSymbolTable ().Get (payloadLength, sf, codeRate, crcOn);
+  return MicroSeconds ((nSymbolsPreamble + nSymbolsPayload) * GetSymbolPeriod (sf, bandwidth));
+}
+
+Time
+LoRaWANPhy::GetTimeOnAir (uint8_t payloadLength, uint8_t dataRateIndex, uint8_t codeRate,
+                          uint8_t preambleLength, bool crcOn)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  const LoRaWANDataRate &dataRate = LoRaWAN::m_supportedDataRates [dataRateIndex];
+  return GetTimeOnAir (payloadLength, dataRate.spreadingFactor, dataRate.bandWith, codeRate, preambleLength, crcOn);
+}
+
+Time
+LoRaWANPhy::GetPreambleTime (LoRaSpreadingFactor sf, uint32_t bandwidth, uint8_t preambleLength)
+{
+  double nSymbolsPreamble = preambleLength + 4.25;
+  return MicroSeconds (nSymbolsPreamble * GetSymbolPeriod (sf, bandwidth));
+}
 
-  double symbolRate = ((double)bandwidth)/pow(2.0, sf);
-  double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
+double
+LoRaWANPhy::GetNominalDataRate (LoRaSpreadingFactor sf, uint32_t bandwidth)
+{
+  // data rate is number of bits per symbol (i.e. SF) times number of symbols per second (i.e. Rs, symbol rate)
+  return sf * (((double)bandwidth)/(double)(1u << sf));
+}
 
-  double nSymbolsPreamble = m_preambleLength + 4.25;
-  uint16_t nSymbolsPayload = 8;
-  // LoRaWAN mandates no imlicit header, assume low data rate optimization (DE) is not used
-  uint32_t crc = 1;
-  if (!m_crcOn)
-    crc = 0;
+/* \param p is the PHYPayload as per the LoRaWAN spec */
+Time
+LoRaWANPhy::CalculateTxTime (uint8_t payloadLength)
+{
+  return CalculateTxTime (payloadLength, m_currentChannelIndex, m_currentDataRateIndex, m_codeRate);
+}
 
-  uint16_t nConditionalSymbolsPayload = ceil((8.0*payloadLength - 4.0*sf + 28 + 16*crc)/4.0/(double)sf)*(m_codeRate + 4);
-  if (nConditionalSymbolsPayload > 0.0)
-    nSymbolsPayload += nConditionalSymbolsPayload;
+Time
+LoRaWANPhy::CalculateTxTime (uint8_t payloadLength, uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate) const
+{
+  // the bandwidth is the one of the channel, so that DR6 is also sent in 125 kHz
+  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [channelIndex].m_bw;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor;
 
-  double txTime = (nSymbolsPreamble + nSymbolsPayload) * symbolPeriod;
+  Time txTime = GetTimeOnAir (payloadLength, sf, bandwidth, codeRate, m_preambleLength, m_crcOn);
 
-  NS_LOG_DEBUG(this << ": " << sf  << "|" << (uint16_t)m_codeRate  << "|" << (uint16_t)payloadLength
-      << "|" << (uint16_t) m_preambleLength  << "|" << nSymbolsPayload  << "|" << nConditionalSymbolsPayload
-      << "|" << txTime << "uS");
+  NS_LOG_DEBUG(this << ": " << sf  << "|" << (uint16_t)codeRate  << "|" << (uint16_t)payloadLength
+      << "|" << (uint16_t) m_preambleLength << "|" << txTime);
 
-  return MicroSeconds(txTime);
+  return txTime;
 }
 
 Time
@@ -902,28 +1259,30 @@ LoRaWANPhy::CalculatePreambleTime ()
   const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
   const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
 
-  double symbolRate = ((double)bandwidth)/pow(2.0, sf);
-  double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
-
-  double nSymbolsPreamble = m_preambleLength + 4.25;
-  double timePreamble = nSymbolsPreamble * symbolPeriod;
-
-  return MicroSeconds(timePreamble);
+  return GetPreambleTime (sf, bandwidth, m_preambleLength);
 }
 
 /* Returns the nominal PHY data rate */
 double
 LoRaWANPhy::GetNominalDataRate ()
 {
-  // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet
   const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
   const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
 
-  double symbolRate = bandwidth/pow(2.0, sf);
   // TODO: return data rate of information stream, not code words stream
+  return GetNominalDataRate (sf, bandwidth);
+}
 
-  // data rate is number of bits per symbol (i.e. SF) times number of symbols per second (i.e. Rs, symbol rate)
-  return sf * symbolRate;
+double
+LoRaWANPhy::GetRxRssi (void) const
+{
+  return m_rxRssi;
+}
+
+double
+LoRaWANPhy::GetRxSnr (void) const
+{
+  return m_rxSnr;
 }
 
 int64_t
@@ -27,6 +27,8 @@
 #include <ns3/traced-value.h>
 #include <ns3/event-id.h>
 
+#include <vector>
+
 namespace ns3 {
 /* ... */
 
@@ -150,6 +152,7 @@ typedef Callback< void, LoRaWANPhyEnumeration > SetTRXStateConfirmCallback;
  */
 class LoRaWANPhy : public SpectrumPhy
 {
+  friend class LoRaWANGatewayReceiver;
 
 public:
   /**
@@ -180,12 +183,74 @@ public:
    */
   Time CalculateTxTime (uint8_t payloadLength);
 
+  /**
+   * Calculate the time on air of a frame that this PHY would send after
+   * SetTxConf with the given channel, data rate and code rate, i.e. with the
+   * bandwidth of the channel and the preamble length and CRC setting of
+   * this PHY.
+   *
+   * \param payloadLength the length of the PHYPayload in bytes
+   * \param channelIndex the channel
+   * \param dataRateIndex the data rate
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \return the transmit time in MicroSeconds
+   */
+  Time CalculateTxTime (uint8_t payloadLength, uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate) const;
+
   /*
    * Calculate the time for transmittin a preamble in microseconds
    * Note number of preamble symbols is supposed to be already configured in the PHY
    */
   Time CalculatePreambleTime();
 
+  /**
+   * Calculate the time on air of a PHY frame, per $4.1.1.7 'Time on air' in
+   * the sx1272 data sheet (explicit header, no low data rate optimization).
+   * The number of payload symbols is looked up in a table that is built once
+   * for all payload lengths, spreading factors, code rates and CRC settings,
+   * so that this can be used for airtime budgeting without a PHY.
+   *
+   * \param payloadLength the length of the PHYPayload in bytes
+   * \param sf the spreading factor
+   * \param bandwidth the bandwidth in Hz
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \param preambleLength the number of programmed preamble symbols
+   * \param crcOn whether the payload CRC is present
+   * \return the time on air in MicroSeconds
+   */
+  static Time GetTimeOnAir (uint8_t payloadLength, LoRaSpreadingFactor sf, uint32_t bandwidth,
+                            uint8_t codeRate, uint8_t preambleLength, bool crcOn);
+
+  /**
+   * Calculate the time on air of a PHY frame sent at a LoRaWAN data rate.
+   *
+   * \param payloadLength the length of the PHYPayload in bytes
+   * \param dataRateIndex the index in LoRaWAN::m_supportedDataRates
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \param preambleLength the number of programmed preamble symbols
+   * \param crcOn whether the payload CRC is present
+   * \return the time on air in MicroSeconds
+   */
+  static Time GetTimeOnAir (uint8_t payloadLength, uint8_t dataRateIndex, uint8_t codeRate = 1,
+                            uint8_t preambleLength = 8, bool crcOn = true);
+
+  /**
+   * Calculate the time for transmitting a preamble (including the sync word).
+   *
+   * \param sf the spreading factor
+   * \param bandwidth the bandwidth in Hz
+   * \param preambleLength the number of programmed preamble symbols
+   * \return the preamble time in MicroSeconds
+   */
+  static Time GetPreambleTime (LoRaSpreadingFactor sf, uint32_t bandwidth, uint8_t preambleLength);
+
+  /**
+   * \param sf the spreading factor
+   * \param bandwidth the bandwidth in Hz
+   * \return the nominal PHY data rate in bits per second
+   */
+  static double GetNominalDataRate (LoRaSpreadingFactor sf, uint32_t bandwidth);
+
   /**
    * Check whether PHY has detected a premable since it switched its state to RX_ON
    */
@@ -257,6 +322,15 @@ public:
    */
   Ptr<LoRaWANErrorModel> GetErrorModel (void) const;
 
+  /**
+   * Use an interference helper that is shared with other PHYs. The owner of
+   * the helper adds and removes the signals and calls EndRx, so the PHY does
+   * neither. Used by LoRaWANGatewayReceiver.
+   *
+   * @param signal the shared interference helper
+   */
+  void SetSharedInterferenceHelper (Ptr<LoRaWANInterferenceHelper> signal);
+
   /**
    *  Ask Phy to switch state
    */
@@ -304,6 +378,22 @@ public:
    */
   double GetPhySymbolsPerOctet (void) const;
 
+  /**
+   * Get the received signal strength of the frame that is or was last
+   * received, measured when the PHY synchronized to it.
+   *
+   * \return the RSSI in dBm
+   */
+  double GetRxRssi (void) const;
+
+  /**
+   * Get the SINR of the frame that is or was last received, measured when the
+   * PHY synchronized to it.
+   *
+   * \return the SNR in dB
+   */
+  double GetRxSnr (void) const;
+
   /**
    * Assign a fixed random variable stream number to the random variables
    * used by this model.  Return the number of streams that have been assigned.
@@ -365,6 +455,70 @@ private:
    */
   void CheckInterference (void);
 
+  /**
+   * Add a signal to the interference, unless the interference helper is shared.
+   *
+   * \param psd the PSD of the signal
+   * \param dataRateIndex the data rate index of the signal
+   */
+  void AddSignal (Ptr<const SpectrumValue> psd, uint8_t dataRateIndex = LoRaWANInterferenceHelper::UNKNOWN_DATA_RATE_INDEX);
+
+  /**
+   * Get the in-band power of the interference and noise for a signal that is
+   * currently being received, without creating any SpectrumValue. Only used
+   * when UseInBandPower () is true. The isolation between spreading factors is
+   * applied when an InterSfRejection table is set.
+   *
+   * \param params signal parameters of the received signal
+   * \return the power of all other accumulated signals plus noise (W)
+   */
+  double GetInterferenceAndNoisePower (Ptr<const LoRaWANSpectrumSignalParameters> params) const;
+
+  /**
+   * \return true if the SINR is computed from the cached in-band powers,
+   * which is the case for ScalarSinr and whenever an InterSfRejection table
+   * is set
+   */
+  bool UseInBandPower (void) const;
+
+  /**
+   * Set the isolation between spreading factors applied to the interference.
+   *
+   * \param table an empty string to disable, "default" for the default table
+   * or a table as accepted by LoRaWANInterSfRejection::Parse
+   */
+  void SetInterSfRejection (std::string table);
+
+  /**
+   * \return the InterSfRejection attribute
+   */
+  std::string GetInterSfRejection (void) const;
+
+  /**
+   * Decide whether the frame currently received survived, from the
+   * interference recorded in m_rxTimeline. Only used when the SinrTimeline
+   * attribute is set.
+   *
+   * The frame is lost when the signal to interference ratio drops below
+   * CaptureThreshold during the last PREAMBLE_LOCK_SYMBOLS symbols of the
+   * preamble or during the header. Otherwise every header and payload symbol
+   * gets the lowest SINR of the segments it overlaps, and the success rate of
+   * each run of symbols with the same SINR is taken from the error model. A
+   * single random draw against the product of these decides on the frame.
+   */
+  void EvaluateRxTimeline (void);
+
+  /**
+   * The number of symbols at the end of the preamble the receiver needs to
+   * lock onto a frame.
+   */
+  static const uint32_t PREAMBLE_LOCK_SYMBOLS = 5;
+
+  /**
+   * The number of symbols of the explicit header.
+   */
+  static const uint32_t HEADER_SYMBOLS = 8;
+
   /**
    * Finish the reception of a frame. This is called at the end of a frame
    * reception, applying possibly pending PHY state changes and fireing the
@@ -531,6 +685,24 @@ private:
    */
   Time m_rxLastUpdate;
 
+  /**
+   * Start of the reception of the packet currently received.
+   */
+  Time m_rxStart;
+
+  /**
+   * RSSI in dBm and SNR in dB of the packet currently or last received.
+   */
+  double m_rxRssi;
+  double m_rxSnr;
+
+  /**
+   * The interference of the packet currently received: for every segment
+   * between two interference changes, the end of the segment and the
+   * in-band interference plus noise power (W) during the segment.
+   */
+  std::vector<std::pair<Time, double> > m_rxTimeline;
+
   /**
    * Statusinformation of the currently received packet. The first parameter
    * contains the frame, as well the signal power of the frame. The second
@@ -584,6 +756,36 @@ private:
   uint8_t m_codeRate; // only for TX
   uint8_t m_preambleLength;
   bool m_crcOn;
+
+  /**
+   * Compute SINR from cached in-band powers instead of PSD copies.
+   */
+  bool m_scalarSinr;
+
+  /**
+   * Record the interference of a received packet and evaluate it at EndRx.
+   */
+  bool m_sinrTimeline;
+
+  /**
+   * Minimum signal to interference ratio for preamble and header (dB).
+   */
+  double m_captureThresholdDb;
+
+  /**
+   * The InterSfRejection attribute, empty if disabled.
+   */
+  std::string m_interSfRejectionTable;
+
+  /**
+   * The parsed InterSfRejection table.
+   */
+  LoRaWANInterSfRejection m_interSfRejection;
+
+  /**
+   * Whether m_signal is shared with other PHYs and managed by its owner.
+   */
+  bool m_sharedSignal;
 }; // class LoRaWANPhy
 
 
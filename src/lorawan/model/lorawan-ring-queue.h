@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_RING_QUEUE_H
+#define LORAWAN_RING_QUEUE_H
+
+#include <ns3/assert.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief FIFO queue that stores its elements in place.
+ *
+ * The elements live in a ring of slots that is reused for the lifetime of the
+ * queue: no element is allocated or freed when it is queued or dequeued. With
+ * a capacity, the ring is allocated once, the first time an element is
+ * pushed. Without one (capacity 0), the queue is unbounded and the ring
+ * doubles whenever it is full, so allocations stop once the ring fits the
+ * largest backlog. A slot is reset to T () when its element leaves the queue,
+ * so that the references it holds (e.g. to a packet) are released.
+ *
+ * \tparam T the element type, which has to be default constructible and
+ * assignable
+ */
+template <typename T>
+class LoRaWANRingQueue
+{
+public:
+  /**
+   * Create an empty queue.
+   *
+   * \param capacity the maximum number of elements, 0 for no limit
+   */
+  LoRaWANRingQueue (uint32_t capacity = 0)
+    : m_capacity (capacity),
+      m_head (0),
+      m_size (0)
+  {
+  }
+
+  /**
+   * Change the maximum number of elements, only allowed while the queue is
+   * empty.
+   *
+   * \param capacity the maximum number of elements, 0 for no limit
+   */
+  void SetCapacity (uint32_t capacity)
+  {
+    NS_ASSERT_MSG (m_size == 0, "The capacity of a LoRaWANRingQueue can only be changed while it is empty");
+    m_capacity = capacity;
+    m_head = 0;
+    std::vector<T> ().swap (m_slots); // reallocated on the next push
+  }
+
+  /**
+   * \return the maximum number of elements, 0 for no limit
+   */
+  uint32_t GetCapacity (void) const
+  {
+    return m_capacity;
+  }
+
+  /**
+   * \return the number of elements in the queue
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * \return true if the queue holds no elements
+   */
+  bool IsEmpty (void) const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * \return true if no element can be pushed
+   */
+  bool IsFull (void) const
+  {
+    return m_capacity > 0 && m_size == m_capacity;
+  }
+
+  /**
+   * \return the oldest element
+   */
+  T &Front (void)
+  {
+    NS_ASSERT (m_size > 0);
+    return m_slots[m_head];
+  }
+
+  /**
+   * \param i the position, 0 being the oldest element
+   * \return the element at position i
+   */
+  T &operator[] (uint32_t i)
+  {
+    NS_ASSERT (i < m_size);
+    return m_slots[Wrap (m_head + i)];
+  }
+
+  /**
+   * Append an element. The queue must not be full.
+   *
+   * \return the slot of the new element, to be filled in by the caller
+   */
+  T &PushBack (void)
+  {
+    NS_ASSERT (!IsFull ());
+    if (m_capacity > 0 && m_slots.size () != m_capacity)
+      {
+        m_slots.resize (m_capacity);
+      }
+    else if (m_size == m_slots.size ())
+      {
+        Grow ();
+      }
+    T &slot = m_slots[Wrap (m_head + m_size)];
+    m_size++;
+    return slot;
+  }
+
+  /**
+   * Remove the oldest element.
+   */
+  void PopFront (void)
+  {
+    NS_ASSERT (m_size > 0);
+    m_slots[m_head] = T ();
+    m_head = Wrap (m_head + 1);
+    m_size--;
+  }
+
+  /**
+   * Remove the element at a position, keeping the order of the others.
+   *
+   * \param i the position, 0 being the oldest element
+   */
+  void Erase (uint32_t i)
+  {
+    NS_ASSERT (i < m_size);
+    for (uint32_t j = i; j + 1 < m_size; j++)
+      {
+        m_slots[Wrap (m_head + j)] = m_slots[Wrap (m_head + j + 1)];
+      }
+    m_slots[Wrap (m_head + m_size - 1)] = T ();
+    m_size--;
+  }
+
+  /**
+   * Remove all elements.
+   */
+  void Clear (void)
+  {
+    while (m_size > 0)
+      {
+        PopFront ();
+      }
+    m_head = 0;
+  }
+
+private:
+  /**
+   * Double the ring of an unbounded queue, moving the elements to the start
+   * of the new ring.
+   */
+  void Grow (void)
+  {
+    std::vector<T> slots (m_slots.empty () ? 4 : 2 * m_slots.size ());
+    for (uint32_t i = 0; i < m_size; i++)
+      {
+        slots[i] = m_slots[Wrap (m_head + i)];
+      }
+    m_slots.swap (slots);
+    m_head = 0;
+  }
+
+  /**
+   * \param i a slot index, possibly beyond the end of the ring
+   * \return the slot index wrapped into the ring
+   */
+  uint32_t Wrap (uint32_t i) const
+  {
+    return i < m_slots.size () ? i : i - m_slots.size ();
+  }
+
+  std::vector<T> m_slots; //!< The ring of slots
+  uint32_t m_capacity;    //!< The maximum number of elements, 0 for no limit
+  uint32_t m_head;        //!< The slot of the oldest element
+  uint32_t m_size;        //!< The number of elements
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_RING_QUEUE_H */
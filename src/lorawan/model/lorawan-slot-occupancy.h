@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_SLOT_OCCUPANCY_H
+#define LORAWAN_SLOT_OCCUPANCY_H
+
+#include <ns3/assert.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Number of transmissions in every timeslot of a period.
+ *
+ * An end device with periodicity p and offset o transmits in slots o, o + p,
+ * o + 2p, ... of the period, its slot train. The histogram counts the slot
+ * trains that cover every slot. Moving an end device to another offset
+ * updates the slots of its train only, so the histogram does not have to be
+ * rebuilt after a move.
+ *
+ * The mean occupancy of a candidate offset is a sum over a slot train. For
+ * many candidates with the same periodicity p, SetStride (p) keeps the sum of
+ * every residue class modulo p, the strided view, up to date. The sum over a
+ * slot train that starts in the first period is then the sum of its residue
+ * class minus at most one slot past the end of the train.
+ */
+class LoRaWANSlotOccupancy
+{
+public:
+  /**
+   * \param size the number of slots in the period
+   */
+  explicit LoRaWANSlotOccupancy (uint32_t size = 0)
+    : m_stride (0)
+  {
+    Reset (size);
+  }
+
+  /**
+   * Empty the histogram and drop the strided view.
+   *
+   * \param size the number of slots in the period
+   */
+  void Reset (uint32_t size)
+  {
+    m_counter.assign (size, 0);
+    m_stride = 0;
+    m_residueSums.clear ();
+  }
+
+  /**
+   * \return the number of slots in the period
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_counter.size ();
+  }
+
+  /**
+   * \param slot a slot of the period
+   * \return the number of transmissions in the slot
+   */
+  uint32_t Get (uint32_t slot) const
+  {
+    return m_counter[slot];
+  }
+
+  /**
+   * Add or remove the slot train of an end device: slots o + l * p for l
+   * from 0 to GetSize () / p, as far as they are in the period.
+   *
+   * \param p the periodicity, at least 1
+   * \param o the offset
+   * \param delta 1 to add the train, -1 to remove it
+   */
+  void Add (int p, int o, int delta)
+  {
+    NS_ASSERT (p > 0);
+    const int64_t size = m_counter.size ();
+    const int64_t trains = size / p;
+    for (int64_t l = 0; l <= trains; l++)
+      {
+        const int64_t slot = l * p + o;
+        if (slot >= 0 && slot < size)
+          {
+            m_counter[slot] += delta;
+            if (m_stride > 0)
+              {
+                m_residueSums[slot % m_stride] += delta;
+              }
+          }
+      }
+  }
+
+  /**
+   * Move the slot train of an end device to another offset.
+   *
+   * \param p the periodicity
+   * \param from the current offset
+   * \param to the new offset
+   */
+  void Move (int p, int from, int to)
+  {
+    Add (p, from, -1);
+    Add (p, to, 1);
+  }
+
+  /**
+   * \param p the periodicity of an end device in the histogram
+   * \param o the offset of the end device
+   * \return the mean number of other transmissions in the slots of its
+   * train, as for Add, or 0 if the train has no slots in the period
+   */
+  float GetOverlap (int p, int o) const
+  {
+    const int64_t size = m_counter.size ();
+    const int64_t trains = size / p;
+    int64_t sum = 0;
+    int numSlots = 0;
+    for (int64_t l = 0; l <= trains; l++)
+      {
+        const int64_t slot = l * p + o;
+        if (slot >= 0 && slot < size)
+          {
+            sum += int64_t (m_counter[slot]) - 1; // discount its own transmission
+            numSlots++;
+          }
+      }
+    return numSlots > 0 ? float (sum) / numSlots : 0.0f;
+  }
+
+  /**
+   * \param p the periodicity of an end device
+   * \param m a candidate offset
+   * \return the mean number of transmissions in slots m + n * p for n from
+   * 0 to GetSize () / p - 1, as far as they are in the period, or 0 if none
+   * of these slots is (see HasCandidateSlots)
+   */
+  float GetCandidateOverlap (int p, int m) const
+  {
+    const int64_t size = m_counter.size ();
+    const int64_t trains = size / p;
+    if (p == int (m_stride) && m >= 0 && m < p && trains > 0)
+      {
+        // All slots of the train are in the period, the residue class holds
+        // one more slot if m + trains * p is still in the period
+        const int64_t last = trains * p + m;
+        const int64_t sum = m_residueSums[m] - (last < size ? m_counter[last] : 0);
+        return float (sum) / trains;
+      }
+
+    int64_t sum = 0;
+    int numSlots = 0;
+    for (int64_t n = 0; n < trains; n++)
+      {
+        const int64_t slot = n * p + m;
+        if (slot >= 0 && slot < size)
+          {
+            sum += m_counter[slot];
+            numSlots++;
+          }
+      }
+    return numSlots > 0 ? float (sum) / numSlots : 0.0f;
+  }
+
+  /**
+   * \param p the periodicity of an end device, at least 1
+   * \param m a candidate offset
+   * \return whether any of the slots m + n * p for n from 0 to
+   * GetSize () / p - 1 is in the period, i.e. whether GetCandidateOverlap
+   * averages over at least one slot
+   */
+  bool HasCandidateSlots (int p, int m) const
+  {
+    NS_ASSERT (p > 0);
+    const int64_t size = m_counter.size ();
+    const int64_t trains = size / p;
+    return trains > 0 && m < size && m + (trains - 1) * p >= 0;
+  }
+
+  /**
+   * Keep the strided view for periodicity p, replacing the one of the
+   * previous stride. Building the view reads every slot once.
+   *
+   * \param p the periodicity, 0 to drop the view
+   */
+  void SetStride (uint32_t p)
+  {
+    m_stride = p;
+    m_residueSums.assign (p, 0);
+    for (uint32_t slot = 0; slot < m_counter.size () && p > 0; slot++)
+      {
+        m_residueSums[slot % p] += m_counter[slot];
+      }
+  }
+
+  /**
+   * \return the periodicity of the strided view, 0 if there is none
+   */
+  uint32_t GetStride (void) const
+  {
+    return m_stride;
+  }
+
+private:
+  std::vector<uint32_t> m_counter;     //!< The number of transmissions in every slot
+  uint32_t m_stride;                   //!< The periodicity of the strided view, 0 if none
+  std::vector<int64_t> m_residueSums;  //!< The sum of m_counter over every residue class modulo m_stride
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SLOT_OCCUPANCY_H */
@@ -0,0 +1,182 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_SNR_HISTORY_H
+#define LORAWAN_SNR_HISTORY_H
+
+#include <ns3/assert.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Sliding window of the last N SNR samples of an end device.
+ *
+ * The samples are kept in a ring of fixed capacity, the oldest sample is
+ * overwritten once the ring is full. The mean is a running sum, the maximum
+ * is kept with a monotonic queue: a second ring holding the sequence numbers
+ * of the samples that are larger than every later sample, so its front is
+ * the maximum of the window. Adding a sample is amortized O(1), reading the
+ * mean or the maximum is O(1), and no memory is allocated after Resize.
+ */
+class LoRaWANSnrHistory
+{
+public:
+  /**
+   * \param capacity the number of samples in the window, zero for a history
+   * that has to be resized before use
+   */
+  explicit LoRaWANSnrHistory (uint32_t capacity = 0)
+  {
+    Resize (capacity);
+  }
+
+  /**
+   * Set the number of samples in the window and forget all samples.
+   *
+   * \param capacity the number of samples in the window
+   */
+  void Resize (uint32_t capacity)
+  {
+    m_samples.assign (capacity, 0.0);
+    m_maxQueue.assign (capacity, 0);
+    Clear ();
+  }
+
+  /**
+   * Forget all samples.
+   */
+  void Clear (void)
+  {
+    m_count = 0;
+    m_size = 0;
+    m_sum = 0.0;
+    m_maxHead = 0;
+    m_maxSize = 0;
+  }
+
+  /**
+   * \return the number of samples in the window
+   */
+  uint32_t GetCapacity (void) const
+  {
+    return m_samples.size ();
+  }
+
+  /**
+   * \return the number of samples in the history
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * \return true if the window is filled with samples
+   */
+  bool IsFull (void) const
+  {
+    return m_size == m_samples.size () && m_size > 0;
+  }
+
+  /**
+   * Add a sample, replacing the oldest one if the window is full.
+   *
+   * \param snr the SNR in dB
+   */
+  void Add (double snr)
+  {
+    const uint32_t capacity = m_samples.size ();
+    NS_ASSERT (capacity > 0);
+    const uint32_t slot = m_count % capacity;
+
+    if (m_size == capacity)
+      {
+        // The oldest sample leaves the window
+        m_sum -= m_samples[slot];
+        if (m_maxQueue[m_maxHead] == m_count - capacity)
+          {
+            m_maxHead = (m_maxHead + 1) % capacity;
+            m_maxSize--;
+          }
+      }
+    else
+      {
+        m_size++;
+      }
+
+    // Samples that are not larger than the new one are never the maximum again
+    while (m_maxSize > 0 && m_samples[m_maxQueue[(m_maxHead + m_maxSize - 1) % capacity] % capacity] <= snr)
+      {
+        m_maxSize--;
+      }
+    m_maxQueue[(m_maxHead + m_maxSize) % capacity] = m_count;
+    m_maxSize++;
+
+    m_samples[slot] = snr;
+    m_sum += snr;
+    m_count++;
+
+    // Start over from the samples in the window once per revolution, so that
+    // rounding errors do not accumulate in the running sum
+    if (m_count % capacity == 0)
+      {
+        m_sum = 0.0;
+        for (uint32_t i = 0; i < m_size; i++)
+          {
+            m_sum += m_samples[i];
+          }
+      }
+  }
+
+  /**
+   * \return the largest sample in the window, the history must not be empty
+   */
+  double GetMax (void) const
+  {
+    NS_ASSERT (m_size > 0);
+    return m_samples[m_maxQueue[m_maxHead] % m_samples.size ()];
+  }
+
+  /**
+   * \return the mean of the samples in the window, the history must not be
+   * empty
+   */
+  double GetMean (void) const
+  {
+    NS_ASSERT (m_size > 0);
+    return m_sum / m_size;
+  }
+
+private:
+  std::vector<double> m_samples;    //!< The samples, sample n is in slot n modulo the capacity
+  std::vector<uint32_t> m_maxQueue; //!< Ring of the sequence numbers of the samples larger than every later sample
+  uint32_t m_count;   //!< The number of samples added since the last Clear
+  uint32_t m_size;    //!< The number of samples in the window
+  double m_sum;       //!< The sum of the samples in the window
+  uint32_t m_maxHead; //!< The front of m_maxQueue, the sequence number of the maximum
+  uint32_t m_maxSize; //!< The number of sequence numbers in m_maxQueue
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SNR_HISTORY_H */
@@ -0,0 +1,648 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-phy.h"
+#include "lorawan.h"
+#include "lorawan-spectrum-signal-parameters.h"
+#include <ns3/simulator.h>
+#include <ns3/log.h>
+#include <ns3/net-device.h>
+#include <ns3/node.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/mobility-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANSpectrumChannel);
+
+namespace {
+
+/**
+ * \param loss the first model of a propagation loss model chain
+ * \return true if every model in the chain is deterministic, non-decreasing
+ * with distance and independent of height and direction
+ */
+bool
+IsCullableLossModel (Ptr<PropagationLossModel> loss)
+{
+  for (; loss; loss = loss->GetNext ())
+    {
+      if (!DynamicCast<FriisPropagationLossModel> (loss)
+          && !DynamicCast<LogDistancePropagationLossModel> (loss)
+          && !DynamicCast<ThreeLogDistancePropagationLossModel> (loss)
+          && !DynamicCast<RangePropagationLossModel> (loss))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+} // anonymous namespace
+
+TypeId
+LoRaWANSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANSpectrumChannel> ()
+    .AddAttribute ("MaxLossDb",
+                   "The maximum loss in dB for which transmissions will be "
+                   "passed to the receiving PHY, see SingleModelSpectrumChannel. "
+                   "When ReceiverCulling is set, this value also determines the "
+                   "cull radius.",
+                   DoubleValue (1.0e9),
+                   MakeDoubleAccessor (&LoRaWANSpectrumChannel::m_maxLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("ReceiverCulling",
+                   "Do not deliver LoRaWAN transmissions to PHYs tuned to "
+                   "another channel or to receivers beyond the cull radius. "
+                   "The cull radius assumes a deterministic loss model that "
+                   "does not decrease with distance, and is only derived for "
+                   "chains of Friis, LogDistance, ThreeLogDistance and Range "
+                   "loss models.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANSpectrumChannel::m_receiverCulling),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxAntennaGainDb",
+                   "Upper bound on the sum of the TX and RX antenna gains, "
+                   "used to compute the cull radius",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&LoRaWANSpectrumChannel::m_maxAntennaGainDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("GridCellSize",
+                   "The width and height (m) of the cells of the grid that "
+                   "indexes the receivers",
+                   DoubleValue (1000.0),
+                   MakeDoubleAccessor (&LoRaWANSpectrumChannel::m_gridCellSize),
+                   MakeDoubleChecker<double> (1.0))
+    .AddTraceSource ("PathLoss",
+                     "This trace is fired whenever a new path loss value "
+                     "is calculated, see SingleModelSpectrumChannel.",
+                     MakeTraceSourceAccessor (&LoRaWANSpectrumChannel::m_pathLossTrace),
+                     "ns3::SpectrumChannel::LossTracedCallback")
+    .AddTraceSource ("AvoidedAllocations",
+                     "The number of heap allocations avoided by reusing pooled "
+                     "LoRaWANSpectrumSignalParameters and PSDs, updated after "
+                     "every transmission. The pool is shared by all channels.",
+                     MakeTraceSourceAccessor (&LoRaWANSpectrumChannel::m_avoidedAllocations),
+                     "ns3::TracedValueCallback::LoRaWANCounter")
+  ;
+  return tid;
+}
+
+LoRaWANSpectrumChannel::LoRaWANSpectrumChannel ()
+  : m_cullRadius (-1.0),
+    m_indexDirty (true),
+    m_avoidedAllocations (0)
+{
+  NS_LOG_FUNCTION (this);
+  LoRaWAN::AcquireRegion ();
+  m_channelBuckets.resize (LoRaWAN::m_supportedChannels.size ());
+}
+
+LoRaWANSpectrumChannel::~LoRaWANSpectrumChannel ()
+{
+  LoRaWAN::ReleaseRegion ();
+}
+
+void
+LoRaWANSpectrumChannel::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  DisconnectCourseChanged ();
+  m_phyList.clear ();
+  m_rxChannelIndices.clear ();
+  m_phyIndices.clear ();
+  m_channelBuckets.clear ();
+  m_allChannelBucket.clear ();
+  m_grid.clear ();
+  m_unlocated.clear ();
+  m_spectrumModel = 0;
+  m_propagationDelay = 0;
+  m_propagationLoss = 0;
+  m_spectrumPropagationLoss = 0;
+  SpectrumChannel::DoDispose ();
+}
+
+void
+LoRaWANSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  Ptr<LoRaWANPhy> loraWanPhy = DynamicCast<LoRaWANPhy> (phy);
+  DoAddRx (phy, loraWanPhy ? loraWanPhy->GetCurrentChannelIndex () : ALL_CHANNELS);
+}
+
+void
+LoRaWANSpectrumChannel::AddNoiseListener (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  DoAddRx (phy, ALL_CHANNELS);
+}
+
+void
+LoRaWANSpectrumChannel::DoAddRx (Ptr<SpectrumPhy> phy, uint8_t channelIndex)
+{
+  NS_ASSERT_MSG (m_phyIndices.find (PeekPointer (phy)) == m_phyIndices.end (), "Receiver was already added");
+  const uint32_t rxIndex = m_phyList.size ();
+  m_phyList.push_back (phy);
+  m_rxChannelIndices.push_back (channelIndex);
+  m_phyIndices[PeekPointer (phy)] = rxIndex;
+  SetBucketBit (GetBucket (channelIndex), rxIndex);
+  m_indexDirty = true;
+}
+
+std::vector<uint64_t> &
+LoRaWANSpectrumChannel::GetBucket (uint8_t channelIndex)
+{
+  if (channelIndex == ALL_CHANNELS)
+    {
+      return m_allChannelBucket;
+    }
+  NS_ASSERT (channelIndex < m_channelBuckets.size ());
+  return m_channelBuckets[channelIndex];
+}
+
+void
+LoRaWANSpectrumChannel::SetBucketBit (std::vector<uint64_t> &bucket, uint32_t rxIndex)
+{
+  if (rxIndex / 64 >= bucket.size ())
+    {
+      bucket.resize (rxIndex / 64 + 1, 0);
+    }
+  bucket[rxIndex / 64] |= uint64_t (1) << (rxIndex % 64);
+}
+
+void
+LoRaWANSpectrumChannel::ClearBucketBit (std::vector<uint64_t> &bucket, uint32_t rxIndex)
+{
+  NS_ASSERT (rxIndex / 64 < bucket.size ());
+  bucket[rxIndex / 64] &= ~(uint64_t (1) << (rxIndex % 64));
+}
+
+void
+LoRaWANSpectrumChannel::SetRxChannelIndex (Ptr<SpectrumPhy> phy, uint8_t channelIndex)
+{
+  NS_LOG_FUNCTION (this << phy << (uint16_t)channelIndex);
+  std::unordered_map<const SpectrumPhy *, uint32_t>::const_iterator it = m_phyIndices.find (PeekPointer (phy));
+  if (it == m_phyIndices.end ())
+    {
+      return; // not attached (yet), AddRx will register the channel
+    }
+  const uint32_t rxIndex = it->second;
+  const uint8_t oldChannelIndex = m_rxChannelIndices[rxIndex];
+  if (oldChannelIndex == channelIndex || oldChannelIndex == ALL_CHANNELS)
+    {
+      return;
+    }
+
+  ClearBucketBit (GetBucket (oldChannelIndex), rxIndex);
+  SetBucketBit (GetBucket (channelIndex), rxIndex);
+  m_rxChannelIndices[rxIndex] = channelIndex;
+}
+
+uint8_t
+LoRaWANSpectrumChannel::GetRxChannelIndex (Ptr<SpectrumPhy> phy) const
+{
+  std::unordered_map<const SpectrumPhy *, uint32_t>::const_iterator it = m_phyIndices.find (PeekPointer (phy));
+  NS_ASSERT_MSG (it != m_phyIndices.end (), "Receiver is not attached to this channel");
+  return m_rxChannelIndices[it->second];
+}
+
+void
+LoRaWANSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+{
+  NS_LOG_FUNCTION (this << txParams->psd << txParams->duration << txParams->txPhy);
+  NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+  NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+  if (m_spectrumModel == 0)
+    {
+      // first pak, record SpectrumModel
+      m_spectrumModel = txParams->psd->GetSpectrumModel ();
+    }
+  else
+    {
+      // all attached SpectrumPhy instances must use the same SpectrumModel
+      NS_ASSERT (*(txParams->psd->GetSpectrumModel ()) == *m_spectrumModel);
+    }
+
+  Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+
+  if (m_receiverCulling)
+    {
+      DeliverCulled (txParams, senderMobility);
+    }
+  else
+    {
+      for (uint32_t i = 0; i < m_phyList.size (); i++)
+        {
+          DeliverTo (txParams, senderMobility, i);
+        }
+    }
+
+  m_avoidedAllocations = LoRaWANSpectrumSignalParameters::GetAvoidedAllocations ();
+}
+
+void
+LoRaWANSpectrumChannel::DeliverCulled (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility)
+{
+  if (m_indexDirty)
+    {
+      BuildIndex ();
+    }
+
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanTxParams = DynamicCast<LoRaWANSpectrumSignalParameters> (txParams);
+
+  m_candidates.clear ();
+  if (senderMobility && m_cullRadius >= 0)
+    {
+      GetCandidates (senderMobility->GetPosition (), m_candidates);
+      // Keep the order of m_phyList, so events are scheduled in the same order
+      std::sort (m_candidates.begin (), m_candidates.end ());
+    }
+  else if (loraWanTxParams)
+    {
+      // Only the receivers on the channel of the transmission, in the order of m_phyList
+      const std::vector<uint64_t> &bucket = GetBucket (loraWanTxParams->channelIndex);
+      const uint32_t nWords = std::max (bucket.size (), m_allChannelBucket.size ());
+      for (uint32_t i = 0; i < nWords; i++)
+        {
+          uint64_t word = (i < bucket.size () ? bucket[i] : 0) | (i < m_allChannelBucket.size () ? m_allChannelBucket[i] : 0);
+          while (word != 0)
+            {
+              m_candidates.push_back (i * 64 + __builtin_ctzll (word));
+              word &= word - 1; // clear the lowest set bit
+            }
+        }
+    }
+  else
+    {
+      m_candidates.resize (m_phyList.size ());
+      for (uint32_t i = 0; i < m_phyList.size (); i++)
+        {
+          m_candidates[i] = i;
+        }
+    }
+
+  for (std::vector<uint32_t>::const_iterator it = m_candidates.begin (); it != m_candidates.end (); ++it)
+    {
+      const uint8_t rxChannelIndex = m_rxChannelIndices[*it];
+      if (loraWanTxParams && rxChannelIndex != ALL_CHANNELS && rxChannelIndex != loraWanTxParams->channelIndex)
+        {
+          continue; // out of band
+        }
+      DeliverTo (txParams, senderMobility, *it);
+    }
+}
+
+void
+LoRaWANSpectrumChannel::DeliverTo (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility, uint32_t rxIndex)
+{
+  Ptr<SpectrumPhy> rxPhy = m_phyList[rxIndex];
+  if (rxPhy == txParams->txPhy)
+    {
+      return;
+    }
+
+  Time delay  = MicroSeconds (0);
+
+  Ptr<MobilityModel> receiverMobility = rxPhy->GetMobility ();
+  NS_LOG_LOGIC ("copying signal parameters " << txParams);
+  Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+
+  if (senderMobility && receiverMobility)
+    {
+      double pathLossDb = 0;
+      if (rxParams->txAntenna != 0)
+        {
+          Angles txAngles (receiverMobility->GetPosition (), senderMobility->GetPosition ());
+          double txAntennaGain = rxParams->txAntenna->GetGainDb (txAngles);
+          NS_LOG_LOGIC ("txAntennaGain = " << txAntennaGain << " dB");
+          pathLossDb -= txAntennaGain;
+        }
+      Ptr<AntennaModel> rxAntenna = rxPhy->GetRxAntenna ();
+      if (rxAntenna != 0)
+        {
+          Angles rxAngles (senderMobility->GetPosition (), receiverMobility->GetPosition ());
+          double rxAntennaGain = rxAntenna->GetGainDb (rxAngles);
+          NS_LOG_LOGIC ("rxAntennaGain = " << rxAntennaGain << " dB");
+          pathLossDb -= rxAntennaGain;
+        }
+      if (m_propagationLoss)
+        {
+          double propagationGainDb = m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+          NS_LOG_LOGIC ("propagationGainDb = " << propagationGainDb << " dB");
+          pathLossDb -= propagationGainDb;
+        }
+      NS_LOG_LOGIC ("total pathLoss = " << pathLossDb << " dB");
+      m_pathLossTrace (txParams->txPhy, rxPhy, pathLossDb);
+      if (pathLossDb > m_maxLossDb)
+        {
+          // beyond range
+          return;
+        }
+      double pathGainLinear = std::pow (10.0, (-pathLossDb) / 10.0);
+      *(rxParams->psd) *= pathGainLinear;
+
+      if (m_spectrumPropagationLoss)
+        {
+          rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility, receiverMobility);
+        }
+
+      if (m_propagationDelay)
+        {
+          delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+        }
+    }
+
+  Ptr<NetDevice> netDev = rxPhy->GetDevice ();
+  if (netDev)
+    {
+      // the receiver has a NetDevice, so we expect that it is attached to a Node
+      uint32_t dstNode =  netDev->GetNode ()->GetId ();
+      Simulator::ScheduleWithContext (dstNode, delay, &LoRaWANSpectrumChannel::StartRx, this, rxParams, rxPhy);
+    }
+  else
+    {
+      // the receiver is not attached to a NetDevice, so we cannot assume that it is attached to a node
+      Simulator::Schedule (delay, &LoRaWANSpectrumChannel::StartRx, this, rxParams, rxPhy);
+    }
+}
+
+void
+LoRaWANSpectrumChannel::GetCandidates (const Vector &position, std::vector<uint32_t> &candidates)
+{
+  const int32_t xMin = GetCellCoordinate (position.x - m_cullRadius);
+  const int32_t xMax = GetCellCoordinate (position.x + m_cullRadius);
+  const int32_t yMin = GetCellCoordinate (position.y - m_cullRadius);
+  const int32_t yMax = GetCellCoordinate (position.y + m_cullRadius);
+  const double windowCells = (static_cast<double> (xMax) - xMin + 1) * (static_cast<double> (yMax) - yMin + 1);
+
+  // Visit either the cells in the window around the position or the non-empty
+  // cells, whichever are fewer
+  if (windowCells <= m_grid.size ())
+    {
+      for (int32_t x = xMin; x <= xMax; x++)
+        {
+          for (int32_t y = yMin; y <= yMax; y++)
+            {
+              std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.find (MakeCellKey (x, y));
+              if (cell != m_grid.end ())
+                {
+                  candidates.insert (candidates.end (), cell->second.begin (), cell->second.end ());
+                }
+            }
+        }
+    }
+  else
+    {
+      for (std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.begin (); cell != m_grid.end (); ++cell)
+        {
+          const int32_t x = static_cast<int32_t> (cell->first >> 32);
+          const int32_t y = static_cast<int32_t> (cell->first & 0xffffffff);
+          if (x >= xMin && x <= xMax && y >= yMin && y <= yMax)
+            {
+              candidates.insert (candidates.end (), cell->second.begin (), cell->second.end ());
+            }
+        }
+    }
+
+  candidates.insert (candidates.end (), m_unlocated.begin (), m_unlocated.end ());
+}
+
+void
+LoRaWANSpectrumChannel::BuildIndex (void)
+{
+  NS_LOG_FUNCTION (this << m_phyList.size ());
+
+  DisconnectCourseChanged ();
+
+  m_grid.clear ();
+  m_unlocated.clear ();
+  m_cellKeys.assign (m_phyList.size (), 0);
+  m_cellMobilities.assign (m_phyList.size (), 0);
+  for (uint32_t i = 0; i < m_phyList.size (); i++)
+    {
+      Ptr<MobilityModel> mobility = m_phyList[i]->GetMobility ();
+      if (mobility)
+        {
+          const Vector position = mobility->GetPosition ();
+          m_cellKeys[i] = GetCellKey (position.x, position.y);
+          m_grid[m_cellKeys[i]].push_back (i);
+
+          Callback<void, uint32_t, Ptr<const MobilityModel> > cb = MakeCallback (&LoRaWANSpectrumChannel::CourseChanged, this);
+          mobility->TraceConnectWithoutContext ("CourseChange", cb.Bind (i));
+          m_cellMobilities[i] = mobility;
+        }
+      else
+        {
+          m_unlocated.push_back (i);
+        }
+    }
+
+  ComputeCullRadius ();
+  m_indexDirty = false;
+}
+
+void
+LoRaWANSpectrumChannel::DisconnectCourseChanged (void)
+{
+  // The PHYs may have changed their mobility model since the last build, so
+  // disconnect from the models that were connected rather than the current ones
+  for (uint32_t i = 0; i < m_cellMobilities.size (); i++)
+    {
+      if (m_cellMobilities[i])
+        {
+          Callback<void, uint32_t, Ptr<const MobilityModel> > cb = MakeCallback (&LoRaWANSpectrumChannel::CourseChanged, this);
+          m_cellMobilities[i]->TraceDisconnectWithoutContext ("CourseChange", cb.Bind (i));
+        }
+    }
+  m_cellMobilities.clear ();
+  m_cellKeys.clear ();
+}
+
+void
+LoRaWANSpectrumChannel::ComputeCullRadius (void)
+{
+  m_cullRadius = -1.0;
+  if (!m_propagationLoss || m_spectrumPropagationLoss)
+    {
+      // Without a (single-frequency only) loss model the loss is not bounded
+      return;
+    }
+  if (!IsCullableLossModel (m_propagationLoss))
+    {
+      // Evaluating a random or position-dependent model along the x axis
+      // would not bound its loss, and could consume its random stream
+      NS_LOG_DEBUG (this << " no cull radius for this propagation loss model");
+      return;
+    }
+
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0.0, 0.0, 0.0));
+
+  const double maxLossDb = m_maxLossDb + m_maxAntennaGainDb;
+  double high = 1.0e7; // 10000 km
+  b->SetPosition (Vector (high, 0.0, 0.0));
+  if (-m_propagationLoss->CalcRxPower (0, a, b) <= maxLossDb)
+    {
+      return; // no culling on distance
+    }
+
+  // Bisection on the distance where the loss exceeds maxLossDb
+  double low = 0.0;
+  while (high - low > 1.0)
+    {
+      const double d = (low + high) / 2;
+      b->SetPosition (Vector (d, 0.0, 0.0));
+      if (-m_propagationLoss->CalcRxPower (0, a, b) > maxLossDb)
+        {
+          high = d;
+        }
+      else
+        {
+          low = d;
+        }
+    }
+  m_cullRadius = high;
+
+  NS_LOG_DEBUG (this << " cull radius = " << m_cullRadius << " m");
+}
+
+double
+LoRaWANSpectrumChannel::GetCullRadius (void)
+{
+  if (m_indexDirty)
+    {
+      BuildIndex ();
+    }
+  return m_cullRadius;
+}
+
+int32_t
+LoRaWANSpectrumChannel::GetCellCoordinate (double x) const
+{
+  return static_cast<int32_t> (std::floor (x / m_gridCellSize));
+}
+
+uint64_t
+LoRaWANSpectrumChannel::GetCellKey (double x, double y) const
+{
+  return MakeCellKey (GetCellCoordinate (x), GetCellCoordinate (y));
+}
+
+uint64_t
+LoRaWANSpectrumChannel::MakeCellKey (int32_t x, int32_t y)
+{
+  return (static_cast<uint64_t> (static_cast<uint32_t> (x)) << 32) | static_cast<uint32_t> (y);
+}
+
+void
+LoRaWANSpectrumChannel::CourseChanged (uint32_t rxIndex, Ptr<const MobilityModel> mobility)
+{
+  const Vector position = mobility->GetPosition ();
+  const uint64_t key = GetCellKey (position.x, position.y);
+  if (key == m_cellKeys[rxIndex])
+    {
+      return;
+    }
+
+  std::vector<uint32_t> &oldCell = m_grid[m_cellKeys[rxIndex]];
+  oldCell.erase (std::find (oldCell.begin (), oldCell.end (), rxIndex));
+  if (oldCell.empty ())
+    {
+      m_grid.erase (m_cellKeys[rxIndex]);
+    }
+  m_grid[key].push_back (rxIndex);
+  m_cellKeys[rxIndex] = key;
+}
+
+void
+LoRaWANSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params);
+  receiver->StartRx (params);
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNDevices (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_phyList.size ();
+}
+
+Ptr<NetDevice>
+LoRaWANSpectrumChannel::GetDevice (uint32_t i) const
+{
+  NS_LOG_FUNCTION (this << i);
+  return m_phyList.at (i)->GetDevice ()->GetObject<NetDevice> ();
+}
+
+void
+LoRaWANSpectrumChannel::AddPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_propagationLoss == 0);
+  m_propagationLoss = loss;
+  m_indexDirty = true;
+}
+
+void
+LoRaWANSpectrumChannel::AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_spectrumPropagationLoss == 0);
+  m_spectrumPropagationLoss = loss;
+  m_indexDirty = true;
+}
+
+void
+LoRaWANSpectrumChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT (m_propagationDelay == 0);
+  m_propagationDelay = delay;
+}
+
+Ptr<SpectrumPropagationLossModel>
+LoRaWANSpectrumChannel::GetSpectrumPropagationLossModel (void)
+{
+  NS_LOG_FUNCTION (this);
+  return m_spectrumPropagationLoss;
+}
+
+} // namespace ns3
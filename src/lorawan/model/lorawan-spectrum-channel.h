@@ -0,0 +1,386 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_SPECTRUM_CHANNEL_H
+#define LORAWAN_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-model.h>
+#include <ns3/traced-callback.h>
+#include <ns3/traced-value.h>
+#include <ns3/vector.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+namespace TracedValueCallback {
+/**
+ * \ingroup lorawan
+ * TracedValue callback signature for 64 bit counters.
+ *
+ * \param [in] oldValue original value of the traced variable
+ * \param [in] newValue new value of the traced variable
+ */
+  typedef void (* LoRaWANCounter) (uint64_t oldValue, uint64_t newValue);
+}  // namespace TracedValueCallback
+
+class MobilityModel;
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief SpectrumChannel for LoRaWAN networks with optional receiver culling.
+ *
+ * By default this channel behaves exactly like SingleModelSpectrumChannel:
+ * every transmission is delivered to every attached SpectrumPhy. When the
+ * ReceiverCulling attribute is set, a transmission is not delivered to
+ * receivers that would discard it anyway:
+ *
+ * - LoRaWANPhy receivers that are tuned to a different LoRaWAN channel than
+ *   the one of the transmission (LoRaWANPhy::StartRx ignores these).
+ * - receivers that are further away than the cull radius. The cull radius is
+ *   the distance beyond which the propagation loss, minus the MaxAntennaGainDb
+ *   bound on the sum of the TX and RX antenna gains, exceeds MaxLossDb. It is
+ *   derived once from the propagation loss model, by evaluating it along the
+ *   x axis. This is only valid for loss models that are deterministic,
+ *   non-decreasing with distance and independent of height and direction, so
+ *   the cull radius is only derived when every model in the loss chain is a
+ *   Friis, LogDistance, ThreeLogDistance or Range model. Other models (e.g.
+ *   Nakagami, which would also draw from its random stream) disable culling
+ *   on distance.
+ *
+ * The channel keeps track of the LoRaWAN channel every LoRaWANPhy is tuned
+ * to: the PHY registers its channel index when it is added and re-registers
+ * when SetTxConf retunes it. With culling, a LoRaWAN transmission is then only
+ * offered to the PHYs in the bucket of its channel and to the PHYs that listen
+ * on all channels (other SpectrumPhys and PHYs added with AddNoiseListener).
+ *
+ * Receivers are indexed in a uniform grid of GridCellSize x GridCellSize m
+ * (x and y coordinates) so that a transmission only visits the cells within
+ * the cull radius. The grid is built at the first transmission and kept up to
+ * date through the CourseChange trace of the mobility models. Receivers
+ * without a mobility model are always considered. Surviving receivers are
+ * visited in the order in which they were added to the channel, so that the
+ * events are scheduled in the same order as without culling. The PathLoss
+ * trace is not fired for culled receivers.
+ */
+class LoRaWANSpectrumChannel : public SpectrumChannel
+{
+public:
+  LoRaWANSpectrumChannel ();
+  virtual ~LoRaWANSpectrumChannel ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * Channel index of the receivers that listen on all LoRaWAN channels.
+   */
+  static const uint8_t ALL_CHANNELS = 0xff;
+
+  // inherited from SpectrumChannel
+  virtual void AddPropagationLossModel (Ptr<PropagationLossModel> loss);
+  virtual void AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss);
+  virtual void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+
+  // inherited from Channel
+  virtual uint32_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (uint32_t i) const;
+
+  /**
+   * Get the frequency-dependent propagation loss model.
+   * \returns a pointer to the propagation loss model.
+   */
+  virtual Ptr<SpectrumPropagationLossModel> GetSpectrumPropagationLossModel (void);
+
+  /**
+   * Attach a receiver that gets all transmissions, whatever the LoRaWAN
+   * channel they are sent on (e.g. to measure the noise floor). Retuning the
+   * receiver does not affect this.
+   *
+   * \param phy the receiver
+   */
+  void AddNoiseListener (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Register the LoRaWAN channel a receiver is tuned to. Called by LoRaWANPhy
+   * whenever it is retuned, ignored for receivers that are not attached to
+   * this channel or that listen on all channels.
+   *
+   * \param phy the receiver
+   * \param channelIndex the index in LoRaWAN::m_supportedChannels
+   */
+  void SetRxChannelIndex (Ptr<SpectrumPhy> phy, uint8_t channelIndex);
+
+  /**
+   * \param phy the receiver
+   * \return the registered channel index of the receiver, ALL_CHANNELS for
+   * receivers that listen on all channels
+   */
+  uint8_t GetRxChannelIndex (Ptr<SpectrumPhy> phy) const;
+
+  /**
+   * \return the distance (m) beyond which receivers are culled, or a negative
+   * value when receivers are not culled based on their distance
+   */
+  double GetCullRadius (void);
+
+private:
+  virtual void DoDispose ();
+
+  /**
+   * Attach a receiver and put it in the bucket of a LoRaWAN channel.
+   *
+   * \param phy the receiver
+   * \param channelIndex the index in LoRaWAN::m_supportedChannels, or ALL_CHANNELS
+   */
+  void DoAddRx (Ptr<SpectrumPhy> phy, uint8_t channelIndex);
+
+  /**
+   * \param channelIndex a channel index, or ALL_CHANNELS
+   * \return the bucket of the receivers listening on the channel
+   */
+  std::vector<uint64_t> &GetBucket (uint8_t channelIndex);
+
+  /**
+   * Add a receiver to a bucket.
+   *
+   * \param bucket the bucket
+   * \param rxIndex the index of the receiver in m_phyList
+   */
+  static void SetBucketBit (std::vector<uint64_t> &bucket, uint32_t rxIndex);
+
+  /**
+   * Remove a receiver from a bucket.
+   *
+   * \param bucket the bucket
+   * \param rxIndex the index of the receiver in m_phyList
+   */
+  static void ClearBucketBit (std::vector<uint64_t> &bucket, uint32_t rxIndex);
+
+  /**
+   * Used internally to reschedule transmission after the propagation delay.
+   *
+   * \param params
+   * \param receiver
+   */
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Apply the propagation models for a single receiver and schedule the
+   * reception.
+   *
+   * \param txParams the parameters of the transmission
+   * \param senderMobility the mobility model of the transmitter
+   * \param rxIndex the index of the receiver in m_phyList
+   */
+  void DeliverTo (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility, uint32_t rxIndex);
+
+  /**
+   * Deliver a transmission to the receivers that survive the culling.
+   *
+   * \param txParams the parameters of the transmission
+   * \param senderMobility the mobility model of the transmitter
+   */
+  void DeliverCulled (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility);
+
+  /**
+   * Collect the indices of the receivers in the grid cells within the cull
+   * radius of a position, plus all receivers without mobility model.
+   *
+   * \param position the position of the transmitter
+   * \param candidates the vector the receiver indices are appended to
+   */
+  void GetCandidates (const Vector &position, std::vector<uint32_t> &candidates);
+
+  /**
+   * (Re)build the grid and the cull radius.
+   */
+  void BuildIndex (void);
+
+  /**
+   * Disconnect CourseChanged from the mobility models connected by
+   * BuildIndex.
+   */
+  void DisconnectCourseChanged (void);
+
+  /**
+   * Compute the cull radius from the propagation loss model, or set it to a
+   * negative value when the loss model chain is not known to be
+   * deterministic and non-decreasing with distance.
+   */
+  void ComputeCullRadius (void);
+
+  /**
+   * \param x the x coordinate (m)
+   * \param y the y coordinate (m)
+   * \return the key of the grid cell containing (x, y)
+   */
+  uint64_t GetCellKey (double x, double y) const;
+
+  /**
+   * \param x the grid x coordinate
+   * \param y the grid y coordinate
+   * \return the key of grid cell (x, y)
+   */
+  static uint64_t MakeCellKey (int32_t x, int32_t y);
+
+  /**
+   * \param x the x coordinate (m)
+   * \return the grid coordinate of x
+   */
+  int32_t GetCellCoordinate (double x) const;
+
+  /**
+   * Move a receiver to the grid cell of its new position.
+   *
+   * \param rxIndex the index of the receiver in m_phyList
+   * \param mobility the mobility model of the receiver
+   */
+  void CourseChanged (uint32_t rxIndex, Ptr<const MobilityModel> mobility);
+
+  /// Container: SpectrumPhy objects
+  typedef std::vector<Ptr<SpectrumPhy> > PhyList;
+
+  /**
+   * List of SpectrumPhy instances attached to the channel.
+   */
+  PhyList m_phyList;
+
+  /**
+   * For every entry of m_phyList: the channel index it is registered on.
+   */
+  std::vector<uint8_t> m_rxChannelIndices;
+
+  /**
+   * Index in m_phyList of every receiver.
+   */
+  std::unordered_map<const SpectrumPhy *, uint32_t> m_phyIndices;
+
+  /**
+   * For every LoRaWAN channel: a bitmap of the indices in m_phyList of the
+   * receivers tuned to it. Retuning a receiver flips two bits, and the
+   * receivers of a channel are found in the order of m_phyList.
+   */
+  std::vector<std::vector<uint64_t> > m_channelBuckets;
+
+  /**
+   * Bitmap of the indices of the receivers listening on all channels.
+   */
+  std::vector<uint64_t> m_allChannelBucket;
+
+  /**
+   * SpectrumModel that this channel instance is supporting.
+   */
+  Ptr<const SpectrumModel> m_spectrumModel;
+
+  /**
+   * Propagation delay model to be used with this channel.
+   */
+  Ptr<PropagationDelayModel> m_propagationDelay;
+
+  /**
+   * Single-frequency propagation loss model to be used with this channel.
+   */
+  Ptr<PropagationLossModel> m_propagationLoss;
+
+  /**
+   * Frequency-dependent propagation loss model to be used with this channel.
+   */
+  Ptr<SpectrumPropagationLossModel> m_spectrumPropagationLoss;
+
+  /**
+   * Maximum loss [dB].
+   *
+   * Any device above this loss is considered out of range.
+   */
+  double m_maxLossDb;
+
+  /**
+   * Skip receivers that would discard the transmission anyway.
+   */
+  bool m_receiverCulling;
+
+  /**
+   * Upper bound on the sum of TX and RX antenna gains [dB].
+   */
+  double m_maxAntennaGainDb;
+
+  /**
+   * Width and height of a grid cell [m].
+   */
+  double m_gridCellSize;
+
+  /**
+   * Distance beyond which receivers are culled [m], negative if none.
+   */
+  double m_cullRadius;
+
+  /**
+   * Whether the grid and cull radius have to be rebuilt.
+   */
+  bool m_indexDirty;
+
+  /**
+   * The receivers in each non-empty grid cell, keyed on the cell key.
+   */
+  std::unordered_map<uint64_t, std::vector<uint32_t> > m_grid;
+
+  /**
+   * For every entry of m_phyList: the key of its grid cell.
+   */
+  std::vector<uint64_t> m_cellKeys;
+
+  /**
+   * For every entry of m_phyList: the mobility model CourseChanged is
+   * connected to, null if none.
+   */
+  std::vector<Ptr<MobilityModel> > m_cellMobilities;
+
+  /**
+   * Receivers without a mobility model.
+   */
+  std::vector<uint32_t> m_unlocated;
+
+  /**
+   * Scratch vector with the receivers of the current transmission.
+   */
+  std::vector<uint32_t> m_candidates;
+
+  /**
+   * The PathLoss trace source.
+   */
+  TracedCallback<Ptr<SpectrumPhy>, Ptr<SpectrumPhy>, double > m_pathLossTrace;
+
+  /**
+   * The AvoidedAllocations trace source.
+   */
+  TracedValue<uint64_t> m_avoidedAllocations;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SPECTRUM_CHANNEL_H */
@@ -19,31 +19,125 @@
  */
 #include "lorawan-spectrum-signal-parameters.h"
 #include <ns3/log.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/spectrum-phy.h>
+#include <ns3/antenna-model.h>
+
+#include <vector>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumSignalParameters");
 
+/// Maximum number of free parameters and of free PSDs kept in the pool
+#define LORAWAN_SIGNAL_POOL_SIZE 4096
+
+namespace {
+
+/**
+ * Free lists of LoRaWANSpectrumSignalParameters memory and of PSDs.
+ */
+struct LoRaWANSignalPool
+{
+  std::vector<void*> blocks;               //!< Memory of released parameters
+  std::vector<Ptr<SpectrumValue> > psds;   //!< PSDs of released parameters
+  uint64_t avoidedAllocations;             //!< Number of heap allocations avoided
+
+  LoRaWANSignalPool () : avoidedAllocations (0) {}
+};
+
+LoRaWANSignalPool&
+GetSignalPool (void)
+{
+  // Never destroyed: parameters may still be released during static destruction
+  static LoRaWANSignalPool* pool = new LoRaWANSignalPool ();
+  return *pool;
+}
+
+} // anonymous namespace
+
+void*
+LoRaWANSpectrumSignalParameters::operator new (size_t size)
+{
+  LoRaWANSignalPool& pool = GetSignalPool ();
+  if (size == sizeof (LoRaWANSpectrumSignalParameters) && !pool.blocks.empty ())
+    {
+      void* p = pool.blocks.back ();
+      pool.blocks.pop_back ();
+      pool.avoidedAllocations++;
+      return p;
+    }
+  return ::operator new (size);
+}
+
+void
+LoRaWANSpectrumSignalParameters::operator delete (void* p, size_t size)
+{
+  LoRaWANSignalPool& pool = GetSignalPool ();
+  if (size == sizeof (LoRaWANSpectrumSignalParameters) && pool.blocks.size () < LORAWAN_SIGNAL_POOL_SIZE)
+    {
+      pool.blocks.push_back (p);
+      return;
+    }
+  ::operator delete (p);
+}
+
+uint64_t
+LoRaWANSpectrumSignalParameters::GetAvoidedAllocations (void)
+{
+  return GetSignalPool ().avoidedAllocations;
+}
+
 LoRaWANSpectrumSignalParameters::LoRaWANSpectrumSignalParameters (void)
+  : rxPower (0.0)
 {
   NS_LOG_FUNCTION (this);
 }
 
 LoRaWANSpectrumSignalParameters::LoRaWANSpectrumSignalParameters (const LoRaWANSpectrumSignalParameters& p)
-  : SpectrumSignalParameters (p)
+  : SpectrumSignalParameters ()
 {
   NS_LOG_FUNCTION (this << &p);
+  // Same as the SpectrumSignalParameters copy constructor, but with a pooled PSD
+  LoRaWANSignalPool& pool = GetSignalPool ();
+  if (!pool.psds.empty ())
+    {
+      psd = pool.psds.back ();
+      pool.psds.pop_back ();
+      *psd = *p.psd;
+      // Reusing a PSD saves both the SpectrumValue and its values
+      pool.avoidedAllocations += 2;
+    }
+  else
+    {
+      psd = p.psd->Copy ();
+    }
+  duration = p.duration;
+  txPhy = p.txPhy;
+  txAntenna = p.txAntenna;
   packet = p.packet;
   channelIndex = p.channelIndex;
   dataRateIndex = p.dataRateIndex;
   codeRate = p.codeRate;
+  rxPower = p.rxPower;
+}
+
+LoRaWANSpectrumSignalParameters::~LoRaWANSpectrumSignalParameters ()
+{
+  NS_LOG_FUNCTION (this);
+  LoRaWANSignalPool& pool = GetSignalPool ();
+  if (psd && psd->GetReferenceCount () == 1 && pool.psds.size () < LORAWAN_SIGNAL_POOL_SIZE)
+    {
+      pool.psds.push_back (psd);
+    }
 }
 
 Ptr<SpectrumSignalParameters>
 LoRaWANSpectrumSignalParameters::Copy (void)
 {
   NS_LOG_FUNCTION (this);
-  return Create<LoRaWANSpectrumSignalParameters> (*this);
+  // Create<> would pass *this by value, i.e. make an additional copy
+  return Ptr<LoRaWANSpectrumSignalParameters> (new LoRaWANSpectrumSignalParameters (*this), false);
 }
 
 } // namespace ns3
@@ -30,6 +30,15 @@ namespace ns3 {
  * \ingroup lorawan
  *
  * Signal parameters for LoRaWAN.
+ *
+ * A transmission creates one instance of these parameters plus one copy per
+ * receiver, each with its own PSD. To avoid a heap allocation for every one
+ * of them, released instances are kept in a pool and reused by the next
+ * Create<LoRaWANSpectrumSignalParameters> (class specific operator new and
+ * delete). The PSD of a released instance is pooled as well if no one else
+ * holds a reference to it, and is reused by Copy. Both pools are bounded, so
+ * that the memory held is proportional to the peak number of signals in
+ * flight.
  */
 struct LoRaWANSpectrumSignalParameters : public SpectrumSignalParameters
 {
@@ -37,6 +46,28 @@ struct LoRaWANSpectrumSignalParameters : public SpectrumSignalParameters
   // inherited from SpectrumSignalParameters
   virtual Ptr<SpectrumSignalParameters> Copy (void);
 
+  /**
+   * Allocate memory from the pool.
+   *
+   * \param size the size of the object
+   * \return the memory for the object
+   */
+  static void* operator new (size_t size);
+
+  /**
+   * Return memory to the pool.
+   *
+   * \param p the memory of the object
+   * \param size the size of the object
+   */
+  static void operator delete (void* p, size_t size);
+
+  /**
+   * \return the number of heap allocations that were avoided by reusing
+   * pooled parameters and PSDs, since the start of the program
+   */
+  static uint64_t GetAvoidedAllocations (void);
+
   /**
    * default constructor
    */
@@ -47,6 +78,11 @@ struct LoRaWANSpectrumSignalParameters : public SpectrumSignalParameters
    */
   LoRaWANSpectrumSignalParameters (const LoRaWANSpectrumSignalParameters& p);
 
+  /**
+   * destructor, returns the PSD to the pool if it is no longer referenced
+   */
+  virtual ~LoRaWANSpectrumSignalParameters ();
+
   /**
    * The packet being transmitted with this signal
    */
@@ -66,6 +102,12 @@ struct LoRaWANSpectrumSignalParameters : public SpectrumSignalParameters
    * The code rate of the transmission
    */
   uint8_t codeRate;
+
+  /**
+   * The in-band power (W) of psd in the channel of the transmission. Filled in
+   * by the receiving LoRaWANPhy when it operates in scalar SINR mode.
+   */
+  double rxPower;
 };
 
 }  // namespace ns3
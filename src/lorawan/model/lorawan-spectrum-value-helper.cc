@@ -29,53 +29,37 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumValueHelper");
 
 Ptr<SpectrumModel> g_LoRaWANSpectrumModel; //!< Global object that stores the LoRaWAN Spectrum Model
+LoRaWANRegion g_LoRaWANSpectrumModelRegion; //!< The region of g_LoRaWANSpectrumModel
 
 /**
  * \ingroup lorawan
- * \brief Helper class used to automatically initialize the LoRaWAN Spectrum Model objects
+ * \brief Get the LoRaWAN Spectrum Model, which has one band per channel of
+ * the current region (e.g. for EU863-870 the three default 125kHz data
+ * channels, four more 125kHz channels and the high power (27dBm) channel on
+ * 869.525MHz). The model is rebuilt when the region changes.
+ * \return the spectrum model
  */
-class LoRaWANSpectrumModelInitializer
+Ptr<SpectrumModel>
+GetLoRaWANSpectrumModel (void)
 {
-public:
-  LoRaWANSpectrumModelInitializer(void)
-  {
-    NS_LOG_FUNCTION (this);
-
-    Bands bands;
-    // The three default 125kHz data channels available in EU863-870:
-    // 868.10, 868.30 & 868.50MHz
-    for (int i = 0; i < 3; i++)
-      {
-        BandInfo bi;
-        bi.fc = 868.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // Four 125kHz channels available in EU863-870:
-    // 867.10, 867.30 & 867.50 & 867.70MHz
-    for (int i = 0; i < 4; i++)
-      {
-        BandInfo bi;
-        bi.fc = 867.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // One 125kHz high power (27dBm) channel on 869.525MHz
+  if (g_LoRaWANSpectrumModel == 0 || g_LoRaWANSpectrumModelRegion != LoRaWAN::GetRegion ())
     {
-        BandInfo bi;
-        bi.fc = 869.525e6;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
+      NS_LOG_FUNCTION ("GetLoRaWANSpectrumModel");
+
+      Bands bands;
+      for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++)
+        {
+          BandInfo bi;
+          bi.fc = LoRaWAN::m_supportedChannels[i].m_fc;
+          bi.fl = bi.fc - LoRaWAN::m_supportedChannels[i].m_bw / 2.0;
+          bi.fh = bi.fc + LoRaWAN::m_supportedChannels[i].m_bw / 2.0;
+          bands.push_back (bi);
+        }
+      g_LoRaWANSpectrumModel = Create<SpectrumModel> (bands);
+      g_LoRaWANSpectrumModelRegion = LoRaWAN::GetRegion ();
     }
-    g_LoRaWANSpectrumModel = Create<SpectrumModel> (bands);
-  }
-
-} g_LoRaWANSpectrumModelInitializerInstance; //!< Global object used to initialize the LoRaWAN Spectrum Model
+  return g_LoRaWANSpectrumModel;
+}
 
 /* ... */
 LoRaWANSpectrumValueHelper::LoRaWANSpectrumValueHelper(void)
@@ -98,18 +82,20 @@ LoRaWANSpectrumValueHelper::CreateTxPowerSpectralDensity (double txPower, uint32
   // Should make a simplification: e.g. power density is constant for a 125kHz
   // region and then we have some roll-off nearby... Didn't really find
   // anything in semtech docs, TODO: measure
-  // For now: assume constant SPD over 125kHz bandwidth of channel and assume
-  // all signal power is concentrated in the channel
+  // For now: assume constant SPD over the bandwidth of the channel (125kHz,
+  // or 500kHz for the wide US902-928 channels) and assume all signal power is
+  // concentrated in the channel
 
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
 
   // txPower is expressed in dBm. We must convert it into natural unit (W).
   txPower = pow (10.0, (txPower - 30) / 10);
 
-  double txPowerDensity = txPower / 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq);
+  double txPowerDensity = txPower / LoRaWAN::m_supportedChannels[index].m_bw;
 
-  (*txPsd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)] = txPowerDensity;
+  (*txPsd)[index] = txPowerDensity;
 
   return txPsd;
 }
@@ -119,7 +105,7 @@ LoRaWANSpectrumValueHelper::CreateNoisePowerSpectralDensity (uint32_t freq)
 {
   // TODO
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
 
   static const double BOLTZMANN = 1.3803e-23;
   // Nt  is the power of thermal noise in W
@@ -157,16 +143,18 @@ double
 LoRaWANSpectrumValueHelper::TotalAvgPower (Ptr<const SpectrumValue> psd, uint32_t freq)
 {
   NS_LOG_FUNCTION (psd);
-  double totalAvgPower = 0.0;
-
-  NS_ASSERT (psd->GetSpectrumModel () == g_LoRaWANSpectrumModel);
 
-  // numerically integrate to get area under psd using 125kHz resolution
+  NS_ASSERT (psd->GetSpectrumModel () == GetLoRaWANSpectrumModel ());
 
-  totalAvgPower += (*psd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)];
-  totalAvgPower *= 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq);
+  return TotalAvgPower ((*psd)[index], LoRaWAN::m_supportedChannels[index].m_bw);
+}
 
-  return totalAvgPower;
+double
+LoRaWANSpectrumValueHelper::TotalAvgPower (double psdValue, double bandwidth)
+{
+  // the PSD is constant over the band of the channel
+  return psdValue * bandwidth;
 }
 
 } // namespace ns3
@@ -63,6 +63,17 @@ public:
    */
   static double TotalAvgPower (Ptr<const SpectrumValue> psd, uint32_t channel);
 
+  /**
+   * \brief total average power of a single PSD value over the bandwidth of a
+   * LoRaWAN channel. This is the scalar form of TotalAvgPower, it returns
+   * exactly the same result for the value and the bandwidth of the channel's
+   * band.
+   * \param psdValue the power spectral density in the band of the channel (W/Hz)
+   * \param bandwidth the bandwidth of the channel (Hz), m_bw in the channel plan
+   * \return total power (W)
+   */
+  static double TotalAvgPower (double psdValue, double bandwidth);
+
 private:
   static uint32_t GetPsdIndexForCenterFrequency(uint32_t freq);
   /**
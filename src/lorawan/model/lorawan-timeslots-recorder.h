@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_TIMESLOTS_RECORDER_H
+#define LORAWAN_TIMESLOTS_RECORDER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief The timeslots of a period in which an end device transmitted.
+ *
+ * An end device transmits in a handful of the up to 63552 timeslots of a
+ * period, so the recorder keeps the sorted list of those slots instead of a
+ * byte per slot: four bytes per transmission rather than 62 kB per DR5 end
+ * device. The slots of a period are recorded in increasing order, which
+ * makes recording a slot O(1). Unpack expands the list into the 0/1 sequence
+ * the periodicity detector works on.
+ */
+class LoRaWANTimeslotsRecorder
+{
+public:
+  /**
+   * \param size the number of slots in the period
+   */
+  explicit LoRaWANTimeslotsRecorder (uint32_t size = 0)
+    : m_size (size)
+  {
+  }
+
+  /**
+   * Forget all transmissions, keeping the memory of the list.
+   *
+   * \param size the number of slots in the new period
+   */
+  void Reset (uint32_t size)
+  {
+    m_size = size;
+    m_slots.clear ();
+  }
+
+  /**
+   * \return the number of slots in the period
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * Record a transmission.
+   *
+   * \param slot the slot of the transmission
+   * \return false if the slot is not in the period
+   */
+  bool Record (uint32_t slot)
+  {
+    if (slot >= m_size)
+      {
+        return false;
+      }
+    if (m_slots.empty () || slot > m_slots.back ())
+      {
+        m_slots.push_back (slot);
+      }
+    else
+      {
+        std::vector<uint32_t>::iterator it = std::lower_bound (m_slots.begin (), m_slots.end (), slot);
+        if (*it != slot)
+          {
+            m_slots.insert (it, slot);
+          }
+      }
+    return true;
+  }
+
+  /**
+   * \param slot a slot of the period
+   * \return true if a transmission was recorded in the slot
+   */
+  bool IsRecorded (uint32_t slot) const
+  {
+    return std::binary_search (m_slots.begin (), m_slots.end (), slot);
+  }
+
+  /**
+   * \return the slots with a transmission, in increasing order
+   */
+  const std::vector<uint32_t> &GetSlots (void) const
+  {
+    return m_slots;
+  }
+
+  /**
+   * Expand the recorder into a sequence of GetSize () bytes, 1 for the slots
+   * with a transmission and 0 for the others.
+   *
+   * \param sequence receives the sequence, its memory is reused
+   */
+  void Unpack (std::vector<unsigned char> &sequence) const
+  {
+    sequence.assign (m_size, 0);
+    for (uint32_t i = 0; i < m_slots.size (); i++)
+      {
+        sequence[m_slots[i]] = 1;
+      }
+  }
+
+private:
+  uint32_t m_size;               //!< The number of slots in the period
+  std::vector<uint32_t> m_slots; //!< The slots with a transmission, sorted
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_TIMESLOTS_RECORDER_H */
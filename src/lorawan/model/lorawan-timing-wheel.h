@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_TIMING_WHEEL_H
+#define LORAWAN_TIMING_WHEEL_H
+
+#include <ns3/assert.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Single level timing wheel of 32 bit identifiers.
+ *
+ * Time is divided in ticks, and an identifier is inserted with the tick at
+ * which it expires. The wheel has a fixed number of buckets and tick t is
+ * stored in bucket t modulo the number of buckets, so all pending ticks have
+ * to lie within one revolution of the earliest pending tick. Inserting is
+ * O(1), finding the earliest pending tick is O(number of buckets).
+ *
+ * The identifiers of a tick are popped in the order they were inserted. The
+ * buckets keep their capacity once popped, so a wheel that reached its
+ * steady state does not allocate memory.
+ */
+class LoRaWANTimingWheel
+{
+public:
+  /**
+   * \param nBuckets the number of buckets, i.e. the number of distinct ticks
+   * that can be pending at the same time
+   */
+  explicit LoRaWANTimingWheel (uint32_t nBuckets = 8)
+    : m_buckets (nBuckets),
+      m_cursor (0),
+      m_size (0)
+  {
+    NS_ASSERT (nBuckets > 0);
+  }
+
+  /**
+   * \return the number of buckets
+   */
+  uint32_t GetNBuckets (void) const
+  {
+    return m_buckets.size ();
+  }
+
+  /**
+   * \return true if no identifier is pending
+   */
+  bool IsEmpty (void) const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * \return the number of pending identifiers
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * Insert an identifier.
+   *
+   * \param tick the tick at which the identifier expires, which must not be
+   * before the earliest pending tick and must be less than one revolution
+   * after it
+   * \param id the identifier
+   */
+  void Insert (uint64_t tick, uint32_t id)
+  {
+    if (m_size == 0)
+      {
+        m_cursor = tick;
+      }
+    else if (tick < m_cursor)
+      {
+        // The new tick becomes the earliest one, all pending ticks have to
+        // stay within one revolution of it
+        NS_ASSERT_MSG (GetLastTick () - tick < m_buckets.size (), "Tick " << tick << " is too far from the pending ticks");
+        m_cursor = tick;
+      }
+    NS_ASSERT_MSG (tick - m_cursor < m_buckets.size (), "Tick " << tick << " is more than one revolution after tick " << m_cursor);
+    m_buckets[tick % m_buckets.size ()].push_back (id);
+    m_size++;
+  }
+
+  /**
+   * \return the earliest pending tick, the wheel must not be empty
+   */
+  uint64_t GetNextTick (void) const
+  {
+    NS_ASSERT (m_size > 0);
+    return m_cursor;
+  }
+
+  /**
+   * Remove the identifiers of the earliest pending tick.
+   *
+   * \param ids receives the identifiers in insertion order, its previous
+   * content is discarded
+   * \return the tick of the identifiers
+   */
+  uint64_t PopNextTick (std::vector<uint32_t> &ids)
+  {
+    NS_ASSERT (m_size > 0);
+    const uint64_t tick = m_cursor;
+    std::vector<uint32_t> &bucket = m_buckets[tick % m_buckets.size ()];
+    ids.clear ();
+    ids.swap (bucket);
+    m_size -= ids.size ();
+    if (m_size > 0)
+      {
+        do
+          {
+            m_cursor++;
+          }
+        while (m_buckets[m_cursor % m_buckets.size ()].empty ());
+      }
+    return tick;
+  }
+
+  /**
+   * Remove all identifiers.
+   */
+  void Clear (void)
+  {
+    for (uint32_t b = 0; b < m_buckets.size (); b++)
+      {
+        m_buckets[b].clear ();
+      }
+    m_size = 0;
+  }
+
+private:
+  /**
+   * \return the latest pending tick
+   */
+  uint64_t GetLastTick (void) const
+  {
+    uint64_t tick = m_cursor + m_buckets.size () - 1;
+    while (m_buckets[tick % m_buckets.size ()].empty ())
+      {
+        tick--;
+      }
+    return tick;
+  }
+
+  std::vector<std::vector<uint32_t> > m_buckets; //!< The identifiers of tick t, in bucket t modulo the number of buckets
+  uint64_t m_cursor; //!< The earliest pending tick, if any
+  uint32_t m_size;   //!< The number of pending identifiers
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_TIMING_WHEEL_H */
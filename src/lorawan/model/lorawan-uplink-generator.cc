@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-uplink-generator.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/trace-source-accessor.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANUplinkGenerator");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANUplinkGenerator);
+
+const uint32_t LoRaWANUplinkGenerator::NOT_PENDING;
+
+LoRaWANUplinkSource::~LoRaWANUplinkSource ()
+{
+}
+
+TypeId
+LoRaWANUplinkGenerator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANUplinkGenerator")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANUplinkGenerator> ()
+    .AddTraceSource ("Batch",
+                     "A batch of end devices was dispatched",
+                     MakeTraceSourceAccessor (&LoRaWANUplinkGenerator::m_batchTrace),
+                     "ns3::LoRaWANUplinkGenerator::BatchTracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANUplinkGenerator::LoRaWANUplinkGenerator ()
+  : m_eventTime (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANUplinkGenerator::~LoRaWANUplinkGenerator ()
+{
+}
+
+void
+LoRaWANUplinkGenerator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_event);
+  m_txTime.clear ();
+  m_heapPosition.clear ();
+  m_sources.clear ();
+  m_ids.clear ();
+  m_heap.clear ();
+  m_batch.clear ();
+  Object::DoDispose ();
+}
+
+uint32_t
+LoRaWANUplinkGenerator::AddDevice (LoRaWANUplinkSource *source, uint32_t id)
+{
+  NS_LOG_FUNCTION (this << source << id);
+  NS_ASSERT (source);
+  m_txTime.push_back (0);
+  m_heapPosition.push_back (NOT_PENDING);
+  m_sources.push_back (source);
+  m_ids.push_back (id);
+  return m_sources.size () - 1;
+}
+
+void
+LoRaWANUplinkGenerator::RemoveDevice (uint32_t index)
+{
+  NS_LOG_FUNCTION (this << index);
+  if (index >= m_sources.size ())
+    {
+      return; // the generator was disposed
+    }
+  Cancel (index);
+  m_sources[index] = 0;
+}
+
+void
+LoRaWANUplinkGenerator::Schedule (uint32_t index, Time delay)
+{
+  NS_LOG_FUNCTION (this << index << delay);
+  NS_ASSERT (index < m_sources.size () && m_sources[index]);
+  NS_ASSERT (!delay.IsStrictlyNegative ());
+
+  m_txTime[index] = (Simulator::Now () + delay).GetTimeStep ();
+  if (m_heapPosition[index] == NOT_PENDING)
+    {
+      HeapPush (index);
+    }
+  else
+    {
+      // The new time can be earlier or later than the old one
+      SiftUp (m_heapPosition[index]);
+      SiftDown (m_heapPosition[index]);
+    }
+  UpdateEvent ();
+}
+
+void
+LoRaWANUplinkGenerator::Cancel (uint32_t index)
+{
+  NS_LOG_FUNCTION (this << index);
+  NS_ASSERT (index < m_sources.size ());
+  if (m_heapPosition[index] != NOT_PENDING)
+    {
+      HeapRemove (m_heapPosition[index]);
+      UpdateEvent ();
+    }
+}
+
+bool
+LoRaWANUplinkGenerator::IsPending (uint32_t index) const
+{
+  NS_ASSERT (index < m_sources.size ());
+  return m_heapPosition[index] != NOT_PENDING;
+}
+
+uint32_t
+LoRaWANUplinkGenerator::GetNPending (void) const
+{
+  return m_heap.size ();
+}
+
+void
+LoRaWANUplinkGenerator::UpdateEvent (void)
+{
+  if (m_heap.empty ())
+    {
+      Simulator::Cancel (m_event);
+      return;
+    }
+
+  const int64_t first = m_txTime[m_heap[0]];
+  if (m_event.IsRunning () && m_eventTime == first)
+    {
+      return;
+    }
+  Simulator::Cancel (m_event);
+  m_eventTime = first;
+  m_event = Simulator::Schedule (TimeStep (first) - Simulator::Now (), &LoRaWANUplinkGenerator::Dispatch, this);
+}
+
+void
+LoRaWANUplinkGenerator::Dispatch (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Take the due devices out of the calendar first, so that the devices can
+  // schedule their next transmission while the batch is dispatched
+  const int64_t now = Simulator::Now ().GetTimeStep ();
+  m_batch.clear ();
+  while (!m_heap.empty () && m_txTime[m_heap[0]] <= now)
+    {
+      m_batch.push_back (m_heap[0]);
+      HeapRemove (0);
+    }
+  NS_LOG_DEBUG (this << " dispatching " << m_batch.size () << " devices");
+  m_batchTrace (Simulator::Now (), m_batch.size ());
+
+  for (std::vector<uint32_t>::const_iterator it = m_batch.begin (); it != m_batch.end (); ++it)
+    {
+      // A device can be removed by the transmission of an earlier one
+      if (m_sources[*it])
+        {
+          m_sources[*it]->SendUplink (m_ids[*it]);
+        }
+    }
+  UpdateEvent ();
+}
+
+bool
+LoRaWANUplinkGenerator::Before (uint32_t a, uint32_t b) const
+{
+  return m_txTime[a] < m_txTime[b] || (m_txTime[a] == m_txTime[b] && a < b);
+}
+
+void
+LoRaWANUplinkGenerator::HeapSet (uint32_t heapPosition, uint32_t index)
+{
+  m_heap[heapPosition] = index;
+  m_heapPosition[index] = heapPosition;
+}
+
+void
+LoRaWANUplinkGenerator::HeapPush (uint32_t index)
+{
+  m_heap.push_back (index);
+  m_heapPosition[index] = m_heap.size () - 1;
+  SiftUp (m_heap.size () - 1);
+}
+
+void
+LoRaWANUplinkGenerator::HeapRemove (uint32_t heapPosition)
+{
+  NS_ASSERT (heapPosition < m_heap.size ());
+  m_heapPosition[m_heap[heapPosition]] = NOT_PENDING;
+  const uint32_t last = m_heap.back ();
+  m_heap.pop_back ();
+  if (heapPosition < m_heap.size ())
+    {
+      HeapSet (heapPosition, last);
+      SiftUp (heapPosition);
+      SiftDown (m_heapPosition[last]);
+    }
+}
+
+void
+LoRaWANUplinkGenerator::SiftUp (uint32_t heapPosition)
+{
+  const uint32_t index = m_heap[heapPosition];
+  while (heapPosition > 0)
+    {
+      const uint32_t parent = (heapPosition - 1) / 2;
+      if (!Before (index, m_heap[parent]))
+        {
+          break;
+        }
+      HeapSet (heapPosition, m_heap[parent]);
+      heapPosition = parent;
+    }
+  HeapSet (heapPosition, index);
+}
+
+void
+LoRaWANUplinkGenerator::SiftDown (uint32_t heapPosition)
+{
+  const uint32_t index = m_heap[heapPosition];
+  const uint32_t size = m_heap.size ();
+  while (2 * heapPosition + 1 < size)
+    {
+      uint32_t child = 2 * heapPosition + 1;
+      if (child + 1 < size && Before (m_heap[child + 1], m_heap[child]))
+        {
+          child++;
+        }
+      if (!Before (m_heap[child], index))
+        {
+          break;
+        }
+      HeapSet (heapPosition, m_heap[child]);
+      heapPosition = child;
+    }
+  HeapSet (heapPosition, index);
+}
+
+} // namespace ns3
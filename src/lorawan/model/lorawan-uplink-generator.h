@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_UPLINK_GENERATOR_H
+#define LORAWAN_UPLINK_GENERATOR_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/traced-callback.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Interface of the end devices whose upstream transmissions are
+ * scheduled by a LoRaWANUplinkGenerator.
+ */
+class LoRaWANUplinkSource
+{
+public:
+  virtual ~LoRaWANUplinkSource ();
+
+  /**
+   * Send the upstream transmission that is due now.
+   *
+   * \param id the identifier of the end device, as passed to
+   * LoRaWANUplinkGenerator::AddDevice
+   */
+  virtual void SendUplink (uint32_t id) = 0;
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Population level source of the upstream transmissions of end device
+ * applications.
+ *
+ * Without a generator, every LoRaWANEndDeviceApplication keeps its own
+ * SendPacket event in the simulator's scheduler. End device applications
+ * whose UplinkGenerator attribute points to a generator, and the end devices
+ * of a LoRaWANEndDevicePopulation, hand their next transmission time to the
+ * generator instead. The generator keeps the next transmission time of all
+ * its devices in one calendar: a struct of arrays indexed by device, with a
+ * binary min-heap of device indices on top of it. Only the earliest
+ * transmission is scheduled in the simulator. When it expires, all devices
+ * that are due at that time are dispatched as one batch, in the order they
+ * were added.
+ *
+ * The generator does not change when devices transmit, only how the
+ * transmissions are scheduled.
+ */
+class LoRaWANUplinkGenerator : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANUplinkGenerator ();
+  virtual ~LoRaWANUplinkGenerator ();
+
+  /**
+   * Add a device to the calendar, without scheduling a transmission.
+   *
+   * \param source the source of the transmissions of the device, which has
+   * to remove the device before it is destroyed
+   * \param id the identifier of the device that is passed to the source
+   * \return the index of the device in the generator
+   */
+  uint32_t AddDevice (LoRaWANUplinkSource *source, uint32_t id = 0);
+
+  /**
+   * Remove a device from the calendar. Its index is not reused.
+   *
+   * \param index the index returned by AddDevice
+   */
+  void RemoveDevice (uint32_t index);
+
+  /**
+   * Schedule the next transmission of a device, replacing the pending one if
+   * any.
+   *
+   * \param index the index returned by AddDevice
+   * \param delay the time until the transmission
+   */
+  void Schedule (uint32_t index, Time delay);
+
+  /**
+   * Cancel the pending transmission of a device, if any.
+   *
+   * \param index the index returned by AddDevice
+   */
+  void Cancel (uint32_t index);
+
+  /**
+   * \param index the index returned by AddDevice
+   * \return true if the device has a pending transmission
+   */
+  bool IsPending (uint32_t index) const;
+
+  /**
+   * \return the number of devices with a pending transmission
+   */
+  uint32_t GetNPending (void) const;
+
+  /**
+   * TracedCallback signature for dispatched batches.
+   *
+   * \param [in] time the time of the transmissions
+   * \param [in] size the number of devices in the batch
+   */
+  typedef void (* BatchTracedCallback)(Time time, uint32_t size);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Send the transmissions of all devices that are due now.
+   */
+  void Dispatch (void);
+
+  /**
+   * (Re)schedule the dispatch event for the earliest transmission.
+   */
+  void UpdateEvent (void);
+
+  /**
+   * \return true if device a has to be dispatched before device b
+   */
+  bool Before (uint32_t a, uint32_t b) const;
+  void HeapPush (uint32_t index);
+  void HeapRemove (uint32_t heapPosition);
+  void SiftUp (uint32_t heapPosition);
+  void SiftDown (uint32_t heapPosition);
+  void HeapSet (uint32_t heapPosition, uint32_t index);
+
+  static const uint32_t NOT_PENDING = 0xffffffff;
+
+  // The calendar, indexed by device
+  std::vector<int64_t> m_txTime;                      //!< The time step of the next transmission
+  std::vector<uint32_t> m_heapPosition;               //!< The position in m_heap, NOT_PENDING if none
+  std::vector<LoRaWANUplinkSource *> m_sources;       //!< The sources, 0 once removed
+  std::vector<uint32_t> m_ids;                        //!< The identifiers passed to the sources
+
+  std::vector<uint32_t> m_heap;  //!< Min-heap of the indices of the pending devices
+  std::vector<uint32_t> m_batch; //!< The devices being dispatched
+  EventId m_event;               //!< The dispatch event
+  int64_t m_eventTime;           //!< The time step of m_event
+
+  /**
+   * Trace of the dispatched batches.
+   */
+  TracedCallback<Time, uint32_t> m_batchTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_UPLINK_GENERATOR_H */
@@ -19,6 +19,11 @@
  */
 #include "lorawan.h"
 #include <ns3/log.h>
+#include <ns3/global-value.h>
+#include <ns3/enum.h>
+#include <ns3/random-variable-stream.h>
+
+#include <algorithm>
 
 namespace ns3 {
 
@@ -26,19 +31,33 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWAN");
 
 /* ... */
 
-const std::vector<LoRaWANChannel> LoRaWAN::m_supportedChannels = {
-  {0, 868100000, 125000, 1},
-  {1, 868300000, 125000, 1},
-  {2, 868500000, 125000, 1},
-  {3, 867100000, 125000, 1},
-  {4, 867300000, 125000, 1},
-  {5, 867500000, 125000, 1},
-  {6, 867700000, 125000, 1},
-  // {7, 867900000, 125000, 1}, // sacrifice for high power channel on 869525000
-  {7, 869525000, 125000, 3}, // NOTE: always keep this special high power channel as the last element in the m_supportedChannels vector
+namespace {
+
+/**
+ * \return the number of elements of a table
+ */
+template <typename T, std::size_t N>
+constexpr uint8_t
+TableSize (const T (&)[N])
+{
+  return N;
+}
+
+// EU863-870
+
+constexpr LoRaWANChannel g_eu868Channels[] = {
+  {0, 868100000, 125000, 1, 0, 6},
+  {1, 868300000, 125000, 1, 0, 6},
+  {2, 868500000, 125000, 1, 0, 6},
+  {3, 867100000, 125000, 1, 0, 6},
+  {4, 867300000, 125000, 1, 0, 6},
+  {5, 867500000, 125000, 1, 0, 6},
+  {6, 867700000, 125000, 1, 0, 6},
+  // {7, 867900000, 125000, 1, 0, 6}, // sacrifice for high power channel on 869525000
+  {7, 869525000, 125000, 3, 0, 6}, // NOTE: always keep this special high power channel as the last element in the m_supportedChannels vector
 };
 
-const std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates = {
+constexpr LoRaWANDataRate g_eu868DataRates[] = {
   {0, LORAWAN_SF12, 125000},
   {1, LORAWAN_SF11, 125000},
   {2, LORAWAN_SF10, 125000},
@@ -48,22 +67,431 @@ const std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates = {
   {6, LORAWAN_SF7, 250000}
 }; // other indexes are RFU
 
-uint8_t LoRaWAN::m_RW2ChannelIndex = LoRaWAN::m_supportedChannels.size () - 1; // high power channel, assume this is last channel in m_supportedChannels
-uint8_t LoRaWAN::m_RW2DataRateIndex = 0; // lowest spreading factor
+constexpr uint8_t g_eu868MaxMACPayloadSize[] = {59, 59, 59, 123, 230, 230, 230}; // we don't take the FSK row (for DR7) into account
+
+constexpr LoRaWANSubBandLimits g_eu868SubBands[] = {
+  {100, 14}, // g(Note 7), 14dBm?
+  {100, 14}, // 1%
+  {1000, 14}, // 0.1%
+  {10, 27}, // 10%, high power subband
+  {100, 14}, // 1%
+};
+
+// As per LoRaWAN $7.1.3, 27 dBm for the high power sub band
+constexpr int8_t g_eu868TxPowers[] = {27, 20, 14, 11, 8, 5, 2};
+
+constexpr uint8_t g_eu868GatewayChannels[] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+// US902-928: 64 upstream 125 kHz channels, 8 upstream 500 kHz channels and
+// 8 downstream 500 kHz channels. There is no duty cycle limit (the dwell time
+// limit is not modelled).
+
+constexpr LoRaWANChannel g_us915Channels[] = {
+  {0, 902300000, 125000, 0, 0, 3},
+  {1, 902500000, 125000, 0, 0, 3},
+  {2, 902700000, 125000, 0, 0, 3},
+  {3, 902900000, 125000, 0, 0, 3},
+  {4, 903100000, 125000, 0, 0, 3},
+  {5, 903300000, 125000, 0, 0, 3},
+  {6, 903500000, 125000, 0, 0, 3},
+  {7, 903700000, 125000, 0, 0, 3},
+  {8, 903900000, 125000, 0, 0, 3},
+  {9, 904100000, 125000, 0, 0, 3},
+  {10, 904300000, 125000, 0, 0, 3},
+  {11, 904500000, 125000, 0, 0, 3},
+  {12, 904700000, 125000, 0, 0, 3},
+  {13, 904900000, 125000, 0, 0, 3},
+  {14, 905100000, 125000, 0, 0, 3},
+  {15, 905300000, 125000, 0, 0, 3},
+  {16, 905500000, 125000, 0, 0, 3},
+  {17, 905700000, 125000, 0, 0, 3},
+  {18, 905900000, 125000, 0, 0, 3},
+  {19, 906100000, 125000, 0, 0, 3},
+  {20, 906300000, 125000, 0, 0, 3},
+  {21, 906500000, 125000, 0, 0, 3},
+  {22, 906700000, 125000, 0, 0, 3},
+  {23, 906900000, 125000, 0, 0, 3},
+  {24, 907100000, 125000, 0, 0, 3},
+  {25, 907300000, 125000, 0, 0, 3},
+  {26, 907500000, 125000, 0, 0, 3},
+  {27, 907700000, 125000, 0, 0, 3},
+  {28, 907900000, 125000, 0, 0, 3},
+  {29, 908100000, 125000, 0, 0, 3},
+  {30, 908300000, 125000, 0, 0, 3},
+  {31, 908500000, 125000, 0, 0, 3},
+  {32, 908700000, 125000, 0, 0, 3},
+  {33, 908900000, 125000, 0, 0, 3},
+  {34, 909100000, 125000, 0, 0, 3},
+  {35, 909300000, 125000, 0, 0, 3},
+  {36, 909500000, 125000, 0, 0, 3},
+  {37, 909700000, 125000, 0, 0, 3},
+  {38, 909900000, 125000, 0, 0, 3},
+  {39, 910100000, 125000, 0, 0, 3},
+  {40, 910300000, 125000, 0, 0, 3},
+  {41, 910500000, 125000, 0, 0, 3},
+  {42, 910700000, 125000, 0, 0, 3},
+  {43, 910900000, 125000, 0, 0, 3},
+  {44, 911100000, 125000, 0, 0, 3},
+  {45, 911300000, 125000, 0, 0, 3},
+  {46, 911500000, 125000, 0, 0, 3},
+  {47, 911700000, 125000, 0, 0, 3},
+  {48, 911900000, 125000, 0, 0, 3},
+  {49, 912100000, 125000, 0, 0, 3},
+  {50, 912300000, 125000, 0, 0, 3},
+  {51, 912500000, 125000, 0, 0, 3},
+  {52, 912700000, 125000, 0, 0, 3},
+  {53, 912900000, 125000, 0, 0, 3},
+  {54, 913100000, 125000, 0, 0, 3},
+  {55, 913300000, 125000, 0, 0, 3},
+  {56, 913500000, 125000, 0, 0, 3},
+  {57, 913700000, 125000, 0, 0, 3},
+  {58, 913900000, 125000, 0, 0, 3},
+  {59, 914100000, 125000, 0, 0, 3},
+  {60, 914300000, 125000, 0, 0, 3},
+  {61, 914500000, 125000, 0, 0, 3},
+  {62, 914700000, 125000, 0, 0, 3},
+  {63, 914900000, 125000, 0, 0, 3},
+  {64, 903000000, 500000, 0, 4, 4},
+  {65, 904600000, 500000, 0, 4, 4},
+  {66, 906200000, 500000, 0, 4, 4},
+  {67, 907800000, 500000, 0, 4, 4},
+  {68, 909400000, 500000, 0, 4, 4},
+  {69, 911000000, 500000, 0, 4, 4},
+  {70, 912600000, 500000, 0, 4, 4},
+  {71, 914200000, 500000, 0, 4, 4},
+  {72, 923300000, 500000, 0, 8, 13}, // downstream
+  {73, 923900000, 500000, 0, 8, 13}, // downstream
+  {74, 924500000, 500000, 0, 8, 13}, // downstream
+  {75, 925100000, 500000, 0, 8, 13}, // downstream
+  {76, 925700000, 500000, 0, 8, 13}, // downstream
+  {77, 926300000, 500000, 0, 8, 13}, // downstream
+  {78, 926900000, 500000, 0, 8, 13}, // downstream
+  {79, 927500000, 500000, 0, 8, 13}, // downstream
+};
+
+constexpr LoRaWANDataRate g_us915DataRates[] = {
+  {0, LORAWAN_SF10, 125000},
+  {1, LORAWAN_SF9, 125000},
+  {2, LORAWAN_SF8, 125000},
+  {3, LORAWAN_SF7, 125000},
+  {4, LORAWAN_SF8, 500000},
+  {5, LORAWAN_SF7, 0}, // RFU
+  {6, LORAWAN_SF7, 0}, // RFU
+  {7, LORAWAN_SF7, 0}, // RFU
+  {8, LORAWAN_SF12, 500000},
+  {9, LORAWAN_SF11, 500000},
+  {10, LORAWAN_SF10, 500000},
+  {11, LORAWAN_SF9, 500000},
+  {12, LORAWAN_SF8, 500000},
+  {13, LORAWAN_SF7, 500000}
+};
+
+constexpr uint8_t g_us915MaxMACPayloadSize[] = {19, 61, 133, 250, 250, 0, 0, 0, 61, 137, 250, 250, 250, 250};
+
+constexpr LoRaWANSubBandLimits g_us915SubBands[] = {
+  {1, 30},
+};
+
+// 30 dBm down to 10 dBm in steps of 2 dB
+constexpr int8_t g_us915TxPowers[] = {30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10};
+
+// Gateways listen on the second sub band of eight 125 kHz channels and its
+// 500 kHz channel, like most 8 channel US915 gateways
+constexpr uint8_t g_us915GatewayChannels[] = {8, 9, 10, 11, 12, 13, 14, 15, 65, 72, 73, 74, 75, 76, 77, 78, 79};
+
+// AS923, without dwell time limits
+
+constexpr LoRaWANChannel g_as923Channels[] = {
+  {0, 923200000, 125000, 0, 0, 6},
+  {1, 923400000, 125000, 0, 0, 6},
+  {2, 922000000, 125000, 0, 0, 6},
+  {3, 922200000, 125000, 0, 0, 6},
+  {4, 922400000, 125000, 0, 0, 6},
+  {5, 922600000, 125000, 0, 0, 6},
+  {6, 922800000, 125000, 0, 0, 6},
+  {7, 923000000, 125000, 0, 0, 6},
+};
+
+constexpr uint8_t g_as923MaxMACPayloadSize[] = {59, 59, 123, 123, 250, 250, 250};
+
+constexpr LoRaWANSubBandLimits g_as923SubBands[] = {
+  {100, 16}, // 1%
+};
+
+// The maximum EIRP of 16 dBm down in steps of 2 dB
+constexpr int8_t g_as923TxPowers[] = {16, 14, 12, 10, 8, 6, 4, 2};
+
+constexpr uint8_t g_as923GatewayChannels[] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+/**
+ * The region plans, indexed on LoRaWANRegion
+ */
+constexpr LoRaWANRegionPlan g_regionPlans[] = {
+  {"EU868", g_eu868Channels, TableSize (g_eu868Channels), 7,
+   g_eu868DataRates, TableSize (g_eu868DataRates), g_eu868MaxMACPayloadSize,
+   g_eu868SubBands, TableSize (g_eu868SubBands),
+   g_eu868TxPowers, TableSize (g_eu868TxPowers),
+   g_eu868GatewayChannels, TableSize (g_eu868GatewayChannels),
+   7, 0, // RW2: 869.525 MHz, SF12
+   0, 0, 0, 0, 6, 5},
+  {"US915", g_us915Channels, TableSize (g_us915Channels), 72,
+   g_us915DataRates, TableSize (g_us915DataRates), g_us915MaxMACPayloadSize,
+   g_us915SubBands, TableSize (g_us915SubBands),
+   g_us915TxPowers, TableSize (g_us915TxPowers),
+   g_us915GatewayChannels, TableSize (g_us915GatewayChannels),
+   72, 8, // RW2: 923.3 MHz, SF12 500 kHz
+   72, 8, 10, 8, 13, 3},
+  {"AS923", g_as923Channels, TableSize (g_as923Channels), 8,
+   g_eu868DataRates, TableSize (g_eu868DataRates), g_as923MaxMACPayloadSize,
+   g_as923SubBands, TableSize (g_as923SubBands),
+   g_as923TxPowers, TableSize (g_as923TxPowers),
+   g_as923GatewayChannels, TableSize (g_as923GatewayChannels),
+   0, 2, // RW2: 923.2 MHz, SF10
+   0, 0, 0, 0, 6, 5},
+};
+
+LoRaWANRegion g_region = LORAWAN_REGION_EU868;
+uint32_t g_regionUsers = 0; //!< The number of objects that use the tables of g_region
+std::vector<LoRaWANChannel> g_channels (g_eu868Channels, g_eu868Channels + TableSize (g_eu868Channels));
+std::vector<LoRaWANDataRate> g_dataRates (g_eu868DataRates, g_eu868DataRates + TableSize (g_eu868DataRates));
+std::vector<uint8_t> g_uplinkChannels; //!< The upstream channels of GetUplinkChannelMask in g_region
+
+GlobalValue g_regionGlobalValue ("LoRaWANRegion",
+                                 "The region whose regional parameters (channels, data rates, "
+                                 "duty cycles) are used by the LoRaWAN objects created afterwards",
+                                 EnumValue (LORAWAN_REGION_EU868),
+                                 MakeEnumChecker (LORAWAN_REGION_EU868, "EU868",
+                                                  LORAWAN_REGION_US915, "US915",
+                                                  LORAWAN_REGION_AS923, "AS923"));
+
+} // anonymous namespace
+
+const std::vector<LoRaWANChannel> &LoRaWAN::m_supportedChannels = g_channels;
+const std::vector<LoRaWANDataRate> &LoRaWAN::m_supportedDataRates = g_dataRates;
+
+uint8_t LoRaWAN::m_RW2ChannelIndex = g_regionPlans[LORAWAN_REGION_EU868].rw2ChannelIndex; // high power channel
+uint8_t LoRaWAN::m_RW2DataRateIndex = g_regionPlans[LORAWAN_REGION_EU868].rw2DataRateIndex; // lowest spreading factor
+
+const LoRaWANRegionPlan &
+LoRaWAN::GetRegionPlan (LoRaWANRegion region)
+{
+  NS_ASSERT (region < TableSize (g_regionPlans));
+  return g_regionPlans[region];
+}
+
+LoRaWANRegion
+LoRaWAN::GetRegion (void)
+{
+  return g_region;
+}
+
+namespace {
+
+/**
+ * Expand the channel mask of LoRaWAN::GetUplinkChannelMask into
+ * g_uplinkChannels, for the current region
+ */
+void
+UpdateUplinkChannels (void)
+{
+  uint16_t channelMask;
+  uint8_t chMaskCntl;
+  LoRaWAN::GetUplinkChannelMask (channelMask, chMaskCntl);
+  g_uplinkChannels.clear ();
+  for (uint8_t i = 0; i < 16; i++)
+    {
+      if ((channelMask & (1u << i)) == 0)
+        {
+          continue;
+        }
+      if (chMaskCntl == 0)
+        {
+          g_uplinkChannels.push_back (i);
+        }
+      else
+        {
+          NS_ASSERT (chMaskCntl == 5);
+          for (uint8_t j = 0; j < 8; j++)
+            {
+              g_uplinkChannels.push_back (8 * i + j);
+            }
+        }
+    }
+  if (chMaskCntl == 5)
+    {
+      // The 500 kHz channels come after all 125 kHz channels
+      for (uint8_t i = 0; i < 8; i++)
+        {
+          if (channelMask & (1u << i))
+            {
+              g_uplinkChannels.push_back (64 + i);
+            }
+        }
+    }
+}
+
+} // anonymous namespace
+
+void
+LoRaWAN::SetRegion (LoRaWANRegion region)
+{
+  NS_LOG_FUNCTION (region);
+  NS_ASSERT_MSG (region == g_region || g_regionUsers == 0,
+                 "Cannot switch to region " << GetRegionPlan (region).name << " while "
+                 << g_regionUsers << " LoRaWAN objects use the tables of region " << GetRegionPlan (g_region).name);
+
+  const LoRaWANRegionPlan &plan = GetRegionPlan (region);
+  g_channels.assign (plan.channels, plan.channels + plan.nChannels);
+  g_dataRates.assign (plan.dataRates, plan.dataRates + plan.nDataRates);
+  m_RW2ChannelIndex = plan.rw2ChannelIndex;
+  m_RW2DataRateIndex = plan.rw2DataRateIndex;
+  g_region = region;
+
+  UpdateUplinkChannels ();
+}
+
+void
+LoRaWAN::AcquireRegion (void)
+{
+  EnumValue region;
+  g_regionGlobalValue.GetValue (region);
+  if (region.Get () != g_region)
+    {
+      NS_LOG_INFO ("Switching to region " << GetRegionPlan (static_cast<LoRaWANRegion> (region.Get ())).name);
+      SetRegion (static_cast<LoRaWANRegion> (region.Get ()));
+    }
+  g_regionUsers++;
+}
+
+void
+LoRaWAN::ReleaseRegion (void)
+{
+  NS_ASSERT (g_regionUsers > 0);
+  g_regionUsers--;
+}
+
+uint8_t
+LoRaWAN::GetNUplinkChannels (void)
+{
+  return g_regionPlans[g_region].nUplinkChannels;
+}
+
+void
+LoRaWAN::GetUplinkChannelMask (uint16_t &channelMask, uint8_t &chMaskCntl)
+{
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  channelMask = 0;
+  if (plan.nUplinkChannels <= 16)
+    {
+      // The mask applies to channels 0 to 15
+      chMaskCntl = 0;
+      for (uint8_t i = 0; i < plan.nGatewayChannels; i++)
+        {
+          if (plan.gatewayChannels[i] < plan.nUplinkChannels)
+            {
+              channelMask |= 1u << plan.gatewayChannels[i];
+            }
+        }
+    }
+  else
+    {
+      // A bit per sub band of eight 125 kHz channels and its 500 kHz channel
+      NS_ASSERT (g_region == LORAWAN_REGION_US915);
+      chMaskCntl = 5;
+      for (uint8_t i = 0; i < plan.nGatewayChannels; i++)
+        {
+          const uint8_t channelIndex = plan.gatewayChannels[i];
+          if (channelIndex < 64)
+            {
+              channelMask |= 1u << (channelIndex / 8);
+            }
+          else if (channelIndex < plan.nUplinkChannels)
+            {
+              channelMask |= 1u << (channelIndex - 64);
+            }
+        }
+    }
+}
+
+const std::vector<uint8_t> &
+LoRaWAN::GetUplinkChannels (void)
+{
+  if (g_uplinkChannels.empty ())
+    {
+      UpdateUplinkChannels (); // the channels of the default region
+    }
+  return g_uplinkChannels;
+}
+
+uint8_t
+LoRaWAN::PickUplinkChannel (uint8_t dataRateIndex, Ptr<UniformRandomVariable> random)
+{
+  const std::vector<uint8_t> &channels = GetUplinkChannels ();
+  uint32_t nChannels = 0;
+  for (std::vector<uint8_t>::const_iterator it = channels.begin (); it != channels.end (); ++it)
+    {
+      const LoRaWANChannel &channel = g_channels[*it];
+      nChannels += dataRateIndex >= channel.m_minDataRateIndex && dataRateIndex <= channel.m_maxDataRateIndex;
+    }
+  NS_ASSERT_MSG (nChannels > 0, "No upstream channel allows data rate " << (uint16_t)dataRateIndex);
+
+  uint32_t pick = random->GetInteger (0, nChannels - 1);
+  for (std::vector<uint8_t>::const_iterator it = channels.begin (); it != channels.end (); ++it)
+    {
+      const LoRaWANChannel &channel = g_channels[*it];
+      if (dataRateIndex >= channel.m_minDataRateIndex && dataRateIndex <= channel.m_maxDataRateIndex && pick-- == 0)
+        {
+          return *it;
+        }
+    }
+  NS_ASSERT (false);
+  return channels.front ();
+}
+
+bool
+LoRaWAN::IsValidTxPower (int8_t power)
+{
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  return std::find (plan.txPowers, plan.txPowers + plan.nTxPowers, power) != plan.txPowers + plan.nTxPowers;
+}
+
+int8_t
+LoRaWAN::GetMinTxPower (void)
+{
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  return *std::min_element (plan.txPowers, plan.txPowers + plan.nTxPowers);
+}
+
+uint8_t
+LoRaWAN::GetMaxMACPayloadSize (uint8_t dataRateIndex)
+{
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  return dataRateIndex < plan.nDataRates ? plan.maxMACPayloadSize[dataRateIndex] : 0;
+}
 
 uint8_t
 LoRaWAN::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
 {
-  if (rx1DROffset == 0 || rx1DROffset == 1 ||rx1DROffset == 2 ||rx1DROffset == 3 ||rx1DROffset == 4 ||rx1DROffset == 5)
-    if (upstreamDRIndex <= rx1DROffset)
-      return 0;
-    else
-      return upstreamDRIndex - rx1DROffset;
-  else {
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  if (rx1DROffset <= plan.rx1MaxDROffset) {
+    int dataRateIndex = upstreamDRIndex + plan.rx1DataRateBase - rx1DROffset;
+    dataRateIndex = std::max<int> (dataRateIndex, plan.rx1MinDataRateIndex);
+    return std::min<int> (dataRateIndex, plan.rx1MaxDataRateIndex);
+  } else {
     NS_LOG_WARN ("LoRaWAN::GetRX1DataRateIndex Invalid rx1DROffset: " << static_cast<uint16_t>(rx1DROffset));
     return upstreamDRIndex;
   }
 }
+
+uint8_t
+LoRaWAN::GetRX1ChannelIndex (uint8_t upstreamChannelIndex)
+{
+  const LoRaWANRegionPlan &plan = g_regionPlans[g_region];
+  if (plan.rx1NChannels == 0)
+    return upstreamChannelIndex; // RW1 uses the same channel as the preceding uplink
+  return plan.rx1FirstChannelIndex + upstreamChannelIndex % plan.rx1NChannels;
+}
+
 /****************************************************************************
  ************************ LoRaWANMsgTypeTag *********************************
  ****************************************************************************/
@@ -127,7 +555,14 @@ LoRaWANMsgTypeTag::Print (std::ostream &os) const
  *********************** LoRaWANPhyParamsTag ************************************
  ****************************************************************************/
 
-LoRaWANPhyParamsTag::LoRaWANPhyParamsTag () {}
+LoRaWANPhyParamsTag::LoRaWANPhyParamsTag ()
+  : m_channelIndex (0),
+    m_dataRateIndex (0),
+    m_codeRate (0),
+    m_rssi (0.0),
+    m_snr (0.0)
+{
+}
 
 void
 LoRaWANPhyParamsTag::SetChannelIndex (uint8_t index)
@@ -165,6 +600,30 @@ LoRaWANPhyParamsTag::GetCodeRate (void) const
   return m_codeRate;
 }
 
+void
+LoRaWANPhyParamsTag::SetRssi (double rssi)
+{
+  m_rssi = rssi;
+}
+
+double
+LoRaWANPhyParamsTag::GetRssi (void) const
+{
+  return m_rssi;
+}
+
+void
+LoRaWANPhyParamsTag::SetSnr (double snr)
+{
+  m_snr = snr;
+}
+
+double
+LoRaWANPhyParamsTag::GetSnr (void) const
+{
+  return m_snr;
+}
+
 TypeId
 LoRaWANPhyParamsTag::GetTypeId (void)
 {
@@ -185,7 +644,7 @@ LoRaWANPhyParamsTag::GetInstanceTypeId (void) const
 uint32_t
 LoRaWANPhyParamsTag::GetSerializedSize (void) const
 {
-  return 3 * sizeof (uint8_t);
+  return 3 * sizeof (uint8_t) + 2 * sizeof (double);
 }
 
 void
@@ -194,6 +653,8 @@ LoRaWANPhyParamsTag::Serialize (TagBuffer i) const
   i.WriteU8 (m_channelIndex);
   i.WriteU8 (m_dataRateIndex);
   i.WriteU8 (m_codeRate);
+  i.WriteDouble (m_rssi);
+  i.WriteDouble (m_snr);
 }
 
 void
@@ -202,12 +663,14 @@ LoRaWANPhyParamsTag::Deserialize (TagBuffer i)
   m_channelIndex = i.ReadU8();
   m_dataRateIndex = i.ReadU8();
   m_codeRate = i.ReadU8();
+  m_rssi = i.ReadDouble ();
+  m_snr = i.ReadDouble ();
 }
 
 void
 LoRaWANPhyParamsTag::Print (std::ostream &os) const
 {
-  os << "LORWAN_PHY_RX_PARMS: channelIndex = " << m_channelIndex << ", dataRateIndex = " << m_dataRateIndex << ", codeRate = " << m_codeRate;
+  os << "LORWAN_PHY_RX_PARMS: channelIndex = " << m_channelIndex << ", dataRateIndex = " << m_dataRateIndex << ", codeRate = " << m_codeRate << ", rssi = " << m_rssi << ", snr = " << m_snr;
 }
 
 uint64_t LoRaWANCounterSingleton::m_counter = -1; // highest possible 64 bit number: 0xffffffffffffffff
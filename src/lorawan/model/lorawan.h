@@ -36,6 +36,8 @@
 
 namespace ns3 {
 
+class UniformRandomVariable;
+
 /* ... */
 
   /**
@@ -49,6 +51,8 @@ namespace ns3 {
     uint32_t m_fc; // in Hz
     uint32_t m_bw;
     uint8_t m_subBandIndex;
+    uint8_t m_minDataRateIndex; // lowest data rate allowed on the channel
+    uint8_t m_maxDataRateIndex; // highest data rate allowed on the channel
   } LoRaWANChannel;
 
   /**
@@ -76,9 +80,63 @@ namespace ns3 {
   {
     uint8_t dataRateIndex;
     LoRaSpreadingFactor spreadingFactor;
-    uint32_t bandWith;
+    uint32_t bandWith; // zero for a data rate that is RFU in the region
   } LoRaWANDataRate;
 
+  /**
+   * \ingroup lorawan
+   *
+   * The regions of the LoRaWAN regional parameters
+   */
+  typedef enum
+  {
+    LORAWAN_REGION_EU868 = 0,
+    LORAWAN_REGION_US915,
+    LORAWAN_REGION_AS923,
+  } LoRaWANRegion;
+
+  /**
+   * \ingroup lorawan
+   *
+   * Regulatory limits of a sub band
+   */
+  typedef struct
+  {
+    uint16_t dutyCycleLimit; // Actual limit is 1 over this value, 1 means no duty cycle limit
+    int8_t maxTXPower; // in dBm
+  } LoRaWANSubBandLimits;
+
+  /**
+   * \ingroup lorawan
+   *
+   * The channel and data rate plan of a region. The tables of the plans are
+   * compile time constants, indexed on channel and data rate index.
+   */
+  typedef struct
+  {
+    const char *name;
+    const LoRaWANChannel *channels;
+    uint8_t nChannels;
+    uint8_t nUplinkChannels; // the end devices send upstream on the channels before this index
+    const LoRaWANDataRate *dataRates;
+    uint8_t nDataRates;
+    const uint8_t *maxMACPayloadSize; // per data rate
+    const LoRaWANSubBandLimits *subBands;
+    uint8_t nSubBands;
+    const int8_t *txPowers; // the TX powers an end device or gateway may use, in dBm
+    uint8_t nTxPowers;
+    const uint8_t *gatewayChannels; // the channels gateways listen and send on
+    uint8_t nGatewayChannels;
+    uint8_t rw2ChannelIndex;
+    uint8_t rw2DataRateIndex;
+    uint8_t rx1FirstChannelIndex; // RX1 channel is rx1FirstChannelIndex + uplink channel % rx1NChannels
+    uint8_t rx1NChannels; // zero if RX1 uses the uplink channel
+    uint8_t rx1DataRateBase; // RX1 data rate is uplink data rate + rx1DataRateBase - RX1DROffset
+    uint8_t rx1MinDataRateIndex;
+    uint8_t rx1MaxDataRateIndex;
+    uint8_t rx1MaxDROffset;
+  } LoRaWANRegionPlan;
+
 
   /**
    * \ingroup lorawan
@@ -114,20 +172,113 @@ namespace ns3 {
 
   public:
     /**
-     * The supported LoRa channels
+     * The supported LoRa channels of the current region
+     */
+    static const std::vector<LoRaWANChannel> &m_supportedChannels;
+
+    /**
+     * The supported LoRaWAN data rates of the current region
+     */
+    static const std::vector<LoRaWANDataRate> &m_supportedDataRates;
+
+    /**
+     * \param region the region
+     * \return the channel and data rate plan of the region
      */
-    static const std::vector<LoRaWANChannel> m_supportedChannels;
+    static const LoRaWANRegionPlan &GetRegionPlan (LoRaWANRegion region);
 
     /**
-     * The supported LoRaWAN data rates
+     * \return the current region
      */
-    static const std::vector<LoRaWANDataRate> m_supportedDataRates;
+    static LoRaWANRegion GetRegion (void);
+
+    /**
+     * Switch the supported channels, data rates and RW2 parameters to those of
+     * a region. The LoRaWAN objects size their state after the tables of the
+     * region they are created in, so the region can only be switched while
+     * no such object exists (see AcquireRegion).
+     *
+     * \param region the region
+     */
+    static void SetRegion (LoRaWANRegion region);
+
+    /**
+     * Switch to the region of the LoRaWANRegion global value, if it changed,
+     * and count the caller as a user of the tables of the current region.
+     * Called by the constructors of the LoRaWAN objects that depend on the
+     * channel and data rate plan, whose destructors call ReleaseRegion.
+     */
+    static void AcquireRegion (void);
+
+    /**
+     * Stop counting the caller as a user of the tables of the current region.
+     */
+    static void ReleaseRegion (void);
+
+    /**
+     * \return the number of channels end devices use for upstream data, the
+     * first channels of m_supportedChannels
+     */
+    static uint8_t GetNUplinkChannels (void);
+
+    /**
+     * Get the ChMask and ChMaskCntl fields of a LinkADRReq that enables the
+     * upstream channels the gateways listen on (see
+     * LoRaWANRegionPlan::gatewayChannels). Regions with up to 16 upstream
+     * channels use ChMaskCntl 0. US902-928 uses ChMaskCntl 5 (Regional
+     * Parameters 1.0.3), where bit i enables the 125 kHz channels 8i to
+     * 8i + 7 and the 500 kHz channel 64 + i.
+     *
+     * \param channelMask the ChMask field
+     * \param chMaskCntl the ChMaskCntl field
+     */
+    static void GetUplinkChannelMask (uint16_t &channelMask, uint8_t &chMaskCntl);
+
+    /**
+     * \return the upstream channels enabled by GetUplinkChannelMask, in
+     * increasing order
+     */
+    static const std::vector<uint8_t> &GetUplinkChannels (void);
+
+    /**
+     * Pick one of the channels of GetUplinkChannels that allow a data rate,
+     * with equal probability. The default channel selection of the end
+     * devices.
+     *
+     * \param dataRateIndex the data rate of the frame
+     * \param random the random variable that picks the channel
+     * \return the channel index
+     */
+    static uint8_t PickUplinkChannel (uint8_t dataRateIndex, Ptr<UniformRandomVariable> random);
+
+    /**
+     * \param power the TX power in dBm
+     * \return true if the current region allows the TX power
+     */
+    static bool IsValidTxPower (int8_t power);
+
+    /**
+     * \return the lowest TX power of the current region in dBm
+     */
+    static int8_t GetMinTxPower (void);
+
+    /**
+     * \param dataRateIndex the data rate
+     * \return the maximum MACPayload size, zero for an unsupported data rate
+     */
+    static uint8_t GetMaxMACPayloadSize (uint8_t dataRateIndex);
 
     /*
-     * Get the RX1 receive window data rate, note frequency is always the same for RW1
+     * Get the RX1 receive window data rate
      */
     static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
 
+    /**
+     * \param upstreamChannelIndex the channel of the upstream transmission
+     * \return the channel of the RX1 receive window
+     */
+    static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex);
+
     /**
      * The channel and data rate index for transmissions in the second receive
      * window (RW2) of a class A end device
@@ -181,6 +332,12 @@ namespace ns3 {
     void SetCodeRate (uint8_t);
     uint8_t GetCodeRate (void) const;
 
+    void SetRssi (double); //!< RSSI in dBm
+    double GetRssi (void) const;
+
+    void SetSnr (double); //!< SNR in dB
+    double GetSnr (void) const;
+
     /**
      * \brief Get the type ID.
      * \return the object TypeId
@@ -205,6 +362,8 @@ namespace ns3 {
     uint8_t m_channelIndex;
     uint8_t m_dataRateIndex;
     uint8_t m_codeRate;
+    double m_rssi;
+    double m_snr;
   }; // class LoRaWANPhyParamsTag
 
   typedef FlowIdTag LoRaWANPhyTraceIdTag;
@@ -0,0 +1,267 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/lorawan-snr-history.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/packet-socket-helper.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-adr-test");
+
+/*
+ * The running maximum and mean of the SNR history match the ones computed
+ * over the last samples.
+ */
+class LoRaWANSnrHistoryTestCase : public TestCase
+{
+public:
+  LoRaWANSnrHistoryTestCase ();
+  virtual ~LoRaWANSnrHistoryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSnrHistoryTestCase::LoRaWANSnrHistoryTestCase ()
+  : TestCase ("Test the LoRaWAN SNR history")
+{
+}
+
+LoRaWANSnrHistoryTestCase::~LoRaWANSnrHistoryTestCase ()
+{
+}
+
+void
+LoRaWANSnrHistoryTestCase::DoRun (void)
+{
+  const uint32_t capacity = 5;
+  LoRaWANSnrHistory history (capacity);
+  NS_TEST_ASSERT_MSG_EQ (history.GetSize (), 0, "A new history is empty");
+
+  Ptr<UniformRandomVariable> snr = CreateObject<UniformRandomVariable> ();
+  snr->SetStream (1);
+  std::deque<double> window;
+  for (uint32_t n = 0; n < 100; n++)
+    {
+      // Rounded values, so that the window often holds equal samples
+      const double sample = std::floor (snr->GetValue (-20.0, 10.0));
+      history.Add (sample);
+      window.push_back (sample);
+      if (window.size () > capacity)
+        {
+          window.pop_front ();
+        }
+
+      double sum = 0.0;
+      for (std::deque<double>::const_iterator it = window.begin (); it != window.end (); ++it)
+        {
+          sum += *it;
+        }
+      NS_TEST_ASSERT_MSG_EQ (history.GetSize (), window.size (), "Wrong number of samples after sample " << n);
+      NS_TEST_ASSERT_MSG_EQ (history.IsFull (), (window.size () == capacity), "Wrong fill state after sample " << n);
+      NS_TEST_ASSERT_MSG_EQ (history.GetMax (), *std::max_element (window.begin (), window.end ()), "Wrong maximum after sample " << n);
+      NS_TEST_ASSERT_MSG_EQ_TOL (history.GetMean (), sum / window.size (), 1e-9, "Wrong mean after sample " << n);
+    }
+
+  history.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (history.GetSize (), 0, "A cleared history is empty");
+  history.Add (3.0);
+  NS_TEST_ASSERT_MSG_EQ (history.GetMax (), 3.0, "Samples from before Clear are still in the history");
+}
+
+/*
+ * The network server raises the data rate of an end device with the ADR bit
+ * set once its SNR history is full, with a LinkADRReq in the next DS frame
+ * that enables all upstream channels of the region.
+ */
+class LoRaWANADRTestCase : public TestCase
+{
+public:
+  /**
+   * \param region the region
+   * \param uplinkChannelIndex the channel of the upstream frames
+   * \param maxSnr the highest SNR of the upstream frames
+   * \param adrDataRateIndex the expected data rate of the LinkADRReq
+   * \param channelMask the expected ChMask of the LinkADRReq
+   * \param chMaskCntl the expected ChMaskCntl of the LinkADRReq
+   */
+  LoRaWANADRTestCase (LoRaWANRegion region, uint8_t uplinkChannelIndex, double maxSnr,
+                      uint8_t adrDataRateIndex, uint16_t channelMask, uint8_t chMaskCntl);
+  virtual ~LoRaWANADRTestCase ();
+
+private:
+  virtual void DoRun (void);
+  virtual void DoTeardown (void);
+  void Tx (Ptr<const Packet> p);
+  void Receive (Ptr<LoRaWANGatewayApplication> gw, uint16_t fCnt, uint8_t dataRateIndex, bool adr, double snr);
+
+  LoRaWANRegion m_region;
+  uint8_t m_uplinkChannelIndex;
+  double m_maxSnr;
+  uint8_t m_adrDataRateIndex;
+  uint16_t m_channelMask;
+  uint8_t m_chMaskCntl;
+  std::vector<Ptr<Packet> > m_txPackets;
+  std::vector<Time> m_txTimes;
+};
+
+LoRaWANADRTestCase::LoRaWANADRTestCase (LoRaWANRegion region, uint8_t uplinkChannelIndex, double maxSnr,
+                                        uint8_t adrDataRateIndex, uint16_t channelMask, uint8_t chMaskCntl)
+  : TestCase (std::string ("Test the adaptive data rate of the LoRaWAN network server in ") + LoRaWAN::GetRegionPlan (region).name),
+    m_region (region),
+    m_uplinkChannelIndex (uplinkChannelIndex),
+    m_maxSnr (maxSnr),
+    m_adrDataRateIndex (adrDataRateIndex),
+    m_channelMask (channelMask),
+    m_chMaskCntl (chMaskCntl)
+{
+}
+
+LoRaWANADRTestCase::~LoRaWANADRTestCase ()
+{
+}
+
+void
+LoRaWANADRTestCase::Tx (Ptr<const Packet> p)
+{
+  m_txPackets.push_back (p->Copy ());
+  m_txTimes.push_back (Simulator::Now ());
+}
+
+void
+LoRaWANADRTestCase::Receive (Ptr<LoRaWANGatewayApplication> gw, uint16_t fCnt, uint8_t dataRateIndex, bool adr, double snr)
+{
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (1));
+  fhdr.setAdr (adr);
+  fhdr.setFrameCounter (fCnt);
+  fhdr.setFramePort (1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (m_uplinkChannelIndex);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (3);
+  phyParamsTag.SetRssi (snr - 117.0);
+  phyParamsTag.SetSnr (snr);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+  packet->AddPacketTag (msgTypeTag);
+
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->HandleUSPacket (gw, Address (), packet);
+}
+
+void
+LoRaWANADRTestCase::DoRun (void)
+{
+  // The region is switched when the first LoRaWAN object is created
+  Config::SetGlobal ("LoRaWANRegion", StringValue (LoRaWAN::GetRegionPlan (m_region).name));
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->SetAttribute ("ADRHistoryLength", UintegerValue (3));
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  Ptr<Node> node = CreateObject<Node> ();
+  node->AggregateObject (CreateObject<ConstantPositionMobilityModel> ());
+  Ptr<LoRaWANNetDevice> device = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  node->AddDevice (device);
+  device->SetChannel (channel);
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (node);
+
+  Ptr<LoRaWANGatewayApplication> app = CreateObject<LoRaWANGatewayApplication> ();
+  node->AddApplication (app);
+  app->SetStartTime (Seconds (0.0));
+  app->TraceConnectWithoutContext ("Tx", MakeCallback (&LoRaWANADRTestCase::Tx, this));
+
+  // Three unconfirmed frames at DR0, in EU868 SF12 with a maximum SNR of
+  // 5 dB: a margin of 5 - (-20) - 10 = 15 dB, so the end device is moved up
+  // five steps to DR5 in RW1 of the third frame, in an otherwise empty DS
+  // frame. In US915 DR0 is SF10 and the highest 125 kHz data rate is DR3.
+  Simulator::Schedule (Seconds (1.0), &LoRaWANADRTestCase::Receive, this, app, 1, 0, true, 2.0);
+  Simulator::Schedule (Seconds (11.0), &LoRaWANADRTestCase::Receive, this, app, 2, 0, true, m_maxSnr);
+  Simulator::Schedule (Seconds (21.0), &LoRaWANADRTestCase::Receive, this, app, 3, 0, true, -3.0);
+
+  // At SF7 the margin of 5 - (-7.5) - 10 = 2.5 dB is less than a step
+  Simulator::Schedule (Seconds (200.0), &LoRaWANADRTestCase::Receive, this, app, 4, m_adrDataRateIndex, true, 5.0);
+
+  // Without the ADR bit the network server does not change the data rate
+  Simulator::Schedule (Seconds (300.0), &LoRaWANADRTestCase::Receive, this, app, 5, 0, false, 5.0);
+
+  Simulator::Stop (Seconds (400.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_txPackets.size (), 1, "Wrong number of DS frames");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[0], Seconds (21.0) + MicroSeconds (RECEIVE_DELAY1), "The LinkADRReq has to be sent in RW1");
+
+  LoRaWANFrameHeaderDownlink fhdr;
+  fhdr.setSerializeFramePort (true);
+  m_txPackets[0]->RemoveHeader (fhdr);
+  NS_TEST_ASSERT_MSG_EQ (fhdr.m_macCommandsNS[LinkADRReq].m_isBeingUsed, true, "The DS frame has no LinkADRReq");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)fhdr.m_dataRateIndex, (uint32_t)m_adrDataRateIndex, "Wrong data rate in the LinkADRReq");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)fhdr.m_txPowerIndex, 0, "Wrong TX power in the LinkADRReq");
+  NS_TEST_ASSERT_MSG_EQ (fhdr.m_channelMaskBytes, m_channelMask, "Wrong ChMask in the LinkADRReq");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)((fhdr.m_redundancy >> 4) & 0x7), (uint32_t)m_chMaskCntl, "Wrong ChMaskCntl in the LinkADRReq");
+  NS_TEST_ASSERT_MSG_EQ (m_txPackets[0]->GetSize (), 0, "The DS frame has a FRMPayload");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANADRTestCase::DoTeardown (void)
+{
+  Config::SetGlobal ("LoRaWANRegion", StringValue ("EU868"));
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+}
+
+class LoRaWANADRTestSuite : public TestSuite
+{
+public:
+  LoRaWANADRTestSuite ();
+};
+
+LoRaWANADRTestSuite::LoRaWANADRTestSuite ()
+  : TestSuite ("lorawan-adr", UNIT)
+{
+  AddTestCase (new LoRaWANSnrHistoryTestCase, TestCase::QUICK);
+  // EU868: channels 0 to 6 with ChMaskCntl 0
+  AddTestCase (new LoRaWANADRTestCase (LORAWAN_REGION_EU868, 0, 5.0, 5, 0x007f, 0), TestCase::QUICK);
+  // US915: the sub band of the gateways, channels 8 to 15 and 65, with ChMaskCntl 5
+  AddTestCase (new LoRaWANADRTestCase (LORAWAN_REGION_US915, 8, 11.0, 3, 0x0002, 5), TestCase::QUICK);
+}
+
+static LoRaWANADRTestSuite lorawanADRTestSuite;
@@ -0,0 +1,208 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lightweight-timeslots.h>
+#include <ns3/lorawan-slot-occupancy.h>
+
+#include <set>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-collision-avoidance-test");
+
+/*
+ * The incrementally updated histogram and its strided view match a histogram
+ * rebuilt from the slot trains.
+ */
+class LoRaWANSlotOccupancyTestCase : public TestCase
+{
+public:
+  LoRaWANSlotOccupancyTestCase ();
+  virtual ~LoRaWANSlotOccupancyTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSlotOccupancyTestCase::LoRaWANSlotOccupancyTestCase ()
+  : TestCase ("Test the LoRaWAN slot occupancy histogram")
+{
+}
+
+LoRaWANSlotOccupancyTestCase::~LoRaWANSlotOccupancyTestCase ()
+{
+}
+
+void
+LoRaWANSlotOccupancyTestCase::DoRun (void)
+{
+  const uint32_t size = 997;
+  const uint32_t nTrains = 40;
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (1);
+
+  std::vector<int> p (nTrains);
+  std::vector<int> o (nTrains);
+  LoRaWANSlotOccupancy occupancy (size);
+  for (uint32_t i = 0; i < nTrains; i++)
+    {
+      p[i] = random->GetInteger (1, 120);
+      o[i] = random->GetInteger (0, p[i] - 1);
+      occupancy.Add (p[i], o[i], 1);
+    }
+  occupancy.SetStride (p[0]);
+
+  for (uint32_t step = 0; step < 200; step++)
+    {
+      const uint32_t i = random->GetInteger (0, nTrains - 1);
+      const int to = random->GetInteger (0, 2 * p[i]) - 5;
+      occupancy.Move (p[i], o[i], to);
+      o[i] = to;
+      if (step % 50 == 0)
+        {
+          occupancy.SetStride (p[i]);
+        }
+    }
+
+  std::vector<uint32_t> counter (size, 0);
+  for (uint32_t i = 0; i < nTrains; i++)
+    {
+      for (int slot = o[i]; slot < int (size); slot += p[i])
+        {
+          if (slot >= 0)
+            {
+              counter[slot]++;
+            }
+        }
+    }
+  for (uint32_t slot = 0; slot < size; slot++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (occupancy.Get (slot), counter[slot], "Wrong occupancy of slot " << slot);
+    }
+
+  // Candidate offsets inside and outside the first period, with and without
+  // the strided view
+  const int stride = occupancy.GetStride ();
+  LoRaWANSlotOccupancy rebuilt (size);
+  for (uint32_t i = 0; i < nTrains; i++)
+    {
+      rebuilt.Add (p[i], o[i], 1);
+    }
+  for (int m = -5; m < 2 * stride + 5; m++)
+    {
+      double sum = 0.0;
+      int numSlots = 0;
+      for (int n = 0; n < int (size) / stride; n++)
+        {
+          if (n * stride + m >= 0 && n * stride + m < int (size))
+            {
+              sum += counter[n * stride + m];
+              numSlots++;
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.GetCandidateOverlap (stride, m), sum / numSlots, 1e-6, "Wrong strided candidate overlap of offset " << m);
+      NS_TEST_ASSERT_MSG_EQ_TOL (rebuilt.GetCandidateOverlap (stride, m), sum / numSlots, 1e-6, "Wrong candidate overlap of offset " << m);
+      NS_TEST_ASSERT_MSG_EQ (occupancy.HasCandidateSlots (stride, m), (numSlots > 0), "Wrong candidate slots of offset " << m);
+    }
+
+  // Trains without slots in the period do not overlap
+  const int longPeriod = size + 10;
+  NS_TEST_ASSERT_MSG_EQ (occupancy.HasCandidateSlots (longPeriod, 3), false, "A train longer than the period has no candidate slots");
+  NS_TEST_ASSERT_MSG_EQ (occupancy.GetCandidateOverlap (longPeriod, 3), 0.0f, "A train without slots should not overlap");
+  NS_TEST_ASSERT_MSG_EQ (occupancy.GetOverlap (longPeriod, size + 3), 0.0f, "A train without slots should not overlap");
+  NS_TEST_ASSERT_MSG_EQ (occupancy.HasCandidateSlots (stride, -int (size)), false, "A train before the period has no candidate slots");
+  NS_TEST_ASSERT_MSG_EQ (occupancy.GetCandidateOverlap (stride, size), 0.0f, "A train after the period should not overlap");
+}
+
+/*
+ * Collision avoidance spreads end devices with the same periodicity and
+ * offset over the offsets they can be pushed to.
+ */
+class LoRaWANCollisionAvoidanceTestCase : public TestCase
+{
+public:
+  LoRaWANCollisionAvoidanceTestCase ();
+  virtual ~LoRaWANCollisionAvoidanceTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANCollisionAvoidanceTestCase::LoRaWANCollisionAvoidanceTestCase ()
+  : TestCase ("Test the collision avoidance of the lightweight timeslots")
+{
+}
+
+LoRaWANCollisionAvoidanceTestCase::~LoRaWANCollisionAvoidanceTestCase ()
+{
+}
+
+void
+LoRaWANCollisionAvoidanceTestCase::DoRun (void)
+{
+  Ptr<LightweightTimeslots> timeslots = CreateObject<LightweightTimeslots> ();
+  const uint8_t dataRateIndex = 0;
+  const int maxPush = timeslots->m_maxTimeSlotPushPerDataRate[dataRateIndex];
+
+  // As many end devices as there are offsets to push them to, all in the
+  // same slot, and one end device with another periodicity in a free slot
+  std::vector<Periodicity> periodicities;
+  for (int i = 0; i <= maxPush; i++)
+    {
+      periodicities.push_back ({100, 10, uint32_t (i + 1), 0, 0});
+    }
+  periodicities.push_back ({150, 70, 100, 0, 0});
+  timeslots->CollisionAvoidance (periodicities, 0.2, dataRateIndex);
+
+  std::set<int> offsets;
+  for (uint32_t i = 0; i < periodicities.size (); i++)
+    {
+      const Periodicity &periodicity = periodicities[i];
+      if (periodicity.uID == 100)
+        {
+          NS_TEST_ASSERT_MSG_EQ (periodicity.o, 70, "An end device without collisions was moved");
+          NS_TEST_ASSERT_MSG_EQ ((uint32_t)periodicity.change, 0, "An end device without collisions was moved");
+          continue;
+        }
+      NS_TEST_ASSERT_MSG_EQ (periodicity.p, 100, "The periodicity of end device " << periodicity.uID << " changed");
+      NS_TEST_ASSERT_MSG_EQ ((int)periodicity.change, periodicity.o - 10, "Wrong change of end device " << periodicity.uID);
+      NS_TEST_ASSERT_MSG_LT_OR_EQ ((int)periodicity.change, maxPush, "End device " << periodicity.uID << " was pushed too far");
+      offsets.insert (periodicity.o);
+    }
+  NS_TEST_ASSERT_MSG_EQ (offsets.size (), uint32_t (maxPush + 1), "The end devices still share slots");
+}
+
+class LoRaWANCollisionAvoidanceTestSuite : public TestSuite
+{
+public:
+  LoRaWANCollisionAvoidanceTestSuite ();
+};
+
+LoRaWANCollisionAvoidanceTestSuite::LoRaWANCollisionAvoidanceTestSuite ()
+  : TestSuite ("lorawan-collision-avoidance", UNIT)
+{
+  AddTestCase (new LoRaWANSlotOccupancyTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANCollisionAvoidanceTestCase, TestCase::QUICK);
+}
+
+static LoRaWANCollisionAvoidanceTestSuite lorawanCollisionAvoidanceTestSuite;
@@ -0,0 +1,159 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/packet.h>
+#include <ns3/simulator.h>
+#include <ns3/boolean.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/lorawan-module.h>
+
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-collision-test");
+
+/*
+ * A frame is sent from 100 m to a receiver, while a second frame on the same
+ * channel and data rate starts during the reception. With a log distance
+ * path loss (exponent 3), an interferer at 100 m is as strong as the frame and
+ * one at 215 m is 10 dB weaker.
+ */
+class LoRaWANCollisionTestCase : public TestCase
+{
+public:
+  LoRaWANCollisionTestCase (double interfererDistance, Time interfererDelay, bool sinrTimeline, bool expectReceived);
+  virtual ~LoRaWANCollisionTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  static std::string GetName (double interfererDistance, Time interfererDelay, bool sinrTimeline);
+  Ptr<LoRaWANPhy> CreatePhy (Ptr<SpectrumChannel> channel, Vector position);
+  void ReceivePdDataIndication (uint32_t psduLength, Ptr<Packet> p, uint8_t lqi,
+                                uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate);
+
+  double m_interfererDistance;
+  Time m_interfererDelay;
+  bool m_sinrTimeline;
+  bool m_expectReceived;
+  uint32_t m_receivedCount;
+};
+
+LoRaWANCollisionTestCase::LoRaWANCollisionTestCase (double interfererDistance, Time interfererDelay, bool sinrTimeline, bool expectReceived)
+  : TestCase (GetName (interfererDistance, interfererDelay, sinrTimeline)),
+    m_interfererDistance (interfererDistance),
+    m_interfererDelay (interfererDelay),
+    m_sinrTimeline (sinrTimeline),
+    m_expectReceived (expectReceived),
+    m_receivedCount (0)
+{
+}
+
+LoRaWANCollisionTestCase::~LoRaWANCollisionTestCase ()
+{
+}
+
+std::string
+LoRaWANCollisionTestCase::GetName (double interfererDistance, Time interfererDelay, bool sinrTimeline)
+{
+  std::ostringstream oss;
+  oss << "Test collision with an interferer at " << interfererDistance << "m starting after "
+      << interfererDelay.GetMilliSeconds () << "ms" << (sinrTimeline ? " (SINR timeline)" : "");
+  return oss.str ();
+}
+
+Ptr<LoRaWANPhy>
+LoRaWANCollisionTestCase::CreatePhy (Ptr<SpectrumChannel> channel, Vector position)
+{
+  Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (0);
+  phy->SetAttribute ("SinrTimeline", BooleanValue (m_sinrTimeline));
+  phy->SetChannel (channel);
+  channel->AddRx (phy);
+
+  Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (position);
+  phy->SetMobility (mobility);
+  phy->SetErrorModel (CreateObject<LoRaWANErrorModel> ());
+
+  phy->SetTxConf (14, 0, 5, 1, 8, false, true);
+  return phy;
+}
+
+void
+LoRaWANCollisionTestCase::ReceivePdDataIndication (uint32_t psduLength, Ptr<Packet> p, uint8_t lqi,
+                                                   uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate)
+{
+  m_receivedCount++;
+}
+
+void
+LoRaWANCollisionTestCase::DoRun (void)
+{
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  Ptr<LoRaWANPhy> sender = CreatePhy (channel, Vector (0.0, 0.0, 0.0));
+  Ptr<LoRaWANPhy> receiver = CreatePhy (channel, Vector (100.0, 0.0, 0.0));
+  Ptr<LoRaWANPhy> interferer = CreatePhy (channel, Vector (100.0 + m_interfererDistance, 0.0, 0.0));
+  receiver->SetPdDataIndicationCallback (MakeCallback (&LoRaWANCollisionTestCase::ReceivePdDataIndication, this));
+
+  sender->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+  interferer->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+  receiver->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+
+  Ptr<Packet> p = Create<Packet> (10);
+  Ptr<Packet> q = Create<Packet> (10);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANPhy::PdDataRequest, sender, p->GetSize (), p);
+  Simulator::Schedule (Seconds (1.0) + m_interfererDelay, &LoRaWANPhy::PdDataRequest, interferer, q->GetSize (), q);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_receivedCount, m_expectReceived ? 1 : 0, "Unexpected reception of the frame");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANCollisionTestSuite : public TestSuite
+{
+public:
+  LoRaWANCollisionTestSuite ();
+};
+
+LoRaWANCollisionTestSuite::LoRaWANCollisionTestSuite ()
+  : TestSuite ("lorawan-collision", UNIT)
+{
+  // SF7: the preamble lasts 12.544 ms, the header the 8.192 ms after it
+  // An equally strong interferer during the header: the interference is
+  // treated as noise at every interference change, but is not captured with
+  // the SINR timeline
+  AddTestCase (new LoRaWANCollisionTestCase (100.0, MilliSeconds (10), false, true), TestCase::QUICK);
+  AddTestCase (new LoRaWANCollisionTestCase (100.0, MilliSeconds (10), true, false), TestCase::QUICK);
+  // A 10 dB weaker interferer during the header is captured
+  AddTestCase (new LoRaWANCollisionTestCase (215.0, MilliSeconds (10), true, true), TestCase::QUICK);
+  // An equally strong interferer during the payload only degrades the SINR
+  AddTestCase (new LoRaWANCollisionTestCase (100.0, MilliSeconds (30), true, true), TestCase::QUICK);
+}
+
+static LoRaWANCollisionTestSuite lorawanCollisionTestSuite;
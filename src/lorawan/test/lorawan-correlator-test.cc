@@ -0,0 +1,326 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-correlator.h>
+#include <ns3/lightweight-timeslots.h>
+
+#include <fstream>
+#include <tuple>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-correlator-test");
+
+/*
+ * The FFT based correlations match the direct sums, for sequences of the
+ * full length of the correlator and for shorter ones.
+ */
+class LoRaWANCorrelatorTestCase : public TestCase
+{
+public:
+  LoRaWANCorrelatorTestCase ();
+  virtual ~LoRaWANCorrelatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckSize (uint32_t correlatorSize, uint32_t sequenceSize, Ptr<UniformRandomVariable> random);
+};
+
+LoRaWANCorrelatorTestCase::LoRaWANCorrelatorTestCase ()
+  : TestCase ("Test the LoRaWAN FFT correlator against direct sums")
+{
+}
+
+LoRaWANCorrelatorTestCase::~LoRaWANCorrelatorTestCase ()
+{
+}
+
+void
+LoRaWANCorrelatorTestCase::CheckSize (uint32_t correlatorSize, uint32_t sequenceSize, Ptr<UniformRandomVariable> random)
+{
+  LoRaWANCorrelator correlator (correlatorSize);
+  NS_TEST_ASSERT_MSG_GT_OR_EQ (correlator.GetTransformSize (), 2 * correlatorSize - 1, "The transform is too short for a linear correlation");
+
+  std::vector<unsigned char> x (sequenceSize);
+  std::vector<unsigned char> y (sequenceSize);
+  for (uint32_t i = 0; i < sequenceSize; i++)
+    {
+      x[i] = random->GetValue () < 0.3;
+      y[i] = random->GetValue () < 0.1;
+    }
+
+  std::vector<float> autocorrelation;
+  std::vector<float> correlation;
+  // Twice, so that the second run starts from the buffers of the first one
+  for (uint32_t run = 0; run < 2; run++)
+    {
+      correlator.Autocorrelate (x, autocorrelation);
+      correlator.Correlate (x, y, correlation);
+    }
+  NS_TEST_ASSERT_MSG_EQ (autocorrelation.size (), correlatorSize, "Wrong number of lags in the autocorrelation");
+  NS_TEST_ASSERT_MSG_EQ (correlation.size (), correlatorSize, "Wrong number of lags in the correlation");
+
+  for (uint32_t m = 0; m < correlatorSize; m++)
+    {
+      double expectedAutocorrelation = 0.0;
+      double expectedCorrelation = 0.0;
+      for (uint32_t j = 0; j + m < sequenceSize; j++)
+        {
+          expectedAutocorrelation += x[j + m] * x[j];
+          expectedCorrelation += x[j + m] * y[j];
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (autocorrelation[m], expectedAutocorrelation, 1e-3, "Wrong autocorrelation at lag " << m << " of " << sequenceSize << " samples");
+      NS_TEST_ASSERT_MSG_EQ_TOL (correlation[m], expectedCorrelation, 1e-3, "Wrong correlation at lag " << m << " of " << sequenceSize << " samples");
+    }
+}
+
+void
+LoRaWANCorrelatorTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::GetFastTransformSize (1), 1, "1 is a product of small primes");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::GetFastTransformSize (127), 128, "Wrong transform size for 127");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::GetFastTransformSize (2 * 63552 - 1), 127575, "Wrong transform size for DR5");
+
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (1);
+  CheckSize (1, 1, random);
+  CheckSize (2, 2, random);
+  CheckSize (97, 97, random);
+  CheckSize (97, 60, random);
+  CheckSize (1986, 1986, random);
+}
+
+/*
+ * Correlators of the same size share their FFTW plans, and the FFTW wisdom
+ * of the process can be written to a file and read back.
+ */
+class LoRaWANPlanCacheTestCase : public TestCase
+{
+public:
+  LoRaWANPlanCacheTestCase ();
+  virtual ~LoRaWANPlanCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPlanCacheTestCase::LoRaWANPlanCacheTestCase ()
+  : TestCase ("Test the FFTW plan cache of the LoRaWAN correlator")
+{
+}
+
+LoRaWANPlanCacheTestCase::~LoRaWANPlanCacheTestCase ()
+{
+}
+
+void
+LoRaWANPlanCacheTestCase::DoRun (void)
+{
+  const uint32_t size = 211;
+  std::vector<unsigned char> x (size, 0);
+  for (uint32_t i = 5; i < size; i += 17)
+    {
+      x[i] = 1;
+    }
+
+  LoRaWANCorrelator first (size);
+  const uint32_t nPlans = LoRaWANCorrelator::GetPlanCacheSize ();
+  LoRaWANCorrelator second (size);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::GetPlanCacheSize (), nPlans, "A correlator of the same size planned again");
+
+  std::vector<float> z1;
+  std::vector<float> z2;
+  first.Autocorrelate (x, z1);
+  second.Autocorrelate (x, z2);
+  for (uint32_t m = 0; m < size; m++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (z2[m], z1[m], "The shared plans give another autocorrelation at lag " << m);
+    }
+  NS_TEST_ASSERT_MSG_EQ (z1[17], 12, "Wrong autocorrelation at the periodicity");
+
+  // Measured plans are kept apart from the estimated ones
+  LoRaWANCorrelator measured (size, true);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::GetPlanCacheSize (), nPlans + 2, "Wrong number of plans after measuring");
+  measured.Autocorrelate (x, z2);
+  for (uint32_t m = 0; m < size; m++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (z2[m], z1[m], "The measured plans give another autocorrelation at lag " << m);
+    }
+
+  const std::string filename = CreateTempDirFilename ("lorawan-fftw.wisdom");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::ImportWisdom (filename), false, "Wisdom was read from a missing file");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::ExportWisdom (filename), true, "The wisdom was not written");
+  NS_TEST_ASSERT_MSG_EQ (std::ifstream (filename.c_str ()).good (), true, "The wisdom file is missing");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCorrelator::ImportWisdom (filename), true, "The wisdom was not read back");
+}
+
+/*
+ * The candidate periodicity and offset of a periodic sequence are found at
+ * every data rate.
+ */
+class LoRaWANCandidateSolutionTestCase : public TestCase
+{
+public:
+  LoRaWANCandidateSolutionTestCase ();
+  virtual ~LoRaWANCandidateSolutionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANCandidateSolutionTestCase::LoRaWANCandidateSolutionTestCase ()
+  : TestCase ("Test the candidate solution of the lightweight timeslots")
+{
+}
+
+LoRaWANCandidateSolutionTestCase::~LoRaWANCandidateSolutionTestCase ()
+{
+}
+
+void
+LoRaWANCandidateSolutionTestCase::DoRun (void)
+{
+  Ptr<LightweightTimeslots> timeslots = CreateObject<LightweightTimeslots> ();
+  for (uint8_t dr = 0; dr < LightweightTimeslots::m_timeSlotsPerDataRate.size (); dr++)
+    {
+      const uint32_t slots = LightweightTimeslots::m_timeSlotsPerDataRate[dr].m_slots;
+      const int periodicity = slots / 10;
+      const int offset = periodicity / 3;
+      std::vector<unsigned char> O (slots, 0);
+      for (uint32_t i = offset; i < slots; i += periodicity)
+        {
+          O[i] = 1;
+        }
+
+      std::tuple<int, int> candidate = timeslots->FindCandidateSolutionAutocorrelation (O, dr);
+      NS_TEST_ASSERT_MSG_EQ (std::get<0> (candidate), periodicity, "Wrong periodicity at DR" << (uint32_t)dr);
+      NS_TEST_ASSERT_MSG_EQ (std::get<1> (candidate), offset, "Wrong offset at DR" << (uint32_t)dr);
+    }
+}
+
+/*
+ * The sparse autocorrelation of the slots with a transmission finds the same
+ * candidate solution as the FFT correlations of the whole sequence.
+ */
+class LoRaWANSparseAutocorrelationTestCase : public TestCase
+{
+public:
+  LoRaWANSparseAutocorrelationTestCase ();
+  virtual ~LoRaWANSparseAutocorrelationTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (Ptr<LightweightTimeslots> timeslots, const std::vector<unsigned char> &O, uint8_t dr);
+};
+
+LoRaWANSparseAutocorrelationTestCase::LoRaWANSparseAutocorrelationTestCase ()
+  : TestCase ("Test the sparse autocorrelation of the lightweight timeslots")
+{
+}
+
+LoRaWANSparseAutocorrelationTestCase::~LoRaWANSparseAutocorrelationTestCase ()
+{
+}
+
+void
+LoRaWANSparseAutocorrelationTestCase::Check (Ptr<LightweightTimeslots> timeslots, const std::vector<unsigned char> &O, uint8_t dr)
+{
+  std::vector<uint32_t> hits;
+  for (uint32_t i = 0; i < O.size (); i++)
+    {
+      if (O[i])
+        {
+          hits.push_back (i);
+        }
+    }
+  std::tuple<int, int> dense = timeslots->FindCandidateSolutionDenseAutocorrelation (O, dr);
+  std::tuple<int, int> sparse = timeslots->FindCandidateSolutionSparseAutocorrelation (hits, dr);
+  NS_TEST_ASSERT_MSG_EQ (std::get<0> (sparse), std::get<0> (dense), "Wrong periodicity of " << hits.size () << " transmissions at DR" << (uint32_t)dr);
+  NS_TEST_ASSERT_MSG_EQ (std::get<1> (sparse), std::get<1> (dense), "Wrong offset of " << hits.size () << " transmissions at DR" << (uint32_t)dr);
+}
+
+void
+LoRaWANSparseAutocorrelationTestCase::DoRun (void)
+{
+  Ptr<LightweightTimeslots> timeslots = CreateObject<LightweightTimeslots> ();
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (1);
+
+  for (uint8_t dr = 0; dr < 3; dr++)
+    {
+      const uint32_t slots = LightweightTimeslots::m_timeSlotsPerDataRate[dr].m_slots;
+
+      // No, one and two transmissions, at the ends and next to each other
+      std::vector<unsigned char> O (slots, 0);
+      Check (timeslots, O, dr);
+      O[0] = 1;
+      Check (timeslots, O, dr);
+      O[slots - 1] = 1;
+      Check (timeslots, O, dr);
+      O[1] = 1;
+      O[2] = 1;
+      Check (timeslots, O, dr);
+
+      // A few periodic end devices, some transmissions lost and some random
+      // ones, which makes the autocorrelation peaks ragged
+      for (uint32_t run = 0; run < 20; run++)
+        {
+          O.assign (slots, 0);
+          const uint32_t nDevices = random->GetInteger (1, 4);
+          for (uint32_t d = 0; d < nDevices; d++)
+            {
+              const uint32_t periodicity = random->GetInteger (2, slots / 3);
+              for (uint32_t i = random->GetInteger (0, periodicity - 1); i < slots; i += periodicity)
+                {
+                  O[i] = random->GetValue () < 0.9 ? 1 : 0;
+                }
+            }
+          const uint32_t nRandom = random->GetInteger (0, 5);
+          for (uint32_t i = 0; i < nRandom; i++)
+            {
+              O[random->GetInteger (0, slots - 1)] = 1;
+            }
+          Check (timeslots, O, dr);
+        }
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (LightweightTimeslots::IsSparse (30, 63552), true, "A DR5 sequence with 30 transmissions is sparse");
+  NS_TEST_ASSERT_MSG_EQ (LightweightTimeslots::IsSparse (20000, 63552), false, "A DR5 sequence with 20000 transmissions is dense");
+}
+
+class LoRaWANCorrelatorTestSuite : public TestSuite
+{
+public:
+  LoRaWANCorrelatorTestSuite ();
+};
+
+LoRaWANCorrelatorTestSuite::LoRaWANCorrelatorTestSuite ()
+  : TestSuite ("lorawan-correlator", UNIT)
+{
+  AddTestCase (new LoRaWANCorrelatorTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANPlanCacheTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANCandidateSolutionTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSparseAutocorrelationTestCase, TestCase::QUICK);
+}
+
+static LoRaWANCorrelatorTestSuite lorawanCorrelatorTestSuite;
@@ -0,0 +1,201 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/lorawan-timing-wheel.h>
+#include <ns3/packet.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-deduplication-test");
+
+/*
+ * Identifiers are popped per tick, in tick order and insertion order.
+ */
+class LoRaWANTimingWheelTestCase : public TestCase
+{
+public:
+  LoRaWANTimingWheelTestCase ();
+  virtual ~LoRaWANTimingWheelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANTimingWheelTestCase::LoRaWANTimingWheelTestCase ()
+  : TestCase ("Test the LoRaWAN timing wheel")
+{
+}
+
+LoRaWANTimingWheelTestCase::~LoRaWANTimingWheelTestCase ()
+{
+}
+
+void
+LoRaWANTimingWheelTestCase::DoRun (void)
+{
+  LoRaWANTimingWheel wheel (4);
+  NS_TEST_ASSERT_MSG_EQ (wheel.IsEmpty (), true, "A new wheel is empty");
+
+  wheel.Insert (10, 1);
+  wheel.Insert (12, 2);
+  wheel.Insert (10, 3);
+  wheel.Insert (9, 4); // earlier than the pending ticks
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetSize (), 4, "Wrong number of identifiers");
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetNextTick (), 9, "Wrong next tick");
+
+  std::vector<uint32_t> ids;
+  NS_TEST_ASSERT_MSG_EQ (wheel.PopNextTick (ids), 9, "Wrong tick");
+  NS_TEST_ASSERT_MSG_EQ (ids.size (), 1, "Wrong number of identifiers of tick 9");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], 4, "Wrong identifier of tick 9");
+
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetNextTick (), 10, "Wrong next tick");
+  wheel.Insert (13, 5); // wraps around to the bucket of tick 9
+  NS_TEST_ASSERT_MSG_EQ (wheel.PopNextTick (ids), 10, "Wrong tick");
+  NS_TEST_ASSERT_MSG_EQ (ids.size (), 2, "Wrong number of identifiers of tick 10");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], 1, "Identifiers are not in insertion order");
+  NS_TEST_ASSERT_MSG_EQ (ids[1], 3, "Identifiers are not in insertion order");
+
+  NS_TEST_ASSERT_MSG_EQ (wheel.PopNextTick (ids), 12, "Tick 11 has no identifiers");
+  NS_TEST_ASSERT_MSG_EQ (ids.size (), 1, "Wrong number of identifiers of tick 12");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], 2, "Wrong identifier of tick 12");
+  NS_TEST_ASSERT_MSG_EQ (wheel.PopNextTick (ids), 13, "Wrong tick");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], 5, "Wrong identifier of tick 13");
+  NS_TEST_ASSERT_MSG_EQ (wheel.IsEmpty (), true, "All identifiers were popped");
+
+  // An empty wheel accepts any tick
+  wheel.Insert (1000, 6);
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetNextTick (), 1000, "Wrong next tick");
+}
+
+/*
+ * The receptions of a frame by several gateways are handed to the rest of
+ * the network server once, when the deduplication window closes.
+ */
+class LoRaWANDeduplicationTestCase : public TestCase
+{
+public:
+  LoRaWANDeduplicationTestCase ();
+  virtual ~LoRaWANDeduplicationTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void USMsgReceived (uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p);
+  void Receive (Ptr<LoRaWANNetworkServer> ns, Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, uint16_t fCnt, double rssi);
+
+  std::vector<uint32_t> m_devices;
+  std::vector<Time> m_times;
+};
+
+LoRaWANDeduplicationTestCase::LoRaWANDeduplicationTestCase ()
+  : TestCase ("Test the deduplication of the receptions of upstream frames by the network server")
+{
+}
+
+LoRaWANDeduplicationTestCase::~LoRaWANDeduplicationTestCase ()
+{
+}
+
+void
+LoRaWANDeduplicationTestCase::USMsgReceived (uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  m_devices.push_back (deviceAddr);
+  m_times.push_back (Simulator::Now ());
+}
+
+void
+LoRaWANDeduplicationTestCase::Receive (Ptr<LoRaWANNetworkServer> ns, Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, uint16_t fCnt, double rssi)
+{
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (deviceAddr));
+  fhdr.setFrameCounter (fCnt);
+  fhdr.setFramePort (1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (5);
+  phyParamsTag.SetCodeRate (3);
+  phyParamsTag.SetRssi (rssi);
+  phyParamsTag.SetSnr (rssi + 120.0);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+  packet->AddPacketTag (msgTypeTag);
+
+  ns->HandleUSPacket (gw, Address (), packet);
+}
+
+void
+LoRaWANDeduplicationTestCase::DoRun (void)
+{
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  ns->Initialize ();
+  ns->TraceConnectWithoutContext ("USMsgReceived", MakeCallback (&LoRaWANDeduplicationTestCase::USMsgReceived, this));
+  Ptr<LoRaWANGatewayApplication> gw1 = CreateObject<LoRaWANGatewayApplication> ();
+  Ptr<LoRaWANGatewayApplication> gw2 = CreateObject<LoRaWANGatewayApplication> ();
+  Ptr<LoRaWANGatewayApplication> gw3 = CreateObject<LoRaWANGatewayApplication> ();
+
+  // Frame 1 of device 1 is received by three gateways within the default
+  // window of 200 ms, frame 1 of device 2 by one gateway. The simulation ends
+  // before the receive windows, as the gateways are not attached to a node.
+  Simulator::Schedule (MilliSeconds (100), &LoRaWANDeduplicationTestCase::Receive, this, ns, gw1, 1, 1, -110.0);
+  Simulator::Schedule (MilliSeconds (100), &LoRaWANDeduplicationTestCase::Receive, this, ns, gw2, 1, 1, -100.0);
+  Simulator::Schedule (MilliSeconds (120), &LoRaWANDeduplicationTestCase::Receive, this, ns, gw3, 2, 1, -90.0);
+  Simulator::Schedule (MilliSeconds (250), &LoRaWANDeduplicationTestCase::Receive, this, ns, gw3, 1, 1, -105.0);
+  Simulator::Stop (MilliSeconds (600));
+  Simulator::Run ();
+
+  // The windows close at the first multiple of 50 ms after their end
+  NS_TEST_ASSERT_MSG_EQ (m_devices.size (), 2, "Every frame has to be processed once");
+  NS_TEST_ASSERT_MSG_EQ (m_devices[0], 1, "Wrong order of the frames");
+  NS_TEST_ASSERT_MSG_EQ (m_times[0], MilliSeconds (300), "Wrong time of frame 1 of device 1");
+  NS_TEST_ASSERT_MSG_EQ (m_devices[1], 2, "Wrong order of the frames");
+  NS_TEST_ASSERT_MSG_EQ (m_times[1], MilliSeconds (350), "Wrong time of frame 1 of device 2");
+
+  // A reception after the window closed is not processed again
+  m_devices.clear ();
+  Simulator::Schedule (MilliSeconds (10), &LoRaWANDeduplicationTestCase::Receive, this, ns, gw1, 2, 1, -110.0);
+  Simulator::Stop (MilliSeconds (300));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_devices.size (), 0, "A late duplicate was processed");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANDeduplicationTestSuite : public TestSuite
+{
+public:
+  LoRaWANDeduplicationTestSuite ();
+};
+
+LoRaWANDeduplicationTestSuite::LoRaWANDeduplicationTestSuite ()
+  : TestSuite ("lorawan-deduplication", UNIT)
+{
+  AddTestCase (new LoRaWANTimingWheelTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANDeduplicationTestCase, TestCase::QUICK);
+}
+
+static LoRaWANDeduplicationTestSuite lorawanDeduplicationTestSuite;
@@ -0,0 +1,107 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/lorawan-module.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-device-table-test");
+
+class LoRaWANDeviceTableTestCase : public TestCase
+{
+public:
+  LoRaWANDeviceTableTestCase ();
+  virtual ~LoRaWANDeviceTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANDeviceTableTestCase::LoRaWANDeviceTableTestCase ()
+  : TestCase ("Test the LoRaWAN device table")
+{
+}
+
+LoRaWANDeviceTableTestCase::~LoRaWANDeviceTableTestCase ()
+{
+}
+
+void
+LoRaWANDeviceTableTestCase::DoRun (void)
+{
+  typedef LoRaWANDeviceTable<uint32_t, std::vector<uint32_t> > Table;
+  Table table;
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0), Table::NOT_FOUND, "Empty table found a device");
+
+  // Sequential addresses, the extremes of the address space and addresses
+  // that share their low bits, added through several rehashes
+  std::vector<uint32_t> keys;
+  for (uint32_t i = 0; i < 1000; i++)
+    {
+      keys.push_back (i);
+      keys.push_back (0xffffffff - i);
+      keys.push_back ((i + 1) << 20);
+    }
+  for (uint32_t i = 0; i < keys.size (); i++)
+    {
+      const uint32_t index = table.Insert (keys[i]);
+      NS_TEST_ASSERT_MSG_EQ (index, i, "Devices are not indexed in the order they were added");
+      table.GetHot (index) = keys[i] ^ 0x5a5a5a5a;
+      table.GetCold (index).push_back (keys[i]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), keys.size (), "Wrong number of devices");
+
+  for (uint32_t i = 0; i < keys.size (); i++)
+    {
+      const uint32_t index = table.Find (keys[i]);
+      NS_TEST_ASSERT_MSG_EQ (index, i, "Wrong index after rehashing");
+      NS_TEST_ASSERT_MSG_EQ (table.GetKey (index), keys[i], "Wrong address");
+      NS_TEST_ASSERT_MSG_EQ (table.GetHot (index), (keys[i] ^ 0x5a5a5a5a), "Wrong hot record");
+      NS_TEST_ASSERT_MSG_EQ (table.GetCold (index).size (), 1, "Wrong cold record");
+      NS_TEST_ASSERT_MSG_EQ (table.GetCold (index)[0], keys[i], "Wrong cold record");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Find (5000), Table::NOT_FOUND, "Found an unknown address");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0x80000000), Table::NOT_FOUND, "Found an unknown address");
+
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "Table is not empty after clearing");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (keys[0]), Table::NOT_FOUND, "Found a device after clearing");
+
+  table.Reserve (10);
+  NS_TEST_ASSERT_MSG_EQ (table.Insert (7), 0, "Wrong index after clearing");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (7), 0, "Wrong index after clearing");
+}
+
+class LoRaWANDeviceTableTestSuite : public TestSuite
+{
+public:
+  LoRaWANDeviceTableTestSuite ();
+};
+
+LoRaWANDeviceTableTestSuite::LoRaWANDeviceTableTestSuite ()
+  : TestSuite ("lorawan-device-table", UNIT)
+{
+  AddTestCase (new LoRaWANDeviceTableTestCase, TestCase::QUICK);
+}
+
+static LoRaWANDeviceTableTestSuite lorawanDeviceTableTestSuite;
@@ -0,0 +1,181 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/packet-socket-helper.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-downlink-gateway-test");
+
+/*
+ * The network server sends a DS frame via the gateway with the best link to
+ * the end device, and falls back to the next gateway when that one can not
+ * send.
+ */
+class LoRaWANDownlinkGatewayTestCase : public TestCase
+{
+public:
+  LoRaWANDownlinkGatewayTestCase ();
+  virtual ~LoRaWANDownlinkGatewayTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Tx (uint32_t gateway, Ptr<const Packet> p);
+  void Receive (Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, double snr);
+  void Block (Ptr<LoRaWANGatewayApplication> gw);
+
+  std::vector<uint32_t> m_txGateways;
+  std::vector<Time> m_txTimes;
+};
+
+LoRaWANDownlinkGatewayTestCase::LoRaWANDownlinkGatewayTestCase ()
+  : TestCase ("Test the selection of the gateway for LoRaWAN DS frames")
+{
+}
+
+LoRaWANDownlinkGatewayTestCase::~LoRaWANDownlinkGatewayTestCase ()
+{
+}
+
+void
+LoRaWANDownlinkGatewayTestCase::Tx (uint32_t gateway, Ptr<const Packet> p)
+{
+  m_txGateways.push_back (gateway);
+  m_txTimes.push_back (Simulator::Now ());
+}
+
+void
+LoRaWANDownlinkGatewayTestCase::Receive (Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, double snr)
+{
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (deviceAddr));
+  fhdr.setFrameCounter (1);
+  fhdr.setFramePort (1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (5);
+  phyParamsTag.SetCodeRate (3);
+  phyParamsTag.SetRssi (snr - 117.0);
+  phyParamsTag.SetSnr (snr);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_CONFIRMED_DATA_UP); // the network server replies with an Ack in RW1
+  packet->AddPacketTag (msgTypeTag);
+
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->HandleUSPacket (gw, Address (), packet);
+}
+
+void
+LoRaWANDownlinkGatewayTestCase::Block (Ptr<LoRaWANGatewayApplication> gw)
+{
+  // Use up the duty cycle of the RW1 sub band of the gateway
+  Ptr<Packet> packet = Create<Packet> (20);
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (LoRaWAN::GetRX1ChannelIndex (0));
+  phyParamsTag.SetDataRateIndex (LoRaWAN::GetRX1DataRateIndex (5, 0));
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_DOWN);
+  packet->AddPacketTag (msgTypeTag);
+  NS_TEST_ASSERT_MSG_EQ (gw->SendDSPacket (packet), true, "An idle gateway has to accept a DS frame");
+
+  // The radio of the gateway is now booked, a second frame is refused
+  NS_TEST_ASSERT_MSG_EQ (gw->SendDSPacket (packet->Copy ()), false, "A busy gateway has to refuse a DS frame");
+}
+
+void
+LoRaWANDownlinkGatewayTestCase::DoRun (void)
+{
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  std::vector<Ptr<LoRaWANGatewayApplication> > apps;
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (1000.0 * i, 0.0, 0.0));
+      node->AggregateObject (mobility);
+      Ptr<LoRaWANNetDevice> device = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+      node->AddDevice (device);
+      device->SetChannel (channel);
+      PacketSocketHelper packetSocket;
+      packetSocket.Install (node);
+
+      Ptr<LoRaWANGatewayApplication> app = CreateObject<LoRaWANGatewayApplication> ();
+      node->AddApplication (app);
+      app->SetStartTime (Seconds (0.0));
+      app->TraceConnectWithoutContext ("Tx", MakeCallback (&LoRaWANDownlinkGatewayTestCase::Tx, this).Bind (i));
+      apps.push_back (app);
+    }
+
+  // Device 1 is heard best by gateway 1, which sends the Ack
+  Simulator::Schedule (Seconds (1.0), &LoRaWANDownlinkGatewayTestCase::Receive, this, apps[0], 1, -5.0);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANDownlinkGatewayTestCase::Receive, this, apps[1], 1, 2.0);
+
+  // Device 2 is also heard best by gateway 1, but gateway 1 used up the duty
+  // cycle of the sub band just before, so gateway 0 sends the Ack
+  Simulator::Schedule (Seconds (10.0), &LoRaWANDownlinkGatewayTestCase::Receive, this, apps[0], 2, -5.0);
+  Simulator::Schedule (Seconds (10.0), &LoRaWANDownlinkGatewayTestCase::Receive, this, apps[1], 2, 2.0);
+  Simulator::Schedule (Seconds (10.5), &LoRaWANDownlinkGatewayTestCase::Block, this, apps[1]);
+
+  Simulator::Stop (Seconds (15.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_txGateways.size (), 3, "Wrong number of DS frames");
+  NS_TEST_ASSERT_MSG_EQ (m_txGateways[0], 1, "The Ack of device 1 has to be sent by the gateway with the highest SNR");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[0], Seconds (1.0) + MicroSeconds (RECEIVE_DELAY1), "The Ack of device 1 has to be sent in RW1");
+  NS_TEST_ASSERT_MSG_EQ (m_txGateways[1], 1, "The first frame of Block has to be sent");
+  NS_TEST_ASSERT_MSG_EQ (m_txGateways[2], 0, "The Ack of device 2 has to be sent by the other gateway");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[2], Seconds (10.0) + MicroSeconds (RECEIVE_DELAY1), "The Ack of device 2 has to be sent in RW1");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+class LoRaWANDownlinkGatewayTestSuite : public TestSuite
+{
+public:
+  LoRaWANDownlinkGatewayTestSuite ();
+};
+
+LoRaWANDownlinkGatewayTestSuite::LoRaWANDownlinkGatewayTestSuite ()
+  : TestSuite ("lorawan-downlink-gateway", UNIT)
+{
+  AddTestCase (new LoRaWANDownlinkGatewayTestCase, TestCase::QUICK);
+}
+
+static LoRaWANDownlinkGatewayTestSuite lorawanDownlinkGatewayTestSuite;
@@ -0,0 +1,220 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-enddevice-population-test");
+
+/*
+ * The frames of a population of end devices are received by a gateway.
+ */
+class LoRaWANEndDevicePopulationTestCase : public TestCase
+{
+public:
+  LoRaWANEndDevicePopulationTestCase ();
+  virtual ~LoRaWANEndDevicePopulationTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void USMsgTransmitted (uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p);
+  void MacRx (Ptr<const Packet> p);
+
+  std::vector<Time> m_txTimes;
+  uint32_t m_nReceived;
+};
+
+LoRaWANEndDevicePopulationTestCase::LoRaWANEndDevicePopulationTestCase ()
+  : TestCase ("Test the reception of the frames of a LoRaWAN end device population"),
+    m_nReceived (0)
+{
+}
+
+LoRaWANEndDevicePopulationTestCase::~LoRaWANEndDevicePopulationTestCase ()
+{
+}
+
+void
+LoRaWANEndDevicePopulationTestCase::USMsgTransmitted (uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p)
+{
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)msgType, LORAWAN_UNCONFIRMED_DATA_UP, "Wrong message type");
+  if (deviceAddress == 1)
+    {
+      m_txTimes.push_back (Simulator::Now ());
+    }
+}
+
+void
+LoRaWANEndDevicePopulationTestCase::MacRx (Ptr<const Packet> p)
+{
+  m_nReceived++;
+}
+
+void
+LoRaWANEndDevicePopulationTestCase::DoRun (void)
+{
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  Ptr<Node> gwNode = CreateObject<Node> ();
+  gwNode->AggregateObject (CreateObject<ConstantPositionMobilityModel> ());
+  Ptr<LoRaWANNetDevice> gw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  gwNode->AddDevice (gw);
+  gw->SetChannel (channel);
+  std::vector<Ptr<LoRaWANMac> > macs = gw->GetMacs ();
+  for (std::vector<Ptr<LoRaWANMac> >::const_iterator it = macs.begin (); it != macs.end (); ++it)
+    {
+      (*it)->TraceConnectWithoutContext ("MacRx", MakeCallback (&LoRaWANEndDevicePopulationTestCase::MacRx, this));
+    }
+
+  // End device 1 always sends on channel 0 and has to wait for the 1% duty
+  // cycle of its sub band (sub band 1 of EU868), the other end devices send
+  // their frames every 100 s
+  Ptr<LoRaWANEndDevicePopulation> population = CreateObject<LoRaWANEndDevicePopulation> ();
+  population->SetAttribute ("DataRateIndex", UintegerValue (5));
+  population->SetAttribute ("ChannelRandomVariable", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+  population->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  population->SetAttribute ("UpstreamSend", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  population->SetChannel (channel);
+  population->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&LoRaWANEndDevicePopulationTestCase::USMsgTransmitted, this));
+  population->AddEndDevice (Ipv4Address (1), Vector (100.0, 0.0, 0.0));
+
+  Ptr<LoRaWANEndDevicePopulation> others = CreateObject<LoRaWANEndDevicePopulation> ();
+  others->SetAttribute ("DataRateIndex", UintegerValue (5));
+  others->SetAttribute ("ChannelRandomVariable", StringValue ("ns3::ConstantRandomVariable[Constant=3]"));
+  others->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+  others->SetAttribute ("UpstreamSend", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=50.0]"));
+  others->AssignStreams (0);
+  others->SetChannel (channel);
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      others->AddEndDevice (Ipv4Address (2 + i), Vector (0.0, 200.0 + 100.0 * i, 0.0));
+    }
+
+  // A 33 byte PHYPayload at SF7 is 92.416 ms on air, after which sub band 1
+  // is unavailable for 99 times as long
+  const Time airTime = LoRaWANPhy::GetTimeOnAir (33, 5, 3);
+  Simulator::Stop (Seconds (1.0) + airTime * 700 + MilliSeconds (500));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes.size (), 8, "Wrong number of frames of end device 1");
+  for (uint32_t i = 1; i < m_txTimes.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_txTimes[i] - m_txTimes[i - 1], airTime * 100, "End device 1 violated the duty cycle");
+    }
+  NS_TEST_ASSERT_MSG_EQ (population->GetEndDevice (0).fCntUp, 8, "Wrong frame counter");
+
+  // Every frame of every end device is received once
+  NS_TEST_ASSERT_MSG_EQ (m_nReceived, 8 + 5, "Not all frames were received by the gateway");
+
+  population->Dispose ();
+  others->Dispose ();
+  gw->Dispose ();
+  Simulator::Destroy ();
+}
+
+/*
+ * The end devices of a population honour the DutyCycleWindow of the RDC.
+ */
+class LoRaWANEndDevicePopulationDutyCycleWindowTestCase : public TestCase
+{
+public:
+  LoRaWANEndDevicePopulationDutyCycleWindowTestCase ();
+  virtual ~LoRaWANEndDevicePopulationDutyCycleWindowTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void USMsgTransmitted (uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p);
+
+  std::vector<Time> m_txTimes;
+};
+
+LoRaWANEndDevicePopulationDutyCycleWindowTestCase::LoRaWANEndDevicePopulationDutyCycleWindowTestCase ()
+  : TestCase ("Test the duty cycle window of a LoRaWAN end device population")
+{
+}
+
+LoRaWANEndDevicePopulationDutyCycleWindowTestCase::~LoRaWANEndDevicePopulationDutyCycleWindowTestCase ()
+{
+}
+
+void
+LoRaWANEndDevicePopulationDutyCycleWindowTestCase::USMsgTransmitted (uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p)
+{
+  m_txTimes.push_back (Simulator::Now ());
+}
+
+void
+LoRaWANEndDevicePopulationDutyCycleWindowTestCase::DoRun (void)
+{
+  // A window of 300 air times holds a 1% budget of 3 frames
+  const Time airTime = LoRaWANPhy::GetTimeOnAir (33, 5, 3);
+  Config::SetDefault ("ns3::LoRaWANMacRDC::DutyCycleWindow", TimeValue (airTime * 300));
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  Ptr<LoRaWANEndDevicePopulation> population = CreateObject<LoRaWANEndDevicePopulation> ();
+  population->SetAttribute ("DataRateIndex", UintegerValue (5));
+  population->SetAttribute ("ChannelRandomVariable", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+  population->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  population->SetAttribute ("UpstreamSend", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  population->SetChannel (channel);
+  population->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&LoRaWANEndDevicePopulationDutyCycleWindowTestCase::USMsgTransmitted, this));
+  population->AddEndDevice (Ipv4Address (1), Vector (0.0, 0.0, 0.0));
+
+  // Three frames are sent a second apart, the fourth waits until the first
+  // left the window
+  Simulator::Stop (Seconds (1.0) + airTime * 301 + MilliSeconds (500));
+  Simulator::Run ();
+  Config::SetDefault ("ns3::LoRaWANMacRDC::DutyCycleWindow", TimeValue (Seconds (0)));
+
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes.size (), 4, "Wrong number of frames");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[0], Seconds (1.0), "Wrong time of frame 1");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[1], Seconds (2.0), "Wrong time of frame 2");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[2], Seconds (3.0), "Wrong time of frame 3");
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes[3], Seconds (1.0) + airTime * 301, "Frame 4 did not wait for the duty cycle window");
+
+  population->Dispose ();
+  Simulator::Destroy ();
+}
+
+class LoRaWANEndDevicePopulationTestSuite : public TestSuite
+{
+public:
+  LoRaWANEndDevicePopulationTestSuite ();
+};
+
+LoRaWANEndDevicePopulationTestSuite::LoRaWANEndDevicePopulationTestSuite ()
+  : TestSuite ("lorawan-enddevice-population", UNIT)
+{
+  AddTestCase (new LoRaWANEndDevicePopulationTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANEndDevicePopulationDutyCycleWindowTestCase, TestCase::QUICK);
+}
+
+static LoRaWANEndDevicePopulationTestSuite lorawanEndDevicePopulationTestSuite;
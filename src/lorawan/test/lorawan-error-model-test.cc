@@ -44,7 +44,7 @@ NS_LOG_COMPONENT_DEFINE ("lorawan-error-model-test");
 class LoRaWANErrorDistanceTestCase : public TestCase
 {
 public:
-  LoRaWANErrorDistanceTestCase ();
+  LoRaWANErrorDistanceTestCase (bool scalarSinr, bool sharedGatewayReceiver = false);
   virtual ~LoRaWANErrorDistanceTestCase ();
   uint32_t GetReceived (void) const
   {
@@ -55,11 +55,16 @@ private:
   virtual void DoRun (void);
   void IndicationCallback (LoRaWANDataIndicationParams params, Ptr<Packet> p);
   uint32_t m_received;
+  bool m_scalarSinr;
+  bool m_sharedGatewayReceiver;
 };
 
-LoRaWANErrorDistanceTestCase::LoRaWANErrorDistanceTestCase ()
-  : TestCase ("Test the lora error model vs distance"),
-    m_received (0)
+LoRaWANErrorDistanceTestCase::LoRaWANErrorDistanceTestCase (bool scalarSinr, bool sharedGatewayReceiver)
+  : TestCase (sharedGatewayReceiver ? "Test the lora error model vs distance (shared gateway receiver)" :
+              scalarSinr ? "Test the lora error model vs distance (scalar SINR)" : "Test the lora error model vs distance"),
+    m_received (0),
+    m_scalarSinr (scalarSinr),
+    m_sharedGatewayReceiver (sharedGatewayReceiver)
 {
 }
 
@@ -80,6 +85,11 @@ LoRaWANErrorDistanceTestCase::DoRun (void)
   RngSeedManager::SetSeed (1);
   RngSeedManager::SetRun (6);
 
+  // The scalar SINR path has to give exactly the same results as the PSD path
+  Config::SetDefault ("ns3::LoRaWANPhy::ScalarSinr", BooleanValue (m_scalarSinr));
+  // A single transmitter never needs more than one demodulation path
+  Config::SetDefault ("ns3::LoRaWANNetDevice::SharedGatewayReceiver", BooleanValue (m_sharedGatewayReceiver));
+
   Ptr<Node> n0 = CreateObject <Node> ();
   Ptr<Node> n1 = CreateObject <Node> ();
   Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
@@ -145,6 +155,8 @@ LoRaWANErrorDistanceTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ (GetReceived (), 954, "Model fails");
 
   Simulator::Destroy ();
+  Config::SetDefault ("ns3::LoRaWANPhy::ScalarSinr", BooleanValue (false));
+  Config::SetDefault ("ns3::LoRaWANNetDevice::SharedGatewayReceiver", BooleanValue (false));
 }
 
 // ==============================================================================
@@ -196,6 +208,66 @@ LoRaWANErrorModelTestCase::DoRun (void)
 
 }
 
+// ==============================================================================
+class LoRaWANErrorModelTableTestCase : public TestCase
+{
+public:
+  LoRaWANErrorModelTableTestCase ();
+  virtual ~LoRaWANErrorModelTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANErrorModelTableTestCase::LoRaWANErrorModelTableTestCase ()
+  : TestCase ("Test the LoRaWAN error model lookup tables against the analytic model")
+{
+}
+
+LoRaWANErrorModelTableTestCase::~LoRaWANErrorModelTableTestCase ()
+{
+}
+
+void
+LoRaWANErrorModelTableTestCase::DoRun (void)
+{
+  Ptr<LoRaWANErrorModel> analytic = CreateObject<LoRaWANErrorModel> ();
+  Ptr<LoRaWANErrorModel> linear = CreateObject<LoRaWANErrorModel> ();
+  linear->SetAttribute ("SuccessRateMode", EnumValue (LoRaWANErrorModel::TABLE_LINEAR));
+  Ptr<LoRaWANErrorModel> cubic = CreateObject<LoRaWANErrorModel> ();
+  cubic->SetAttribute ("SuccessRateMode", EnumValue (LoRaWANErrorModel::TABLE_CUBIC));
+  const uint32_t bandwidth = 125e3;
+  const uint32_t nbits[] = {1, 8, 64, 256, 2040};
+
+  // Maximum absolute error on the chunk success rate
+  const double linearTolerance = 1e-4;
+  const double cubicTolerance = 1e-8;
+
+  double maxLinearError = 0.0;
+  double maxCubicError = 0.0;
+  for (uint8_t sf = LORAWAN_SF7; sf <= LORAWAN_SF12; sf++)
+    {
+      for (uint8_t codeRate = 1; codeRate <= 3; codeRate += 2)
+        {
+          // Also cover SNRs outside of the fitted range, which are clamped
+          for (double snr = -28.0; snr < 2.0; snr += 0.00373)
+            {
+              for (uint32_t i = 0; i < sizeof (nbits) / sizeof (nbits[0]); i++)
+                {
+                  LoRaSpreadingFactor spreadingFactor = static_cast <LoRaSpreadingFactor> (sf);
+                  double expected = analytic->GetChunkSuccessRate (snr, nbits[i], bandwidth, spreadingFactor, codeRate);
+                  maxLinearError = std::max (maxLinearError, std::fabs (linear->GetChunkSuccessRate (snr, nbits[i], bandwidth, spreadingFactor, codeRate) - expected));
+                  maxCubicError = std::max (maxCubicError, std::fabs (cubic->GetChunkSuccessRate (snr, nbits[i], bandwidth, spreadingFactor, codeRate) - expected));
+                }
+            }
+        }
+    }
+
+  NS_LOG_DEBUG ("Max. success rate error: linear = " << maxLinearError << ", cubic = " << maxCubicError);
+  NS_TEST_ASSERT_MSG_LT (maxLinearError, linearTolerance, "Linear interpolation deviates too much from the analytic model");
+  NS_TEST_ASSERT_MSG_LT (maxCubicError, cubicTolerance, "Cubic interpolation deviates too much from the analytic model");
+}
+
 // ==============================================================================
 class LoRaWANErrorModelTestSuite : public TestSuite
 {
@@ -207,7 +279,10 @@ LoRaWANErrorModelTestSuite::LoRaWANErrorModelTestSuite ()
   : TestSuite ("lorawan-error-model", UNIT)
 {
   AddTestCase (new LoRaWANErrorModelTestCase, TestCase::QUICK);
-  AddTestCase (new LoRaWANErrorDistanceTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANErrorModelTableTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANErrorDistanceTestCase (false), TestCase::QUICK);
+  AddTestCase (new LoRaWANErrorDistanceTestCase (true), TestCase::QUICK);
+  AddTestCase (new LoRaWANErrorDistanceTestCase (false, true), TestCase::QUICK);
 }
 
 static LoRaWANErrorModelTestSuite lorawanErrorModelTestSuite;
@@ -0,0 +1,206 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-interference-helper-test");
+
+class LoRaWANInterferenceHelperTestCase : public TestCase
+{
+public:
+  LoRaWANInterferenceHelperTestCase ();
+  virtual ~LoRaWANInterferenceHelperTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANInterferenceHelperTestCase::LoRaWANInterferenceHelperTestCase ()
+  : TestCase ("Test the incremental LoRaWAN interference accumulator")
+{
+}
+
+LoRaWANInterferenceHelperTestCase::~LoRaWANInterferenceHelperTestCase ()
+{
+}
+
+void
+LoRaWANInterferenceHelperTestCase::DoRun (void)
+{
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t freq0 = LoRaWAN::m_supportedChannels [0].m_fc;
+  const uint32_t freq1 = LoRaWAN::m_supportedChannels [1].m_fc;
+
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (freq0);
+  Ptr<LoRaWANInterferenceHelper> helper = Create<LoRaWANInterferenceHelper> (noise->GetSpectrumModel ());
+
+  Ptr<SpectrumValue> s0 = psdHelper.CreateTxPowerSpectralDensity (14, freq0);
+  Ptr<SpectrumValue> s1 = psdHelper.CreateTxPowerSpectralDensity (-120, freq0);
+  Ptr<SpectrumValue> s2 = psdHelper.CreateTxPowerSpectralDensity (2, freq1);
+
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s0, 5), true, "Adding a new signal should succeed");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s0, 5), false, "Adding the same signal twice should fail");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s1, 0), true, "Adding a new signal should succeed");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s2), true, "Adding a new signal should succeed");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 3, "Wrong number of accumulated signals");
+
+  // Per band and per (band, data rate) sums
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0), (*s0)[0] + (*s1)[0], 1e-25, "Wrong PSD in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, 5), (*s0)[0], "Wrong PSD for DR5 in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, 0), (*s1)[0], "Wrong PSD for DR0 in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (1), (*s2)[1], "Wrong PSD in band 1");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (1, 5), 0.0, "Unexpected PSD for DR5 in band 1");
+
+  // The scalar in-band power matches the one computed on the full PSD
+  NS_TEST_ASSERT_MSG_EQ (helper->GetInBandPower (0),
+                         LoRaWANSpectrumValueHelper::TotalAvgPower (helper->GetSignalPsd (), freq0),
+                         "Scalar in-band power does not match TotalAvgPower");
+
+  // Removing the strong signal leaves the weak one (nearly) untouched
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s0), true, "Removing an added signal should succeed");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s0), false, "Removing a signal twice should fail");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0), (*s1)[0], (*s1)[0] * 1e-9, "Weak signal lost after removing strong signal");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, 5), 0.0, "DR5 sum should be exactly zero after removal");
+
+  // Many add/remove cycles should not make the running sums drift
+  std::vector<Ptr<SpectrumValue> > signals;
+  for (uint32_t i = 0; i < 5000; i++)
+    {
+      Ptr<SpectrumValue> s = psdHelper.CreateTxPowerSpectralDensity (-130.0 + (i % 150), freq0);
+      helper->AddSignal (s, i % 6);
+      signals.push_back (s);
+      if (signals.size () > 10)
+        {
+          helper->RemoveSignal (signals.front ());
+          signals.erase (signals.begin ());
+        }
+    }
+  for (uint32_t i = 0; i < signals.size (); i++)
+    {
+      helper->RemoveSignal (signals[i]);
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0), (*s1)[0], (*s1)[0] * 1e-9, "Running sum drifted");
+
+  helper->RemoveSignal (s1);
+  helper->RemoveSignal (s2);
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 0, "Helper should be empty");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0), 0.0, "Empty helper should report exactly zero");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (1), 0.0, "Empty helper should report exactly zero");
+}
+
+// ==============================================================================
+class LoRaWANInterSfRejectionTestCase : public TestCase
+{
+public:
+  LoRaWANInterSfRejectionTestCase ();
+  virtual ~LoRaWANInterSfRejectionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANInterSfRejectionTestCase::LoRaWANInterSfRejectionTestCase ()
+  : TestCase ("Test the isolation between spreading factors in the interference accumulator")
+{
+}
+
+LoRaWANInterSfRejectionTestCase::~LoRaWANInterSfRejectionTestCase ()
+{
+}
+
+void
+LoRaWANInterSfRejectionTestCase::DoRun (void)
+{
+  // The default table is valid and does not attenuate co-SF interference
+  LoRaWANInterSfRejection rejection;
+  for (uint8_t sf = LORAWAN_SF7; sf <= LORAWAN_SF12; sf++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (rejection.GetGain (sf, sf), 1.0, "Co-SF interference should not be attenuated");
+    }
+  NS_TEST_ASSERT_MSG_EQ (rejection.GetIsolationDb (LORAWAN_SF7, LORAWAN_SF12), 10.0, "Wrong default isolation");
+  NS_TEST_ASSERT_MSG_EQ (rejection.GetIsolationDb (LORAWAN_SF12, LORAWAN_SF7), 26.0, "Wrong default isolation");
+
+  // Invalid tables are rejected and leave the table untouched
+  NS_TEST_ASSERT_MSG_EQ (rejection.Parse ("1 2 3"), false, "A short table should be rejected");
+  std::string diagonal = "1 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0";
+  NS_TEST_ASSERT_MSG_EQ (rejection.Parse (diagonal), false, "A non-zero diagonal should be rejected");
+  std::string negative = "0 -3 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0  0 0 0 0 0 0";
+  NS_TEST_ASSERT_MSG_EQ (rejection.Parse (negative), false, "A negative isolation should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (rejection.GetIsolationDb (LORAWAN_SF7, LORAWAN_SF12), 10.0, "An invalid table should not change the table");
+  std::string uniform = "0 20 20 20 20 20  20 0 20 20 20 20  20 20 0 20 20 20  20 20 20 0 20 20  20 20 20 20 0 20  20 20 20 20 20 0";
+  NS_TEST_ASSERT_MSG_EQ (rejection.Parse (uniform), true, "A valid table should be accepted");
+  NS_TEST_ASSERT_MSG_EQ_TOL (rejection.GetGain (LORAWAN_SF9, LORAWAN_SF8), 0.01, 1e-12, "Wrong gain for 20 dB isolation");
+
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t freq0 = LoRaWAN::m_supportedChannels [0].m_fc;
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (freq0);
+  Ptr<LoRaWANInterferenceHelper> helper = Create<LoRaWANInterferenceHelper> (noise->GetSpectrumModel ());
+
+  Ptr<SpectrumValue> sf7 = psdHelper.CreateTxPowerSpectralDensity (14, freq0);
+  Ptr<SpectrumValue> sf12 = psdHelper.CreateTxPowerSpectralDensity (2, freq0);
+  Ptr<SpectrumValue> other = psdHelper.CreateTxPowerSpectralDensity (-10, freq0);
+  helper->AddSignal (sf7, 5);
+  helper->AddSignal (sf12, 0);
+  helper->AddSignal (other);
+
+  // Without a table every signal counts in full
+  NS_TEST_ASSERT_MSG_EQ (helper->HasInterSfRejection (), false, "No table should be set by default");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetRejectedSignalPsd (0, 5), helper->GetSignalPsd (0), "Without a table nothing should be attenuated");
+
+  // The table is applied to the signals that were already accumulated
+  helper->SetInterSfRejection (LoRaWANInterSfRejection ());
+  const double p7 = (*sf7)[0];
+  const double p12 = (*sf12)[0];
+  const double pOther = (*other)[0];
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetRejectedSignalPsd (0, 5), p7 + p12 * 0.1 + pOther, 1e-12 * p7, "Wrong interference for SF7");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetRejectedSignalPsd (0, 0), p7 * std::pow (10.0, -2.6) + p12 + pOther, 1e-12 * p7, "Wrong interference for SF12");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetRejectedSignalPsd (0, LoRaWANInterferenceHelper::UNKNOWN_DATA_RATE_INDEX), helper->GetSignalPsd (0), 1e-12 * p7, "Unknown data rates should see all signals");
+
+  // Removing a signal also removes its attenuated contribution
+  helper->RemoveSignal (sf7);
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetRejectedSignalPsd (0, 0), p12 + pOther, 1e-9 * p12, "Wrong interference for SF12 after removal");
+
+  helper->ClearInterSfRejection ();
+  NS_TEST_ASSERT_MSG_EQ (helper->HasInterSfRejection (), false, "The table should be cleared");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetRejectedSignalPsd (0, 5), helper->GetSignalPsd (0), "Without a table nothing should be attenuated");
+}
+
+class LoRaWANInterferenceHelperTestSuite : public TestSuite
+{
+public:
+  LoRaWANInterferenceHelperTestSuite ();
+};
+
+LoRaWANInterferenceHelperTestSuite::LoRaWANInterferenceHelperTestSuite ()
+  : TestSuite ("lorawan-interference-helper", UNIT)
+{
+  AddTestCase (new LoRaWANInterferenceHelperTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANInterSfRejectionTestCase, TestCase::QUICK);
+}
+
+static LoRaWANInterferenceHelperTestSuite lorawanInterferenceHelperTestSuite;
@@ -0,0 +1,180 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-mac-rdc-test");
+
+class LoRaWANMacRDCWindowTestCase : public TestCase
+{
+public:
+  LoRaWANMacRDCWindowTestCase ();
+  virtual ~LoRaWANMacRDCWindowTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (Ptr<LoRaWANMac::LoRaWANMacRDC> rdc);
+};
+
+LoRaWANMacRDCWindowTestCase::LoRaWANMacRDCWindowTestCase ()
+  : TestCase ("Test the LoRaWAN RDC sliding window accounting")
+{
+}
+
+LoRaWANMacRDCWindowTestCase::~LoRaWANMacRDCWindowTestCase ()
+{
+}
+
+void
+LoRaWANMacRDCWindowTestCase::Check (Ptr<LoRaWANMac::LoRaWANMacRDC> rdc)
+{
+  // 30 s of the 36 s budget is used: 6 s fit, 7 s only once the first
+  // second of the first frame left the window
+  NS_TEST_ASSERT_MSG_EQ (rdc->IsSubBandAvailable (0, Seconds (6)), true, "Frame within the budget is blocked");
+  NS_TEST_ASSERT_MSG_EQ (rdc->IsSubBandAvailable (0, Seconds (7)), false, "Frame beyond the budget is allowed");
+  NS_TEST_ASSERT_MSG_EQ (rdc->GetSubBandAvailableTime (0, Seconds (7)), Seconds (3601), "Wrong available time");
+  // The second frame has to leave the window as well
+  NS_TEST_ASSERT_MSG_EQ (rdc->GetSubBandAvailableTime (0, Seconds (26)), Seconds (3600 + 100 + 10), "Wrong available time");
+}
+
+void
+LoRaWANMacRDCWindowTestCase::DoRun (void)
+{
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  rdc->SetAttribute ("DutyCycleWindow", TimeValue (Hours (1)));
+
+  // Sub band 0 allows 1%, i.e. 36 s per hour
+  rdc->UpdateRDCTimerForSubBand (0, Seconds (10));
+  Simulator::Schedule (Seconds (100), &LoRaWANMac::LoRaWANMacRDC::UpdateRDCTimerForSubBand, rdc, 0, Seconds (20));
+  Simulator::Schedule (Seconds (200), &LoRaWANMacRDCWindowTestCase::Check, this, rdc);
+  Simulator::Run ();
+
+  Simulator::Destroy ();
+}
+
+/*
+ * An end device queues a burst of frames, which are sent as the duty cycle
+ * allows. A lazy RDC object has to send them at the same times as the sub
+ * band timers do.
+ */
+class LoRaWANMacRDCLazyTestCase : public TestCase
+{
+public:
+  LoRaWANMacRDCLazyTestCase ();
+  virtual ~LoRaWANMacRDCLazyTestCase ();
+
+private:
+  virtual void DoRun (void);
+  std::vector<Time> Send (bool lazy);
+  static void MacTx (std::vector<Time> *txTimes, Ptr<const Packet> p);
+};
+
+LoRaWANMacRDCLazyTestCase::LoRaWANMacRDCLazyTestCase ()
+  : TestCase ("Test the LoRaWAN lazy RDC availability")
+{
+}
+
+LoRaWANMacRDCLazyTestCase::~LoRaWANMacRDCLazyTestCase ()
+{
+}
+
+void
+LoRaWANMacRDCLazyTestCase::MacTx (std::vector<Time> *txTimes, Ptr<const Packet> p)
+{
+  txTimes->push_back (Simulator::Now ());
+}
+
+std::vector<Time>
+LoRaWANMacRDCLazyTestCase::Send (bool lazy)
+{
+  Config::SetDefault ("ns3::LoRaWANMacRDC::LazyAvailability", BooleanValue (lazy));
+
+  Ptr<Node> n0 = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  dev0->AssignStreams (0);
+  dev0->SetAddress (Ipv4Address (0x00000001));
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  dev0->SetChannel (channel);
+  n0->AddDevice (dev0);
+  dev0->GetPhy ()->SetMobility (CreateObject<ConstantPositionMobilityModel> ());
+
+  std::vector<Time> txTimes;
+  dev0->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&LoRaWANMacRDCLazyTestCase::MacTx, &txTimes));
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 5;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_numberOfTransmissions = 1;
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      params.m_requestHandle = i;
+      Simulator::Schedule (Seconds (1), &LoRaWANMac::sendMACPayloadRequest, dev0->GetMac (), params, Create<Packet> (20));
+    }
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  Config::SetDefault ("ns3::LoRaWANMacRDC::LazyAvailability", BooleanValue (false));
+  return txTimes;
+}
+
+void
+LoRaWANMacRDCLazyTestCase::DoRun (void)
+{
+  std::vector<Time> timerTxTimes = Send (false);
+  std::vector<Time> lazyTxTimes = Send (true);
+
+  NS_TEST_ASSERT_MSG_EQ (timerTxTimes.size (), 5, "Not all frames were sent");
+  NS_TEST_ASSERT_MSG_EQ (lazyTxTimes.size (), timerTxTimes.size (), "Lazy RDC sent a different number of frames");
+  for (uint32_t i = 0; i < lazyTxTimes.size () && i < timerTxTimes.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (lazyTxTimes[i], timerTxTimes[i], "Lazy RDC sent frame " << i << " at a different time");
+    }
+}
+
+class LoRaWANMacRDCTestSuite : public TestSuite
+{
+public:
+  LoRaWANMacRDCTestSuite ();
+};
+
+LoRaWANMacRDCTestSuite::LoRaWANMacRDCTestSuite ()
+  : TestSuite ("lorawan-mac-rdc", UNIT)
+{
+  AddTestCase (new LoRaWANMacRDCWindowTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANMacRDCLazyTestCase, TestCase::QUICK);
+}
+
+static LoRaWANMacRDCTestSuite lorawanMacRDCTestSuite;
@@ -0,0 +1,302 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/packet.h>
+#include <ns3/simulator.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <ns3/lorawan-module.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-mac-tx-queue-test");
+
+class LoRaWANRingQueueTestCase : public TestCase
+{
+public:
+  LoRaWANRingQueueTestCase ();
+  virtual ~LoRaWANRingQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRingQueueTestCase::LoRaWANRingQueueTestCase ()
+  : TestCase ("Test the LoRaWAN ring queue")
+{
+}
+
+LoRaWANRingQueueTestCase::~LoRaWANRingQueueTestCase ()
+{
+}
+
+void
+LoRaWANRingQueueTestCase::DoRun (void)
+{
+  LoRaWANRingQueue<uint32_t> queue (3);
+  NS_TEST_ASSERT_MSG_EQ (queue.IsEmpty (), true, "New queue is not empty");
+
+  queue.PushBack () = 1;
+  queue.PushBack () = 2;
+  queue.PushBack () = 3;
+  NS_TEST_ASSERT_MSG_EQ (queue.IsFull (), true, "Queue is not full");
+  NS_TEST_ASSERT_MSG_EQ (queue.Front (), 1, "Wrong first element");
+
+  // Wrap around the end of the ring
+  queue.PopFront ();
+  queue.PopFront ();
+  queue.PushBack () = 4;
+  queue.PushBack () = 5;
+  NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), 3, "Wrong size after wrapping");
+  NS_TEST_ASSERT_MSG_EQ (queue[0], 3, "Wrong element 0 after wrapping");
+  NS_TEST_ASSERT_MSG_EQ (queue[1], 4, "Wrong element 1 after wrapping");
+  NS_TEST_ASSERT_MSG_EQ (queue[2], 5, "Wrong element 2 after wrapping");
+
+  // Erasing keeps the order of the other elements
+  queue.Erase (1);
+  NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), 2, "Wrong size after erasing");
+  NS_TEST_ASSERT_MSG_EQ (queue[0], 3, "Wrong element 0 after erasing");
+  NS_TEST_ASSERT_MSG_EQ (queue[1], 5, "Wrong element 1 after erasing");
+  queue.PushBack () = 6;
+  NS_TEST_ASSERT_MSG_EQ (queue[2], 6, "Wrong element 2 after erasing");
+
+  queue.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (queue.IsEmpty (), true, "Cleared queue is not empty");
+  queue.SetCapacity (5);
+  NS_TEST_ASSERT_MSG_EQ (queue.GetCapacity (), 5, "Wrong capacity");
+
+  // Without a capacity the ring grows, also while it wraps around its end
+  LoRaWANRingQueue<uint32_t> unbounded;
+  NS_TEST_ASSERT_MSG_EQ (unbounded.GetCapacity (), 0, "The default queue is bounded");
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      unbounded.PushBack () = i;
+    }
+  unbounded.PopFront ();
+  unbounded.PopFront ();
+  for (uint32_t i = 3; i < 100; i++)
+    {
+      unbounded.PushBack () = i;
+      NS_TEST_ASSERT_MSG_EQ (unbounded.IsFull (), false, "An unbounded queue is full");
+    }
+  NS_TEST_ASSERT_MSG_EQ (unbounded.GetSize (), 98, "Wrong size of the unbounded queue");
+  for (uint32_t i = 0; i < unbounded.GetSize (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (unbounded[i], i + 2, "Wrong element " << i << " of the unbounded queue");
+    }
+}
+
+/*
+ * By default the transmit queue holds any number of frames. With a small
+ * depth, the frames that do not fit are reported by the MacTxDrop trace.
+ */
+class LoRaWANMacTxQueueDepthTestCase : public TestCase
+{
+public:
+  LoRaWANMacTxQueueDepthTestCase ();
+  virtual ~LoRaWANMacTxQueueDepthTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void MacTxDrop (Ptr<const Packet> packet);
+  uint32_t Offer (Ptr<LoRaWANMac> mac, uint32_t nFrames);
+
+  std::vector<uint64_t> m_dropped;
+};
+
+LoRaWANMacTxQueueDepthTestCase::LoRaWANMacTxQueueDepthTestCase ()
+  : TestCase ("Test the depth of the LoRaWAN MAC transmit queue")
+{
+}
+
+LoRaWANMacTxQueueDepthTestCase::~LoRaWANMacTxQueueDepthTestCase ()
+{
+}
+
+void
+LoRaWANMacTxQueueDepthTestCase::MacTxDrop (Ptr<const Packet> packet)
+{
+  m_dropped.push_back (packet->GetUid ());
+}
+
+// Queue frames on a MAC that can not send, returns the uid of the first frame
+uint32_t
+LoRaWANMacTxQueueDepthTestCase::Offer (Ptr<LoRaWANMac> mac, uint32_t nFrames)
+{
+  mac->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&LoRaWANMacTxQueueDepthTestCase::MacTxDrop, this));
+  mac->ChangeMacState (MAC_UNAVAILABLE);
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 5;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_numberOfTransmissions = 1;
+
+  uint32_t firstUid = 0;
+  for (uint32_t i = 0; i < nFrames; i++)
+    {
+      params.m_requestHandle = i;
+      LoRaWANFrameHeaderUplink frameHdr (Ipv4Address (1), false, false, false, false, 0, i, 1);
+      Ptr<Packet> p = Create<Packet> (10);
+      p->AddHeader (frameHdr);
+      if (i == 0)
+        {
+          firstUid = p->GetUid ();
+        }
+      mac->sendMACPayloadRequest (params, p);
+    }
+  return firstUid;
+}
+
+void
+LoRaWANMacTxQueueDepthTestCase::DoRun (void)
+{
+  Ptr<LoRaWANMac> unbounded = CreateObject<LoRaWANMac> (0);
+  UintegerValue depth;
+  unbounded->GetAttribute ("TxQueueDepth", depth);
+  NS_TEST_ASSERT_MSG_EQ (depth.Get (), 0, "The transmit queue is bounded by default");
+  Offer (unbounded, 200);
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 0, "The default transmit queue dropped frames");
+  unbounded->Dispose ();
+
+  Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (0);
+  mac->SetAttribute ("TxQueueDepth", UintegerValue (2));
+  const uint32_t firstUid = Offer (mac, 5);
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 3, "Wrong number of dropped frames");
+  for (uint32_t i = 0; i < m_dropped.size (); i++)
+    {
+      // The MAC traces the frame with its MAC header, which keeps the uid
+      NS_TEST_ASSERT_MSG_EQ (m_dropped[i], firstUid + 2 + i, "Wrong dropped frame " << i);
+    }
+  mac->Dispose ();
+  Simulator::Destroy ();
+}
+
+/*
+ * Frames are queued on a MAC that can not send, so that the transmit queue
+ * overflows. Frames with an odd request handle have the ACK bit set.
+ */
+class LoRaWANMacTxQueueOverflowTestCase : public TestCase
+{
+public:
+  LoRaWANMacTxQueueOverflowTestCase (LoRaWANTxQueueOverflowPolicy policy, uint32_t expectedDropped[2]);
+  virtual ~LoRaWANMacTxQueueOverflowTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void DataConfirm (LoRaWANDataConfirmParams params);
+  void TxQueueOccupancy (uint32_t oldValue, uint32_t newValue);
+
+  LoRaWANTxQueueOverflowPolicy m_policy;
+  uint32_t m_expectedDropped[2];
+  std::vector<uint32_t> m_dropped;
+  uint32_t m_occupancy;
+};
+
+LoRaWANMacTxQueueOverflowTestCase::LoRaWANMacTxQueueOverflowTestCase (LoRaWANTxQueueOverflowPolicy policy, uint32_t expectedDropped[2])
+  : TestCase ("Test the LoRaWAN MAC transmit queue overflow policy " + std::to_string (policy)),
+    m_policy (policy),
+    m_occupancy (0)
+{
+  m_expectedDropped[0] = expectedDropped[0];
+  m_expectedDropped[1] = expectedDropped[1];
+}
+
+LoRaWANMacTxQueueOverflowTestCase::~LoRaWANMacTxQueueOverflowTestCase ()
+{
+}
+
+void
+LoRaWANMacTxQueueOverflowTestCase::DataConfirm (LoRaWANDataConfirmParams params)
+{
+  NS_TEST_ASSERT_MSG_EQ (params.m_status, LORAWAN_TRANSACTION_OVERFLOW, "Unexpected confirm status");
+  m_dropped.push_back (params.m_requestHandle);
+}
+
+void
+LoRaWANMacTxQueueOverflowTestCase::TxQueueOccupancy (uint32_t oldValue, uint32_t newValue)
+{
+  m_occupancy = newValue;
+}
+
+void
+LoRaWANMacTxQueueOverflowTestCase::DoRun (void)
+{
+  Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (0);
+  mac->SetAttribute ("TxQueueDepth", UintegerValue (3));
+  mac->SetAttribute ("TxQueueOverflowPolicy", EnumValue (m_policy));
+  mac->SetDataConfirmCallback (MakeCallback (&LoRaWANMacTxQueueOverflowTestCase::DataConfirm, this));
+  mac->TraceConnectWithoutContext ("TxQueueOccupancy", MakeCallback (&LoRaWANMacTxQueueOverflowTestCase::TxQueueOccupancy, this));
+  mac->ChangeMacState (MAC_UNAVAILABLE);
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 5;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_numberOfTransmissions = 1;
+
+  // Handles 0, 2 and 4 fill the queue, then ACK frame 5 and frame 6 arrive
+  const uint32_t handles[] = {0, 2, 4, 5, 6};
+  for (uint32_t i = 0; i < sizeof (handles) / sizeof (handles[0]); i++)
+    {
+      params.m_requestHandle = handles[i];
+      LoRaWANFrameHeaderUplink frameHdr (Ipv4Address (1), false, false, handles[i] % 2 == 1, false, 0, i, 1);
+      Ptr<Packet> p = Create<Packet> (10);
+      p->AddHeader (frameHdr);
+      mac->sendMACPayloadRequest (params, p);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (m_occupancy, 3, "Wrong transmit queue occupancy");
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 2, "Wrong number of dropped frames");
+  NS_TEST_ASSERT_MSG_EQ (m_dropped[0], m_expectedDropped[0], "Wrong first dropped frame");
+  NS_TEST_ASSERT_MSG_EQ (m_dropped[1], m_expectedDropped[1], "Wrong second dropped frame");
+
+  mac->Dispose ();
+  Simulator::Destroy ();
+}
+
+class LoRaWANMacTxQueueTestSuite : public TestSuite
+{
+public:
+  LoRaWANMacTxQueueTestSuite ();
+};
+
+LoRaWANMacTxQueueTestSuite::LoRaWANMacTxQueueTestSuite ()
+  : TestSuite ("lorawan-mac-tx-queue", UNIT)
+{
+  AddTestCase (new LoRaWANRingQueueTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANMacTxQueueDepthTestCase, TestCase::QUICK);
+  uint32_t dropTail[2] = {5, 6};
+  AddTestCase (new LoRaWANMacTxQueueOverflowTestCase (LORAWAN_TXQ_DROP_TAIL, dropTail), TestCase::QUICK);
+  uint32_t dropOldest[2] = {0, 2};
+  AddTestCase (new LoRaWANMacTxQueueOverflowTestCase (LORAWAN_TXQ_DROP_OLDEST, dropOldest), TestCase::QUICK);
+  // The ACK frame replaces the oldest frame, the frame after it is dropped
+  uint32_t ackPriority[2] = {0, 6};
+  AddTestCase (new LoRaWANMacTxQueueOverflowTestCase (LORAWAN_TXQ_ACK_PRIORITY, ackPriority), TestCase::QUICK);
+}
+
+static LoRaWANMacTxQueueTestSuite lorawanMacTxQueueTestSuite;
@@ -0,0 +1,256 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/packet-socket-helper.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-periodicity-detection-test");
+
+/*
+ * The timeslot recorder keeps the recorded slots sorted and unique and
+ * expands them into the sequence of the periodicity detector.
+ */
+class LoRaWANTimeslotsRecorderTestCase : public TestCase
+{
+public:
+  LoRaWANTimeslotsRecorderTestCase ();
+  virtual ~LoRaWANTimeslotsRecorderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANTimeslotsRecorderTestCase::LoRaWANTimeslotsRecorderTestCase ()
+  : TestCase ("Test the LoRaWAN timeslots recorder")
+{
+}
+
+LoRaWANTimeslotsRecorderTestCase::~LoRaWANTimeslotsRecorderTestCase ()
+{
+}
+
+void
+LoRaWANTimeslotsRecorderTestCase::DoRun (void)
+{
+  LoRaWANTimeslotsRecorder recorder (100);
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (10), true, "Slot 10 was not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (40), true, "Slot 40 was not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (25), true, "Slot 25 was not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (0), true, "Slot 0 was not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (25), true, "Slot 25 was not recorded twice");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (99), true, "The last slot was not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (100), false, "A slot past the period was recorded");
+
+  const uint32_t expected[] = {0, 10, 25, 40, 99};
+  const std::vector<uint32_t> &slots = recorder.GetSlots ();
+  NS_TEST_ASSERT_MSG_EQ (slots.size (), 5, "Wrong number of recorded slots");
+  for (uint32_t i = 0; i < slots.size () && i < 5; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (slots[i], expected[i], "Wrong recorded slot " << i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (recorder.IsRecorded (25), true, "Slot 25 is not recorded");
+  NS_TEST_ASSERT_MSG_EQ (recorder.IsRecorded (26), false, "Slot 26 is recorded");
+
+  std::vector<unsigned char> sequence (7, 1);
+  recorder.Unpack (sequence);
+  NS_TEST_ASSERT_MSG_EQ (sequence.size (), 100, "Wrong size of the sequence");
+  for (uint32_t slot = 0; slot < sequence.size (); slot++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((sequence[slot] == 1), recorder.IsRecorded (slot), "Wrong sequence in slot " << slot);
+    }
+
+  recorder.Reset (50);
+  NS_TEST_ASSERT_MSG_EQ (recorder.GetSize (), 50, "Wrong size after a reset");
+  NS_TEST_ASSERT_MSG_EQ (recorder.GetSlots ().size (), 0, "Slots survived a reset");
+  NS_TEST_ASSERT_MSG_EQ (recorder.Record (60), false, "A slot past the new period was recorded");
+}
+
+/*
+ * The network server finds the periodicity of end devices that send at a
+ * fixed interval, with the same result for any number of detection threads.
+ */
+class LoRaWANPeriodicityDetectionTestCase : public TestCase
+{
+public:
+  LoRaWANPeriodicityDetectionTestCase ();
+  virtual ~LoRaWANPeriodicityDetectionTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Receive (Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, uint16_t fCnt, uint8_t dataRateIndex);
+  void Detect (uint32_t threads);
+  std::vector<Periodicity> Run (uint32_t threads);
+
+  std::vector<Periodicity> m_periodicities;
+};
+
+// The period of the lightweight timeslots scheduler: one DR0 slot per second
+static const double PERIOD = 1986.0;
+static const uint32_t N_DEVICES = 12;
+
+LoRaWANPeriodicityDetectionTestCase::LoRaWANPeriodicityDetectionTestCase ()
+  : TestCase ("Test the periodicity detection of the LoRaWAN network server")
+{
+}
+
+LoRaWANPeriodicityDetectionTestCase::~LoRaWANPeriodicityDetectionTestCase ()
+{
+}
+
+void
+LoRaWANPeriodicityDetectionTestCase::Receive (Ptr<LoRaWANGatewayApplication> gw, uint32_t deviceAddr, uint16_t fCnt, uint8_t dataRateIndex)
+{
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (deviceAddr));
+  fhdr.setFrameCounter (fCnt);
+  fhdr.setFramePort (1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (3);
+  phyParamsTag.SetRssi (-110.0);
+  phyParamsTag.SetSnr (5.0);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+  packet->AddPacketTag (msgTypeTag);
+
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->HandleUSPacket (gw, Address (), packet);
+}
+
+void
+LoRaWANPeriodicityDetectionTestCase::Detect (uint32_t threads)
+{
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->DetectPeriodicities ();
+  m_periodicities.clear ();
+  for (uint8_t dr = 0; dr < 6; dr++)
+    {
+      const std::vector<Periodicity> &periodicities = ns->GetPeriodicities (dr);
+      m_periodicities.insert (m_periodicities.end (), periodicities.begin (), periodicities.end ());
+    }
+
+  // The recorders were cleared, so nothing is found the second time
+  ns->DetectPeriodicities ();
+  for (uint8_t dr = 0; dr < 6; dr++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (ns->GetPeriodicities (dr).size (), 0, "The recorders were not cleared with " << threads << " threads");
+    }
+}
+
+std::vector<Periodicity>
+LoRaWANPeriodicityDetectionTestCase::Run (uint32_t threads)
+{
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  std::ostringstream period;
+  period << "ns3::ConstantRandomVariable[Constant=" << PERIOD << "]";
+  ns->SetAttribute ("TimeSlotCalcRanomVariable", StringValue (period.str ()));
+  ns->SetAttribute ("TimeslotsDetectionThreads", UintegerValue (threads));
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  Ptr<Node> node = CreateObject<Node> ();
+  node->AggregateObject (CreateObject<ConstantPositionMobilityModel> ());
+  Ptr<LoRaWANNetDevice> device = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  node->AddDevice (device);
+  device->SetChannel (channel);
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (node);
+
+  Ptr<LoRaWANGatewayApplication> app = CreateObject<LoRaWANGatewayApplication> ();
+  node->AddApplication (app);
+  app->SetStartTime (Seconds (0.0));
+
+  // End device i sends every 30 + 5 * i seconds from second 2 * i, a third
+  // of them at DR2, which has four slots per second
+  for (uint32_t i = 1; i <= N_DEVICES; i++)
+    {
+      const uint8_t dataRateIndex = i % 3 == 0 ? 2 : 0;
+      uint16_t fCnt = 1;
+      for (double t = 2.0 * i + 0.3; t < PERIOD - 10.0; t += 30.0 + 5.0 * i)
+        {
+          Simulator::Schedule (Seconds (t), &LoRaWANPeriodicityDetectionTestCase::Receive, this, app, i, fCnt++, dataRateIndex);
+        }
+    }
+
+  // Before the scheduler of the network server runs at the end of the period
+  Simulator::Schedule (Seconds (PERIOD - 1.0), &LoRaWANPeriodicityDetectionTestCase::Detect, this, threads);
+  Simulator::Stop (Seconds (PERIOD - 0.5));
+  Simulator::Run ();
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  return m_periodicities;
+}
+
+void
+LoRaWANPeriodicityDetectionTestCase::DoRun (void)
+{
+  std::vector<Periodicity> serial = Run (1);
+  NS_TEST_ASSERT_MSG_EQ (serial.size (), N_DEVICES, "Wrong number of periodicities");
+  for (uint32_t n = 0; n < serial.size (); n++)
+    {
+      const uint32_t i = serial[n].uID;
+      const int slotsPerSecond = i % 3 == 0 ? 4 : 1;
+      NS_TEST_ASSERT_MSG_EQ (serial[n].p, slotsPerSecond * int (30 + 5 * i), "Wrong periodicity of end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (serial[n].o, slotsPerSecond * int (2 * i) + (slotsPerSecond == 4 ? 1 : 0), "Wrong offset of end device " << i);
+    }
+
+  std::vector<Periodicity> parallel = Run (4);
+  NS_TEST_ASSERT_MSG_EQ (parallel.size (), serial.size (), "The number of periodicities depends on the number of threads");
+  for (uint32_t n = 0; n < serial.size () && n < parallel.size (); n++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (parallel[n].uID, serial[n].uID, "The order of the periodicities depends on the number of threads");
+      NS_TEST_ASSERT_MSG_EQ (parallel[n].p, serial[n].p, "The periodicity depends on the number of threads");
+      NS_TEST_ASSERT_MSG_EQ (parallel[n].o, serial[n].o, "The offset depends on the number of threads");
+    }
+}
+
+class LoRaWANPeriodicityDetectionTestSuite : public TestSuite
+{
+public:
+  LoRaWANPeriodicityDetectionTestSuite ();
+};
+
+LoRaWANPeriodicityDetectionTestSuite::LoRaWANPeriodicityDetectionTestSuite ()
+  : TestSuite ("lorawan-periodicity-detection", UNIT)
+{
+  AddTestCase (new LoRaWANTimeslotsRecorderTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANPeriodicityDetectionTestCase, TestCase::QUICK);
+}
+
+static LoRaWANPeriodicityDetectionTestSuite lorawanPeriodicityDetectionTestSuite;
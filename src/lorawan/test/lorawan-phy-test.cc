@@ -26,6 +26,9 @@
 #include "ns3/nstime.h"
 #include <ns3/log.h>
 
+#include <algorithm>
+#include <cmath>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
@@ -296,6 +299,54 @@ LoRaWANPhyTxTimeTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Compare the time on air table with the closed form expression of the sx1272
+// data sheet, for all payload lengths, spreading factors, code rates and CRC
+// settings.
+class LoRaWANPhyTimeOnAirTableTestCase : public TestCase
+{
+public:
+  LoRaWANPhyTimeOnAirTableTestCase ();
+  virtual ~LoRaWANPhyTimeOnAirTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPhyTimeOnAirTableTestCase::LoRaWANPhyTimeOnAirTableTestCase ()
+  : TestCase ("Test the static time on air table against the closed form expression")
+{
+}
+
+LoRaWANPhyTimeOnAirTableTestCase::~LoRaWANPhyTimeOnAirTableTestCase ()
+{
+}
+
+void
+LoRaWANPhyTimeOnAirTableTestCase::DoRun (void)
+{
+  const uint32_t bandwidth = 125000;
+  const uint8_t preambleLength = 8;
+  for (uint32_t crc = 0; crc < 2; crc++)
+    for (uint32_t codeRate = 1; codeRate <= 4; codeRate++)
+      for (uint32_t sf = LORAWAN_SF7; sf <= LORAWAN_SF12; sf++)
+        for (uint32_t length = 0; length < 256; length++)
+          {
+            double symbolPeriod = 1.0e6/(bandwidth/pow (2.0, sf));
+            double nSymbolsPayload = 8 + std::max (ceil ((8.0*length - 4.0*sf + 28 + 16*crc)/(4.0*sf))*(codeRate + 4), 0.0);
+            Time expected = MicroSeconds ((preambleLength + 4.25 + nSymbolsPayload) * symbolPeriod);
+            Time timeOnAir = LoRaWANPhy::GetTimeOnAir (length, (LoRaSpreadingFactor)sf, bandwidth, codeRate, preambleLength, crc == 1);
+            NS_TEST_ASSERT_MSG_EQ (timeOnAir, expected, "Wrong time on air for SF" << sf << ", CR" << codeRate << ", CRC " << crc << ", length " << length);
+          }
+
+  // The PHY uses the same table
+  Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (0);
+  bool txConfSucces = phy->SetTxConf (2, 0, 3, 2, preambleLength, false, true);
+  NS_TEST_ASSERT_MSG_EQ (txConfSucces, true, "Failed to configure LoRa PHY");
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxTime (23), LoRaWANPhy::GetTimeOnAir (23, 3, 2), "PHY time on air differs from the table");
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculatePreambleTime (), LoRaWANPhy::GetPreambleTime (LORAWAN_SF9, bandwidth, preambleLength), "PHY preamble time differs from the table");
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANPhy::GetNominalDataRate (LORAWAN_SF9, bandwidth), 9 * 125000.0 / 512, 1e-9, "Wrong nominal data rate");
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -311,6 +362,7 @@ LoRaWANPhyTestSuite::LoRaWANPhyTestSuite()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new LoRaWANPhyTxTimeTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANPhyTimeOnAirTableTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
@@ -0,0 +1,303 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/config.h>
+#include <ns3/string.h>
+#include <ns3/simulator.h>
+#include <ns3/node.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-region-test");
+
+class LoRaWANRegionTestCase : public TestCase
+{
+public:
+  LoRaWANRegionTestCase ();
+  virtual ~LoRaWANRegionTestCase ();
+
+private:
+  virtual void DoRun (void);
+  virtual void DoTeardown (void);
+};
+
+LoRaWANRegionTestCase::LoRaWANRegionTestCase ()
+  : TestCase ("Test the LoRaWAN US915 region plan")
+{
+}
+
+LoRaWANRegionTestCase::~LoRaWANRegionTestCase ()
+{
+}
+
+void
+LoRaWANRegionTestCase::DoRun (void)
+{
+  Config::SetGlobal ("LoRaWANRegion", StringValue ("US915"));
+
+  // The region is switched when the first LoRaWAN object is created
+  Ptr<Node> n0 = CreateObject<Node> ();
+  Ptr<LoRaWANNetDevice> gw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  n0->AddDevice (gw);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetRegion (), LORAWAN_REGION_US915, "Region was not switched");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 80, "Wrong number of channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedDataRates.size (), 14, "Wrong number of data rates");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetNUplinkChannels (), 72, "Wrong number of uplink channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[65].m_fc, 904600000, "Wrong 500 kHz uplink channel frequency");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[79].m_fc, 927500000, "Wrong downlink channel frequency");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetMaxMACPayloadSize (0), 19, "Wrong DR0 maximum MACPayload size");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2ChannelIndex, 72, "Wrong RW2 channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2DataRateIndex, 8, "Wrong RW2 data rate");
+
+  // By default the end devices use the sub band the gateways listen on, and
+  // only the 500 kHz channel at DR4
+  const std::vector<uint8_t> &uplinkChannels = LoRaWAN::GetUplinkChannels ();
+  NS_TEST_ASSERT_MSG_EQ (uplinkChannels.size (), 9, "Wrong number of default uplink channels");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)uplinkChannels.front (), 8, "Wrong first default uplink channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)uplinkChannels.back (), 65, "Wrong 500 kHz default uplink channel");
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      const uint8_t channelIndex = LoRaWAN::PickUplinkChannel (0, random);
+      NS_TEST_ASSERT_MSG_EQ ((channelIndex >= 8 && channelIndex <= 15), true, "Wrong DR0 channel " << (uint16_t)channelIndex);
+    }
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::PickUplinkChannel (4, random), 65, "Wrong DR4 channel");
+
+  // RX1 is on the downlink channel upstream channel % 8, with DR 10 + uplink DR - offset
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (9), 73, "Wrong RX1 channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (65), 73, "Wrong RX1 channel for a 500 kHz uplink");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (0, 0), 10, "Wrong RX1 data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (4, 0), 13, "Wrong RX1 data rate for DR4");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (0, 3), 8, "Wrong RX1 data rate with an offset");
+
+  // The gateway only listens on the data rates of sub band 2, its 500 kHz
+  // channel and the downlink channels: 8 * 4 + 1 + 8 * 6 PHYs
+  std::vector<Ptr<LoRaWANPhy> > phys = gw->GetPhys ();
+  NS_TEST_ASSERT_MSG_EQ (phys.size (), 81, "Wrong number of gateway PHYs");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)phys[0]->GetCurrentChannelIndex (), 8, "Wrong channel of the first gateway PHY");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)phys[32]->GetCurrentChannelIndex (), 65, "Wrong channel of the 500 kHz gateway PHY");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)phys[32]->GetCurrentDataRateIndex (), 4, "Wrong data rate of the 500 kHz gateway PHY");
+
+  // The spectrum model has a band per channel
+  Ptr<SpectrumValue> noise = LoRaWANSpectrumValueHelper ().CreateNoisePowerSpectralDensity (LoRaWAN::m_supportedChannels[0].m_fc);
+  NS_TEST_ASSERT_MSG_EQ (noise->GetSpectrumModel ()->GetNumBands (), 80, "Wrong number of spectrum bands");
+
+  // The power of a signal and of the noise is integrated over the bandwidth
+  // of the channel, so a 500 kHz channel has the same signal power and four
+  // times the noise power of a 125 kHz channel
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t narrow = LoRaWAN::m_supportedChannels[8].m_fc;
+  const uint32_t wide = LoRaWAN::m_supportedChannels[65].m_fc;
+  const double txPower = pow (10.0, (14.0 - 30) / 10);
+  Ptr<SpectrumValue> narrowPsd = psdHelper.CreateTxPowerSpectralDensity (14.0, narrow);
+  Ptr<SpectrumValue> widePsd = psdHelper.CreateTxPowerSpectralDensity (14.0, wide);
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANSpectrumValueHelper::TotalAvgPower (narrowPsd, narrow), txPower, txPower * 1e-9, "Wrong power on a 125 kHz channel");
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANSpectrumValueHelper::TotalAvgPower (widePsd, wide), txPower, txPower * 1e-9, "Wrong power on a 500 kHz channel");
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANSpectrumValueHelper::TotalAvgPower ((*widePsd)[65], LoRaWAN::m_supportedChannels[65].m_bw), txPower, txPower * 1e-9, "Wrong scalar power on a 500 kHz channel");
+  const double narrowSnr = 10.0 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (narrowPsd, narrow) / LoRaWANSpectrumValueHelper::TotalAvgPower (noise, narrow));
+  const double wideSnr = 10.0 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (widePsd, wide) / LoRaWANSpectrumValueHelper::TotalAvgPower (noise, wide));
+  NS_TEST_ASSERT_MSG_EQ_TOL (narrowSnr - wideSnr, 10.0 * log10 (4.0), 1e-6, "Wrong SNR on a 500 kHz channel");
+
+  gw->Dispose ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANRegionTestCase::DoTeardown (void)
+{
+  // Also after a failed assertion, so that the suites run after this one
+  // find the default region
+  Config::SetGlobal ("LoRaWANRegion", StringValue ("EU868"));
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+}
+
+/*
+ * An end device sends an upstream frame through its MAC and PHY to a gateway
+ * 100 m away, which answers in RW1. The MACs configure the PHYs with the
+ * maximum TX power of the sub band, which has to be a TX power of the region.
+ */
+class LoRaWANRegionFrameTestCase : public TestCase
+{
+public:
+  LoRaWANRegionFrameTestCase (LoRaWANRegion region, uint8_t channelIndex, uint8_t dataRateIndex);
+  virtual ~LoRaWANRegionFrameTestCase ();
+
+private:
+  virtual void DoRun (void);
+  virtual void DoTeardown (void);
+
+  bool GatewayReceive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from);
+  bool EndDeviceReceive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from);
+  void SendDownlink (Ptr<LoRaWANNetDevice> gateway, uint8_t channelIndex, uint8_t dataRateIndex);
+
+  LoRaWANRegion m_region;
+  uint8_t m_channelIndex;
+  uint8_t m_dataRateIndex;
+  std::vector<std::pair<uint8_t, uint8_t> > m_uplinks;   //!< Channel and data rate of the received US frames
+  std::vector<std::pair<uint8_t, uint8_t> > m_downlinks; //!< Channel and data rate of the received DS frames
+};
+
+LoRaWANRegionFrameTestCase::LoRaWANRegionFrameTestCase (LoRaWANRegion region, uint8_t channelIndex, uint8_t dataRateIndex)
+  : TestCase (std::string ("Test a frame exchange through the MAC and PHY in ") + LoRaWAN::GetRegionPlan (region).name),
+    m_region (region),
+    m_channelIndex (channelIndex),
+    m_dataRateIndex (dataRateIndex)
+{
+}
+
+LoRaWANRegionFrameTestCase::~LoRaWANRegionFrameTestCase ()
+{
+}
+
+bool
+LoRaWANRegionFrameTestCase::GatewayReceive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from)
+{
+  LoRaWANPhyParamsTag phyParamsTag;
+  packet->PeekPacketTag (phyParamsTag);
+  m_uplinks.push_back (std::make_pair (phyParamsTag.GetChannelIndex (), phyParamsTag.GetDataRateIndex ()));
+
+  // Answer in RW1, as the network server does
+  const uint8_t channelIndex = LoRaWAN::GetRX1ChannelIndex (phyParamsTag.GetChannelIndex ());
+  const uint8_t dataRateIndex = LoRaWAN::GetRX1DataRateIndex (phyParamsTag.GetDataRateIndex (), 0);
+  Simulator::Schedule (MicroSeconds (RECEIVE_DELAY1), &LoRaWANRegionFrameTestCase::SendDownlink, this,
+                       DynamicCast<LoRaWANNetDevice> (device), channelIndex, dataRateIndex);
+  return true;
+}
+
+bool
+LoRaWANRegionFrameTestCase::EndDeviceReceive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from)
+{
+  LoRaWANPhyParamsTag phyParamsTag;
+  packet->PeekPacketTag (phyParamsTag);
+  m_downlinks.push_back (std::make_pair (phyParamsTag.GetChannelIndex (), phyParamsTag.GetDataRateIndex ()));
+  return true;
+}
+
+void
+LoRaWANRegionFrameTestCase::SendDownlink (Ptr<LoRaWANNetDevice> gateway, uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  LoRaWANFrameHeaderDownlink fhdr (Ipv4Address (1), false, false, false, false, 0, 1, 1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (channelIndex);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_DOWN);
+  packet->AddPacketTag (msgTypeTag);
+
+  NS_TEST_EXPECT_MSG_EQ (gateway->Send (packet, Address (), 0), true, "The gateway refused the DS frame");
+}
+
+void
+LoRaWANRegionFrameTestCase::DoRun (void)
+{
+  // The region is switched when the first LoRaWAN object is created
+  Config::SetGlobal ("LoRaWANRegion", StringValue (LoRaWAN::GetRegionPlan (m_region).name));
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  Ptr<Node> endDeviceNode = CreateObject<Node> ();
+  Ptr<ConstantPositionMobilityModel> endDeviceMobility = CreateObject<ConstantPositionMobilityModel> ();
+  endDeviceMobility->SetPosition (Vector (0.0, 0.0, 0.0));
+  endDeviceNode->AggregateObject (endDeviceMobility);
+  Ptr<LoRaWANNetDevice> endDevice = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  endDevice->SetAddress (Ipv4Address (1));
+  endDevice->SetChannel (channel);
+  endDeviceNode->AddDevice (endDevice);
+  endDevice->SetReceiveCallback (MakeCallback (&LoRaWANRegionFrameTestCase::EndDeviceReceive, this));
+
+  Ptr<Node> gatewayNode = CreateObject<Node> ();
+  Ptr<ConstantPositionMobilityModel> gatewayMobility = CreateObject<ConstantPositionMobilityModel> ();
+  gatewayMobility->SetPosition (Vector (100.0, 0.0, 0.0));
+  gatewayNode->AggregateObject (gatewayMobility);
+  Ptr<LoRaWANNetDevice> gateway = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  gateway->SetChannel (channel);
+  gatewayNode->AddDevice (gateway);
+  gateway->SetReceiveCallback (MakeCallback (&LoRaWANRegionFrameTestCase::GatewayReceive, this));
+
+  // The sub band limits of the region are TX powers of the region
+  const LoRaWANRegionPlan &plan = LoRaWAN::GetRegionPlan (m_region);
+  for (uint8_t i = 0; i < plan.nSubBands; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (plan.subBands[i].maxTXPower), true, "Invalid maximum TX power of sub band " << (uint16_t)i);
+    }
+
+  LoRaWANFrameHeaderUplink fhdr (Ipv4Address (1), false, false, false, false, 0, 1, 1);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (fhdr);
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (m_channelIndex);
+  phyParamsTag.SetDataRateIndex (m_dataRateIndex);
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANNetDevice::Send, endDevice, packet, Address (), 0);
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_uplinks.size (), 1, "The gateway did not receive the US frame");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)m_uplinks[0].first, (uint16_t)m_channelIndex, "Wrong channel of the US frame");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)m_uplinks[0].second, (uint16_t)m_dataRateIndex, "Wrong data rate of the US frame");
+  NS_TEST_ASSERT_MSG_EQ (m_downlinks.size (), 1, "The end device did not receive the DS frame in RW1");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)m_downlinks[0].first, (uint16_t)LoRaWAN::GetRX1ChannelIndex (m_channelIndex), "Wrong channel of the DS frame");
+
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANRegionFrameTestCase::DoTeardown (void)
+{
+  Config::SetGlobal ("LoRaWANRegion", StringValue ("EU868"));
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+}
+
+class LoRaWANRegionTestSuite : public TestSuite
+{
+public:
+  LoRaWANRegionTestSuite ();
+};
+
+LoRaWANRegionTestSuite::LoRaWANRegionTestSuite ()
+  : TestSuite ("lorawan-region", UNIT)
+{
+  AddTestCase (new LoRaWANRegionTestCase, TestCase::QUICK);
+  // A channel and data rate the gateways listen on
+  AddTestCase (new LoRaWANRegionFrameTestCase (LORAWAN_REGION_EU868, 0, 5), TestCase::QUICK);
+  AddTestCase (new LoRaWANRegionFrameTestCase (LORAWAN_REGION_US915, 8, 0), TestCase::QUICK);
+  AddTestCase (new LoRaWANRegionFrameTestCase (LORAWAN_REGION_AS923, 0, 5), TestCase::QUICK);
+}
+
+static LoRaWANRegionTestSuite lorawanRegionTestSuite;
@@ -0,0 +1,367 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/packet.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-spectrum-channel-test");
+
+class LoRaWANSpectrumChannelCullingTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelCullingTestCase (bool receiverCulling);
+  virtual ~LoRaWANSpectrumChannelCullingTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  Ptr<LoRaWANPhy> CreatePhy (Ptr<SpectrumChannel> channel, Vector position, uint8_t channelIndex);
+  void PathLoss (Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb);
+  void ReceivePdDataIndication (uint32_t psduLength, Ptr<Packet> p, uint8_t lqi,
+                                uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate);
+
+  bool m_receiverCulling;
+  uint32_t m_pathLossCount;
+  uint32_t m_receivedCount;
+};
+
+LoRaWANSpectrumChannelCullingTestCase::LoRaWANSpectrumChannelCullingTestCase (bool receiverCulling)
+  : TestCase (receiverCulling ? "Test LoRaWAN spectrum channel with receiver culling"
+                              : "Test LoRaWAN spectrum channel without receiver culling"),
+    m_receiverCulling (receiverCulling),
+    m_pathLossCount (0),
+    m_receivedCount (0)
+{
+}
+
+LoRaWANSpectrumChannelCullingTestCase::~LoRaWANSpectrumChannelCullingTestCase ()
+{
+}
+
+Ptr<LoRaWANPhy>
+LoRaWANSpectrumChannelCullingTestCase::CreatePhy (Ptr<SpectrumChannel> channel, Vector position, uint8_t channelIndex)
+{
+  Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (0);
+  phy->SetChannel (channel);
+  channel->AddRx (phy);
+
+  Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (position);
+  phy->SetMobility (mobility);
+  phy->SetErrorModel (CreateObject<LoRaWANErrorModel> ());
+
+  phy->SetTxConf (14, channelIndex, 5, 1, 8, false, true);
+  phy->SetPdDataIndicationCallback (MakeCallback (&LoRaWANSpectrumChannelCullingTestCase::ReceivePdDataIndication, this));
+  return phy;
+}
+
+void
+LoRaWANSpectrumChannelCullingTestCase::PathLoss (Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb)
+{
+  m_pathLossCount++;
+}
+
+void
+LoRaWANSpectrumChannelCullingTestCase::ReceivePdDataIndication (uint32_t psduLength, Ptr<Packet> p, uint8_t lqi,
+                                                                uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate)
+{
+  m_receivedCount++;
+}
+
+void
+LoRaWANSpectrumChannelCullingTestCase::DoRun (void)
+{
+  const double maxLossDb = 160.0;
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("ReceiverCulling", BooleanValue (m_receiverCulling));
+  channel->SetAttribute ("MaxLossDb", DoubleValue (maxLossDb));
+  Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
+  channel->AddPropagationLossModel (lossModel);
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  channel->TraceConnectWithoutContext ("PathLoss", MakeCallback (&LoRaWANSpectrumChannelCullingTestCase::PathLoss, this));
+
+  Ptr<LoRaWANPhy> sender = CreatePhy (channel, Vector (0.0, 0.0, 0.0), 0);
+  Ptr<LoRaWANPhy> sameChannel = CreatePhy (channel, Vector (100.0, 0.0, 0.0), 0);
+  Ptr<LoRaWANPhy> otherChannel = CreatePhy (channel, Vector (0.0, 100.0, 0.0), 1);
+  Ptr<LoRaWANPhy> farAway = CreatePhy (channel, Vector (50000.0, 0.0, 0.0), 0);
+
+  sender->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+  sameChannel->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+  otherChannel->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+  farAway->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+
+  Ptr<Packet> p = Create<Packet> (10);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANPhy::PdDataRequest, sender, p->GetSize (), p);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_receivedCount, 1, "Only the nearby receiver on the same channel should receive the frame");
+  if (m_receiverCulling)
+    {
+      // LogDistance: L = L0 + 10 n log10 (d / d0)
+      const double expectedRadius = std::pow (10.0, (maxLossDb - 46.6777) / 30.0);
+      NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetCullRadius (), expectedRadius, 1.0, "Unexpected cull radius");
+      NS_TEST_ASSERT_MSG_EQ (m_pathLossCount, 1, "Out of band and out of range receivers should be culled");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_pathLossCount, 3, "All receivers should be visited without culling");
+    }
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANSpectrumChannelBucketTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelBucketTestCase ();
+  virtual ~LoRaWANSpectrumChannelBucketTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  Ptr<LoRaWANPhy> CreatePhy (Ptr<LoRaWANSpectrumChannel> channel, uint8_t channelIndex, bool noiseListener);
+  void PathLoss (Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb);
+
+  uint32_t m_pathLossCount;
+};
+
+LoRaWANSpectrumChannelBucketTestCase::LoRaWANSpectrumChannelBucketTestCase ()
+  : TestCase ("Test that the LoRaWAN spectrum channel tracks the channel PHYs are tuned to"),
+    m_pathLossCount (0)
+{
+}
+
+LoRaWANSpectrumChannelBucketTestCase::~LoRaWANSpectrumChannelBucketTestCase ()
+{
+}
+
+Ptr<LoRaWANPhy>
+LoRaWANSpectrumChannelBucketTestCase::CreatePhy (Ptr<LoRaWANSpectrumChannel> channel, uint8_t channelIndex, bool noiseListener)
+{
+  Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (0);
+  phy->SetChannel (channel);
+  phy->SetTxConf (14, channelIndex, 5, 1, 8, false, true);
+  if (noiseListener)
+    {
+      channel->AddNoiseListener (phy);
+    }
+  else
+    {
+      channel->AddRx (phy);
+    }
+
+  Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (Vector (100.0, 0.0, 0.0));
+  phy->SetMobility (mobility);
+  phy->SetErrorModel (CreateObject<LoRaWANErrorModel> ());
+  phy->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+  return phy;
+}
+
+void
+LoRaWANSpectrumChannelBucketTestCase::PathLoss (Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb)
+{
+  m_pathLossCount++;
+}
+
+void
+LoRaWANSpectrumChannelBucketTestCase::DoRun (void)
+{
+  // The loss model never exceeds MaxLossDb, so only the channel buckets cull receivers
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("ReceiverCulling", BooleanValue (true));
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  channel->TraceConnectWithoutContext ("PathLoss", MakeCallback (&LoRaWANSpectrumChannelBucketTestCase::PathLoss, this));
+
+  Ptr<LoRaWANPhy> sender = CreatePhy (channel, 0, false);
+  Ptr<LoRaWANPhy> retunedTo = CreatePhy (channel, 1, false);
+  Ptr<LoRaWANPhy> retunedFrom = CreatePhy (channel, 0, false);
+  Ptr<LoRaWANPhy> listener = CreatePhy (channel, 3, true);
+  // Receivers beyond the first 64 are in the next word of the bucket bitmaps
+  Ptr<LoRaWANPhy> far;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      far = CreatePhy (channel, 5, false);
+    }
+  sender->GetMobility ()->SetPosition (Vector (0.0, 0.0, 0.0));
+  sender->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+
+  retunedTo->SetTxConf (14, 0, 5, 1, 8, false, true);
+  retunedFrom->SetTxConf (14, 2, 5, 1, 8, false, true);
+  listener->SetTxConf (14, 4, 5, 1, 8, false, true);
+  far->SetTxConf (14, 0, 5, 1, 8, false, true);
+
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)channel->GetRxChannelIndex (retunedTo), 0, "Retuned PHY should be registered on its new channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)channel->GetRxChannelIndex (retunedFrom), 2, "Retuned PHY should be registered on its new channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)channel->GetRxChannelIndex (listener), LoRaWANSpectrumChannel::ALL_CHANNELS, "Noise listeners should stay on all channels");
+
+  Ptr<Packet> p = Create<Packet> (10);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANPhy::PdDataRequest, sender, p->GetSize (), p);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_pathLossCount, 3, "Only the PHYs on channel 0 and the noise listener should be visited");
+
+  // A disposed channel must no longer track the receivers
+  channel->Dispose ();
+  far->GetMobility ()->SetPosition (Vector (1.0e5, 0.0, 0.0));
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANSpectrumChannelCullRadiusTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelCullRadiusTestCase ();
+  virtual ~LoRaWANSpectrumChannelCullRadiusTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  double GetCullRadius (Ptr<PropagationLossModel> loss);
+};
+
+LoRaWANSpectrumChannelCullRadiusTestCase::LoRaWANSpectrumChannelCullRadiusTestCase ()
+  : TestCase ("Test that the cull radius is only derived for deterministic loss models")
+{
+}
+
+LoRaWANSpectrumChannelCullRadiusTestCase::~LoRaWANSpectrumChannelCullRadiusTestCase ()
+{
+}
+
+double
+LoRaWANSpectrumChannelCullRadiusTestCase::GetCullRadius (Ptr<PropagationLossModel> loss)
+{
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("ReceiverCulling", BooleanValue (true));
+  channel->SetAttribute ("MaxLossDb", DoubleValue (160.0));
+  channel->AddPropagationLossModel (loss);
+  const double radius = channel->GetCullRadius ();
+  channel->Dispose ();
+  return radius;
+}
+
+void
+LoRaWANSpectrumChannelCullRadiusTestCase::DoRun (void)
+{
+  Ptr<LogDistancePropagationLossModel> logDistance = CreateObject<LogDistancePropagationLossModel> ();
+  logDistance->SetNext (CreateObject<FriisPropagationLossModel> ());
+  NS_TEST_ASSERT_MSG_GT (GetCullRadius (logDistance), 0.0, "A chain of deterministic models should have a cull radius");
+
+  Ptr<LogDistancePropagationLossModel> faded = CreateObject<LogDistancePropagationLossModel> ();
+  faded->SetNext (CreateObject<NakagamiPropagationLossModel> ());
+  NS_TEST_ASSERT_MSG_LT (GetCullRadius (faded), 0.0, "A random model in the chain should disable culling on distance");
+
+  NS_TEST_ASSERT_MSG_LT (GetCullRadius (CreateObject<RandomPropagationLossModel> ()), 0.0,
+                         "A random model should disable culling on distance");
+}
+
+class LoRaWANSpectrumSignalParametersPoolTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumSignalParametersPoolTestCase ();
+  virtual ~LoRaWANSpectrumSignalParametersPoolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSpectrumSignalParametersPoolTestCase::LoRaWANSpectrumSignalParametersPoolTestCase ()
+  : TestCase ("Test that LoRaWAN signal parameters and their PSDs are reused")
+{
+}
+
+LoRaWANSpectrumSignalParametersPoolTestCase::~LoRaWANSpectrumSignalParametersPoolTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumSignalParametersPoolTestCase::DoRun (void)
+{
+  LoRaWANSpectrumValueHelper psdHelper;
+  Ptr<SpectrumValue> txPsd = psdHelper.CreateTxPowerSpectralDensity (14, LoRaWAN::m_supportedChannels [2].m_fc);
+
+  Ptr<LoRaWANSpectrumSignalParameters> txParams = Create<LoRaWANSpectrumSignalParameters> ();
+  txParams->psd = txPsd;
+  txParams->channelIndex = 2;
+  txParams->dataRateIndex = 3;
+  txParams->codeRate = 1;
+
+  // Release a copy, so that both its memory and its PSD end up in the pool
+  Ptr<SpectrumSignalParameters> copy = txParams->Copy ();
+  const SpectrumSignalParameters* copyAddress = PeekPointer (copy);
+  const SpectrumValue* copyPsdAddress = PeekPointer (copy->psd);
+  copy = 0;
+
+  const uint64_t avoided = LoRaWANSpectrumSignalParameters::GetAvoidedAllocations ();
+  Ptr<LoRaWANSpectrumSignalParameters> reused = DynamicCast<LoRaWANSpectrumSignalParameters> (txParams->Copy ());
+  NS_TEST_ASSERT_MSG_EQ (PeekPointer (reused), copyAddress, "Released parameters should be reused");
+  NS_TEST_ASSERT_MSG_EQ (PeekPointer (reused->psd), copyPsdAddress, "Released PSD should be reused");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANSpectrumSignalParameters::GetAvoidedAllocations (), avoided + 3, "Unexpected number of avoided allocations");
+
+  NS_TEST_ASSERT_MSG_NE (PeekPointer (reused->psd), PeekPointer (txPsd), "The copy should have its own PSD");
+  for (uint32_t i = 0; i < txPsd->GetSpectrumModel ()->GetNumBands (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((*reused->psd)[i], (*txPsd)[i], "The reused PSD should hold the copied values");
+    }
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)reused->channelIndex, 2, "Unexpected channel index");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)reused->dataRateIndex, 3, "Unexpected data rate index");
+
+  // A PSD that is still referenced elsewhere must not be pooled
+  Ptr<SpectrumValue> held = reused->psd;
+  reused = 0;
+  Ptr<SpectrumSignalParameters> other = txParams->Copy ();
+  NS_TEST_ASSERT_MSG_NE (PeekPointer (other->psd), PeekPointer (held), "A referenced PSD should not be reused");
+}
+
+// ==============================================================================
+class LoRaWANSpectrumChannelTestSuite : public TestSuite
+{
+public:
+  LoRaWANSpectrumChannelTestSuite ();
+};
+
+LoRaWANSpectrumChannelTestSuite::LoRaWANSpectrumChannelTestSuite ()
+  : TestSuite ("lorawan-spectrum-channel", UNIT)
+{
+  AddTestCase (new LoRaWANSpectrumChannelCullingTestCase (false), TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelCullingTestCase (true), TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelBucketTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelCullRadiusTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumSignalParametersPoolTestCase, TestCase::QUICK);
+}
+
+static LoRaWANSpectrumChannelTestSuite lorawanSpectrumChannelTestSuite;
@@ -0,0 +1,190 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/packet-socket-helper.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-uplink-generator-test");
+
+/*
+ * A population of end devices sends frames with and without an uplink
+ * generator. The end devices have to send at the same times in both cases.
+ */
+class LoRaWANUplinkGeneratorTestCase : public TestCase
+{
+public:
+  LoRaWANUplinkGeneratorTestCase ();
+  virtual ~LoRaWANUplinkGeneratorTestCase ();
+
+private:
+  typedef std::vector<std::pair<Time, uint32_t> > TxList;
+
+  virtual void DoRun (void);
+  TxList Send (bool generator, std::string upstreamSend);
+  static void USMsgTransmitted (TxList *txList, uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p);
+  static void Batch (std::vector<uint32_t> *batches, Time time, uint32_t size);
+  static void Payload (std::vector<Ptr<Packet> > *payloads, uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p);
+
+  std::vector<uint32_t> m_batches;
+  std::vector<Ptr<Packet> > m_payloads;
+};
+
+LoRaWANUplinkGeneratorTestCase::LoRaWANUplinkGeneratorTestCase ()
+  : TestCase ("Test the LoRaWAN uplink generator")
+{
+}
+
+LoRaWANUplinkGeneratorTestCase::~LoRaWANUplinkGeneratorTestCase ()
+{
+}
+
+void
+LoRaWANUplinkGeneratorTestCase::USMsgTransmitted (TxList *txList, uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p)
+{
+  txList->push_back (std::make_pair (Simulator::Now (), deviceAddress));
+}
+
+void
+LoRaWANUplinkGeneratorTestCase::Batch (std::vector<uint32_t> *batches, Time time, uint32_t size)
+{
+  batches->push_back (size);
+}
+
+void
+LoRaWANUplinkGeneratorTestCase::Payload (std::vector<Ptr<Packet> > *payloads, uint32_t deviceAddress, uint8_t msgType, Ptr<const Packet> p)
+{
+  payloads->push_back (p->Copy ());
+}
+
+LoRaWANUplinkGeneratorTestCase::TxList
+LoRaWANUplinkGeneratorTestCase::Send (bool generator, std::string upstreamSend)
+{
+  const uint32_t nDevices = 10;
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  Ptr<LoRaWANUplinkGenerator> uplinkGenerator = CreateObject<LoRaWANUplinkGenerator> ();
+  m_batches.clear ();
+  m_payloads.clear ();
+  uplinkGenerator->TraceConnectWithoutContext ("Batch", MakeBoundCallback (&LoRaWANUplinkGeneratorTestCase::Batch, &m_batches));
+
+  TxList txList;
+  for (uint32_t i = 0; i < nDevices; i++)
+    {
+      Ptr<Node> node = CreateObject <Node> ();
+      Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+      dev->SetAddress (Ipv4Address (i + 1));
+      dev->SetChannel (channel);
+      node->AddDevice (dev);
+      dev->GetPhy ()->SetMobility (CreateObject<ConstantPositionMobilityModel> ());
+
+      PacketSocketHelper packetSocket;
+      packetSocket.Install (node);
+
+      Ptr<LoRaWANEndDeviceApplication> app = CreateObject<LoRaWANEndDeviceApplication> ();
+      app->SetAttribute ("UpstreamIAT", StringValue ("ns3::UniformRandomVariable[Min=100.0|Max=200.0]"));
+      app->SetAttribute ("UpstreamSend", StringValue (upstreamSend));
+      app->SetAttribute ("DataRateIndex", UintegerValue (5));
+      if (generator)
+        {
+          app->SetAttribute ("UplinkGenerator", PointerValue (uplinkGenerator));
+        }
+      app->AssignStreams (10 * i);
+      app->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&LoRaWANUplinkGeneratorTestCase::USMsgTransmitted, &txList));
+      app->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&LoRaWANUplinkGeneratorTestCase::Payload, &m_payloads));
+      node->AddApplication (app);
+      app->SetStartTime (Seconds (0));
+      app->SetStopTime (Seconds (1000));
+    }
+
+  Simulator::Stop (Seconds (1000));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::sort (txList.begin (), txList.end ());
+  return txList;
+}
+
+void
+LoRaWANUplinkGeneratorTestCase::DoRun (void)
+{
+  const std::string random = "ns3::UniformRandomVariable[Min=0.0|Max=100.0]";
+  TxList eventTxList = Send (false, random);
+  TxList generatorTxList = Send (true, random);
+
+  NS_TEST_ASSERT_MSG_GT (eventTxList.size (), 10, "Too few frames were sent");
+  NS_TEST_ASSERT_MSG_EQ (generatorTxList.size (), eventTxList.size (), "The generator sent a different number of frames");
+  for (uint32_t i = 0; i < generatorTxList.size () && i < eventTxList.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (generatorTxList[i].first, eventTxList[i].first, "The generator sent frame " << i << " at a different time");
+      NS_TEST_ASSERT_MSG_EQ (generatorTxList[i].second, eventTxList[i].second, "The generator sent frame " << i << " for a different device");
+    }
+
+  // The FRMPayloads start with the decrementing counter, followed by zeros
+  NS_TEST_ASSERT_MSG_EQ (m_payloads.size (), generatorTxList.size (), "Wrong number of traced frames");
+  uint64_t lastCounter = 0;
+  for (uint32_t i = 0; i < m_payloads.size (); i++)
+    {
+      LoRaWANFrameHeaderUplink fhdr;
+      m_payloads[i]->RemoveHeader (fhdr);
+      NS_TEST_ASSERT_MSG_EQ (m_payloads[i]->GetSize (), 33 - fhdr.GetSerializedSize () - 1 - 4, "Wrong FRMPayload size");
+      std::vector<uint8_t> payload (m_payloads[i]->GetSize ());
+      m_payloads[i]->CopyData (&payload[0], payload.size ());
+      uint64_t counter;
+      memcpy (&counter, &payload[0], sizeof (counter));
+      NS_TEST_ASSERT_MSG_EQ ((i == 0 || counter < lastCounter), true, "The counter of frame " << i << " did not decrement");
+      NS_TEST_ASSERT_MSG_EQ (std::count (payload.begin () + sizeof (counter), payload.end (), 0), (long)(payload.size () - sizeof (counter)), "The FRMPayload of frame " << i << " is not zero after the counter");
+      lastCounter = counter;
+    }
+
+  // All end devices start at the same time: the first frames are sent as one batch
+  Send (true, "ns3::ConstantRandomVariable[Constant=10.0]");
+  NS_TEST_ASSERT_MSG_EQ (m_batches.empty (), false, "No batches were dispatched");
+  NS_TEST_ASSERT_MSG_EQ (m_batches[0], 10, "The first frames were not sent as one batch");
+}
+
+class LoRaWANUplinkGeneratorTestSuite : public TestSuite
+{
+public:
+  LoRaWANUplinkGeneratorTestSuite ();
+};
+
+LoRaWANUplinkGeneratorTestSuite::LoRaWANUplinkGeneratorTestSuite ()
+  : TestSuite ("lorawan-uplink-generator", UNIT)
+{
+  AddTestCase (new LoRaWANUplinkGeneratorTestCase, TestCase::QUICK);
+}
+
+static LoRaWANUplinkGeneratorTestSuite lorawanUplinkGeneratorTestSuite;